@@ -20,3 +20,18 @@ std::unique_ptr<AppProvider> AppProvider::CreateAppProvider(TMsgGetter msg_gette
 
 	return provider;
 }
+
+
+void AppProvider::WarmUp()
+{
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+	XDGBasedAppProvider::StartDesktopDatabaseWarmUp();
+#endif
+}
+
+void AppProvider::Shutdown()
+{
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
+	XDGBasedAppProvider::StopDesktopDatabaseWarmUp();
+#endif
+}
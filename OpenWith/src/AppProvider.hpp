@@ -28,6 +28,10 @@ public:
 
 	static std::unique_ptr<AppProvider> CreateAppProvider(TMsgGetter msg_getter);
 
+	// Process-wide preparations done in background on plugin load and their teardown on unload.
+	static void WarmUp();
+	static void Shutdown();
+
 	virtual std::vector<CandidateInfo> GetAppCandidates(const std::vector<std::wstring>& filepaths) = 0;
 	virtual std::vector<std::wstring> GetMimeTypes() = 0;
 	virtual std::vector<std::wstring> ConstructLaunchCommands(const CandidateInfo& candidate, const std::vector<std::wstring>& filepaths) = 0;
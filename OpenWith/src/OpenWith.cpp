@@ -516,6 +516,7 @@ SHAREDSYMBOL void WINAPI SetStartupInfoW(const struct PluginStartupInfo *Info)
 	g_fsf = *Info->FSF;
 	g_info.FSF = &g_fsf;
 	OpenWithPlugin::LoadGeneralSettings();
+	AppProvider::WarmUp();
 }
 
 
@@ -617,6 +618,7 @@ SHAREDSYMBOL int WINAPI ConfigureW(int ItemNumber)
 
 SHAREDSYMBOL void WINAPI ExitFARW()
 {
+	AppProvider::Shutdown();
 }
 
 
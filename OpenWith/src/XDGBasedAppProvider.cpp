@@ -10,10 +10,12 @@
 #include <dirent.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <fnmatch.h>
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <fstream>
 #include <sstream>
@@ -26,6 +28,7 @@
 
 #define INI_LOCATION_XDG InMyConfig("plugins/openwith/config.ini")
 #define INI_SECTION_XDG  "Settings.XDG"
+#define DESKTOP_DATABASE_LOCATION InMyCache("plugins/openwith/desktop_database.idx")
 
 
 
@@ -396,7 +399,7 @@ XDGBasedAppProvider::CandidateMap XDGBasedAppProvider::DiscoverCandidatesForExpa
 	AppendCandidatesFromMimeAppsLists(expanded_mimes, unique_candidates);
 
 	// Find candidates using the cache prepared by OperationContext.
-	if (!_op_mime_to_desktop_associations_index.empty()) {
+	if (_op_use_mimeinfo_associations) {
 		// Use 'mimeinfo.cache' (fast path).
 		AppendCandidatesFromMimeinfoCache(expanded_mimes, unique_candidates);
 	} else {
@@ -460,7 +463,8 @@ void XDGBasedAppProvider::AppendCandidatesFromMimeAppsLists(const std::vector<st
 
 void XDGBasedAppProvider::AppendCandidatesFromMimeinfoCache(const std::vector<std::string>& expanded_mimes, CandidateMap& unique_candidates)
 {
-	if (_op_mime_to_desktop_associations_index.empty()) {
+	const auto& mime_to_desktop_associations = _op_desktop_database->mime_to_desktop_associations;
+	if (mime_to_desktop_associations.empty()) {
 		return;
 	}
 	const int total_mimes = expanded_mimes.size();
@@ -469,8 +473,8 @@ void XDGBasedAppProvider::AppendCandidatesFromMimeinfoCache(const std::vector<st
 	// Iterate through the expanded MIME types list (ordered from most specific to least specific).
 	for (int i = 0; i < total_mimes; ++i) {
 		const auto& mime = expanded_mimes[i];
-		auto it_cache = _op_mime_to_desktop_associations_index.find(mime);
-		if (it_cache != _op_mime_to_desktop_associations_index.end()) {
+		auto it_cache = mime_to_desktop_associations.find(mime);
+		if (it_cache != mime_to_desktop_associations.end()) {
 			int rank = (total_mimes - i) * Ranking::SPECIFICITY_MULTIPLIER + Ranking::SOURCE_RANK_CACHE_OR_SCAN;
 			for (const auto& desktop_association : it_cache->second) {
 				const auto& desktop_id = desktop_association.desktop_id;
@@ -496,10 +500,12 @@ void XDGBasedAppProvider::AppendCandidatesFromMimeinfoCache(const std::vector<st
 }
 
 
-// Finds and registers candidates using the internal runtime index built during the fullscan by ParseAllDesktopFiles().
+// Finds and registers candidates using the MimeType keys index built by the full scan in ScanDesktopFilesMimeTypes().
+// Desktop entries are parsed lazily, only for the Desktop IDs that match the requested MIME types.
 void XDGBasedAppProvider::AppendCandidatesFromDesktopEntryIndex(const std::vector<std::string>& expanded_mimes, CandidateMap& unique_candidates)
 {
-	if (_op_mime_to_desktop_entry_index.empty()) {
+	const auto& mime_to_desktop_ids = _op_desktop_database->mime_to_desktop_ids;
+	if (mime_to_desktop_ids.empty()) {
 		return;
 	}
 	const int total_mimes = expanded_mimes.size();
@@ -508,17 +514,22 @@ void XDGBasedAppProvider::AppendCandidatesFromDesktopEntryIndex(const std::vecto
 	// Iterate through the expanded MIME types list (ordered from most specific to least specific).
 	for (int i = 0; i < total_mimes; ++i) {
 		const auto& mime = expanded_mimes[i];
-		auto it_index = _op_mime_to_desktop_entry_index.find(mime);
-		if (it_index == _op_mime_to_desktop_entry_index.end()) {
+		auto it_index = mime_to_desktop_ids.find(mime);
+		if (it_index == mime_to_desktop_ids.end()) {
 			continue; // No applications associated with this MIME type in the index.
 		}
 		int rank = (total_mimes - i) * Ranking::SPECIFICITY_MULTIPLIER + Ranking::SOURCE_RANK_CACHE_OR_SCAN;
 		// Iterate through all applications found for this MIME type in the index.
-		for (const DesktopEntry* desktop_entry_ptr : it_index->second) {
-			if (!desktop_entry_ptr) continue;
-			if (IsAssociationRemoved(mime, desktop_entry_ptr->id)) {
+		for (const auto& desktop_id : it_index->second) {
+			if (IsAssociationRemoved(mime, desktop_id)) {
 				continue;
 			}
+			// Skips entries that turned out to be invalid (hidden, not an application, etc.).
+			const auto& desktop_entry_opt = GetOrLoadDesktopEntry(desktop_id);
+			if (!desktop_entry_opt) {
+				continue;
+			}
+			const DesktopEntry* desktop_entry_ptr = &desktop_entry_opt.value();
 			auto source_info = StrWide2MB(m_GetMsg(MFullScanFor)) + mime;
 			// Insert or update the score for this DesktopEntry pointer.
 			auto [it, inserted] = desktop_entry_to_score_map.try_emplace(desktop_entry_ptr, rank, source_info);
@@ -988,26 +999,160 @@ std::string XDGBasedAppProvider::GuessMimeTypeByExtension(const std::string& fil
 // ****************************** XDG database parsing & caching ******************************
 
 
-// Recursively scans all XDG application directories to build an index mapping Desktop File IDs to their absolute file paths.
-std::unordered_map<std::string, std::string> XDGBasedAppProvider::IndexAllDesktopFiles()
+// Returns the desktop database that matches the current state of the XDG application directories.
+// Tries the in-memory snapshot first, then the one persisted by previous sessions, and rebuilds it
+// only if both are outdated. The full scan of MimeType keys is added on demand as it requires
+// reading every .desktop file; once done, it's kept in all later rebuilds.
+std::shared_ptr<const XDGBasedAppProvider::DesktopDatabase> XDGBasedAppProvider::AcquireDesktopDatabase(bool need_mime_types_scan)
 {
-	if (_op_desktop_file_dirpaths.empty()) {
-		return {};
+	std::lock_guard<std::mutex> lock(s_desktop_database_mutex);
+
+	const auto search_dirpaths = GetDesktopFileSearchDirpaths();
+	const std::string index_filepath = DESKTOP_DATABASE_LOCATION;
+
+	std::shared_ptr<const DesktopDatabase> database = s_desktop_database;
+	const bool had_mime_types_scan = database && database->has_mime_types_scan;
+
+	if (!database || !IsDesktopDatabaseActual(*database, search_dirpaths)) {
+		database = LoadDesktopDatabase(index_filepath);
+		if (database && !IsDesktopDatabaseActual(*database, search_dirpaths)) {
+			database.reset();
+		}
+	}
+
+	bool modified = false;
+	if (!database) {
+		database = BuildDesktopDatabase(search_dirpaths, need_mime_types_scan || had_mime_types_scan);
+		modified = true;
+
+	} else if (need_mime_types_scan && !database->has_mime_types_scan) {
+		auto extended_database = std::make_shared<DesktopDatabase>(*database);
+		ScanDesktopFilesMimeTypes(*extended_database);
+		database = extended_database;
+		modified = true;
+	}
+
+	if (modified) {
+		SaveDesktopDatabase(*database, index_filepath);
+	}
+
+	s_desktop_database = database;
+	return database;
+}
+
+
+void XDGBasedAppProvider::StartDesktopDatabaseWarmUp()
+{
+	if (s_desktop_database_warmup.joinable()) {
+		return;
+	}
+
+	// Failures are not fatal here: the database will be acquired again by the first GetAppCandidates call.
+	try {
+		s_desktop_database_warmup = std::thread([] {
+			try {
+				AcquireDesktopDatabase(false);
+			} catch (...) {
+			}
+		});
+	} catch (...) {
+	}
+}
+
+
+void XDGBasedAppProvider::StopDesktopDatabaseWarmUp()
+{
+	if (s_desktop_database_warmup.joinable()) {
+		s_desktop_database_warmup.join();
 	}
 
-	std::unordered_map<std::string, std::string> desktop_id_to_path_map;
+	std::lock_guard<std::mutex> lock(s_desktop_database_mutex);
+	s_desktop_database.reset();
+}
+
+
+// Recursively scans all XDG application directories to build an index mapping Desktop File IDs to their
+// absolute file paths, stamping every walked directory, and parses 'mimeinfo.cache' of each search directory.
+std::shared_ptr<XDGBasedAppProvider::DesktopDatabase> XDGBasedAppProvider::BuildDesktopDatabase(const std::vector<std::string>& search_dirpaths, bool with_mime_types_scan)
+{
+	auto database = std::make_shared<DesktopDatabase>();
+	database->search_dirpaths = search_dirpaths;
 
 	VisitedInodeSet visited_inodes;
 
-	for (const auto& dirpath : _op_desktop_file_dirpaths) {
-		IndexDirectoryRecursively(desktop_id_to_path_map, dirpath, dirpath, visited_inodes);
+	for (const auto& dirpath : search_dirpaths) {
+		IndexDirectoryRecursively(*database, dirpath, dirpath, visited_inodes);
+	}
+
+	for (const auto& dirpath : search_dirpaths) {
+		std::string filepath = dirpath + "/mimeinfo.cache";
+		struct stat st;
+		database->file_stamps.push_back(MakeStamp(filepath, stat(filepath.c_str(), &st) == 0 ? &st : nullptr));
+		if (IsReadableFile(filepath)) {
+			ParseMimeinfoCache(filepath, database->mime_to_desktop_associations);
+		}
 	}
 
-	return desktop_id_to_path_map;
+	// Filesystem timestamps are coarser than the real time, so a change made right after an object
+	// was scanned may keep its mtime intact. Recently modified objects get an impossible stamp instead
+	// to be rescanned on the next revalidation, which will happen once they settle down.
+	struct timespec now;
+	if (clock_gettime(CLOCK_REALTIME, &now) == 0) {
+		const uint64_t recent_mtime_ns = (uint64_t(now.tv_sec) - 2) * 1000000000;
+		for (auto* stamps : { &database->dir_stamps, &database->file_stamps }) {
+			for (auto& stamp : *stamps) {
+				if (stamp.mtime_ns >= recent_mtime_ns) {
+					stamp.mtime_ns = 0;
+					stamp.size = UINT64_MAX;
+				}
+			}
+		}
+	}
+
+	if (with_mime_types_scan) {
+		ScanDesktopFilesMimeTypes(*database);
+	}
+
+	return database;
+}
+
+
+// Checks that nothing has been added, removed or renamed in the indexed directories since the database was built.
+// Note that in-place modifications of .desktop files don't change their directory's mtime, but that's fine
+// as the database holds only locations of these files, and their content is always parsed at runtime.
+bool XDGBasedAppProvider::IsDesktopDatabaseActual(const DesktopDatabase& database, const std::vector<std::string>& search_dirpaths)
+{
+	if (database.search_dirpaths != search_dirpaths) {
+		return false;
+	}
+
+	for (const auto* stamps : { &database.dir_stamps, &database.file_stamps }) {
+		for (const auto& stamp : *stamps) {
+			struct stat st;
+			const auto actual_stamp = MakeStamp(stamp.path, stat(stamp.path.c_str(), &st) == 0 ? &st : nullptr);
+			if (actual_stamp.mtime_ns != stamp.mtime_ns || actual_stamp.size != stamp.size) {
+				return false;
+			}
+		}
+	}
+
+	return true;
 }
 
 
-void XDGBasedAppProvider::IndexDirectoryRecursively(std::unordered_map<std::string, std::string>& desktop_id_to_path_map, const std::string& current_path, const std::string& base_dir_prefix, VisitedInodeSet &visited_inodes)
+XDGBasedAppProvider::DesktopDatabase::Stamp XDGBasedAppProvider::MakeStamp(const std::string& path, const struct stat* st)
+{
+	DesktopDatabase::Stamp stamp;
+	stamp.path = path;
+	if (st) {
+		stamp.mtime_ns = uint64_t(st->st_mtim.tv_sec) * 1000000000 + uint64_t(st->st_mtim.tv_nsec);
+		stamp.size = S_ISDIR(st->st_mode) ? 0 : uint64_t(st->st_size);
+	}
+	return stamp;
+}
+
+
+void XDGBasedAppProvider::IndexDirectoryRecursively(DesktopDatabase& database, const std::string& current_path, const std::string& base_dir_prefix, VisitedInodeSet &visited_inodes)
 {
 	struct stat st;
 	if (stat(current_path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
@@ -1022,6 +1167,8 @@ void XDGBasedAppProvider::IndexDirectoryRecursively(std::unordered_map<std::stri
 	DIR* dir_stream = opendir(current_path.c_str());
 	if (!dir_stream) return;
 
+	database.dir_stamps.push_back(MakeStamp(current_path, &st));
+
 	struct dirent* dir_entry;
 
 	while ((dir_entry = readdir(dir_stream))) {
@@ -1064,7 +1211,7 @@ void XDGBasedAppProvider::IndexDirectoryRecursively(std::unordered_map<std::stri
 		}
 
 		if (is_dir) {
-			IndexDirectoryRecursively(desktop_id_to_path_map, full_path, base_dir_prefix, visited_inodes);
+			IndexDirectoryRecursively(database, full_path, base_dir_prefix, visited_inodes);
 		} else if (is_reg) {
 			if (name.size() > 8 && name.compare(name.size() - 8, 8, ".desktop") == 0) {
 				// Calculate ID: relative path from base_dir_prefix, with '/' replaced by '-'.
@@ -1072,7 +1219,7 @@ void XDGBasedAppProvider::IndexDirectoryRecursively(std::unordered_map<std::stri
 					std::string id = full_path.substr(base_dir_prefix.size() + 1); // +1 for the separator
 					std::replace(id.begin(), id.end(), '/', '-');
 					// Store in the map. First found wins.
-					desktop_id_to_path_map.try_emplace(std::move(id), full_path);
+					database.desktop_id_to_path.try_emplace(std::move(id), full_path);
 				}
 			}
 		}
@@ -1089,8 +1236,8 @@ const std::optional<XDGBasedAppProvider::DesktopEntry>& XDGBasedAppProvider::Get
 		return it->second;
 	}
 
-	auto it_path = _op_desktop_id_to_path_index.find(desktop_id);
-	if (it_path != _op_desktop_id_to_path_index.end()) {
+	auto it_path = _op_desktop_database->desktop_id_to_path.find(desktop_id);
+	if (it_path != _op_desktop_database->desktop_id_to_path.end()) {
 		const std::string& filepath = it_path->second;
 		if (auto desktop_entry = ParseDesktopFile(filepath)) {
 			// Set the ID on the object, as ParseDesktopFile does not know it.
@@ -1106,48 +1253,280 @@ const std::optional<XDGBasedAppProvider::DesktopEntry>& XDGBasedAppProvider::Get
 }
 
 
-// Builds a reverse index by iterating through all discovered Desktop IDs and parsing their fields.
-XDGBasedAppProvider::MimeToDesktopEntryIndex XDGBasedAppProvider::ParseAllDesktopFiles()
+// Builds a reverse index of MimeType keys of all discovered .desktop files. Only the [Desktop Entry] section
+// is looked at, with the same rules as in ParseDesktopFile(); validity of the entries is checked later,
+// when they're parsed by GetOrLoadDesktopEntry() as candidates for the requested MIME types.
+void XDGBasedAppProvider::ScanDesktopFilesMimeTypes(DesktopDatabase& database)
 {
-	MimeToDesktopEntryIndex index;
+	database.mime_to_desktop_ids.clear();
 
-	// Iterate over all found IDs in the map.
-	for (const auto& [id, filepath] : _op_desktop_id_to_path_index) {
+	for (const auto& [id, filepath] : database.desktop_id_to_path) {
+		std::ifstream file(filepath);
+		if (!file.is_open()) continue;
 
-		// This call populates _desktop_id_to_desktop_entry_cache via GetOrLoadDesktopEntry logic.
-		const auto& desktop_entry_opt = GetOrLoadDesktopEntry(id);
-		if (!desktop_entry_opt.has_value()) {
-			continue;
+		std::string line, mimetype;
+		bool in_main_section = false;
+		while (std::getline(file, line)) {
+			line = Trim(line);
+			if (line.empty() || line[0] == '#') continue;
+			if (line == "[Desktop Entry]") {
+				in_main_section = true;
+				continue;
+			}
+			if (line[0] == '[') {
+				in_main_section = false;
+				continue;
+			}
+			if (in_main_section) {
+				auto eq_pos = line.find('=');
+				if (eq_pos != std::string::npos && Trim(line.substr(0, eq_pos)) == "MimeType") {
+					mimetype = Trim(line.substr(eq_pos + 1));
+				}
+			}
 		}
 
-		const DesktopEntry* desktop_entry_ptr = &desktop_entry_opt.value();
-
-		std::vector<std::string> entry_mimes = SplitString(desktop_entry_ptr->mimetype, ';');
-		for (const auto& mime : entry_mimes) {
+		for (const auto& mime : SplitString(mimetype, ';')) {
 			if (!mime.empty()) {
-				index[mime].push_back(desktop_entry_ptr);
+				database.mime_to_desktop_ids[mime].push_back(id);
 			}
 		}
 	}
-	return index;
+
+	database.has_mime_types_scan = true;
 }
 
 
-// Aggregates associations from all 'mimeinfo.cache' files found in the configured XDG data directories.
-XDGBasedAppProvider::MimeToDesktopAssociationsMap XDGBasedAppProvider::ParseAllMimeinfoCacheFiles()
+// The on-disk desktop database is a magic signature followed by a sequence of NUL-terminated tokens:
+// strings as is and numbers in decimal. Each list is prefixed with its number of elements:
+//   search dirpaths:     N, N x { dirpath }
+//   directory stamps:    N, N x { path, mtime_ns, size }
+//   'mimeinfo.cache':    N, N x { path, mtime_ns, size }
+//   Desktop IDs:         N, N x { desktop_id, filepath }
+//   cache associations:  N, N x { mime, M, M x { desktop_id, index of 'mimeinfo.cache' in its list } }
+//   MimeType keys scan:  0 or 1, N, N x { mime, M, M x { desktop_id } }
+// The file is mapped into memory and deserialized with bounds checks, so it can't crash us if corrupted.
+
+static const char s_desktop_database_magic[8] = {'O', 'W', 'X', 'D', 'G', 'D', 'B', '1'};
+
+namespace
 {
-	if (_op_desktop_file_dirpaths.empty()) {
-		return {};
+	class DesktopDatabaseReader
+	{
+		const char* _cur;
+		const char* _end;
+
+	public:
+		DesktopDatabaseReader(const char* data, size_t size) : _cur(data), _end(data + size) {}
+
+		bool AtEnd() const { return _cur == _end; }
+
+		bool Str(std::string& out)
+		{
+			const char* term = static_cast<const char*>(memchr(_cur, 0, _end - _cur));
+			if (!term) return false;
+			out.assign(_cur, term - _cur);
+			_cur = term + 1;
+			return true;
+		}
+
+		bool Num(uint64_t& out)
+		{
+			std::string token;
+			if (!Str(token) || token.empty()) return false;
+			char* token_end = nullptr;
+			out = strtoull(token.c_str(), &token_end, 10);
+			return *token_end == 0;
+		}
+
+		// Element counts are validated against the remaining size, each element takes at least one byte.
+		bool Count(size_t& out)
+		{
+			uint64_t num;
+			if (!Num(num) || num > uint64_t(_end - _cur)) return false;
+			out = size_t(num);
+			return true;
+		}
+	};
+
+	class DesktopDatabaseWriter
+	{
+		std::string _data;
+
+	public:
+		DesktopDatabaseWriter(const char* magic, size_t magic_size) : _data(magic, magic_size) {}
+
+		void Str(const std::string& str) { _data.append(str.c_str(), str.size() + 1); }
+		void Num(uint64_t num) { Str(std::to_string(num)); }
+		const std::string& Data() const { return _data; }
+	};
+}
+
+
+std::shared_ptr<XDGBasedAppProvider::DesktopDatabase> XDGBasedAppProvider::LoadDesktopDatabase(const std::string& filepath)
+{
+	int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return nullptr;
 	}
 
-	MimeToDesktopAssociationsMap mime_to_desktop_associations_map;
-	for (const auto& dirpath : _op_desktop_file_dirpaths) {
-		std::string filepath = dirpath + "/mimeinfo.cache";
-		if (IsReadableFile(filepath)) {
-			ParseMimeinfoCache(filepath, mime_to_desktop_associations_map);
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || size_t(st.st_size) <= sizeof(s_desktop_database_magic)) {
+		close(fd);
+		return nullptr;
+	}
+
+	const size_t size = size_t(st.st_size);
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED) {
+		return nullptr;
+	}
+
+	const char* data = static_cast<const char*>(view);
+	auto database = std::make_shared<DesktopDatabase>();
+
+	auto parse = [&]() -> bool {
+		if (memcmp(data, s_desktop_database_magic, sizeof(s_desktop_database_magic)) != 0) {
+			return false;
+		}
+
+		DesktopDatabaseReader reader(data + sizeof(s_desktop_database_magic), size - sizeof(s_desktop_database_magic));
+		size_t count, sub_count;
+		uint64_t num;
+		std::string str, str2;
+
+		if (!reader.Count(count)) return false;
+		database->search_dirpaths.resize(count);
+		for (auto& dirpath : database->search_dirpaths) {
+			if (!reader.Str(dirpath)) return false;
+		}
+
+		for (auto* stamps : { &database->dir_stamps, &database->file_stamps }) {
+			if (!reader.Count(count)) return false;
+			stamps->resize(count);
+			for (auto& stamp : *stamps) {
+				if (!reader.Str(stamp.path) || !reader.Num(stamp.mtime_ns) || !reader.Num(stamp.size)) return false;
+			}
+		}
+
+		if (!reader.Count(count)) return false;
+		database->desktop_id_to_path.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			if (!reader.Str(str) || !reader.Str(str2)) return false;
+			database->desktop_id_to_path.emplace(std::move(str), std::move(str2));
 		}
+
+		if (!reader.Count(count)) return false;
+		database->mime_to_desktop_associations.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			if (!reader.Str(str) || !reader.Count(sub_count)) return false;
+			auto& desktop_associations = database->mime_to_desktop_associations[str];
+			desktop_associations.reserve(sub_count);
+			for (size_t j = 0; j < sub_count; ++j) {
+				if (!reader.Str(str2) || !reader.Num(num) || num >= database->file_stamps.size()) return false;
+				desktop_associations.emplace_back(str2, database->file_stamps[num].path);
+			}
+		}
+
+		if (!reader.Num(num) || num > 1) return false;
+		database->has_mime_types_scan = (num != 0);
+		if (!reader.Count(count)) return false;
+		database->mime_to_desktop_ids.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			if (!reader.Str(str) || !reader.Count(sub_count)) return false;
+			auto& desktop_ids = database->mime_to_desktop_ids[str];
+			desktop_ids.resize(sub_count);
+			for (auto& desktop_id : desktop_ids) {
+				if (!reader.Str(desktop_id)) return false;
+			}
+		}
+
+		return reader.AtEnd() && database->file_stamps.size() == database->search_dirpaths.size();
+	};
+
+	const bool parsed = parse();
+	munmap(view, size);
+
+	return parsed ? database : nullptr;
+}
+
+
+// Writes the database to a temporary file and then renames it over the previous one,
+// so concurrent far2l instances never see partially written data.
+void XDGBasedAppProvider::SaveDesktopDatabase(const DesktopDatabase& database, const std::string& filepath)
+{
+	DesktopDatabaseWriter writer(s_desktop_database_magic, sizeof(s_desktop_database_magic));
+
+	writer.Num(database.search_dirpaths.size());
+	for (const auto& dirpath : database.search_dirpaths) {
+		writer.Str(dirpath);
+	}
+
+	for (const auto* stamps : { &database.dir_stamps, &database.file_stamps }) {
+		writer.Num(stamps->size());
+		for (const auto& stamp : *stamps) {
+			writer.Str(stamp.path);
+			writer.Num(stamp.mtime_ns);
+			writer.Num(stamp.size);
+		}
+	}
+
+	writer.Num(database.desktop_id_to_path.size());
+	for (const auto& [desktop_id, desktop_filepath] : database.desktop_id_to_path) {
+		writer.Str(desktop_id);
+		writer.Str(desktop_filepath);
+	}
+
+	std::unordered_map<std::string, size_t> source_filepath_to_index;
+	for (size_t i = 0; i < database.file_stamps.size(); ++i) {
+		source_filepath_to_index.emplace(database.file_stamps[i].path, i);
+	}
+
+	writer.Num(database.mime_to_desktop_associations.size());
+	for (const auto& [mime, desktop_associations] : database.mime_to_desktop_associations) {
+		writer.Str(mime);
+		writer.Num(desktop_associations.size());
+		for (const auto& desktop_association : desktop_associations) {
+			auto it = source_filepath_to_index.find(desktop_association.source_filepath);
+			if (it == source_filepath_to_index.end()) {
+				return; // can't happen as associations come only from stamped files
+			}
+			writer.Str(desktop_association.desktop_id);
+			writer.Num(it->second);
+		}
+	}
+
+	writer.Num(database.has_mime_types_scan ? 1 : 0);
+	writer.Num(database.mime_to_desktop_ids.size());
+	for (const auto& [mime, desktop_ids] : database.mime_to_desktop_ids) {
+		writer.Str(mime);
+		writer.Num(desktop_ids.size());
+		for (const auto& desktop_id : desktop_ids) {
+			writer.Str(desktop_id);
+		}
+	}
+
+	const std::string tmp_filepath = filepath + ".tmp" + std::to_string(getpid());
+	int fd = open(tmp_filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return;
+	}
+
+	const std::string& data = writer.Data();
+	bool written = true;
+	for (size_t ofs = 0; ofs < data.size(); ) {
+		ssize_t r = write(fd, data.data() + ofs, data.size() - ofs);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) {
+			written = false;
+			break;
+		}
+		ofs += size_t(r);
+	}
+
+	if (close(fd) != 0 || !written || rename(tmp_filepath.c_str(), filepath.c_str()) != 0) {
+		unlink(tmp_filepath.c_str());
 	}
-	return mime_to_desktop_associations_map;
 }
 
 
@@ -2280,10 +2659,10 @@ XDGBasedAppProvider::OperationContext::OperationContext(XDGBasedAppProvider& p)
 
 	// ----- Phase 2: Path Resolution & Desktop File Indexing -----
 
-	provider._op_desktop_file_dirpaths = provider.GetDesktopFileSearchDirpaths();
 	provider._op_mimeapps_list_filepaths = provider.GetMimeappsListSearchFilepaths();
 	provider._op_mime_database_dirpaths = provider.GetMimeDatabaseSearchDirpaths();
-	provider._op_desktop_id_to_path_index = provider.IndexAllDesktopFiles();
+	// Usually comes from memory or from the persistent index, the directories are walked only if they changed.
+	provider._op_desktop_database = AcquireDesktopDatabase(!provider._use_mimeinfo_cache);
 
 	// ----- Phase 3: Auxiliary MIME Databases & User Configuration -----
 
@@ -2314,15 +2693,14 @@ XDGBasedAppProvider::OperationContext::OperationContext(XDGBasedAppProvider& p)
 
 	// ----- Phase 4: Association Database Construction -----
 
-	if (provider._use_mimeinfo_cache) {
-		// Attempt to load from 'mimeinfo.cache' first, as per user setting.
-		provider._op_mime_to_desktop_associations_index = provider.ParseAllMimeinfoCacheFiles();
-	}
+	// Use associations from 'mimeinfo.cache' files first, as per user setting.
+	provider._op_use_mimeinfo_associations = provider._use_mimeinfo_cache
+		&& !provider._op_desktop_database->mime_to_desktop_associations.empty();
 
 	// If caching is disabled (by user) OR cache was empty...
-	if (provider._op_mime_to_desktop_associations_index.empty()) {
-		// ...populate the index by performing a full scan.
-		provider._op_mime_to_desktop_entry_index = provider.ParseAllDesktopFiles();
+	if (!provider._op_use_mimeinfo_associations && !provider._op_desktop_database->has_mime_types_scan) {
+		// ...extend the database by performing a full scan.
+		provider._op_desktop_database = AcquireDesktopDatabase(true);
 	}
 }
 
@@ -2335,18 +2713,16 @@ XDGBasedAppProvider::OperationContext::~OperationContext()
 	provider._op_xdg_mime_exists = false;
 	provider._op_file_tool_enabled_and_exists = false;
 	provider._op_magika_tool_enabled_and_exists = false;
-	provider._op_desktop_file_dirpaths.clear();
+	provider._op_desktop_database.reset();
+	provider._op_use_mimeinfo_associations = false;
 	provider._op_mimeapps_list_filepaths.clear();
 	provider._op_mime_database_dirpaths.clear();
-	provider._op_desktop_id_to_path_index.clear();
 	provider._op_glob_rules_cache.clear();
 	provider._op_alias_to_canonical_cache.clear();
 	provider._op_canonical_to_aliases_cache.clear();
 	provider._op_subclass_to_parent_cache.clear();
 	provider._op_mimeapps_lists_cache = {};
 	provider._op_mime_to_default_desktop_id_cache.clear();
-	provider._op_mime_to_desktop_associations_index.clear();
-	provider._op_mime_to_desktop_entry_index.clear();
 }
 
 #endif
@@ -5,8 +5,12 @@
 #include "AppProvider.hpp"
 #include "common.hpp"
 #include "lng.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -15,6 +19,7 @@
 #include <set>
 #include <utility>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 
 class XDGBasedAppProvider : public AppProvider
@@ -34,6 +39,11 @@ public:
 	void LoadPlatformSettings() override;
 	void SavePlatformSettings() override;
 
+	// Revalidates (and rebuilds if needed) the persistent desktop database in background,
+	// so the first invocation of the plugin doesn't have to wait for it.
+	static void StartDesktopDatabaseWarmUp();
+	static void StopDesktopDatabaseWarmUp();
+
 private:
 
 	// ******************************************************************************
@@ -198,6 +208,31 @@ private:
 	};
 
 
+	// Compact snapshot of the XDG application directories: locations of all .desktop files,
+	// associations from 'mimeinfo.cache' files and, on demand, MimeType keys of all entries.
+	// It's shared process-wide and persisted in the cache dir, so walking the directories isn't
+	// repeated on every invocation. The snapshot stays actual as long as the list of search
+	// directories and the stamps of every walked directory and 'mimeinfo.cache' file stay same.
+	struct DesktopDatabase
+	{
+		// Modification stamp of a filesystem object; all zeroes if the object doesn't exist.
+		struct Stamp
+		{
+			std::string path;
+			uint64_t mtime_ns = 0;
+			uint64_t size = 0;
+		};
+
+		std::vector<std::string> search_dirpaths;
+		std::vector<Stamp> dir_stamps;   // every directory walked while indexing .desktop files
+		std::vector<Stamp> file_stamps;  // 'mimeinfo.cache' of each search directory, in the same order
+		std::unordered_map<std::string, std::string> desktop_id_to_path;
+		std::unordered_map<std::string, std::vector<DesktopAssociation>> mime_to_desktop_associations;  // from 'mimeinfo.cache'
+		bool has_mime_types_scan = false;
+		std::unordered_map<std::string, std::vector<std::string>> mime_to_desktop_ids;  // from MimeType keys, if has_mime_types_scan
+	};
+
+
 	// ******************************************************************************
 	// Group 4: Ranking & Candidate Identification
 	// Structures used in the logic for selecting and sorting the best applications.
@@ -313,7 +348,6 @@ private:
 	// ******************************************************************************
 
 	using CandidateMap = std::unordered_map<AppUniqueKey, RankedCandidate, AppUniqueKey::Hash>;
-	using MimeToDesktopEntryIndex = std::unordered_map<std::string, std::vector<const DesktopEntry*>>;
 	using MimeToDesktopAssociationsMap = std::unordered_map<std::string, std::vector<DesktopAssociation>>;
 	using VisitedInodeSet = std::set<std::pair<dev_t, ino_t>>;
 
@@ -349,11 +383,15 @@ private:
 	static const std::unordered_map<std::string, std::string>& GetExtMimeMap();
 
 	// --- XDG database parsing & caching ---
-	std::unordered_map<std::string, std::string> IndexAllDesktopFiles();
-	void IndexDirectoryRecursively(std::unordered_map<std::string, std::string>& desktop_id_to_path_map, const std::string& current_path, const std::string& base_dir_prefix, VisitedInodeSet& visited_inodes);
+	static std::shared_ptr<const DesktopDatabase> AcquireDesktopDatabase(bool need_mime_types_scan);
+	static std::shared_ptr<DesktopDatabase> BuildDesktopDatabase(const std::vector<std::string>& search_dirpaths, bool with_mime_types_scan);
+	static bool IsDesktopDatabaseActual(const DesktopDatabase& database, const std::vector<std::string>& search_dirpaths);
+	static std::shared_ptr<DesktopDatabase> LoadDesktopDatabase(const std::string& filepath);
+	static void SaveDesktopDatabase(const DesktopDatabase& database, const std::string& filepath);
+	static DesktopDatabase::Stamp MakeStamp(const std::string& path, const struct stat* st);
+	static void IndexDirectoryRecursively(DesktopDatabase& database, const std::string& current_path, const std::string& base_dir_prefix, VisitedInodeSet& visited_inodes);
+	static void ScanDesktopFilesMimeTypes(DesktopDatabase& database);
 	const std::optional<XDGBasedAppProvider::DesktopEntry>& GetOrLoadDesktopEntry(const std::string& desktop_id);
-	MimeToDesktopEntryIndex ParseAllDesktopFiles();
-	MimeToDesktopAssociationsMap ParseAllMimeinfoCacheFiles();
 	static void ParseMimeinfoCache(const std::string& filepath, MimeToDesktopAssociationsMap& mime_to_desktop_associations_map);
 	MimeappsListsConfig ParseMimeappsLists();
 	static void ParseMimeappsList(const std::string& filepath, MimeappsListsConfig& mimeapps_lists, std::unordered_set<std::string>& blacklist);
@@ -440,6 +478,13 @@ private:
 		{ "UseMagikaTool", "magika" }
 	};
 
+	// --- Process-wide desktop database ---
+	// Last acquired snapshot, shared by all provider instances; guarded by the mutex,
+	// which also serializes revalidation between the warm-up thread and the foreground.
+	inline static std::mutex s_desktop_database_mutex;
+	inline static std::shared_ptr<const DesktopDatabase> s_desktop_database;
+	inline static std::thread s_desktop_database_warmup;
+
 	// --- Operation-Scoped State ---
 	// Fields managed by OperationContext. Valid only during a GetAppCandidates call.
 	std::vector<std::string> _op_locale_suffixes;
@@ -447,18 +492,16 @@ private:
 	bool _op_xdg_mime_exists = false;
 	bool _op_file_tool_enabled_and_exists = false;
 	bool _op_magika_tool_enabled_and_exists = false;
-	std::vector<std::string> _op_desktop_file_dirpaths;
+	std::shared_ptr<const DesktopDatabase> _op_desktop_database;  // .desktop files locations and 'mimeinfo.cache'
+	bool _op_use_mimeinfo_associations = false;  // otherwise use MimeType keys from the full scan
 	std::vector<std::string> _op_mimeapps_list_filepaths;
 	std::vector<std::string> _op_mime_database_dirpaths;
-	std::unordered_map<std::string, std::string> _op_desktop_id_to_path_index;
 	std::vector<GlobRule> _op_glob_rules_cache; // from 'globs2'
 	std::unordered_map<std::string, std::string> _op_alias_to_canonical_cache;  // from 'aliases'
 	std::unordered_map<std::string, std::vector<std::string>> _op_canonical_to_aliases_cache;  // from 'aliases'
 	std::unordered_map<std::string, std::string> _op_subclass_to_parent_cache;  // from 'subclasses'
 	MimeappsListsConfig _op_mimeapps_lists_cache;  // from 'mimeapps.list'
 	std::map<std::string, std::string> _op_mime_to_default_desktop_id_cache;  // from 'xdg-mime query default'
-	MimeToDesktopAssociationsMap _op_mime_to_desktop_associations_index; 	// from 'mimeinfo.cache'
-	MimeToDesktopEntryIndex _op_mime_to_desktop_entry_index;  // from full .desktop scan
 };
 
 #endif
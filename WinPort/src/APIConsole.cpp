@@ -1,6 +1,9 @@
 #include <mutex>
 #include <map>
 #include <vector>
+#include <unordered_map>
+#include <string_view>
+#include <algorithm>
 #include <atomic>
 #include <stdexcept>
 #include <debug.h>
@@ -313,6 +316,12 @@ extern "C" {
 		return TRUE;
 	}
 
+	WINPORT_DECL(WriteConsoleOutputRegions,BOOL,(HANDLE hConsoleOutput,const CHAR_INFO *lpBuffer,COORD dwBufferSize,PSMALL_RECT lpScreenRegions,DWORD nRegions))
+	{
+		ChooseConOut(hConsoleOutput)->Write(lpBuffer, dwBufferSize, lpScreenRegions, nRegions);
+		return TRUE;
+	}
+
 	WINPORT_DECL(ReadConsoleOutput, BOOL, (HANDLE hConsoleOutput, CHAR_INFO *lpBuffer, COORD dwBufferSize, COORD dwBufferCoord, PSMALL_RECT lpScreenRegion))
 	{
 		ChooseConOut(hConsoleOutput)->Read(lpBuffer, dwBufferSize, dwBufferCoord, *lpScreenRegion);
@@ -579,16 +588,96 @@ extern "C" {
 		return ChooseConOut(con)->OnDeleteConsoleImage(id);
 	}
 
-	static struct {
-		struct Cmp
-		{
-			bool operator()(const WCHAR *a, const WCHAR *b) const { return wcscmp(a, b) < 0; }
+	// Composite chars never released cause their IDs are copied into CHAR_INFO-s outside of
+	// console buffers (screen buffers of far2l, saved screens, VT logs) and strings returned
+	// by lookup are retained by callers. So storage is append-only: strings are kept in arena
+	// chunks and ID->string mapping is array of never reallocated segments, so lookup doesnt
+	// need any lock. Register takes lock only if sequence missed thread-local cache.
+	static struct CompositeChars
+	{
+		enum {
+			SEGMENT_BITS = 10,
+			SEGMENT_SIZE = 1 << SEGMENT_BITS,
+			SEGMENTS_COUNT = 0x4000,
+			ARENA_CHUNK = 0x4000, // in WCHARs
+			THREAD_CACHE_SIZE = 64,
+			THREAD_HITS_FLUSH = 0x100
 		};
+
+		std::atomic<const WCHAR **> segments[SEGMENTS_COUNT]{};
+		std::atomic<COMP_CHAR> count{0};
+
 		std::mutex mtx;
-		std::vector<WCHAR *> id2str;
-		std::map<const WCHAR *, COMP_CHAR, Cmp> str2id;
+		std::unordered_map<std::wstring_view, COMP_CHAR> str2id;
+		std::vector<WCHAR *> arena;
+		WCHAR *arena_pos{nullptr};
+		size_t arena_avail{0};
+
+		std::atomic<DWORD64> hits{0}, misses{0};
+
+		const WCHAR *Store(const WCHAR *sequence, size_t len)
+		{
+			if (arena_avail < len + 1) {
+				const size_t chunk = std::max(len + 1, (size_t)ARENA_CHUNK);
+				arena.emplace_back(new WCHAR[chunk]);
+				arena_pos = arena.back();
+				arena_avail = chunk;
+			}
+			WCHAR *out = arena_pos;
+			wmemcpy(out, sequence, len + 1);
+			arena_pos+= len + 1;
+			arena_avail-= len + 1;
+			return out;
+		}
+
+		const WCHAR *Lookup(COMP_CHAR id) const
+		{
+			if (id >= count.load(std::memory_order_acquire)) {
+				return nullptr;
+			}
+			return segments[id >> SEGMENT_BITS].load(std::memory_order_relaxed)[id & (SEGMENT_SIZE - 1)];
+		}
+
+		COMP_CHAR Register(const WCHAR *sequence, size_t len)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			auto it = str2id.find(std::wstring_view(sequence, len));
+			if (it != str2id.end()) {
+				hits.fetch_add(1, std::memory_order_relaxed);
+				return it->second;
+			}
+
+			const COMP_CHAR id = count.load(std::memory_order_relaxed);
+			if ((id >> SEGMENT_BITS) >= SEGMENTS_COUNT) {
+				throw std::runtime_error("too many composite chars");
+			}
+
+			const WCHAR **segment = segments[id >> SEGMENT_BITS].load(std::memory_order_relaxed);
+			if (!segment) {
+				segment = new const WCHAR *[SEGMENT_SIZE];
+				segments[id >> SEGMENT_BITS].store(segment, std::memory_order_relaxed);
+			}
+
+			const WCHAR *stored = Store(sequence, len);
+			str2id.emplace(std::wstring_view(stored, len), id);
+			segment[id & (SEGMENT_SIZE - 1)] = stored;
+			// publishes segment and its new element to lock-free lookups
+			count.store(id + 1, std::memory_order_release);
+			misses.fetch_add(1, std::memory_order_relaxed);
+			return id;
+		}
 	} s_composite_chars;
 
+	static thread_local struct CompositeCharsThreadCache
+	{
+		struct {
+			const WCHAR *str;
+			size_t len;
+			COMP_CHAR id;
+		} entries[CompositeChars::THREAD_CACHE_SIZE]{};
+		unsigned int hits{0}; // flushed to s_composite_chars.hits by THREAD_HITS_FLUSH portions
+	} s_composite_chars_cache;
+
 	WINPORT_DECL(CompositeCharRegister,COMP_CHAR,(const WCHAR *lpSequence))
 	{
 		if (!lpSequence[0]) {
@@ -598,24 +687,30 @@ extern "C" {
 			return lpSequence[0];
 		}
 
-		std::lock_guard<std::mutex> lock(s_composite_chars.mtx);
-		auto it = s_composite_chars.str2id.find(lpSequence);
-		if (it != s_composite_chars.str2id.end()) {
-			return it->second | COMPOSITE_CHAR_MARK;
+		const size_t len = wcslen(lpSequence);
+		size_t hash = len;
+		for (size_t i = 0; i < len; ++i) {
+			hash = hash * 31 + (uint32_t)lpSequence[i];
+		}
+
+		auto &entry = s_composite_chars_cache.entries[hash % CompositeChars::THREAD_CACHE_SIZE];
+		if (entry.str && entry.len == len && wmemcmp(entry.str, lpSequence, len) == 0) {
+			if (++s_composite_chars_cache.hits == CompositeChars::THREAD_HITS_FLUSH) {
+				s_composite_chars.hits.fetch_add(s_composite_chars_cache.hits, std::memory_order_relaxed);
+				s_composite_chars_cache.hits = 0;
+			}
+			return entry.id | COMPOSITE_CHAR_MARK;
 		}
-		wchar_t *wd = wcsdup(lpSequence);
-		try {
-			if (!wd)
-				throw std::logic_error("wcsdup failed");
 
-			const COMP_CHAR id = COMP_CHAR(s_composite_chars.id2str.size());
-			s_composite_chars.id2str.emplace_back(wd);
-			s_composite_chars.str2id.emplace(wd, id);
+		try {
+			const COMP_CHAR id = s_composite_chars.Register(lpSequence, len);
+			entry.str = s_composite_chars.Lookup(id);
+			entry.len = len;
+			entry.id = id;
 			return id | COMPOSITE_CHAR_MARK;
 
 		} catch (std::exception &e) {
 			fprintf(stderr, "%s: %s for '%ls'\n", __FUNCTION__, e.what(), lpSequence);
-			free(wd);
 		}
 		return 0;
 	}
@@ -628,14 +723,25 @@ extern "C" {
 			return L"\u2022";
 		}
 
-		const COMP_CHAR id = CompositeChar & (~COMPOSITE_CHAR_MARK);
-
-		std::lock_guard<std::mutex> lock(s_composite_chars.mtx);
-		if (id >= (COMP_CHAR)s_composite_chars.id2str.size()) {
+		const WCHAR *out = s_composite_chars.Lookup(CompositeChar & (~COMPOSITE_CHAR_MARK));
+		if (!out) {
 			fprintf(stderr, "%s: out of range composite-char 0x%llx\n",
 				__FUNCTION__, (unsigned long long)CompositeChar);
 			return L"\u2022";
 		}
-		return s_composite_chars.id2str[id];
+		return out;
+	}
+
+	WINPORT_DECL(CompositeCharStats,VOID,(DWORD64 *pdwCount, DWORD64 *pdwHits, DWORD64 *pdwMisses))
+	{
+		if (pdwCount) {
+			*pdwCount = s_composite_chars.count.load(std::memory_order_acquire);
+		}
+		if (pdwHits) {
+			*pdwHits = s_composite_chars.hits.load(std::memory_order_relaxed) + s_composite_chars_cache.hits;
+		}
+		if (pdwMisses) {
+			*pdwMisses = s_composite_chars.misses.load(std::memory_order_relaxed);
+		}
 	}
 }
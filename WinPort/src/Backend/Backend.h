@@ -187,6 +187,8 @@ public:
 
 	virtual void Read(CHAR_INFO *data, COORD data_size, COORD data_pos, SMALL_RECT &screen_rect) = 0;
 	virtual void Write(const CHAR_INFO *data, COORD data_size, COORD data_pos, SMALL_RECT &screen_rect) = 0;
+	// writes several regions under single lock, each region taken from same position of data
+	virtual void Write(const CHAR_INFO *data, COORD data_size, SMALL_RECT *screen_rects, size_t count) = 0;
 	virtual bool Read(CHAR_INFO &data, COORD screen_pos) = 0;
 	virtual bool Write(const CHAR_INFO &data, COORD screen_pos) = 0;
 
@@ -216,6 +218,8 @@ public:
 	virtual void OverrideColor(DWORD Index, DWORD *ColorFG, DWORD *ColorBK) = 0;
 	virtual void RepaintsDeferStart() = 0;
 	virtual void RepaintsDeferFinish(bool force) = 0;
+	// counts of buffer modifying calls and of backend notifications about updated areas
+	virtual void GetStats(DWORD64 &writes, DWORD64 &notifications) = 0;
 
 	virtual void OnGetConsoleImageCaps(WinportGraphicsInfo *wgi) = 0;
 	virtual bool OnSetConsoleImage(const char *id, DWORD64 flags, const SMALL_RECT *area, DWORD width, DWORD height, const void *buffer) = 0;
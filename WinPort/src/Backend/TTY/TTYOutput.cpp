@@ -21,6 +21,7 @@
 #include "WideMB.h"
 #include "WinPort.h"
 #include "Backend.h"
+#include "TestMarks.h"
 #include "../WinPortRGB.h"
 
 #define ESC "\x1b"
@@ -247,7 +248,10 @@ void TTYOutput::WriteReally(const char *str, int len)
 		}
 		len-= wr;
 		str+= wr;
+		TEST_COUNT(backend_bytes, wr);
+		TEST_COUNT(backend_writes, 1);
 	}
+	TEST_MARK(backend_output);
 }
 
 void TTYOutput::FinalizeSameChars()
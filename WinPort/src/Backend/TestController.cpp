@@ -1,5 +1,6 @@
 #include "TestController.h"
 #include "Backend.h"
+#include "TestMarks.h"
 #include "CheckedCast.hpp"
 #include "os_call.hpp"
 #include "WinPort.h"
@@ -8,6 +9,8 @@
 #include <LocalSocket.h>
 #include <Event.h>
 
+TestMarks g_test_marks;
+
 static void StrCpyZeroFill(char *dst, size_t dst_len, const std::string &src)
 {
 	for (size_t i = 0, j = src.size(); i < dst_len; ++i) {
@@ -53,7 +56,9 @@ void TestController::ClientLoop(const std::string &ipc_client)
 		if (len < sizeof(_buf.cmd)) {
 			throw std::runtime_error(StrPrintf("too small len %lu", (unsigned long)len));
 		}
-		fprintf(stderr, "TestController: got command %u\n", _buf.cmd);
+		if (_buf.cmd != TEST_CMD_BENCH_STATS) { // its polled, dont flood log
+			fprintf(stderr, "TestController: got command %u\n", _buf.cmd);
+		}
 
 		switch (_buf.cmd) {
 			case TEST_CMD_DETACH:
@@ -80,6 +85,10 @@ void TestController::ClientLoop(const std::string &ipc_client)
 				len = ClientDispatchSync(len);
 				break;
 
+			case TEST_CMD_BENCH_STATS:
+				len = ClientDispatchBenchStats();
+				break;
+
 			default:
 				throw std::runtime_error(StrPrintf("bad command %u", _buf.cmd));
 		}
@@ -242,6 +251,9 @@ size_t TestController::ClientDispatchSendKey(size_t len)
 	if (ir.Event.KeyEvent.wVirtualScanCode == 0 && ir.Event.KeyEvent.wVirtualKeyCode != 0) {
 		ir.Event.KeyEvent.wVirtualScanCode = WINPORT(MapVirtualKey)(ir.Event.KeyEvent.wVirtualKeyCode, MAPVK_VK_TO_VSC);
 	}
+	if (ir.Event.KeyEvent.bKeyDown) {
+		TEST_MARK(key_injected);
+	}
 	g_winport_con_in->Enqueue(&ir, 1);
 	return 0;
 }
@@ -286,3 +298,19 @@ size_t TestController::ClientDispatchSync(size_t len)
 	ev->Deref();
 	return sizeof(_buf.rep_sync);
 }
+
+size_t TestController::ClientDispatchBenchStats()
+{
+	DWORD64 console_writes{}, console_notifications{};
+	g_winport_con_out->GetStats(console_writes, console_notifications);
+	_buf.rep_bench_stats.key_injected = g_test_marks.key_injected;
+	_buf.rep_bench_stats.input_dequeued = g_test_marks.input_dequeued;
+	_buf.rep_bench_stats.output_updated = g_test_marks.output_updated;
+	_buf.rep_bench_stats.backend_output = g_test_marks.backend_output;
+	_buf.rep_bench_stats.backend_bytes = g_test_marks.backend_bytes;
+	_buf.rep_bench_stats.backend_writes = g_test_marks.backend_writes;
+	_buf.rep_bench_stats.console_writes = console_writes;
+	_buf.rep_bench_stats.console_notifications = console_notifications;
+	_buf.rep_bench_stats.now = TestMarkNow();
+	return sizeof(_buf.rep_bench_stats);
+}
@@ -26,6 +26,8 @@ class TestController : protected Threaded
 
 		TestRequestSync req_sync;
 		TestReplySync rep_sync;
+
+		TestReplyBenchStats rep_bench_stats;
 	} _buf;
 
 	virtual void *ThreadProc();
@@ -35,6 +37,7 @@ class TestController : protected Threaded
 	size_t ClientDispatchWaitString(size_t len, bool need_presence);
 	size_t ClientDispatchSendKey(size_t len);
 	size_t ClientDispatchSync(size_t len);
+	size_t ClientDispatchBenchStats();
 
 public:
 	TestController(const std::string &id);
@@ -0,0 +1,38 @@
+#pragma once
+
+// Milestones of console input/output path that test harness uses to measure
+// keystroke-to-paint latency (see TEST_CMD_BENCH_STATS). Timestamps are
+// CLOCK_MONOTONIC nanoseconds of last occurence, counters only grow.
+// Everything compiles into nothing unless built with TESTING.
+
+#ifdef TESTING
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+struct TestMarks
+{
+	std::atomic<uint64_t> key_injected{0};   // harness enqueued key press
+	std::atomic<uint64_t> input_dequeued{0}; // application dequeued key press
+	std::atomic<uint64_t> output_updated{0}; // application changed console buffer contents
+	std::atomic<uint64_t> backend_output{0}; // backend delivered output to its terminal
+	std::atomic<uint64_t> backend_bytes{0};
+	std::atomic<uint64_t> backend_writes{0};
+};
+
+extern TestMarks g_test_marks;
+
+static inline uint64_t TestMarkNow()
+{
+	struct timespec ts{};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+# define TEST_MARK(WHAT)		g_test_marks.WHAT.store(TestMarkNow(), std::memory_order_relaxed)
+# define TEST_COUNT(WHAT, N)	g_test_marks.WHAT.fetch_add((N), std::memory_order_relaxed)
+
+#else
+# define TEST_MARK(WHAT)
+# define TEST_COUNT(WHAT, N)
+#endif
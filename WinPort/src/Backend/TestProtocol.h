@@ -1,6 +1,6 @@
 #pragma once
 
-#define TEST_PROTOCOL_VERSION	0xF001
+#define TEST_PROTOCOL_VERSION	0xF002
 
 enum TestCommand
 {
@@ -11,6 +11,7 @@ enum TestCommand
 	TEST_CMD_WAIT_NO_STRING,
 	TEST_CMD_SEND_KEY,
 	TEST_CMD_SYNC,
+	TEST_CMD_BENCH_STATS,
 };
 
 struct TestReplyStatus
@@ -78,3 +79,16 @@ struct TestReplySync
 	uint8_t waited;
 };
 
+
+struct TestReplyBenchStats
+{ // timestamps are CLOCK_MONOTONIC nanoseconds of last occurence or zero if never happened
+	uint64_t now;
+	uint64_t key_injected;   // key press enqueued by TEST_CMD_SEND_KEY
+	uint64_t input_dequeued; // key press taken from input queue by application
+	uint64_t output_updated; // console buffer contents changed by application
+	uint64_t backend_output; // output delivered by backend to terminal (TTY backend only)
+	uint64_t backend_bytes;  // bytes written by backend to terminal
+	uint64_t backend_writes; // write calls done by backend to terminal
+	uint64_t console_writes; // console buffer write operations
+	uint64_t console_notifications; // console buffer change notifications
+};
@@ -8,6 +8,7 @@
 #include "PathHelpers.h"
 #include "WinPort.h"
 #include <utils.h>
+#include <chrono>
 
 #define COLOR_ATTRIBUTES ( FOREGROUND_INTENSITY | BACKGROUND_INTENSITY | \
 					FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | \
@@ -15,6 +16,12 @@
 
 #define DYNAMIC_FONTS
 
+// cached glyphs are dropped all together when their count reaches this limit
+#define GLYPH_CACHE_LIMIT	4096
+
+// paint stats are printed to stderr once per this count of paints
+#define PAINT_STATS_PERIOD	256
+
 #ifdef __APPLE__
 # define DEFAULT_FONT_SIZE	20
 #else
@@ -123,7 +130,8 @@ static void InitializeFont(wxWindow *parent, wxFont& font)
 
 ConsolePaintContext::ConsolePaintContext(wxWindow *window) :
 	_window(window), _font_width(12), _font_height(16), _font_descent(0), _font_thickness(2),
-	_buffered_paint(false), _sharp(false), _stage(STG_NOT_REFRESHED)
+	_buffered_paint(false), _sharp(false), _glyph_cache_enabled(false), _backing_enabled(false),
+	_paint_stats(false), _stage(STG_NOT_REFRESHED)
 {
 	_char_fit_cache.checked.resize(0xffff);
 	_char_fit_cache.result.resize(0xffff);
@@ -259,8 +267,22 @@ void ConsolePaintContext::SetFont(wxFont font)
 			_buffered_paint = true;
 	}
 
+	// cached bitmaps are of logical size, so they would be blurry on scaled display
+	const bool unscaled = (_window->GetContentScaleFactor() == 1.0);
+	_glyph_cache_enabled = unscaled && stat(InMyConfig("noglyphcache").c_str(), &s) != 0;
+	_backing_enabled = unscaled && stat(InMyConfig("nobackingstore").c_str(), &s) != 0;
+	_paint_stats = stat(InMyConfig("paintstats").c_str(), &s) == 0;
+
 	_fonts.clear();
 	_fonts.push_back(font);
+	ResetCaches();
+}
+
+void ConsolePaintContext::ResetCaches()
+{
+	_glyph_cache.clear();
+	_backing = wxBitmap();
+	_damage.Clear();
 }
 
 void ConsolePaintContext::ShowFontDialog()
@@ -277,7 +299,7 @@ void ConsolePaintContext::ShowFontDialog()
 	SetFont(font);
 }
 
-uint8_t ConsolePaintContext::CharFitTest(wxPaintDC &dc, wchar_t wc, unsigned int nx)
+uint8_t ConsolePaintContext::CharFitTest(wxDC &dc, wchar_t wc, unsigned int nx)
 {
 #ifdef DYNAMIC_FONTS
 	const bool cacheable = (size_t((uint32_t)wc) - 1 < _char_fit_cache.checked.size()); // && wcz[1] == 0
@@ -324,70 +346,52 @@ uint8_t ConsolePaintContext::CharFitTest(wxPaintDC &dc, wchar_t wc, unsigned int
 #endif
 }
 
-void ConsolePaintContext::ApplyFont(wxPaintDC &dc, uint8_t index)
+void ConsolePaintContext::ApplyFont(wxDC &dc, uint8_t index)
 {
 	if (index < _fonts.size())
 		dc.SetFont(_fonts[index]);
 }
 
-void ConsolePaintContext::OnPaint(wxPaintDC &dc, SMALL_RECT *qedit)
+const wxBitmap &ConsolePaintContext::CachedGlyph(const GlyphKey &key, DWORD64 attributes, const wchar_t *wcz)
 {
-	if (UNLIKELY(_stage == STG_NOT_REFRESHED)) {
-		// not refreshed yet - so early start so nothing to paint yet
-		// so simple fill with background color for the sake of faster start
-		dc.SetBackground(GetBrush(g_wx_palette.background[0]));
-		dc.Clear();
-		return;
+	auto it = _glyph_cache.find(key);
+	if (it != _glyph_cache.end()) {
+		++_stats.glyph_hits;
+		return it->second;
 	}
 
-#if wxUSE_GRAPHICS_CONTEXT
-	wxGraphicsContext* gctx = dc.GetGraphicsContext();
-	if (gctx) {
-		if (_sharp) {
-			gctx->SetInterpolationQuality(wxINTERPOLATION_FAST);
-			gctx->SetAntialiasMode(wxANTIALIAS_NONE);
-		} else {
-			gctx->SetInterpolationQuality(wxINTERPOLATION_DEFAULT);
-			gctx->SetAntialiasMode(wxANTIALIAS_DEFAULT);
-		}
+	++_stats.glyph_misses;
+	if (_glyph_cache.size() >= GLYPH_CACHE_LIMIT) {
+		_glyph_cache.clear();
 	}
-#endif
-	unsigned int cw, ch; g_winport_con_out->GetSize(cw, ch);
-	if (UNLIKELY(cw > MAXSHORT)) cw = MAXSHORT;
-	if (UNLIKELY(ch > MAXSHORT)) ch = MAXSHORT;
 
-	wxRegion rgn = _window->GetUpdateRegion();
-	wxRect box = rgn.GetBox();
-	SMALL_RECT area = {SHORT(box.GetLeft() / _font_width), SHORT(box.GetTop() / _font_height),
-		SHORT(box.GetRight() / _font_width), SHORT(box.GetBottom() / _font_height)};
-
-	if (UNLIKELY(area.Left < 0)) {
-		area.Left = 0;
-	}
-	if (UNLIKELY(area.Top < 0)) {
-		area.Top = 0;
-	}
-	if (UNLIKELY((unsigned)area.Right >= cw)) {
-		area.Right = cw - 1;
-	}
-	if (UNLIKELY((unsigned)area.Bottom >= ch)) {
-		area.Bottom = ch - 1;
-	}
-	if (UNLIKELY(area.Right < area.Left) || UNLIKELY(area.Bottom < area.Top)) {
-		return;
-	}
-
-	_line.resize(cw);
-	ApplyFont(dc);
+	wxBitmap bitmap(_font_width * key.nx, _font_height);
+	{
+		// render cell with the same painter code, but without cursor and not using cache recursively
+		wxMemoryDC dc(bitmap);
+		ApplyFont(dc);
+		CursorProps no_cursor;
+		wxString buffer;
+		ConsolePainter painter(this, dc, buffer, no_cursor, false);
+		painter.LineBegin(0);
+		painter.NextChar(0, attributes, wcz, key.nx);
+		painter.LineFlush(key.nx);
+	}
+
+	return _glyph_cache.emplace(key, bitmap).first->second;
+}
 
-	_cursor_props.Update();
+void ConsolePaintContext::PaintArea(wxDC &dc, const SMALL_RECT &area, SMALL_RECT *qedit, const wxRegion *rgn)
+{
+	unsigned int cw = _line.size();
 
 	ConsolePainter painter(this, dc, _buffer, _cursor_props);
 	for (unsigned int cy = (unsigned)area.Top; cy <= (unsigned)area.Bottom; ++cy) {
-		wxRegionContain lc = rgn.Contains(0, cy * _font_height, cw * _font_width, _font_height);
-
-		if (lc == wxOutRegion) {
-			continue;
+		if (rgn) {
+			wxRegionContain lc = rgn->Contains(0, cy * _font_height, cw * _font_width, _font_height);
+			if (lc == wxOutRegion) {
+				continue;
+			}
 		}
 
 		const CHAR_INFO *line;
@@ -439,21 +443,146 @@ void ConsolePaintContext::OnPaint(wxPaintDC &dc, SMALL_RECT *qedit)
 		}
 		painter.LineFlush(area.Right + 1);
 	}
+}
+
+unsigned long long ConsolePaintContext::PaintFromBacking(wxPaintDC &dc, const wxRegion &rgn, SMALL_RECT *qedit, unsigned int cw, unsigned int ch)
+{
+	unsigned long long cells = 0;
+	const int width = int(cw * _font_width), height = int(ch * _font_height);
+	if (!_backing.IsOk() || _backing.GetWidth() != width || _backing.GetHeight() != height) {
+		_backing.Create(width, height);
+		_damage = wxRegion(0, 0, cw, ch);
+	}
+
+	// selection highlighting is not reported as damage, so track its changes here
+	const SMALL_RECT no_qedit{-1, -1, -1, -1};
+	const SMALL_RECT &cur_qedit = qedit ? *qedit : no_qedit;
+	if (memcmp(&cur_qedit, &_backing_qedit, sizeof(cur_qedit)) != 0) {
+		for (const auto &r : {_backing_qedit, cur_qedit}) {
+			if (r.Left >= 0 && r.Top >= 0) {
+				_damage.Union(r.Left, r.Top, r.Right + 1 - r.Left, r.Bottom + 1 - r.Top);
+			}
+		}
+		_backing_qedit = cur_qedit;
+	}
+
+	wxMemoryDC mdc(_backing);
+	if (!_damage.IsEmpty()) {
+		_damage.Intersect(0, 0, cw, ch);
+		ApplyFont(mdc);
+		for (wxRegionIterator it(_damage); it; ++it) {
+			const wxRect &r = it.GetRect();
+			const SMALL_RECT area = {SHORT(r.GetLeft()), SHORT(r.GetTop()), SHORT(r.GetRight()), SHORT(r.GetBottom())};
+			PaintArea(mdc, area, qedit, nullptr);
+			cells+= (unsigned long long)r.GetWidth() * r.GetHeight();
+		}
+		_damage.Clear();
+	}
+
+	for (wxRegionIterator it(rgn); it; ++it) {
+		wxRect r = it.GetRect().Intersect(wxRect(0, 0, width, height));
+		if (!r.IsEmpty()) {
+			dc.Blit(r.GetLeft(), r.GetTop(), r.GetWidth(), r.GetHeight(), &mdc, r.GetLeft(), r.GetTop());
+		}
+	}
+
+	return cells;
+}
+
+void ConsolePaintContext::StatsPaint(unsigned long long usec, unsigned long long cells)
+{
+	_stats.paint_usec+= usec;
+	_stats.cells+= cells;
+	if (++_stats.paints == PAINT_STATS_PERIOD) {
+		fprintf(stderr, "PAINT_STATS: %llu usec/frame, %llu cells/frame, glyph cache %llu hits %llu misses %lu size\n",
+			_stats.paint_usec / _stats.paints, _stats.cells / _stats.paints,
+			_stats.glyph_hits, _stats.glyph_misses, (unsigned long)_glyph_cache.size());
+		_stats = {};
+	}
+}
+
+void ConsolePaintContext::OnPaint(wxPaintDC &dc, SMALL_RECT *qedit)
+{
+	if (UNLIKELY(_stage == STG_NOT_REFRESHED)) {
+		// not refreshed yet - so early start so nothing to paint yet
+		// so simple fill with background color for the sake of faster start
+		dc.SetBackground(GetBrush(g_wx_palette.background[0]));
+		dc.Clear();
+		return;
+	}
+
+	const auto paint_start = _paint_stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+#if wxUSE_GRAPHICS_CONTEXT
+	wxGraphicsContext* gctx = dc.GetGraphicsContext();
+	if (gctx) {
+		if (_sharp) {
+			gctx->SetInterpolationQuality(wxINTERPOLATION_FAST);
+			gctx->SetAntialiasMode(wxANTIALIAS_NONE);
+		} else {
+			gctx->SetInterpolationQuality(wxINTERPOLATION_DEFAULT);
+			gctx->SetAntialiasMode(wxANTIALIAS_DEFAULT);
+		}
+	}
+#endif
+	unsigned int cw, ch; g_winport_con_out->GetSize(cw, ch);
+	if (UNLIKELY(cw > MAXSHORT)) cw = MAXSHORT;
+	if (UNLIKELY(ch > MAXSHORT)) ch = MAXSHORT;
+
+	wxRegion rgn = _window->GetUpdateRegion();
+	wxRect box = rgn.GetBox();
+	SMALL_RECT area = {SHORT(box.GetLeft() / _font_width), SHORT(box.GetTop() / _font_height),
+		SHORT(box.GetRight() / _font_width), SHORT(box.GetBottom() / _font_height)};
+
+	if (UNLIKELY(area.Left < 0)) {
+		area.Left = 0;
+	}
+	if (UNLIKELY(area.Top < 0)) {
+		area.Top = 0;
+	}
+	if (UNLIKELY((unsigned)area.Right >= cw)) {
+		area.Right = cw - 1;
+	}
+	if (UNLIKELY((unsigned)area.Bottom >= ch)) {
+		area.Bottom = ch - 1;
+	}
+	if (UNLIKELY(area.Right < area.Left) || UNLIKELY(area.Bottom < area.Top)) {
+		return;
+	}
+
+	_line.resize(cw);
+	_cursor_props.Update();
+
+	unsigned long long cells;
+	if (_backing_enabled) {
+		cells = PaintFromBacking(dc, rgn, qedit, cw, ch);
+
+	} else {
+		ApplyFont(dc);
+		PaintArea(dc, area, qedit, &rgn);
+		cells = (unsigned long long)(area.Right + 1 - area.Left) * (area.Bottom + 1 - area.Top);
+	}
 
 	// check if there is unused space in right and bottom and fill it with black color
 	const int right_edge = (area.Right + 1) * _font_width;
 	const int bottom_edge = (area.Bottom + 1) * _font_height;
+	if (right_edge <= box.GetRight() || bottom_edge <= box.GetBottom()) {
+		dc.SetPen(GetTransparentPen());
+		dc.SetBrush(GetBrush(g_wx_palette.background[0]));
+	}
 	if (right_edge <= box.GetRight()) {
-		painter.SetFillColor(g_wx_palette.background[0]);
 		dc.DrawRectangle((area.Right + 1) * _font_width, box.GetTop(),
 			box.GetRight() + 1 - right_edge, box.GetHeight());
 	}
 	if (bottom_edge <= box.GetBottom()) {
-		painter.SetFillColor(g_wx_palette.background[0]);
 		dc.DrawRectangle(box.GetLeft(), bottom_edge,
 			box.GetWidth(), box.GetBottom() + 1 - bottom_edge);
 	}
 
+	if (UNLIKELY(_paint_stats)) {
+		StatsPaint(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - paint_start).count(), cells);
+	}
 
 	if (UNLIKELY(_stage == STG_REFRESHED)) {
 		_stage = STG_PAINTED;
@@ -473,9 +602,22 @@ void ConsolePaintContext::RefreshArea( const SMALL_RECT &area )
 	rc.SetRight(((int)area.Right) * _font_width + _font_width - 1);
 	rc.SetTop(((int)area.Top) * _font_height);
 	rc.SetBottom(((int)area.Bottom) * _font_height + _font_height - 1);
+	if (_backing_enabled) {
+		_damage.Union(area.Left, area.Top, area.Right + 1 - area.Left, area.Bottom + 1 - area.Top);
+	}
 	_window->Refresh(false, &rc);
 }
 
+// whole window repaint that must not reuse backing store, like after palette change
+void ConsolePaintContext::RefreshAll()
+{
+	if (_backing_enabled) {
+		_backing = wxBitmap();
+		_damage.Clear();
+	}
+	_window->Refresh();
+}
+
 
 void ConsolePaintContext::BlinkCursor()
 {
@@ -500,6 +642,7 @@ void ConsolePaintContext::SetSharp(bool sharp)
 {
 	if (_sharp != sharp) {
 		_sharp = sharp;
+		ResetCaches();
 		_window->Refresh();
 	}
 }
@@ -544,10 +687,11 @@ void CursorProps::Update()
 
 //////////////////////
 
-ConsolePainter::ConsolePainter(ConsolePaintContext *context, wxPaintDC &dc, wxString &buffer, CursorProps &cursor_props) :
+ConsolePainter::ConsolePainter(ConsolePaintContext *context, wxDC &dc, wxString &buffer, CursorProps &cursor_props, bool use_glyph_cache) :
 	_context(context), _dc(dc), _buffer(buffer), _cursor_props(cursor_props),
 	_start_cx((unsigned int)-1), _start_back_cx((unsigned int)-1), _prev_fit_font_index(0),
-	_prev_underlined(false), _prev_strikeout(false), _prev_bold(false)
+	_prev_underlined(false), _prev_strikeout(false), _prev_bold(false),
+	_use_glyph_cache(use_glyph_cache && context->IsGlyphCacheEnabled())
 {
 	_dc.SetPen(context->GetTransparentPen());
 	_dc.SetBackgroundMode(wxPENSTYLE_TRANSPARENT);
@@ -564,11 +708,16 @@ void ConsolePainter::SetFillColor(const WinPortRGB &clr)
 	}
 }
 
-void ConsolePainter::PrepareBackground(unsigned int cx, const WinPortRGB &clr, unsigned int nx)
+bool ConsolePainter::IsCursorAt(unsigned int cx) const
 {
-	const bool cursor_here = (_cursor_props.visible && _cursor_props.blink_state
+	return (_cursor_props.visible && _cursor_props.blink_state
 		&& cx == (unsigned int)_cursor_props.pos.X
 		&& _start_cy == (unsigned int)_cursor_props.pos.Y);
+}
+
+void ConsolePainter::PrepareBackground(unsigned int cx, const WinPortRGB &clr, unsigned int nx)
+{
+	const bool cursor_here = IsCursorAt(cx);
 
 	if (!cursor_here && _start_back_cx != (unsigned int)-1 && _clr_back == clr)
 		return;
@@ -752,6 +901,33 @@ void WXCustomDrawChar::Painter::FillPixel(wxCoord left, wxCoord top)
 	((WXCustomDrawCharPainter *)this)->FillRectangleImpl(left, top, left, top);
 }
 
+bool ConsolePainter::NextCachedChar(unsigned int cx, DWORD64 attributes, wchar_t wc, unsigned int nx, bool custom_draw)
+{
+	// buffered paint draws text by runs that is cheaper than per-cell blits,
+	// so only custom draws are cached then; cursor cell is never cached
+	if ((!custom_draw && _context->IsPaintBuffered()) || IsCursorAt(cx)) {
+		return false;
+	}
+
+	GlyphKey key;
+	key.fg = WxConsoleForeground2RGB(attributes);
+	key.bg = WxConsoleBackground2RGB(attributes);
+	key.wc = wc;
+	key.nx = (uint8_t)nx;
+	key.font_index = custom_draw ? 0 : _context->CharFitTest(_dc, wc, nx);
+	key.flags = ((attributes & COMMON_LVB_UNDERSCORE) ? 1 : 0)
+		| ((attributes & COMMON_LVB_STRIKEOUT) ? 2 : 0)
+		| (((attributes & COMMON_LVB_BOLD) && !custom_draw) ? 4 : 0);
+
+	const wchar_t wcz[2] = {wc, 0};
+	const wxBitmap &bitmap = _context->CachedGlyph(key, attributes, wcz);
+
+	FlushBackground(cx);
+	FlushText(cx);
+	_dc.DrawBitmap(bitmap, cx * _context->FontWidth(), _start_y);
+	return true;
+}
+
 void ConsolePainter::NextChar(unsigned int cx, DWORD64 attributes, const wchar_t *wcz, unsigned int nx)
 {
 	if (!wcz[0] || !WCHAR_IS_VALID(wcz[0])) {
@@ -767,6 +943,11 @@ void ConsolePainter::NextChar(unsigned int cx, DWORD64 attributes, const wchar_t
 		FlushText(cx + nx - 1);
 	}
 
+	if (_use_glyph_cache && !wcz[1] && wcz[0] != L' '
+	 && NextCachedChar(cx, attributes, wcz[0], nx, custom_draw != nullptr)) {
+		return;
+	}
+
 	const WinPortRGB &clr_back = WxConsoleBackground2RGB(attributes);
 	PrepareBackground(cx, clr_back, nx);
 
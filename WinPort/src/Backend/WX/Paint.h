@@ -1,6 +1,7 @@
 #pragma once
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include <wx/graphics.h>
 #include "WinCompat.h"
 #include "wxWinTranslations.h"
@@ -20,12 +21,39 @@ struct CursorProps
 
 ///
 
+struct GlyphKey
+{
+	WinPortRGB fg, bg;
+	wchar_t wc;
+	uint8_t nx;
+	uint8_t font_index;
+	uint8_t flags; // COMMON_LVB_UNDERSCORE/STRIKEOUT/BOLD presence bits
+
+	inline bool operator == (const GlyphKey &k) const
+	{
+		return wc == k.wc && nx == k.nx && font_index == k.font_index
+			&& flags == k.flags && fg == k.fg && bg == k.bg;
+	}
+};
+
+struct GlyphKeyHash
+{
+	inline size_t operator()(const GlyphKey &k) const
+	{
+		size_t h = size_t((uint32_t)k.wc) ^ (size_t(k.nx) << 21) ^ (size_t(k.font_index) << 23) ^ (size_t(k.flags) << 29);
+		h = h * 0x9e3779b1 ^ (size_t(k.fg.r) | (size_t(k.fg.g) << 8) | (size_t(k.fg.b) << 16));
+		h = h * 0x9e3779b1 ^ (size_t(k.bg.r) | (size_t(k.bg.g) << 8) | (size_t(k.bg.b) << 16));
+		return h;
+	}
+};
+
 class ConsolePaintContext
 {
 	std::vector<wxFont> _fonts;
 	wxWindow *_window;
 	unsigned int _font_width, _font_height, _font_descent, _font_thickness;
 	bool _custom_draw_enabled, _buffered_paint, _sharp;
+	bool _glyph_cache_enabled, _backing_enabled, _paint_stats;
 	enum {
 		STG_NOT_REFRESHED,
 		STG_REFRESHED,
@@ -45,15 +73,35 @@ class ConsolePaintContext
 	std::map<WinPortRGB, wxBrush> _color2brush;
 	wxPen _transparent_pen{wxColour(0, 0, 0), 1, wxPENSTYLE_TRANSPARENT};
 
+	// rendered cells, blitted instead of drawing text or custom draw primitives again
+	std::unordered_map<GlyphKey, wxBitmap, GlyphKeyHash> _glyph_cache;
+
+	// console image rendered so far, only cells damaged by RefreshArea are repainted into it
+	wxBitmap _backing;
+	wxRegion _damage; // in cells
+	SMALL_RECT _backing_qedit{-1, -1, -1, -1};
+
+	struct {
+		unsigned long long glyph_hits, glyph_misses;
+		unsigned long long paints, paint_usec, cells;
+	} _stats{};
+
 	void SetFont(wxFont font);
+	void ResetCaches();
+	void PaintArea(wxDC &dc, const SMALL_RECT &area, SMALL_RECT *qedit, const wxRegion *rgn);
+	unsigned long long PaintFromBacking(wxPaintDC &dc, const wxRegion &rgn, SMALL_RECT *qedit, unsigned int cw, unsigned int ch);
+	void StatsPaint(unsigned long long usec, unsigned long long cells);
+
 public:
 	ConsolePaintContext(wxWindow *window);
 	void ShowFontDialog();
 
-	uint8_t CharFitTest(wxPaintDC &dc, wchar_t wcz, unsigned int nx);
-	void ApplyFont(wxPaintDC &dc, uint8_t index = 0);
+	uint8_t CharFitTest(wxDC &dc, wchar_t wcz, unsigned int nx);
+	void ApplyFont(wxDC &dc, uint8_t index = 0);
+	const wxBitmap &CachedGlyph(const GlyphKey &key, DWORD64 attributes, const wchar_t *wcz);
 	void OnPaint(wxPaintDC &dc, SMALL_RECT *qedit = NULL);
 	void RefreshArea( const SMALL_RECT &area );
+	void RefreshAll();
 	void BlinkCursor();
 	void SetSharp(bool sharp);
 	bool IsSharpSupported();
@@ -64,6 +112,7 @@ public:
 	inline bool IsCustomDrawEnabled() const { return _custom_draw_enabled; }
 	inline bool IsSharp() const { return _sharp; }
 	inline bool IsPaintBuffered() const { return _buffered_paint; }
+	inline bool IsGlyphCacheEnabled() const { return _glyph_cache_enabled; }
 	inline unsigned int FontWidth() const { return _font_width; }
 	inline unsigned int FontHeight() const { return _font_height; }
 	inline unsigned int FontThickness() const { return _font_thickness; }
@@ -95,7 +144,7 @@ class ConsolePainter
 	} _brush_clr;
 
 	ConsolePaintContext *_context;
-	wxPaintDC &_dc;
+	wxDC &_dc;
 	wxString &_buffer;
 	CursorProps &_cursor_props;
 
@@ -106,6 +155,7 @@ class ConsolePainter
 	bool	_prev_underlined;
 	bool	_prev_strikeout;
 	bool	_prev_bold;
+	bool	_use_glyph_cache;
 	std::map<WinPortRGB, wxPen *> _custom_draw_pens;
 
 	friend struct WXCustomDrawCharPainter;
@@ -114,9 +164,11 @@ class ConsolePainter
 	void FlushBackground(unsigned int cx_end);
 	void FlushText(unsigned int cx_end);
 	void FlushDecorations(unsigned int cx_end);
+	bool IsCursorAt(unsigned int cx) const;
+	bool NextCachedChar(unsigned int cx, DWORD64 attributes, wchar_t wc, unsigned int nx, bool custom_draw);
 
 public:
-	ConsolePainter(ConsolePaintContext *context, wxPaintDC &dc, wxString &_buffer, CursorProps &cursor_props);
+	ConsolePainter(ConsolePaintContext *context, wxDC &dc, wxString &_buffer, CursorProps &cursor_props, bool use_glyph_cache = true);
 	void SetFillColor(const WinPortRGB &clr);
 
 
@@ -826,7 +826,7 @@ void WinPortPanel::OnTimerPeriodic(wxTimerEvent& event)
 		if (WINPORT(GetTickCount)() - _last_title_ticks > TIMER_EXTRA_REFRESH) {
 			_periodic_timer->Stop();
 			_extra_refresh = false;
-			Refresh();
+			_paint_context.RefreshAll();
 			_periodic_timer->Start(g_TIMER_PERIOD);
 			fprintf(stderr, "Extra refresh\n");
 		}
@@ -2124,7 +2124,7 @@ void WinPortPanel::OnConsoleChangeFontSync(wxCommandEvent& event)
 	_paint_context.ShowFontDialog();
 	_resize_pending = RP_INSTANT;
 	CheckForResizePending();
-	Refresh();
+	_paint_context.RefreshAll();
 }
 
 void WinPortPanel::OnConsoleChangeFont()
@@ -2308,7 +2308,8 @@ void WinPortPanel::ResetInputState()
 	_exclusive_hotkeys.Reset();
 }
 
-static void ConsoleOverrideColorInMain(DWORD Index, DWORD *ColorFG, DWORD *ColorBK)
+// returns true if palette changed, so already painted cells must be repainted
+static bool ConsoleOverrideColorInMain(DWORD Index, DWORD *ColorFG, DWORD *ColorBK)
 {
 	if (Index == (DWORD)-1) {
 		const DWORD64 orig_attrs = g_winport_con_out->GetAttributes();
@@ -2325,7 +2326,7 @@ static void ConsoleOverrideColorInMain(DWORD Index, DWORD *ColorFG, DWORD *Color
 
 		*ColorFG = WxConsoleForeground2RGB(orig_attrs & ~(DWORD64)COMMON_LVB_REVERSE_VIDEO).AsRGB();
 		*ColorBK = WxConsoleBackground2RGB(orig_attrs & ~(DWORD64)COMMON_LVB_REVERSE_VIDEO).AsRGB();
-		return;
+		return false;
 	}
 
 	WinPortRGB fg(*ColorFG), bk(*ColorBK);
@@ -2345,6 +2346,7 @@ static void ConsoleOverrideColorInMain(DWORD Index, DWORD *ColorFG, DWORD *Color
 	}
 	*ColorFG = prev_fg;
 	*ColorBK = prev_bk;
+	return g_wx_palette.foreground[Index].AsRGB() != prev_fg || g_wx_palette.background[Index].AsRGB() != prev_bk;
 }
 
 static void ConsoleOverrideBasePaletteInMain(void *pbuff)
@@ -2362,7 +2364,10 @@ bool WinPortPanel::OnConsoleSetBasePalette(void *pbuff)
 	if (!pbuff)
 		return false;
 
-	auto fn = std::bind(&ConsoleOverrideBasePaletteInMain, pbuff);
+	auto fn = [&]() {
+		ConsoleOverrideBasePaletteInMain(pbuff);
+		_paint_context.RefreshAll();
+	};
 	CallInMainNoRet(fn);
 
 	return true;
@@ -2375,6 +2380,10 @@ void WinPortPanel::OnConsoleOverrideColor(DWORD Index, DWORD *ColorFG, DWORD *Co
 		return;
 	}
 
-	auto fn = std::bind(&ConsoleOverrideColorInMain, Index, ColorFG, ColorBK);
+	auto fn = [&]() {
+		if (ConsoleOverrideColorInMain(Index, ColorFG, ColorBK)) {
+			_paint_context.RefreshAll();
+		}
+	};
 	CallInMainNoRet(fn);
 }
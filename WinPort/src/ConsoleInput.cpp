@@ -1,6 +1,7 @@
 #include <assert.h>
 #include "ConsoleInput.h"
 #include "WinPort.h"
+#include "TestMarks.h"
 #include <UtfDefines.h>
 #include <utils.h>
 
@@ -413,6 +414,11 @@ DWORD ConsoleInput::Dequeue(INPUT_RECORD *data, DWORD size, unsigned int request
 		for (i = 0; (i < size && !_pending.empty()); ++i) {
 			data[i] = _pending.front();
 			_pending.pop_front();
+#ifdef TESTING
+			if (data[i].EventType == KEY_EVENT && data[i].Event.KeyEvent.bKeyDown) {
+				TEST_MARK(input_dequeued);
+			}
+#endif
 			if (EventBacktraced(data[i])) {
 				while (_backtrace.size() > MAX_INPUT_BACKTRACE_CONUT
 						&& now - _backtrace.front().first > MAX_INPUT_BACKTRACE_SECONDS * 1000) {
@@ -1,5 +1,6 @@
 #include "ConsoleOutput.h"
 #include "WinPort.h"
+#include "TestMarks.h"
 #include <utils.h>
 
 #define TAB_WIDTH	8
@@ -66,6 +67,48 @@ void ConsoleOutput::DeferredRepaints::Add(const SMALL_RECT *areas, size_t cnt)
 	}
 }
 
+static inline bool IsAreaInside(const SMALL_RECT &inner, const SMALL_RECT &outer)
+{
+	return inner.Left >= outer.Left && inner.Right <= outer.Right
+		&& inner.Top >= outer.Top && inner.Bottom <= outer.Bottom;
+}
+
+void ConsoleOutput::DeferredRepaints::Coalesce()
+{
+	// drop areas covered by other areas, like cursor cells inside of written regions;
+	// quadratic, so long lists (like from VT output) are passed as is
+	if (size() > 64) {
+		return;
+	}
+	for (size_t i = 0; i < size();) {
+		bool covered = false;
+		for (size_t j = 0; j < size(); ++j) {
+			if (j != i && IsAreaInside((*this)[i], (*this)[j])) {
+				covered = true;
+				break;
+			}
+		}
+		if (covered) {
+			erase(begin() + i);
+		} else {
+			++i;
+		}
+	}
+}
+
+void ConsoleOutput::NotifyUpdated(const SMALL_RECT *areas, size_t count)
+{
+	++_stats.notifications;
+	TEST_MARK(output_updated);
+	_backend->OnConsoleOutputUpdated(areas, count);
+}
+
+void ConsoleOutput::GetStats(DWORD64 &writes, DWORD64 &notifications)
+{
+	writes = _stats.writes;
+	notifications = _stats.notifications;
+}
+
 
 ConsoleOutput::ConsoleOutput() :
 	_backend(NULL),
@@ -159,7 +202,7 @@ void ConsoleOutput::SetCursor(COORD pos)
 		LockedChangeIdUpdate();
 	}
 	if (_backend) {
-		_backend->OnConsoleOutputUpdated(&area[0], 2);
+		NotifyUpdated(&area[0], 2);
 	}
 }
 
@@ -185,7 +228,7 @@ void ConsoleOutput::SetCursor(UCHAR height, bool visible)
 		LockedChangeIdUpdate();
 	}
 	if (_backend) {
-		_backend->OnConsoleOutputUpdated(&area, 1);
+		NotifyUpdated(&area, 1);
 	}
 }
 
@@ -300,6 +343,7 @@ void ConsoleOutput::Write(const CHAR_INFO *data, COORD data_size, COORD data_pos
 {
 	{
 		std::lock_guard<std::mutex> lock(_mutex);
+		++_stats.writes;
 		_buf.Write(data, data_size, data_pos, screen_rect);
 		if (_repaint_defer) {
 			_deferred_repaints.Add(screen_rect);
@@ -308,7 +352,27 @@ void ConsoleOutput::Write(const CHAR_INFO *data, COORD data_size, COORD data_pos
 		LockedChangeIdUpdate();
 	}
 	if (_backend) {
-		_backend->OnConsoleOutputUpdated(&screen_rect, 1);
+		NotifyUpdated(&screen_rect, 1);
+	}
+}
+
+void ConsoleOutput::Write(const CHAR_INFO *data, COORD data_size, SMALL_RECT *screen_rects, size_t count)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_stats.writes;
+		for (size_t i = 0; i < count; ++i) {
+			const COORD data_pos = {screen_rects[i].Left, screen_rects[i].Top};
+			_buf.Write(data, data_size, data_pos, screen_rects[i]);
+		}
+		if (_repaint_defer) {
+			_deferred_repaints.Add(screen_rects, count);
+			return;
+		}
+		LockedChangeIdUpdate();
+	}
+	if (_backend && count) {
+		NotifyUpdated(screen_rects, count);
 	}
 }
 
@@ -323,6 +387,7 @@ bool ConsoleOutput::Write(const CHAR_INFO &data, COORD screen_pos)
 	SMALL_RECT area;
 	{
 		std::lock_guard<std::mutex> lock(_mutex);
+		++_stats.writes;
 		switch (_buf.Write(data, screen_pos)) {
 			case ConsoleBuffer::WR_BAD: return false;
 			case ConsoleBuffer::WR_SAME: return true;
@@ -338,7 +403,7 @@ bool ConsoleOutput::Write(const CHAR_INFO &data, COORD screen_pos)
 	}
 
 	if (_backend) {
-		_backend->OnConsoleOutputUpdated(&area, 1);
+		NotifyUpdated(&area, 1);
 	}
 
 	return true;
@@ -512,6 +577,7 @@ size_t ConsoleOutput::ModifySequenceAt(SequenceModifier &sm, COORD &pos)
 	bool refresh_main_area;
 	{
 		std::lock_guard<std::mutex> lock(_mutex);
+		++_stats.writes;
 		SetUpdateCellArea(areas[0], pos);
 		unsigned int width, height;
 		_buf.GetSize(width, height);
@@ -592,9 +658,9 @@ size_t ConsoleOutput::ModifySequenceAt(SequenceModifier &sm, COORD &pos)
 
 	if (_backend) {
 		if (refresh_pos_areas) {
-			_backend->OnConsoleOutputUpdated(&areas[0], refresh_main_area ? 3 : 2);
+			NotifyUpdated(&areas[0], refresh_main_area ? 3 : 2);
 		} else if (refresh_main_area) {
-			_backend->OnConsoleOutputUpdated(&areas[2], 1);
+			NotifyUpdated(&areas[2], 1);
 		}
 	}
 	return rv;
@@ -700,6 +766,7 @@ bool ConsoleOutput::Scroll(const SMALL_RECT *lpScrollRectangle,
 		(SHORT)(dwDestinationOrigin.X + data_size.X - 1), (SHORT)(dwDestinationOrigin.Y + data_size.Y - 1)};
 	{
 		std::lock_guard<std::mutex> lock(_mutex);
+		++_stats.writes;
 		_temp_chars.resize(total_chars);
 		_buf.Read(&_temp_chars[0], data_size, data_pos, areas.n.src);
 
@@ -746,7 +813,7 @@ bool ConsoleOutput::Scroll(const SMALL_RECT *lpScrollRectangle,
 	}
 
 	if (_backend) {
-		_backend->OnConsoleOutputUpdated(&areas.both[0], lpFill ? 2 : 1);
+		NotifyUpdated(&areas.both[0], lpFill ? 2 : 1);
 	}
 
 	return true;
@@ -875,6 +942,7 @@ void ConsoleOutput::RepaintsDeferFinish(bool force)
 			--_repaint_defer;
 		}
 		if (_repaint_defer == 0) {
+			_deferred_repaints.Coalesce();
 			deferred_repaints.swap(_deferred_repaints);
 		}
 		if (!deferred_repaints.empty()) {
@@ -882,7 +950,7 @@ void ConsoleOutput::RepaintsDeferFinish(bool force)
 		}
 	}
 	if (!deferred_repaints.empty() && _backend) {
-		_backend->OnConsoleOutputUpdated(&deferred_repaints[0], deferred_repaints.size());
+		NotifyUpdated(&deferred_repaints[0], deferred_repaints.size());
 	}
 }
 
@@ -934,7 +1002,7 @@ void ConsoleOutput::ReleaseConsoleOutput(IConsoleOutput *con_out, bool join)
 			}
 		}
 		if (!repaint_defered && _backend) {
-			_backend->OnConsoleOutputUpdated(&screen_rect, 1);
+			NotifyUpdated(&screen_rect, 1);
 		}
 	}
 	delete co;
@@ -1,5 +1,6 @@
 #pragma once
 #include <mutex>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <condition_variable>
@@ -22,7 +23,11 @@ class ConsoleOutput : public IConsoleOutput
 	{
 		void Add(const SMALL_RECT &area);
 		void Add(const SMALL_RECT *areas, size_t cnt);
+		void Coalesce();
 	} _deferred_repaints;
+	struct {
+		std::atomic<DWORD64> writes{0}, notifications{0};
+	} _stats;
 	unsigned int _change_id{1};
 	std::condition_variable _change_id_cond;
 
@@ -53,6 +58,7 @@ class ConsoleOutput : public IConsoleOutput
 	};
 
 	void LockedChangeIdUpdate();
+	void NotifyUpdated(const SMALL_RECT *areas, size_t count);
 
 	SHORT ModifySequenceEntityAt(SequenceModifier &sm, COORD pos, SMALL_RECT &area);
 	size_t ModifySequenceAt(SequenceModifier &sm, COORD &pos);
@@ -93,6 +99,7 @@ public:
 
 	virtual void Read(CHAR_INFO *data, COORD data_size, COORD data_pos, SMALL_RECT &screen_rect);
 	virtual void Write(const CHAR_INFO *data, COORD data_size, COORD data_pos, SMALL_RECT &screen_rect);
+	virtual void Write(const CHAR_INFO *data, COORD data_size, SMALL_RECT *screen_rects, size_t count);
 	virtual bool Read(CHAR_INFO &data, COORD screen_pos);
 	virtual bool Write(const CHAR_INFO &data, COORD screen_pos);
 
@@ -122,6 +129,7 @@ public:
 	virtual void OverrideColor(DWORD Index, DWORD *ColorFG, DWORD *ColorBK);
 	virtual void RepaintsDeferStart();
 	virtual void RepaintsDeferFinish(bool force);
+	virtual void GetStats(DWORD64 &writes, DWORD64 &notifications);
 
 	virtual IConsoleOutput *ForkConsoleOutput(HANDLE con_handle);
 	virtual void ReleaseConsoleOutput(IConsoleOutput *con_out, bool join);
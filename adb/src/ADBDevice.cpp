@@ -1,5 +1,6 @@
 #include "ADBDevice.h"
 #include "ADBShell.h"
+#include "ADBSync.h"
 #include "ADBLog.h"
 #include <sstream>
 #include <cstring>
@@ -219,7 +220,8 @@ bool ProgressParser::ExtractProgress(const std::string &s, int &percent, std::st
 }
 
 ADBDevice::ADBDevice(const std::string &device_serial)
-    : _device_serial(device_serial), _current_path("/"), _adb_shell(nullptr), _connected(false)
+    : _device_serial(device_serial), _current_path("/"), _adb_shell(nullptr),
+      _sync(std::make_unique<ADBSync>(device_serial)), _connected(false)
 {
     
     
@@ -272,6 +274,9 @@ void ADBDevice::Disconnect()
         _adb_shell->stop();
         _adb_shell.reset();
     }
+    if (_sync) {
+        _sync->Close();
+    }
     _connected = false;
 }
 
@@ -598,6 +603,18 @@ int ADBDevice::TransferItem(const std::string& src, const std::string& dst, bool
     EnsureConnection();
     if (int err = ADBUtils::CheckConnection(_connected)) return err;
 
+    // Single files stream over the sync socket — no adb process spawn, no progress output parsing.
+    if (!recursive) {
+        std::function<void(int)> sync_progress;
+        if (on_progress) sync_progress = [&](int percent) { on_progress(percent, src); };
+        int rc = is_push ? _sync->Send(src, dst, sync_progress, abort_check)
+                         : _sync->Recv(src, dst, sync_progress, abort_check);
+        if (!ADBSync::IsFallback(rc)) {
+            DBG("TransferItem sync is_push=%d rc=%d src='%s' dst='%s'\n", is_push, rc, src.c_str(), dst.c_str());
+            return rc;
+        }
+    }
+
     std::vector<std::string> args = {is_push ? "push" : "pull"};
     if (on_progress) args.push_back("-p");
     // Pull `-a` preserves timestamp+mode (verified `adb help`); push has no equivalent flag.
@@ -789,6 +806,10 @@ bool ADBDevice::FileExists(const std::string &devicePath) {
     EnsureConnection();
     if (!_connected) return false;
 
+    ADBSyncStat st;
+    int rc = _sync->Stat(devicePath, st);
+    if (!ADBSync::IsFallback(rc)) return rc == 0;
+
     std::string command = "test -e " + ADBUtils::ShellQuote(devicePath) + " && echo 1 || echo 0";
     std::string result = RunShellCommand(command);
 
@@ -804,6 +825,10 @@ bool ADBDevice::FileExists(const std::string &devicePath) {
 bool ADBDevice::IsDirectory(const std::string &devicePath) {
     EnsureConnection();
     if (!_connected) return false;
+    // Without stat_v2 sync STAT is lstat — symlinks still need `test -d`.
+    ADBSyncStat st;
+    int rc = _sync->Stat(devicePath, st);
+    if (!ADBSync::IsFallback(rc) && !S_ISLNK(st.mode)) return rc == 0 && S_ISDIR(st.mode);
     std::string command = "test -d " + ADBUtils::ShellQuote(devicePath) + " && echo 1 || echo 0";
     std::string result = RunShellCommand(command);
     ADBUtils::TrimTrailingNewlines(result);
@@ -814,6 +839,11 @@ bool ADBDevice::IsDirectory(const std::string &devicePath) {
 void ADBDevice::ListDirNames(const std::string &devicePath, std::unordered_set<std::string>& out) {
     EnsureConnection();
     if (!_connected) return;
+    std::vector<ADBSyncDirEntry> entries;
+    if (!ADBSync::IsFallback(_sync->List(devicePath, entries))) {
+        for (auto& e : entries) out.insert(std::move(e.name));
+        return;
+    }
     // -A includes dotfiles, -1 one-per-line; ignore stderr (missing dir → empty set).
     std::string command = "ls -A1 -- " + ADBUtils::ShellQuote(devicePath) + " 2>/dev/null";
     std::string result = RunShellCommand(command);
@@ -827,6 +857,42 @@ void ADBDevice::ListDirNames(const std::string &devicePath, std::unordered_set<s
     }
 }
 
+void ADBDevice::FilesExist(const std::vector<std::string> &devicePaths, std::vector<bool> &out) {
+    out.assign(devicePaths.size(), false);
+    EnsureConnection();
+    if (!_connected) return;
+
+    std::vector<ADBSyncStat> stats;
+    if (!ADBSync::IsFallback(_sync->StatMany(devicePaths, stats))) {
+        for (size_t i = 0; i < stats.size(); ++i) out[i] = (stats[i].mode != 0);
+        return;
+    }
+    for (size_t i = 0; i < devicePaths.size(); ++i) out[i] = FileExists(devicePaths[i]);
+}
+
+int ADBDevice::GetFileStat(const std::string &devicePath, uint64_t &size, time_t &mtime) {
+    size = 0;
+    mtime = 0;
+    EnsureConnection();
+    if (int err = ADBUtils::CheckConnection(_connected)) return err;
+
+    ADBSyncStat st;
+    int rc = _sync->Stat(devicePath, st);
+    if (!ADBSync::IsFallback(rc)) {
+        size = st.size;
+        mtime = (time_t)st.mtime;
+        return rc;
+    }
+
+    std::string out = RunShellCommand("stat -c '%s %Y' -- " + ADBUtils::ShellQuote(devicePath) + " 2>/dev/null");
+    unsigned long long sz = 0;
+    long long mt = 0;
+    if (sscanf(out.c_str(), "%llu %lld", &sz, &mt) != 2) return ENOENT;
+    size = (uint64_t)sz;
+    mtime = (time_t)mt;
+    return 0;
+}
+
 void ADBDevice::BatchDirectoryFileSizes(const std::vector<std::string>& devicePaths,
                                          std::map<std::string, std::unordered_map<std::string, uint64_t>>& out) {
     EnsureConnection();
@@ -18,6 +18,7 @@
 
 // Forward declarations
 class ADBShell;
+class ADBSync;
 struct PluginPanelItem;
 
 // Per-file progress callback. percent 0-100; path is adb's reported path (empty on synthetic 0%/100%).
@@ -29,6 +30,8 @@ private:
     std::string _device_serial;
     std::string _current_path;
     std::unique_ptr<ADBShell> _adb_shell;
+    // Direct adb server connection for stats/listings/single-file transfers; CLI is the fallback.
+    std::unique_ptr<ADBSync> _sync;
     bool _connected;
 
     void EnsureConnection();
@@ -101,6 +104,10 @@ public:
     bool IsDirectory(const std::string &devicePath);
     // Single-roundtrip name list for collision pre-scan (replaces N+1 FileExists).
     void ListDirNames(const std::string &devicePath, std::unordered_set<std::string>& out);
+    // Existence of many paths with pipelined sync STATs (one shell roundtrip per path on CLI fallback).
+    void FilesExist(const std::vector<std::string> &devicePaths, std::vector<bool> &out);
+    // Size + mtime in one STAT; returns errno, ENOENT if missing.
+    int GetFileStat(const std::string &devicePath, uint64_t &size, time_t &mtime);
 
     // Per-file size map for many roots in ONE shell roundtrip — keyed by input devicePath, inner map is rel-path → size; empty dirs yield an empty inner map.
     void BatchDirectoryFileSizes(const std::vector<std::string>& devicePaths,
@@ -253,7 +253,7 @@ static int EnsureAdbParentDirs(ADBDevice& dev, const std::string& abs_path) {
 	return MkdirPAdb(dev, abs_path.substr(0, slash));
 }
 
-// Auto-increment "name(N)" for collision. Cap=32 — each probe is a shell roundtrip.
+// Auto-increment "name(N)" for collision. Cap=32 — all candidates probed in one pipelined batch.
 static std::string FindFreeAdbName(ADBDevice& dev, const std::string& abs_path) {
 	auto slash = abs_path.find_last_of('/');
 	std::string parent = (slash == std::string::npos) ? std::string() : abs_path.substr(0, slash);
@@ -261,30 +261,23 @@ static std::string FindFreeAdbName(ADBDevice& dev, const std::string& abs_path)
 	std::string stem = base, ext;
 	auto dot = base.find_last_of('.');
 	if (dot != std::string::npos && dot > 0) { stem = base.substr(0, dot); ext = base.substr(dot); }
+	std::vector<std::string> cands;
 	for (int n = 2; n < kFindFreeNameMaxTries; ++n) {
-		std::string cand = parent + (parent.empty() ? "" : "/") + stem + "(" + std::to_string(n) + ")" + ext;
-		if (!dev.FileExists(cand)) return cand;
+		cands.push_back(parent + (parent.empty() ? "" : "/") + stem + "(" + std::to_string(n) + ")" + ext);
+	}
+	std::vector<bool> exists;
+	dev.FilesExist(cands, exists);
+	for (size_t i = 0; i < cands.size(); ++i) {
+		if (!exists[i]) return cands[i];
 	}
 	return std::string();
 }
 
-// Device file size via `stat -c %s`; 0 on missing/error.
-static uint64_t GetAdbSize(ADBDevice& dev, const std::string& abs_path) {
-	std::string cmd = "stat -c %s -- " + ADBUtils::ShellQuote(abs_path) + " 2>/dev/null";
-	std::string out = dev.RunShellCommand(cmd);
-	ADBUtils::TrimTrailingNewlines(out);
-	if (out.empty()) return 0;
-	try { return (uint64_t)std::stoull(out); } catch (...) { return 0; }
-}
-
-// Device mtime via `stat -c %Y`; logs clock-skew warning (throttled) when device clock is wildly off.
+// Device mtime; logs clock-skew warning (throttled) when device clock is wildly off.
 static time_t GetAdbMtime(ADBDevice& dev, const std::string& abs_path) {
-	std::string cmd = "stat -c %Y -- " + ADBUtils::ShellQuote(abs_path) + " 2>/dev/null";
-	std::string out = dev.RunShellCommand(cmd);
-	ADBUtils::TrimTrailingNewlines(out);
-	if (out.empty()) return 0;
+	uint64_t size = 0;
 	time_t mt = 0;
-	try { mt = (time_t)std::stoll(out); } catch (...) { return 0; }
+	if (dev.GetFileStat(abs_path, size, mt) != 0) return 0;
 	if (mt > 0) {
 		static time_t last_warn = 0;
 		const time_t now = time(nullptr);
@@ -340,8 +333,9 @@ static void FillFileMeta(std::shared_ptr<ADBDevice> adb, const std::string& path
 			mtime = static_cast<int64_t>(st.st_mtime);
 		}
 	} else {
-		size = GetAdbSize(*adb, path);
-		mtime = static_cast<int64_t>(GetAdbMtime(*adb, path));
+		time_t mt = 0;
+		adb->GetFileStat(path, size, mt);
+		mtime = static_cast<int64_t>(mt);
 	}
 }
 
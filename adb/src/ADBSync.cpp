@@ -0,0 +1,582 @@
+// Local includes
+#include "ADBSync.h"
+#include "ADBDevice.h"
+#include "ADBLog.h"
+
+// Standard library includes
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+// System includes
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Protocol limits from adb's file_sync_protocol.h.
+static constexpr size_t kSyncDataMax = 64 * 1024;
+static constexpr size_t kSyncPathMax = 1024;
+// Pipelined STAT window: replies of a window must fit socket buffers, else both sides block on write.
+static constexpr size_t kStatWindow = 64;
+static constexpr int kSocketTimeoutSec = 60;
+
+static void PutLE32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(char((v >> (8 * i)) & 0xff));
+}
+
+static uint32_t GetLE32(const unsigned char* p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static uint64_t GetLE64(const unsigned char* p) {
+    return uint64_t(GetLE32(p)) | (uint64_t(GetLE32(p + 4)) << 32);
+}
+
+static bool IsId(const char* id, const char* expected) {
+    return memcmp(id, expected, 4) == 0;
+}
+
+static bool WriteFd(int fd, const void* data, size_t len) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, flags);
+        if (n > 0) {
+            p += n;
+            len -= (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ReadFd(int fd, void* data, size_t len) {
+    char* p = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n > 0) {
+            p += n;
+            len -= (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool WriteFileAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n > 0) {
+            data += n;
+            len -= (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n == 0) errno = EIO;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads 4 hex digits length prefix followed by that many bytes (smart-socket FAIL message, features reply).
+static bool ReadHexPrefixed(int fd, std::string& out) {
+    char hex[5] = {};
+    if (!ReadFd(fd, hex, 4)) return false;
+    char* end = nullptr;
+    unsigned long len = strtoul(hex, &end, 16);
+    if (end != hex + 4) return false;
+    out.resize(len);
+    return len == 0 || ReadFd(fd, &out[0], len);
+}
+
+static int OpenServerSocket() {
+    std::string host = "127.0.0.1", port = "5037";
+    const char* server_socket = getenv("ADB_SERVER_SOCKET");
+    if (server_socket && strncmp(server_socket, "tcp:", 4) == 0) {
+        std::string spec = server_socket + 4;
+        size_t colon = spec.rfind(':');
+        if (colon == std::string::npos) {
+            port = spec;
+        } else {
+            host = spec.substr(0, colon);
+            port = spec.substr(colon + 1);
+        }
+    } else {
+        const char* env_host = getenv("ANDROID_ADB_SERVER_ADDRESS");
+        const char* env_port = getenv("ANDROID_ADB_SERVER_PORT");
+        if (env_host && *env_host) host = env_host;
+        if (env_port && *env_port) port = env_port;
+    }
+
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        DBG("getaddrinfo failed for %s:%s\n", host.c_str(), port.c_str());
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == -1) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd == -1) {
+        DBG("adb server not reachable at %s:%s\n", host.c_str(), port.c_str());
+        return -1;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    struct timeval tv{};
+    tv.tv_sec = kSocketTimeoutSec;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Smart-socket request: 4 hex digits length + payload, answered by OKAY or FAIL + hex-prefixed message.
+static bool SmartRequest(int fd, const std::string& request, std::string& error) {
+    char hdr[8];
+    snprintf(hdr, sizeof(hdr), "%04x", (unsigned)request.size());
+    if (!WriteFd(fd, hdr, 4) || !WriteFd(fd, request.data(), request.size())) {
+        error = "write failed";
+        return false;
+    }
+    char status[4];
+    if (!ReadFd(fd, status, 4)) {
+        error = "read failed";
+        return false;
+    }
+    if (IsId(status, "OKAY")) return true;
+    if (!IsId(status, "FAIL") || !ReadHexPrefixed(fd, error)) error = "protocol error";
+    return false;
+}
+
+ADBSync::ADBSync(const std::string& device_serial)
+    : _device_serial(device_serial)
+{
+}
+
+ADBSync::~ADBSync() {
+    Disconnect();
+}
+
+void ADBSync::Close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Disconnect();
+}
+
+void ADBSync::Disconnect() {
+    if (_fd != -1) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+void ADBSync::QueryFeatures() {
+    int fd = OpenServerSocket();
+    if (fd == -1) return;
+    std::string error, features;
+    const std::string request = _device_serial.empty()
+        ? std::string("host:features")
+        : "host-serial:" + _device_serial + ":features";
+    if (SmartRequest(fd, request, error) && ReadHexPrefixed(fd, features)) {
+        _features_known = true;
+        features = "," + features + ",";
+        _stat_v2 = features.find(",stat_v2,") != std::string::npos;
+        _ls_v2 = features.find(",ls_v2,") != std::string::npos;
+    }
+    close(fd);
+    DBG("features: stat_v2=%d ls_v2=%d\n", _stat_v2, _ls_v2);
+}
+
+int ADBSync::EnsureConnected() {
+    if (_fd != -1) return 0;
+    if (!_features_known) QueryFeatures();
+
+    int fd = OpenServerSocket();
+    if (fd == -1) return ENOTCONN;
+    std::string error;
+    const std::string transport = _device_serial.empty()
+        ? std::string("host:transport-any")
+        : "host:transport:" + _device_serial;
+    if (!SmartRequest(fd, transport, error) || !SmartRequest(fd, "sync:", error)) {
+        DBG("sync session failed: %s\n", error.c_str());
+        close(fd);
+        return ENOTCONN;
+    }
+    _fd = fd;
+    return 0;
+}
+
+int ADBSync::Transaction(const std::function<int()>& op) {
+    for (int attempt = 0;; ++attempt) {
+        const bool reused = (_fd != -1);
+        int rc = EnsureConnected();
+        if (rc != 0) return rc;
+        rc = op();
+        if (rc != ECONNRESET) return rc;
+        // Connection is desynced or dead; a stale one gets a single retry on a fresh connection.
+        Disconnect();
+        if (!reused || attempt > 0) return ENOTCONN;
+        DBG("retrying on fresh connection\n");
+    }
+}
+
+bool ADBSync::WriteAll(const void* data, size_t len) {
+    return WriteFd(_fd, data, len);
+}
+
+bool ADBSync::ReadAll(void* data, size_t len) {
+    return ReadFd(_fd, data, len);
+}
+
+bool ADBSync::AppendRequest(std::string& out, const char* id, const std::string& payload) {
+    if (payload.size() > kSyncPathMax) return false;
+    out.append(id, 4);
+    PutLE32(out, (uint32_t)payload.size());
+    out += payload;
+    return true;
+}
+
+bool ADBSync::AppendStatRequest(std::string& out, const std::string& path, bool follow) {
+    return AppendRequest(out, _stat_v2 ? (follow ? "STA2" : "LST2") : "STAT", path);
+}
+
+bool ADBSync::ReadSyncHeader(char* id, uint32_t& len) {
+    unsigned char hdr[8];
+    if (!ReadAll(hdr, sizeof(hdr))) return false;
+    memcpy(id, hdr, 4);
+    len = GetLE32(hdr + 4);
+    return true;
+}
+
+int ADBSync::ReadFail(uint32_t len) {
+    if (len > kSyncDataMax) return ECONNRESET;
+    std::string message(len, '\0');
+    if (len && !ReadAll(&message[0], len)) return ECONNRESET;
+    DBG("FAIL: %s\n", message.c_str());
+    // adbd ends the sync session after FAIL.
+    Disconnect();
+    return ADBDevice::Str2Errno(message);
+}
+
+int ADBSync::ReadStatReply(ADBSyncStat& st) {
+    char id[4];
+    if (!ReadAll(id, sizeof(id))) return ECONNRESET;
+    st = ADBSyncStat();
+    if (IsId(id, "STAT")) {
+        unsigned char body[12];
+        if (!ReadAll(body, sizeof(body))) return ECONNRESET;
+        st.mode = GetLE32(body);
+        st.size = GetLE32(body + 4);
+        st.mtime = GetLE32(body + 8);
+        return 0;
+    }
+    if (IsId(id, "STA2") || IsId(id, "LST2")) {
+        // error, dev, ino, mode, nlink, uid, gid, size, atime, mtime, ctime
+        unsigned char body[68];
+        if (!ReadAll(body, sizeof(body))) return ECONNRESET;
+        if (GetLE32(body) == 0) {
+            st.mode = GetLE32(body + 20);
+            st.size = GetLE64(body + 36);
+            st.mtime = (int64_t)GetLE64(body + 52);
+        }
+        return 0;
+    }
+    return ECONNRESET;
+}
+
+int ADBSync::DoStatMany(const std::vector<std::string>& paths, std::vector<ADBSyncStat>& out, bool follow) {
+    out.assign(paths.size(), ADBSyncStat());
+    for (size_t base = 0; base < paths.size(); base += kStatWindow) {
+        const size_t end = std::min(paths.size(), base + kStatWindow);
+        std::string request;
+        for (size_t i = base; i < end; ++i) {
+            if (!AppendStatRequest(request, paths[i], follow)) return ENAMETOOLONG;
+        }
+        if (!WriteAll(request.data(), request.size())) return ECONNRESET;
+        for (size_t i = base; i < end; ++i) {
+            int rc = ReadStatReply(out[i]);
+            if (rc != 0) return rc;
+        }
+    }
+    return 0;
+}
+
+int ADBSync::StatMany(const std::vector<std::string>& paths, std::vector<ADBSyncStat>& out, bool follow) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Transaction([&]() { return DoStatMany(paths, out, follow); });
+}
+
+int ADBSync::Stat(const std::string& path, ADBSyncStat& st, bool follow) {
+    std::vector<ADBSyncStat> out;
+    int rc = StatMany({path}, out, follow);
+    if (rc != 0) return rc;
+    st = out[0];
+    return st.mode ? 0 : ENOENT;
+}
+
+int ADBSync::DoList(const std::string& path, std::vector<ADBSyncDirEntry>& out) {
+    out.clear();
+    std::string request;
+    if (!AppendRequest(request, _ls_v2 ? "LIS2" : "LIST", path)) return ENAMETOOLONG;
+    if (!WriteAll(request.data(), request.size())) return ECONNRESET;
+
+    for (;;) {
+        char id[4];
+        if (!ReadAll(id, sizeof(id))) return ECONNRESET;
+        ADBSyncDirEntry entry;
+        uint32_t namelen;
+        if (_ls_v2) {
+            // error, dev, ino, mode, nlink, uid, gid, size, atime, mtime, ctime, namelen
+            unsigned char body[72];
+            if (!ReadAll(body, sizeof(body))) return ECONNRESET;
+            if (IsId(id, "DONE")) return 0;
+            if (!IsId(id, "DNT2")) return ECONNRESET;
+            entry.st.mode = GetLE32(body + 20);
+            entry.st.size = GetLE64(body + 36);
+            entry.st.mtime = (int64_t)GetLE64(body + 52);
+            namelen = GetLE32(body + 68);
+        } else {
+            // mode, size, mtime, namelen
+            unsigned char body[16];
+            if (!ReadAll(body, sizeof(body))) return ECONNRESET;
+            if (IsId(id, "DONE")) return 0;
+            if (!IsId(id, "DENT")) return ECONNRESET;
+            entry.st.mode = GetLE32(body);
+            entry.st.size = GetLE32(body + 4);
+            entry.st.mtime = GetLE32(body + 8);
+            namelen = GetLE32(body + 12);
+        }
+        if (namelen > kSyncPathMax) return ECONNRESET;
+        entry.name.resize(namelen);
+        if (namelen && !ReadAll(&entry.name[0], namelen)) return ECONNRESET;
+        if (entry.name != "." && entry.name != "..") out.emplace_back(std::move(entry));
+    }
+}
+
+int ADBSync::List(const std::string& path, std::vector<ADBSyncDirEntry>& out) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Transaction([&]() { return DoList(path, out); });
+}
+
+int ADBSync::DoRecv(const std::string& remote_path, const std::string& local_path,
+                    const std::function<void(int)>& on_progress, const std::function<bool()>& abort_check) {
+    std::string target = local_path;
+    struct stat lst{};
+    if (stat(local_path.c_str(), &lst) == 0 && S_ISDIR(lst.st_mode)) {
+        target = ADBUtils::JoinPath(local_path, ADBUtils::PathBasename(remote_path));
+    }
+
+    // STAT and RECV go out together, STAT reply arrives before file data.
+    std::string request;
+    if (!AppendStatRequest(request, remote_path, true) || !AppendRequest(request, "RECV", remote_path)) {
+        return ENAMETOOLONG;
+    }
+    if (!WriteAll(request.data(), request.size())) return ECONNRESET;
+    ADBSyncStat st;
+    int rc = ReadStatReply(st);
+    if (rc != 0) return rc;
+    // Check before open() truncates existing local file.
+    if (st.mode == 0) {
+        Disconnect();
+        return ENOENT;
+    }
+    if (S_ISDIR(st.mode)) {
+        Disconnect();
+        return ENOTSUP;
+    }
+
+    int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        rc = errno;
+        // RECV reply is already on its way, session can't be reused.
+        Disconnect();
+        return rc;
+    }
+
+    uint64_t done = 0;
+    int last_percent = -1;
+    std::vector<char> buf;
+    for (;;) {
+        if (abort_check && abort_check()) {
+            Disconnect();
+            rc = ECANCELED;
+            break;
+        }
+        char id[4];
+        uint32_t len;
+        if (!ReadSyncHeader(id, len)) {
+            rc = ECONNRESET;
+            break;
+        }
+        if (IsId(id, "DONE")) {
+            rc = 0;
+            break;
+        }
+        if (IsId(id, "FAIL")) {
+            rc = ReadFail(len);
+            break;
+        }
+        if (!IsId(id, "DATA") || len > kSyncDataMax) {
+            rc = ECONNRESET;
+            break;
+        }
+        buf.resize(len);
+        if (!ReadAll(buf.data(), len)) {
+            rc = ECONNRESET;
+            break;
+        }
+        if (!WriteFileAll(fd, buf.data(), len)) {
+            rc = errno;
+            Disconnect();
+            break;
+        }
+        done += len;
+        if (on_progress && st.size) {
+            int percent = (int)std::min<uint64_t>(100, done * 100 / st.size);
+            if (percent != last_percent) {
+                last_percent = percent;
+                on_progress(percent);
+            }
+        }
+    }
+
+    if (rc == 0) {
+        fchmod(fd, S_ISREG(st.mode) ? (st.mode & 07777) : 0644);
+        if (st.mtime) {
+            struct timeval tv[2]{};
+            tv[0].tv_sec = tv[1].tv_sec = (time_t)st.mtime;
+            futimes(fd, tv);
+        }
+    }
+    close(fd);
+    if (rc != 0) {
+        unlink(target.c_str());
+    } else if (on_progress && last_percent != 100) {
+        on_progress(100);
+    }
+    return rc;
+}
+
+int ADBSync::Recv(const std::string& remote_path, const std::string& local_path,
+                  const std::function<void(int)>& on_progress, const std::function<bool()>& abort_check) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Transaction([&]() { return DoRecv(remote_path, local_path, on_progress, abort_check); });
+}
+
+int ADBSync::DoSend(const std::string& local_path, const std::string& remote_path,
+                    const std::function<void(int)>& on_progress, const std::function<bool()>& abort_check) {
+    struct stat lst{};
+    if (stat(local_path.c_str(), &lst) != 0) return errno;
+    if (!S_ISREG(lst.st_mode)) return ENOTSUP;
+
+    std::string target = remote_path;
+    std::vector<ADBSyncStat> rstats;
+    int rc = DoStatMany({remote_path}, rstats, true);
+    if (rc != 0) return rc;
+    if (S_ISDIR(rstats[0].mode)) {
+        target = ADBUtils::JoinPath(remote_path, ADBUtils::PathBasename(local_path));
+    }
+
+    int fd = open(local_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return errno;
+
+    std::string request;
+    if (!AppendRequest(request, "SEND", target + "," + std::to_string((unsigned)lst.st_mode))) {
+        close(fd);
+        return ENAMETOOLONG;
+    }
+
+    const uint64_t total = (uint64_t)lst.st_size;
+    uint64_t done = 0;
+    int last_percent = -1;
+    std::vector<char> chunk(8 + kSyncDataMax);
+    bool write_failed = false;
+    rc = 0;
+    if (on_progress) on_progress(0);
+    if (!WriteAll(request.data(), request.size())) write_failed = true;
+
+    while (!write_failed) {
+        if (abort_check && abort_check()) {
+            // Dropping connection mid-SEND makes adbd discard partial file.
+            Disconnect();
+            rc = ECANCELED;
+            break;
+        }
+        ssize_t n = read(fd, chunk.data() + 8, kSyncDataMax);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            rc = errno;
+            Disconnect();
+            break;
+        }
+        if (n == 0) break;
+        memcpy(chunk.data(), "DATA", 4);
+        std::string len_le;
+        PutLE32(len_le, (uint32_t)n);
+        memcpy(chunk.data() + 4, len_le.data(), 4);
+        if (!WriteAll(chunk.data(), 8 + (size_t)n)) {
+            write_failed = true;
+            break;
+        }
+        done += (uint64_t)n;
+        if (on_progress && total) {
+            int percent = (int)std::min<uint64_t>(100, done * 100 / total);
+            if (percent != last_percent) {
+                last_percent = percent;
+                on_progress(percent);
+            }
+        }
+    }
+    close(fd);
+    if (rc != 0) return rc;
+
+    if (!write_failed) {
+        std::string done_msg("DONE", 4);
+        PutLE32(done_msg, (uint32_t)lst.st_mtime);
+        write_failed = !WriteAll(done_msg.data(), done_msg.size());
+    }
+
+    // adbd may have already answered FAIL (e.g. read-only fs) which is why writing stopped working.
+    char id[4];
+    uint32_t len;
+    if (!ReadSyncHeader(id, len)) return ECONNRESET;
+    if (IsId(id, "FAIL")) return ReadFail(len);
+    if (write_failed || !IsId(id, "OKAY")) return ECONNRESET;
+    if (on_progress && last_percent != 100) on_progress(100);
+    return 0;
+}
+
+int ADBSync::Send(const std::string& local_path, const std::string& remote_path,
+                  const std::function<void(int)>& on_progress, const std::function<bool()>& abort_check) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Transaction([&]() { return DoSend(local_path, remote_path, on_progress, abort_check); });
+}
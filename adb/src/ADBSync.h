@@ -0,0 +1,85 @@
+#pragma once
+
+// Standard library includes
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <errno.h>
+
+// Sync-protocol view of remote file; mode == 0 means path doesn't exist.
+struct ADBSyncStat {
+    uint32_t mode = 0;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+struct ADBSyncDirEntry {
+    std::string name;
+    ADBSyncStat st;
+};
+
+// Talks to the local adb server directly: smart-socket "host:transport:<serial>" + "sync:", then
+// LIST/STAT/SEND/RECV over one persistent connection — no adb process per operation.
+// Server address: ADB_SERVER_SOCKET=tcp:[host:]port, else ANDROID_ADB_SERVER_ADDRESS/_PORT, else 127.0.0.1:5037
+// (so it can be pointed at a fake server). All methods return 0 or errno; ENOTCONN/ENOTSUP mean the
+// operation wasn't done over sync (server/device unreachable, connection lost, unsupported item) and
+// the caller should fall back to the adb CLI.
+class ADBSync {
+public:
+    ADBSync(const std::string& device_serial = "");
+    ~ADBSync();
+
+    ADBSync(const ADBSync&) = delete;
+    ADBSync& operator=(const ADBSync&) = delete;
+
+    // follow = stat() semantics; only honored when device supports stat_v2, otherwise it's lstat().
+    int Stat(const std::string& path, ADBSyncStat& st, bool follow = true);
+    // Pipelined: requests go out in windows without waiting for each reply. out[i].mode == 0 if missing.
+    int StatMany(const std::vector<std::string>& paths, std::vector<ADBSyncStat>& out, bool follow = true);
+    // Entries of directory without "." and ".."; missing directory yields empty list.
+    int List(const std::string& path, std::vector<ADBSyncDirEntry>& out);
+
+    // Streaming single-file transfers; existing directory as destination means 'put inside it'.
+    // Recv preserves mode and mtime like 'adb pull -a'. on_progress gets percent of current file.
+    int Recv(const std::string& remote_path, const std::string& local_path,
+             const std::function<void(int)>& on_progress = {}, const std::function<bool()>& abort_check = {});
+    int Send(const std::string& local_path, const std::string& remote_path,
+             const std::function<void(int)>& on_progress = {}, const std::function<bool()>& abort_check = {});
+
+    void Close();
+
+    static bool IsFallback(int rc) { return rc == ENOTCONN || rc == ENOTSUP; }
+
+private:
+    std::string _device_serial;
+    int _fd = -1;
+    bool _features_known = false;
+    bool _stat_v2 = false;
+    bool _ls_v2 = false;
+
+    // Serializes whole request/response transactions on the socket.
+    std::mutex _mutex;
+
+    int EnsureConnected();
+    void Disconnect();
+    void QueryFeatures();
+    bool WriteAll(const void* data, size_t len);
+    bool ReadAll(void* data, size_t len);
+    bool AppendRequest(std::string& out, const char* id, const std::string& payload);
+    bool AppendStatRequest(std::string& out, const std::string& path, bool follow);
+    bool ReadSyncHeader(char* id, uint32_t& len);
+    int ReadFail(uint32_t len);
+    int ReadStatReply(ADBSyncStat& st);
+
+    int DoStatMany(const std::vector<std::string>& paths, std::vector<ADBSyncStat>& out, bool follow);
+    int DoList(const std::string& path, std::vector<ADBSyncDirEntry>& out);
+    int DoRecv(const std::string& remote_path, const std::string& local_path,
+               const std::function<void(int)>& on_progress, const std::function<bool()>& abort_check);
+    int DoSend(const std::string& local_path, const std::string& remote_path,
+               const std::function<void(int)>& on_progress, const std::function<bool()>& abort_check);
+
+    // Runs op, reconnecting once if it failed on a connection left over from earlier (server restart, idle drop).
+    int Transaction(const std::function<int()>& op);
+};
@@ -498,6 +498,8 @@ private:
 
 	void update_hard_link_counts();
 	void groupHardLinks(HardLinkPrepData &prep_data);
+	bool split_extract_lanes(const std::vector<UInt32> &indices, std::vector<std::vector<UInt32>> &lanes);
+	bool open_lane_in_archive(ComObject<IInArchive<UseVirtualDestructor>> &arc);
 
 public:
 	void extract(UInt32 src_dir_index, const std::vector<UInt32> &src_indices, const ExtractOptions &options,
@@ -13,6 +13,7 @@
 #include <sys/mman.h>
 #include <pwd.h>
 #include <grp.h>
+#include <Threaded.h>
 
 ExtractOptions::ExtractOptions()
 	: ignore_errors(false),
@@ -40,6 +41,70 @@ using PendingHardlinks = std::vector<PendingHardlink>;
 using PendingSymlinks = std::vector<PendingSymlink>;
 using PendingSPFiles = std::vector<UInt32>;
 
+// state shared by extraction lanes that run in parallel on own instances of archive
+struct ExtractLanes {
+	// properties of lanes' items read before lanes start, so lanes and their write caches
+	// don't query archive instance that is busy extracting in other thread meanwhile
+	struct ItemProps {
+		DWORD attr;
+		DWORD posixattr;
+		UInt64 size;
+		FILETIME mtime;
+		FILETIME atime;
+		bool anti;
+	};
+	std::unordered_map<UInt32, ItemProps> items;
+
+	// serializes overwrite and error prompts along with updates of state they share:
+	// skipped indices, overwrite action, ignore errors flag and error log
+	std::mutex prompt_mutex;
+	std::atomic<bool> aborted{false};
+
+	template<bool UseVirtualDestructor>
+	void add_item(const Archive<UseVirtualDestructor> &archive, UInt32 index)
+	{
+		ItemProps props{};
+		props.attr = archive.get_attr(index, &props.posixattr);
+		props.size = archive.get_size(index);
+		props.mtime = archive.get_mtime(index);
+		props.atime = archive.get_atime(index);
+		props.anti = archive.get_anti(index);
+		items.emplace(index, props);
+	}
+
+	const ItemProps &item(UInt32 index) const { return items.at(index); }
+
+	static std::unique_lock<std::mutex> prompt_lock(const std::shared_ptr<ExtractLanes> &lanes)
+	{
+		return lanes ? std::unique_lock<std::mutex>(lanes->prompt_mutex) : std::unique_lock<std::mutex>();
+	}
+};
+
+// same as RETRY_OR_IGNORE_END and IGNORE_END, but serialize error prompts of parallel extraction lanes
+#define LANES_RETRY_OR_IGNORE_END(lanes, ignore_errors, error_log, progress)                                 \
+	break;                                                                                                   \
+	}                                                                                                        \
+	catch (const Error &error)                                                                               \
+	{                                                                                                        \
+		auto prompt_lock = ExtractLanes::prompt_lock(lanes);                                                 \
+		retry_or_ignore_error(error, error_ignored, ignore_errors, error_log, progress, true, true);         \
+		if (error_ignored)                                                                                   \
+			break;                                                                                           \
+	}                                                                                                        \
+	}
+
+#define LANES_IGNORE_END(lanes, ignore_errors, error_log, progress)                                          \
+	break;                                                                                                   \
+	}                                                                                                        \
+	catch (const Error &error)                                                                               \
+	{                                                                                                        \
+		auto prompt_lock = ExtractLanes::prompt_lock(lanes);                                                 \
+		retry_or_ignore_error(error, error_ignored, ignore_errors, error_log, progress, false, true);        \
+		if (error_ignored)                                                                                   \
+			break;                                                                                           \
+	}                                                                                                        \
+	}
+
 static std::wstring get_progress_bar_str(unsigned width, unsigned percent1, unsigned percent2)
 {
 	const wchar_t c_pb_black = 9608;
@@ -76,6 +141,7 @@ private:
 	UInt64 cache_total;
 	std::wstring cache_file_path;
 	bool bDoubleBuffering;
+	std::vector<UInt64> lanes_total, lanes_completed;
 
 	void do_update_ui() override
 	{
@@ -142,6 +208,25 @@ public:
 		extract_completed = size;
 		update_ui();
 	}
+	void set_lanes(size_t count)
+	{
+		CriticalSectionLock lock(GetSync());
+		lanes_total.assign(count, 0);
+		lanes_completed.assign(count, 0);
+	}
+	void set_extract_total(UInt64 size, size_t lane)
+	{
+		CriticalSectionLock lock(GetSync());
+		lanes_total[lane] = size;
+		extract_total = std::accumulate(lanes_total.begin(), lanes_total.end(), UInt64(0));
+	}
+	void update_extract_completed(UInt64 size, size_t lane)
+	{
+		CriticalSectionLock lock(GetSync());
+		lanes_completed[lane] = size;
+		extract_completed = std::accumulate(lanes_completed.begin(), lanes_completed.end(), UInt64(0));
+		update_ui();
+	}
 	void update_cache_file(const std::wstring &file_path)
 	{
 		CriticalSectionLock lock(GetSync());
@@ -322,6 +407,7 @@ private:
 	static constexpr size_t c_min_cache_size = 32 * 1024 * 1024; // x2 for double buffer
 	static constexpr size_t c_max_cache_size = 100 * 1024 * 1024; // x2 for double buffer
 	static constexpr size_t c_block_size = 1 * 1024 * 1024; // Write block size
+	static constexpr size_t c_min_lane_cache_size = 8 * 1024 * 1024; // of each parallel extraction lane
 
 	struct CacheRecord {
 		std::wstring file_path;
@@ -337,6 +423,7 @@ private:
 	const ExtractOptions &options;
 	std::shared_ptr<ErrorLog> error_log;
 	std::shared_ptr<ExtractProgress> progress;
+	std::shared_ptr<ExtractLanes> lanes;
 	bool bDouble_buffering = true;
 
 	unsigned char* _buffer;
@@ -362,6 +449,29 @@ private:
 	std::atomic<bool> finalize_called { false };
 	std::atomic<bool> worker_has_unfinished_work { false };
 
+	DWORD item_attr(UInt32 index, DWORD &posixattr) const
+	{
+		if (!lanes)
+			return archive->get_attr(index, &posixattr);
+		posixattr = lanes->item(index).posixattr;
+		return lanes->item(index).attr;
+	}
+
+	UInt64 item_size(UInt32 index) const
+	{
+		return lanes ? lanes->item(index).size : archive->get_size(index);
+	}
+
+	FILETIME item_mtime(UInt32 index) const
+	{
+		return lanes ? lanes->item(index).mtime : archive->get_mtime(index);
+	}
+
+	FILETIME item_atime(UInt32 index) const
+	{
+		return lanes ? lanes->item(index).atime : archive->get_atime(index);
+	}
+
 	size_t get_max_cache_size() const
 	{
 		MEMORYSTATUSEX mem_st { sizeof(mem_st) };
@@ -404,10 +514,10 @@ private:
 		DWORD attrib = FILE_ATTRIBUTE_TEMPORARY;
 //		const ArcFileInfo &fi = archive->file_list[current_rec.file_id];
 		DWORD attr, posixattr = 0;
-		attr = archive->get_attr(current_rec.file_id, &posixattr);
+		attr = item_attr(current_rec.file_id, posixattr);
 		(void)attr;
 		if ((posixattr & S_IFMT) == S_IFLNK) {
-			if (archive->get_size(current_rec.file_id) <= PATH_MAX)
+			if (item_size(current_rec.file_id) <= PATH_MAX)
 				attrib |= FILE_FLAG_CREATE_REPARSE_POINT;
 		}
 		bool opened = false;
@@ -422,7 +532,7 @@ private:
 			}
 		}
 		CHECK_FILE(opened, file_path);
-		RETRY_OR_IGNORE_END(*ignore_errors, *error_log, *progress)
+		LANES_RETRY_OR_IGNORE_END(lanes, *ignore_errors, *error_log, *progress)
 
 		if (error_ignored)
 			error_state = true;
@@ -434,7 +544,7 @@ private:
 		//fprintf(stderr, "FWC: allocate_file() [TID: %lu]\n", static_cast<unsigned long>(pthread_self()));
 		if (error_state)
 			return;
-		if (archive->get_size(current_rec.file_id) == 0)
+		if (item_size(current_rec.file_id) == 0)
 			return;
 
 		UInt64 size;
@@ -444,10 +554,10 @@ private:
 			size = 0;
 
 		RETRY_OR_IGNORE_BEGIN
-		file.set_pos(size + archive->get_size(current_rec.file_id), FILE_BEGIN);
+		file.set_pos(size + item_size(current_rec.file_id), FILE_BEGIN);
 		file.set_end();
 		file.set_pos(size, FILE_BEGIN);
-		RETRY_OR_IGNORE_END(*ignore_errors, *error_log, *progress)
+		LANES_RETRY_OR_IGNORE_END(lanes, *ignore_errors, *error_log, *progress)
 
 		if (error_ignored)
 			error_state = true;
@@ -475,7 +585,7 @@ private:
 			//fprintf(stderr, "FWC: file.write pos=%zu current_rec.buffer_size =%zu\n", pos, current_rec.buffer_size );
 
 			size_written = file.write(buffer[wbi] + current_rec.buffer_pos + pos, size);
-			RETRY_OR_IGNORE_END(*ignore_errors, *error_log, *progress)
+			LANES_RETRY_OR_IGNORE_END(lanes, *ignore_errors, *error_log, *progress)
 
 			if (error_ignored) {
 				error_state = true;
@@ -503,7 +613,7 @@ private:
 		const ArcFileInfo &fi = archive->file_list[current_rec.file_id];
 		std::string mb_path = StrWide2MB(current_rec.file_path);
 		DWORD attr, posixattr = 0;
-		attr = archive->get_attr(current_rec.file_id, &posixattr);
+		attr = item_attr(current_rec.file_id, posixattr);
 		(void)attr;
 
 		RETRY_OR_IGNORE_BEGIN
@@ -539,8 +649,8 @@ private:
 					set_file_owner_group(mb_path, fi, options.extract_owners_groups);
 				}
 
-				FILETIME atime_ft = archive->get_atime(current_rec.file_id);
-				FILETIME mtime_ft = archive->get_mtime(current_rec.file_id);
+				FILETIME atime_ft = item_atime(current_rec.file_id);
+				FILETIME mtime_ft = item_mtime(current_rec.file_id);
 				if (set_symlink_times(mb_path, atime_ft, mtime_ft)) {
 					FAIL(errno);
 				}
@@ -560,13 +670,13 @@ private:
 				}
 			}
 
-			FILETIME atime_ft = archive->get_atime(current_rec.file_id);
-			FILETIME mtime_ft = archive->get_mtime(current_rec.file_id);
+			FILETIME atime_ft = item_atime(current_rec.file_id);
+			FILETIME mtime_ft = item_mtime(current_rec.file_id);
 			if (set_file_times(mb_path, atime_ft, mtime_ft)) {
 				FAIL(errno);
 			}
 		}
-		RETRY_OR_IGNORE_END(*ignore_errors, *error_log, *progress)
+		LANES_RETRY_OR_IGNORE_END(lanes, *ignore_errors, *error_log, *progress)
 		if (error_ignored) {
 			error_state = true;
 		}
@@ -740,14 +850,15 @@ public:
 	FileWriteCache(std::shared_ptr<Archive<UseVirtualDestructor>> archive,
 		std::shared_ptr<bool> ignore_errors, const ExtractOptions &options,
 		std::shared_ptr<ErrorLog> error_log, std::shared_ptr<ExtractProgress> progress,
-		bool double_buffering = false )
+		bool double_buffering = false, std::shared_ptr<ExtractLanes> lanes = nullptr, size_t lanes_count = 1 )
 		: archive(archive),
 		ignore_errors(ignore_errors),
 		options(options),
 		error_log(error_log),
 		progress(progress),
+		lanes(lanes),
 		bDouble_buffering(double_buffering),
-		buffer_size(get_max_cache_size())
+		buffer_size(std::max(get_max_cache_size() / lanes_count, c_min_lane_cache_size))
 	{
 		progress->set_cache_total(buffer_size);
 		_buffer = (unsigned char *)mmap(NULL, buffer_size * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
@@ -815,6 +926,8 @@ public:
 		store(data + full_buffer_cnt * buffer_size, size % buffer_size);
 	}
 
+	size_t cache_size() const { return buffer_size; }
+
 	bool has_background_work() const {
 		return worker_started.load(std::memory_order_acquire) &&
 			   worker_has_unfinished_work.load(std::memory_order_acquire);
@@ -906,12 +1019,53 @@ private:
 	std::shared_ptr<FileWriteCache<UseVirtualDestructor>> cache;
 	std::shared_ptr<ExtractProgress> progress;
 	std::shared_ptr<std::set<UInt32>> skipped_indices;
+	std::shared_ptr<ExtractLanes> lanes;
+	size_t lane;
+
+	bool ask_overwrite(UInt32 index, const FindData &dst_file_info, OverwriteAction &overwrite)
+	{
+		if (*overwrite_action == oaAsk) {
+			OverwriteFileInfo src_ov_info, dst_ov_info;
+			src_ov_info.is_dir = file_info.is_dir;
+			src_ov_info.size = lanes ? lanes->item(index).size : archive->get_size(index);
+			src_ov_info.mtime = lanes ? lanes->item(index).mtime : archive->get_mtime(index);
+			dst_ov_info.is_dir = dst_file_info.is_dir();
+			dst_ov_info.size = dst_file_info.size();
+			dst_ov_info.mtime = dst_file_info.ftLastWriteTime;
+			ProgressSuspend ps(*progress);
+			OverwriteOptions ov_options;
+			if (!overwrite_dialog(file_path, src_ov_info, dst_ov_info, odkExtract, ov_options))
+				return false;
+			if (g_options.strict_case && ov_options.action == oaOverwrite) {
+				auto dst_len = std::wcslen(dst_file_info.cFileName);
+				if (file_path.size() > dst_len
+						&& file_path.substr(file_path.size() - dst_len) != dst_file_info.cFileName)
+					ov_options.action = oaOverwriteCase;
+			}
+			overwrite = ov_options.action;
+			if (ov_options.all)
+				*overwrite_action = ov_options.action;
+		} else
+			overwrite = *overwrite_action;
+
+		if (overwrite == oaSkip) {
+			if (skipped_indices) {
+				skipped_indices->insert(index);
+				for (UInt32 idx = file_info.parent; idx != c_root_index;
+						idx = archive->file_list[idx].parent) {
+					skipped_indices->insert(idx);
+				}
+			}
+		}
+		return true;
+	}
 
 public:
 	ArchiveExtractor(UInt32 src_dir_index, const std::wstring &dst_dir, std::shared_ptr<Archive<UseVirtualDestructor>> archive,
 			HardlinkIndexMap &hlmap, std::shared_ptr<OverwriteAction> overwrite_action, std::shared_ptr<bool> ignore_errors,
 			std::shared_ptr<ErrorLog> error_log, std::shared_ptr<FileWriteCache<UseVirtualDestructor>> cache,
-			std::shared_ptr<ExtractProgress> progress, std::shared_ptr<std::set<UInt32>> skipped_indices)
+			std::shared_ptr<ExtractProgress> progress, std::shared_ptr<std::set<UInt32>> skipped_indices,
+			std::shared_ptr<ExtractLanes> lanes = nullptr, size_t lane = 0)
 		: src_dir_index(src_dir_index),
 		  dst_dir(dst_dir),
 		  archive(archive),
@@ -921,7 +1075,9 @@ public:
 		  error_log(error_log),
 		  cache(cache),
 		  progress(progress),
-		  skipped_indices(skipped_indices)
+		  skipped_indices(skipped_indices),
+		  lanes(lanes),
+		  lane(lane)
 	{
 	}
 
@@ -935,7 +1091,10 @@ public:
 	{
 		CriticalSectionLock lock(GetSync());
 		COM_ERROR_HANDLER_BEGIN
-		progress->set_extract_total(total);
+		if (lanes)
+			progress->set_extract_total(total, lane);
+		else
+			progress->set_extract_total(total);
 		return S_OK;
 		COM_ERROR_HANDLER_END
 	}
@@ -943,8 +1102,14 @@ public:
 	{
 		CriticalSectionLock lock(GetSync());
 		COM_ERROR_HANDLER_BEGIN
-		if (completeValue)
-			progress->update_extract_completed(*completeValue);
+		if (lanes && lanes->aborted)
+			return E_ABORT;
+		if (completeValue) {
+			if (lanes)
+				progress->update_extract_completed(*completeValue, lane);
+			else
+				progress->update_extract_completed(*completeValue);
+		}
 		return S_OK;
 		COM_ERROR_HANDLER_END
 	}
@@ -973,47 +1138,22 @@ public:
 		if (askExtractMode != NArchive::NExtract::NAskMode::kExtract)
 			return S_OK;
 
+		if (lanes && lanes->aborted)
+			return E_ABORT;
+
 		FindData dst_file_info;
 		OverwriteAction overwrite;
 		if (File::get_find_data_nt(file_path, dst_file_info)) {
-			if (*overwrite_action == oaAsk) {
-				OverwriteFileInfo src_ov_info, dst_ov_info;
-				src_ov_info.is_dir = file_info.is_dir;
-				src_ov_info.size = archive->get_size(index);
-				src_ov_info.mtime = archive->get_mtime(index);
-				dst_ov_info.is_dir = dst_file_info.is_dir();
-				dst_ov_info.size = dst_file_info.size();
-				dst_ov_info.mtime = dst_file_info.ftLastWriteTime;
-				ProgressSuspend ps(*progress);
-				OverwriteOptions ov_options;
-				if (!overwrite_dialog(file_path, src_ov_info, dst_ov_info, odkExtract, ov_options))
-					return E_ABORT;
-				if (g_options.strict_case && ov_options.action == oaOverwrite) {
-					auto dst_len = std::wcslen(dst_file_info.cFileName);
-					if (file_path.size() > dst_len
-							&& file_path.substr(file_path.size() - dst_len) != dst_file_info.cFileName)
-						ov_options.action = oaOverwriteCase;
-				}
-				overwrite = ov_options.action;
-				if (ov_options.all)
-					*overwrite_action = ov_options.action;
-			} else
-				overwrite = *overwrite_action;
-
-			if (overwrite == oaSkip) {
-				if (skipped_indices) {
-					skipped_indices->insert(index);
-					for (UInt32 idx = file_info.parent; idx != c_root_index;
-							idx = archive->file_list[idx].parent) {
-						skipped_indices->insert(idx);
-					}
-				}
+			auto prompt_lock = ExtractLanes::prompt_lock(lanes); // other lanes may prompt at same time
+			if (!ask_overwrite(index, dst_file_info, overwrite))
+				return E_ABORT;
+			prompt_lock = std::unique_lock<std::mutex>();
+			if (overwrite == oaSkip)
 				return S_OK;
-			}
 		} else
 			overwrite = oaAsk;
 
-		if (archive->get_anti(index)) {
+		if (lanes ? lanes->item(index).anti : archive->get_anti(index)) {
 
 			if (File::exists(file_path))
 				File::delete_file(file_path);
@@ -1085,7 +1225,7 @@ public:
 		error.messages.emplace_back(file_path);
 		error.messages.emplace_back(archive->arc_path);
 		throw error;
-		IGNORE_END(*ignore_errors, *error_log, *progress)
+		LANES_IGNORE_END(lanes, *ignore_errors, *error_log, *progress)
 		COM_ERROR_HANDLER_END
 	}
 
@@ -1986,6 +2126,93 @@ void create_hardlinks(
 	progress->clean();
 }
 
+// Items that can be decompressed independently (entries of ZIP or non-solid 7z, separate
+// solid blocks) are distributed between lanes, each extracted by own archive instance.
+// Items of same solid block or same hard link group are kept in same lane, so nothing is
+// decompressed twice and no file is written by two lanes.
+template<bool UseVirtualDestructor>
+bool Archive<UseVirtualDestructor>::split_extract_lanes(const std::vector<UInt32> &indices,
+		std::vector<std::vector<UInt32>> &lanes)
+{
+	static constexpr UInt64 c_min_parallel_size = 16 * 1024 * 1024;
+
+	lanes.clear();
+	if (g_options.extract_threads_num == 1 || indices.size() < 2 || ex_stream || parent
+			|| arc_chain.size() != 1 || !volume_names.empty())
+		return false;
+
+	const ArcType &type = arc_chain.front().type;
+	if (type != c_zip && type != c_7z)
+		return false;
+
+	std::vector<size_t> units(indices.size());
+	std::iota(units.begin(), units.end(), 0);
+	const auto find_unit = [&](size_t i) {
+		while (units[i] != i)
+			i = units[i] = units[units[i]];
+		return i;
+	};
+
+	std::map<UInt64, size_t> block_items, hl_group_items;
+	UInt64 total_size = 0;
+	for (size_t i = 0; i < indices.size(); ++i) {
+		const UInt32 index = indices[i];
+		// password prompts and wrong password handling remain serial
+		if (get_encrypted(index))
+			return false;
+
+		total_size += get_size(index);
+		PropVariant prop;
+		if (in_arc->GetProperty(index, kpidBlock, prop.ref()) == S_OK && prop.is_uint()) {
+			const auto ir = block_items.emplace(prop.get_uint(), i);
+			if (!ir.second)
+				units[find_unit(i)] = find_unit(ir.first->second);
+		}
+		const ArcFileInfo &file_info = file_list[index];
+		if (file_info.hl_group != (uint32_t)-1 && !file_info.is_altstream) {
+			const auto ir = hl_group_items.emplace(file_info.hl_group, i);
+			if (!ir.second)
+				units[find_unit(i)] = find_unit(ir.first->second);
+		}
+	}
+
+	if (total_size < c_min_parallel_size)
+		return false;
+
+	std::map<size_t, std::pair<UInt64, std::vector<UInt32>>> unit_items;
+	for (size_t i = 0; i < indices.size(); ++i) {
+		auto &unit = unit_items[find_unit(i)];
+		unit.first += get_size(indices[i]);
+		unit.second.emplace_back(indices[i]);
+	}
+
+	size_t lanes_count = g_options.extract_threads_num > 0
+		? static_cast<size_t>(g_options.extract_threads_num) : static_cast<size_t>(BestThreadsCount());
+	lanes_count = std::min(lanes_count, unit_items.size());
+	if (lanes_count < 2)
+		return false;
+
+	// biggest units first, each to least loaded lane
+	std::vector<std::pair<UInt64, std::vector<UInt32>> *> sorted_units;
+	for (auto &unit : unit_items)
+		sorted_units.emplace_back(&unit.second);
+	std::stable_sort(sorted_units.begin(), sorted_units.end(),
+		[](const auto *a, const auto *b) { return a->first > b->first; });
+
+	std::vector<UInt64> lanes_size(lanes_count, 0);
+	lanes.resize(lanes_count);
+	for (const auto *unit : sorted_units) {
+		const size_t lane = std::min_element(lanes_size.begin(), lanes_size.end()) - lanes_size.begin();
+		lanes_size[lane] += unit->first;
+		lanes[lane].insert(lanes[lane].end(), unit->second.begin(), unit->second.end());
+	}
+
+	for (auto &lane : lanes)
+		std::sort(lane.begin(), lane.end());
+
+	return true;
+}
+
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::extract(UInt32 src_dir_index, const std::vector<UInt32> &src_indices,
 		const ExtractOptions &options, std::shared_ptr<ErrorLog> error_log,
@@ -2043,7 +2270,78 @@ void Archive<UseVirtualDestructor>::extract(UInt32 src_dir_index, const std::vec
 		ex_stream->Seek(0, STREAM_CTL_GETFULLSIZE, &bFullSizeStream);
 	}
 
-	if (ex_stream && !bFullSizeStream) {
+	std::vector<std::vector<UInt32>> lanes_indices;
+	if (split_extract_lanes(indices, lanes_indices)) {
+		const size_t max_lanes = lanes_indices.size();
+		std::vector<ComObject<IInArchive<UseVirtualDestructor>>> lanes_arc(max_lanes);
+		lanes_arc[0] = in_arc;
+		size_t n_lanes = 1;
+		while (n_lanes < max_lanes && open_lane_in_archive(lanes_arc[n_lanes]))
+			++n_lanes;
+		if (n_lanes < max_lanes) {
+			for (size_t i = n_lanes; i < max_lanes; ++i) {
+				auto &lane = lanes_indices[i % n_lanes];
+				lane.insert(lane.end(), lanes_indices[i].begin(), lanes_indices[i].end());
+				std::sort(lane.begin(), lane.end());
+			}
+			lanes_indices.resize(n_lanes);
+			lanes_arc.resize(n_lanes);
+		}
+
+		const auto lanes = std::make_shared<ExtractLanes>();
+		for (const auto &lane_indices : lanes_indices) {
+			for (const UInt32 index : lane_indices)
+				lanes->add_item(*this, index);
+		}
+		progress->set_lanes(n_lanes);
+		std::vector<std::shared_ptr<FileWriteCache<UseVirtualDestructor>>> lanes_cache;
+		std::vector<ComObject<IArchiveExtractCallback<UseVirtualDestructor>>> lanes_extractor;
+		UInt64 lanes_cache_total = 0;
+		for (size_t i = 0; i < n_lanes; ++i) {
+			lanes_cache.emplace_back(std::make_shared<FileWriteCache<UseVirtualDestructor>>(this->shared_from_this(),
+					ignore_errors, options, error_log, progress, bDoubleBuffering, lanes, n_lanes));
+			lanes_cache_total += lanes_cache.back()->cache_size();
+			lanes_extractor.emplace_back(new ArchiveExtractor<UseVirtualDestructor>(src_dir_index, options.dst_dir,
+					this->shared_from_this(), hlmap, overwrite_action, ignore_errors,
+					error_log, lanes_cache.back(), progress,
+					skipped_indices, lanes, i));
+		}
+		progress->set_cache_total(lanes_cache_total);
+
+		std::vector<int> lanes_errc(n_lanes, S_OK);
+		std::atomic<size_t> lanes_running{n_lanes};
+		std::atomic<size_t> first_failed_lane{n_lanes};
+		std::vector<std::thread> lanes_thread;
+		for (size_t i = 0; i < n_lanes; ++i) {
+			lanes_thread.emplace_back([&, i]() {
+				lanes_errc[i] = lanes_arc[i]->Extract(lanes_indices[i].data(),
+						static_cast<UInt32>(lanes_indices[i].size()), 0, lanes_extractor[i]);
+				if (lanes_errc[i] != S_OK) {
+					size_t expected = n_lanes;
+					first_failed_lane.compare_exchange_strong(expected, i);
+					lanes->aborted = true;
+				}
+				--lanes_running;
+			});
+		}
+
+		for (bool busy = true; busy;) {
+			Far::g_fsf.DispatchInterThreadCalls();
+			busy = (lanes_running != 0) || std::any_of(lanes_cache.begin(), lanes_cache.end(),
+					[](const auto &lane_cache) { return lane_cache->has_background_work(); });
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		for (auto &thread : lanes_thread)
+			thread.join();
+
+		for (auto &lane_cache : lanes_cache)
+			lane_cache->finalize();
+
+		if (first_failed_lane < n_lanes)
+			COM_ERROR_CHECK(lanes_errc[first_failed_lane]);
+	}
+	else if (ex_stream && !bFullSizeStream) {
 		ex_stream->Seek(0, STREAM_CTL_RESET, nullptr);
 		UInt32 indices2[2] = { 0, 0 };
 		ComObject<IArchiveExtractCallback<UseVirtualDestructor>> extractor2(new SimpleExtractor<UseVirtualDestructor>(parent, ex_out_stream));
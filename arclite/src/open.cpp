@@ -1862,6 +1862,30 @@ void Archive<UseVirtualDestructor>::reopen()
 	}
 }
 
+// opens one more instance of same archive, so extraction lanes can decompress in parallel
+template<bool UseVirtualDestructor>
+bool Archive<UseVirtualDestructor>::open_lane_in_archive(ComObject<IInArchive<UseVirtualDestructor>> &arc)
+{
+	if (arc_chain.size() != 1 || !volume_names.empty() || parent || ex_stream)
+		return false;
+
+	ComObject<IInStream<UseVirtualDestructor>> stream(new ArchiveOpenStream<UseVirtualDestructor>(arc_path));
+	if (arc_chain.front().sig_pos > 0)
+		stream = new ArchiveSubStream<UseVirtualDestructor>(stream, arc_chain.front().sig_pos);
+
+	ArcAPI::create_in_archive(arc_chain.front().type, (void **)arc.ref());
+	ComObject<IArchiveOpenCallback<UseVirtualDestructor>> opener(new ArchiveOpener<UseVirtualDestructor>(this->shared_from_this(), false));
+	const UInt64 max_check_start_position = 0;
+	UInt32 num_indices = 0;
+	if (arc->Open(stream, &max_check_start_position, opener) != S_OK
+			|| arc->GetNumberOfItems(&num_indices) != S_OK || num_indices != m_num_indices) {
+		arc.Release();
+		return false;
+	}
+
+	return true;
+}
+
 template<bool UseVirtualDestructor>
 void Archive<UseVirtualDestructor>::close()
 {
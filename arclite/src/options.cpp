@@ -317,6 +317,7 @@ Options::Options()
 	extract_overwrite(oaAsk),
 	extract_separate_dir(triUndef),
 	extract_open_dir(false),
+	extract_threads_num(0),
 	update_arc_format_name(L"7z"),
 	update_arc_repack_format_name(L"xz"),
 	update_level(5),
@@ -563,6 +564,7 @@ bool Options::load()
 	GET_VALUE(extract_overwrite, int);
 	GET_VALUE(extract_separate_dir, int);
 	GET_VALUE(extract_open_dir, bool);
+	GET_VALUE(extract_threads_num, int);
 	GET_VALUE(update_arc_format_name, str);
 	GET_VALUE(update_arc_repack_format_name, str);
 	GET_VALUE(update_level, int);
@@ -647,6 +649,7 @@ void Options::save() const
 	SET_VALUE(extract_overwrite, int);
 	SET_VALUE(extract_separate_dir, int);
 	SET_VALUE(extract_open_dir, bool);
+	SET_VALUE(extract_threads_num, int);
 	SET_VALUE(update_arc_format_name, str);
 	SET_VALUE(update_arc_repack_format_name, str);
 	SET_VALUE(update_level, int);
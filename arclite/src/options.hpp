@@ -60,6 +60,7 @@ struct Options
 	OverwriteAction extract_overwrite;
 	TriState extract_separate_dir;
 	bool extract_open_dir;
+	int extract_threads_num;	// 0 - automatic, 1 - no parallel extraction
 	// update
 	std::wstring update_arc_format_name;
 	std::wstring update_arc_repack_format_name;
@@ -1859,6 +1859,9 @@ Allowed column types are:
 
     F          - number of streams
 
+    G          - git status: #M# - modified, #?# - untracked, #!# - ignored,
+                 for folder - status of its content
+
     Windows file attributes have the following indications:
        #R#         - Read only
        #S#         - System
@@ -2553,6 +2556,10 @@ $ #Settings dialog: panel#
 
   #Highlight files#         Enable ~files highlighting~@Highlight@.
 
+  #Highlight by git status# Files modified, untracked or ignored
+                          in git work tree are shown with colors
+                          of corresponding panel palette items.
+
   #Highlight files#         Button for open dialog
   # - Marking#              (works only if #Highlight files# enabled)
                           for customize show/align markers in panel
@@ -2965,6 +2972,8 @@ $ #Viewer: control keys#
                        line.
     #Ctrl-Shift-B#       Show/Hide status line
     #Ctrl-S#             Show/Hide the scrollbar.
+    #Ctrl-F#             Toggle follow mode: keep showing end of growing
+                       file, reopen it if replaced (log rotation).
     #Alt-BS, Ctrl-Z#     Undo position change
     #RightCtrl-0..9#     Set a bookmark 0..9 at the current position
     #Ctrl-Shift-0..9#    Set a bookmark 0..9 at the current position
@@ -3998,6 +4007,9 @@ characters, delimited with commas. Allowed column types are:
 
     F          - number of streams
 
+    G          - git status: #M# - modified, #?# - untracked, #!# - ignored,
+                 for folder - status of its content
+
     If the column types description contains more than one file name column,
 the file panel will be displayed in multicolumn form.
 
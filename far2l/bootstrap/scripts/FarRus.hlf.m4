@@ -1904,6 +1904,9 @@ $ #Дополнительные параметры поиска#
 
     F          - количество потоков
 
+    G          - состояние в git: #M# - изменён, #?# - не отслеживается,
+                 #!# - игнорируется, для папки - состояние её содержимого
+
     Windows атрибуты файла имеют следующие обозначения:
        #R#         - Только для чтения
        #S#         - Системный
@@ -2591,6 +2594,10 @@ $ #Настройка панели#
 
   #Раскраска файлов#        Разрешает ~раскраску файлов~@Highlight@
 
+  #Раскраска по состоянию#  Изменённые, неотслеживаемые и игнорируемые
+  #в git#                   файлы рабочего дерева git показываются
+                          цветами соответствующих пунктов палитры панели.
+
   #Раскраска файлов#        Кнопка для открытия диалога
   # - Маркировка#           (работает только, если #Раскраска файлов# включена)
                           для настройки показа/выравнивания маркеров на панели
@@ -3011,6 +3018,8 @@ $ #Программа просмотра: клавиши управления#
                        клавиш
     #Ctrl-Shift-B#       Спрятать/Показать статусную строку
     #Ctrl-S#             Спрятать/Показать полосу прокрутки
+    #Ctrl-F#             Включить/Выключить слежение за концом растущего
+                       файла с переоткрытием при его замене (ротация логов)
     #Alt-BS, Ctrl-Z#     Возврат к предыдущей позиции
     #ПравыйCtrl-0..9#    Установить закладку 0..9 в текущей позиции
     #Ctrl-Shift-0..9#    Установить закладку 0..9 в текущей позиции
@@ -4072,6 +4081,9 @@ $ #Настройка режимов просмотра панели файло
 
     F          - количество потоков
 
+    G          - состояние в git: #M# - изменён, #?# - не отслеживается,
+                 #!# - игнорируется, для папки - состояние её содержимого
+
     Если описание типов колонок содержит более одной колонки имени
 файла, панель файлов будет отображаться в многоколоночной форме.
 
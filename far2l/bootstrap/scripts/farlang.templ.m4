@@ -2265,6 +2265,17 @@ ConfigHighlight
 "&Розфарбовка файлів"
 "&Размалёўка файлаў"
 
+ConfigHighlightGitStatus
+"Раскраска по состоянию в git"
+"Highlight by git status"
+upd:"Highlight by git status"
+upd:"Highlight by git status"
+upd:"Highlight by git status"
+upd:"Highlight by git status"
+upd:"Highlight by git status"
+"Розфарбовка за станом у git"
+upd:"Highlight by git status"
+
 ConfigTreeOptions
 "Параметры дерева каталогов"
 "Tree panel options"
@@ -11254,6 +11265,17 @@ ColumnMumLinks
 "КлС"
 "КлСпасылак"
 
+ColumnGitStatus
+"G"
+"G"
+"G"
+"G"
+"G"
+"G"
+"G"
+"G"
+"G"
+
 DirUp
 "Вверх"
 "Up"
@@ -19639,6 +19661,39 @@ SetColorPanelScreensNumber
 "Кількість фонових екранів"
 "Колькасць фонавых экранаў"
 
+SetColorPanelGitModified
+"Изменён в git"
+"Git modified"
+upd:"Git modified"
+upd:"Git modified"
+upd:"Git modified"
+upd:"Git modified"
+upd:"Git modified"
+"Змінений у git"
+upd:"Git modified"
+
+SetColorPanelGitUntracked
+"Не отслеживается git"
+"Git untracked"
+upd:"Git untracked"
+upd:"Git untracked"
+upd:"Git untracked"
+upd:"Git untracked"
+upd:"Git untracked"
+"Не відстежується git"
+upd:"Git untracked"
+
+SetColorPanelGitIgnored
+"Игнорируется git"
+"Git ignored"
+upd:"Git ignored"
+upd:"Git ignored"
+upd:"Git ignored"
+upd:"Git ignored"
+upd:"Git ignored"
+"Ігнорується git"
+upd:"Git ignored"
+
 SetColorDialogNormal
 l:
 "Обычный текст"
@@ -21489,6 +21544,28 @@ ViewerCannotOpenFile
 "Помилка відкриття файлу"
 "Немагчыма адчыніць файл"
 
+ViewerStatusFollow
+"Слежение"
+"Follow"
+"Sledování"
+"Folgen"
+"Követés"
+"Śledzenie"
+"Seguir"
+"Стеження"
+"Сачэнне"
+
+ViewerStatusLine
+"Стр"
+"Line"
+"Řádek"
+"Zeile"
+"Sor"
+"Wiersz"
+"Lín"
+"Рядок"
+"Радок"
+
 ViewerStatusCol
 "Кол"
 "Col"
@@ -23136,6 +23213,17 @@ GoToDecimal
 "10-ічне з&міщення"
 "10-разрадны з&рух"
 
+GoToLine
+"Номер с&троки"
+"&Line number"
+"Číslo řád&ku"
+"&Zeilennummer"
+"&Sor száma"
+"Numer &wiersza"
+"Número de &línea"
+"Номер &рядка"
+"Нумар &радка"
+
 ExcTrappedException
 "Исключительная ситуация"
 "Exception occurred"
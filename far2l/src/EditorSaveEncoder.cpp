@@ -0,0 +1,163 @@
+#include "headers.hpp"
+
+#include "EditorSaveEncoder.hpp"
+
+static const size_t SaveEncoderBlockChars = 0x100000;
+
+EditorSaveEncoder::EditorSaveEncoder(UINT codepage)
+	: _codepage(codepage)
+{
+	CPINFO cpi{};
+	if (WINPORT(GetCPInfo)(codepage, &cpi) && cpi.MaxCharSize > 0) {
+		_max_char_size = cpi.MaxCharSize;
+	}
+
+	// if there is only one CPU then encoding is done synchronously by Fetch
+	const unsigned int threads_count = BestThreadsCount();
+	for (unsigned int i = 0; threads_count > 1 && i < threads_count; ++i) {
+		_workers.emplace_back(this);
+		if (!_workers.back().Start()) {
+			_workers.pop_back();
+			break;
+		}
+	}
+	_max_blocks = _workers.size() * 2 + 2;
+}
+
+EditorSaveEncoder::~EditorSaveEncoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	_workers.clear(); // joins them
+}
+
+void EditorSaveEncoder::Add(const wchar_t *Str, size_t Length)
+{
+	if (!Length)
+		return;
+
+	if (!_collecting) {
+		std::lock_guard<std::mutex> lock(_mtx);
+		_blocks.emplace_back();
+		_collecting = true;
+	}
+
+	// workers don't touch collecting block, so no need to lock here
+	Block &block = _blocks.back();
+	block.Pieces.emplace_back(Piece{Str, Length});
+	block.Chars+= Length;
+}
+
+void EditorSaveEncoder::Encode(Block &block)
+{
+	std::string &out = block.Encoded;
+	out.reserve((_codepage == CP_UTF8) ? block.Chars + block.Chars / 8 : block.Chars * 2);
+
+	std::vector<char> tmp;
+	for (const auto &piece : block.Pieces) {
+		if (_codepage == CP_WIDE_LE) {
+			out.append((const char *)piece.Str, piece.Length * sizeof(wchar_t));
+
+		} else if (_codepage == CP_UTF8) {
+			Wide2MB(piece.Str, piece.Length, out, true);
+
+		} else {
+			// MaxCharSize is per UTF-16 unit, so non-BMP chars may need more, then ask exact size
+			const size_t pos = out.size();
+			out.resize(pos + piece.Length * _max_char_size);
+			int cnt = WINPORT(WideCharToMultiByte)(_codepage, 0, piece.Str, piece.Length,
+					&out[pos], out.size() - pos, nullptr, nullptr);
+			if (cnt <= 0) {
+				cnt = WINPORT(WideCharToMultiByte)(_codepage, 0, piece.Str, piece.Length,
+						nullptr, 0, nullptr, nullptr);
+				if (cnt > 0) {
+					out.resize(pos + cnt);
+					cnt = WINPORT(WideCharToMultiByte)(_codepage, 0, piece.Str, piece.Length,
+							&out[pos], cnt, nullptr, nullptr);
+				}
+			}
+			if (cnt <= 0) {
+				block.Failed = true;
+				cnt = 0;
+			}
+			out.resize(pos + cnt);
+		}
+	}
+
+	block.Pieces.clear();
+	block.Pieces.shrink_to_fit();
+}
+
+void EditorSaveEncoder::WorkerProc()
+{
+	std::unique_lock<std::mutex> lock(_mtx);
+	while (!_stop) {
+		Block *block = nullptr;
+		for (auto &b : _blocks) {
+			if (b.State == BS_PENDING) {
+				block = &b;
+				break;
+			}
+		}
+		if (!block) {
+			_cond.wait(lock);
+			continue;
+		}
+
+		block->State = BS_ENCODING;
+		lock.unlock();
+		Encode(*block);
+		lock.lock();
+		block->State = BS_READY;
+		_cond.notify_all();
+	}
+}
+
+void EditorSaveEncoder::Submit()
+{
+	Block &block = _blocks.back();
+	_collecting = false;
+	if (_workers.empty()) {
+		Encode(block);
+		block.State = BS_READY;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		block.State = BS_PENDING;
+	}
+	_cond.notify_all();
+}
+
+bool EditorSaveEncoder::Fetch(std::string &Out, bool Final)
+{
+	if (_collecting && (Final || _blocks.back().Chars >= SaveEncoderBlockChars)) {
+		Submit();
+	}
+
+	std::unique_lock<std::mutex> lock(_mtx);
+	if (_blocks.empty() || _blocks.front().State == BS_COLLECTING) {
+		return false;
+	}
+
+	if (_blocks.front().State != BS_READY) {
+		if (!Final && _blocks.size() <= _max_blocks) {
+			return false;
+		}
+		while (_blocks.front().State != BS_READY) {
+			_cond.wait(lock);
+		}
+	}
+
+	if (_blocks.front().Failed) {
+		throw (DWORD)EILSEQ;
+	}
+
+	Out.swap(_blocks.front().Encoded);
+	_blocks.pop_front();
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <Threaded.h>
+#include <WinCompat.h>
+
+// Encodes text being saved into target codepage using several threads: added pieces of text are
+// batched into large blocks, blocks are encoded in parallel and fetched by caller in original order.
+// Count of blocks in flight is limited, so memory usage doesn't depend on size of text.
+class EditorSaveEncoder
+{
+	enum BlockState
+	{
+		BS_COLLECTING,
+		BS_PENDING,
+		BS_ENCODING,
+		BS_READY
+	};
+
+	struct Piece
+	{
+		const wchar_t *Str;
+		size_t Length;
+	};
+
+	struct Block
+	{
+		std::vector<Piece> Pieces;
+		size_t Chars{0};
+		BlockState State{BS_COLLECTING};
+		bool Failed{false};
+		std::string Encoded;
+	};
+
+	struct Worker : Threaded
+	{
+		EditorSaveEncoder *Owner;
+
+		Worker(EditorSaveEncoder *owner) : Owner(owner) {}
+		virtual ~Worker() { WaitThread(); }
+		virtual void *ThreadProc() { Owner->WorkerProc(); return nullptr; }
+		bool Start() { return StartThread(); }
+	};
+
+	const UINT _codepage;
+	size_t _max_char_size{4};
+	size_t _max_blocks;
+
+	std::mutex _mtx;
+	std::condition_variable _cond;
+	std::list<Block> _blocks; // front is oldest, back may be being collected
+	bool _collecting{false}; // accessed only by caller's thread
+	bool _stop{false};
+
+	std::list<Worker> _workers;
+
+	void WorkerProc();
+	void Encode(Block &block);
+	void Submit();
+
+public:
+	EditorSaveEncoder(UINT codepage);
+	~EditorSaveEncoder();
+
+	// text referenced by Str must remain valid until block that contains it is fetched
+	void Add(const wchar_t *Str, size_t Length);
+
+	// returns true with encoded data of oldest block if its ready or if too many blocks in flight (then
+	// waits for it), Final means that no more text will be added so all blocks must be fetched;
+	// throws EILSEQ if some text of block could not be encoded, so saving must be aborted
+	bool Fetch(std::string &Out, bool Final);
+};
@@ -6,7 +6,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <utils.h>
+#include <limits.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <FSNotify.h>
+#include <Threaded.h>
 
 #include <sudo.h>
 
@@ -21,156 +31,413 @@ bool FilesSuggestor::Suggestion::operator < (const Suggestion &another) const
 	return name < another.name;
 }
 
-FilesSuggestor::~FilesSuggestor()
+static const size_t SuggestorDirsLimit = 32;
+static const size_t SuggestorNamesLimit = 0x100000; // total count of names in all cached dirs
+static const size_t SuggestorPrefetchSubdirs = 4;
+static const size_t SuggestorPublishBatch = 0x100;
+static const unsigned int SuggestorWaitMSec = 1500; // dont keep user waiting longer than that
+
+class FilesSuggestorCache : protected Threaded
+{
+	typedef FilesSuggestor::Suggestion Suggestion;
+
+	struct Dir
+	{
+		struct stat St{};
+		std::vector<Suggestion> Names; // sorted if Complete
+		std::unique_ptr<IFSNotify> Watcher;
+		uint64_t LastUsed{0};
+		bool Queued{false};
+		bool Prefetch{false};
+		bool Complete{false};
+		bool Changed{false};
+	};
+
+	std::mutex _mtx;
+	std::condition_variable _cond;
+	std::condition_variable _done_cond;
+	std::map<std::string, Dir> _dirs;
+	std::deque<std::string> _queue;
+	std::string _busy; // directory being enumerated right now
+	bool _busy_prefetch{false};
+	std::atomic<bool> _abort_prefetch{false};
+	uint64_t _use_counter{0};
+	bool _started{false};
+	std::atomic<bool> _stop{false};
+
+	static bool SameTimes(const struct stat &st1, const struct stat &st2);
+	void Enqueue(const std::string &path, Dir &dir, bool prefetch);
+	void Prefetch(const std::string &path);
+	void Trim(const std::string &keep, std::vector<std::unique_ptr<IFSNotify> > &garbage);
+	void OnChanged(const std::string &path);
+	bool Enumerate(const std::string &path, bool prefetch);
+
+	virtual void *ThreadProc();
+
+public:
+	virtual ~FilesSuggestorCache();
+
+	void Query(const std::string &path, const struct stat &st,
+		const std::string &prefix, std::vector<Suggestion> &result);
+};
+
+FilesSuggestorCache::~FilesSuggestorCache()
 {
 	{
 		std::lock_guard<std::mutex> lock(_mtx);
-		_stopping = true;
+		_stop = true;
 	}
-
+	_cond.notify_all();
 	WaitThread();
+
+	// destroy watchers without lock held as their callbacks take it
+	std::vector<std::unique_ptr<IFSNotify> > watchers;
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		for (auto &it : _dirs) {
+			watchers.emplace_back(std::move(it.second.Watcher));
+		}
+	}
 }
 
-bool FilesSuggestor::StartEnum(const std::string &dir_path, const struct stat &dir_st)
+bool FilesSuggestorCache::SameTimes(const struct stat &st1, const struct stat &st2)
 {
-	fprintf(stderr, "FilesSuggestor: enum '%s'\n", dir_path.c_str());
-
-	std::lock_guard<std::mutex> lock(_mtx);
-	_dir_path = dir_path;
-	_suggestions.clear();
-	_dir_st = dir_st;
-	_stopping = false;
-	return StartThread();
+	return st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino
+		&& memcmp(&st1.st_mtim, &st2.st_mtim, sizeof(st1.st_mtim)) == 0
+		&& memcmp(&st1.st_ctim, &st2.st_ctim, sizeof(st1.st_ctim)) == 0;
 }
 
-void FilesSuggestor::Suggest(const std::string &filter, std::vector<Suggestion> &result)
+void FilesSuggestorCache::Enqueue(const std::string &path, Dir &dir, bool prefetch)
 {
-	std::string dir_path, name_prefix;
-
-	size_t last_slash = filter.rfind(GOOD_SLASH);
-	if (last_slash != std::string::npos) {
-		name_prefix = filter.substr(last_slash + 1);
-		if (last_slash > 0) {
-			dir_path = filter.substr(0, last_slash);
-			if (dir_path[0] != GOOD_SLASH) {
-				dir_path.insert(0, "./");
-			}
-		} else {
-			dir_path = GOOD_SLASH;
+	if (dir.Queued) {
+		if (prefetch || !dir.Prefetch) {
+			return;
 		}
-
-	} else {
-		name_prefix = filter;
-		dir_path = ".";
+		// user needs it right now - move ahead of prefetches
+		_queue.erase(std::find(_queue.begin(), _queue.end(), path));
 	}
 
-	struct stat dir_st{};
-	if (sdc_stat(dir_path.c_str(), &dir_st) == -1) {
-		fprintf(stderr, "FilesSuggestor: error %u stat '%s'\n", errno, _dir_path.c_str());
-		return;
+	dir.Queued = true;
+	dir.Prefetch = prefetch;
+	if (prefetch) {
+		_queue.emplace_back(path);
+	} else {
+		_queue.emplace_front(path);
+		if (_busy_prefetch && _busy != path) {
+			_abort_prefetch = true;
+		}
 	}
+	_cond.notify_all();
+}
 
-	bool need_reenumerate;
-
-	{
-		std::lock_guard<std::mutex> lock(_mtx);
-		need_reenumerate = (dir_path != _dir_path
-				|| dir_st.st_dev != _dir_st.st_dev || dir_st.st_ino != _dir_st.st_ino
-				|| memcmp(&dir_st.st_mtim, &_dir_st.st_mtim, sizeof(dir_st.st_mtim)) != 0
-				|| memcmp(&dir_st.st_ctim, &_dir_st.st_ctim, sizeof(dir_st.st_ctim)) != 0
-			);
-
-		if (need_reenumerate) {
-			_stopping = true;
-		}
+void FilesSuggestorCache::Prefetch(const std::string &path)
+{
+	auto it = _dirs.find(path);
+	if (it == _dirs.end()) {
+		it = _dirs.emplace(path, Dir()).first;
+		it->second.LastUsed = _use_counter; // not newer than queried one
+	} else if (it->second.Complete && !it->second.Changed) {
+		return; // times will be checked when it will be queried
 	}
+	Enqueue(path, it->second, true);
+}
 
-	if (need_reenumerate) {
-		WaitThread();
-		if (!StartEnum(dir_path, dir_st)) {
-			fprintf(stderr, "FilesSuggestor: thread start error %u\n", errno);
-			return;
+void FilesSuggestorCache::Trim(const std::string &keep, std::vector<std::unique_ptr<IFSNotify> > &garbage)
+{
+	for (;;) {
+		size_t names = 0;
+		auto oldest = _dirs.end();
+		for (auto it = _dirs.begin(); it != _dirs.end(); ++it) {
+			names+= it->second.Names.size();
+			if (!it->second.Queued && it->first != _busy && it->first != keep
+					&& (oldest == _dirs.end() || it->second.LastUsed < oldest->second.LastUsed)) {
+				oldest = it;
+			}
 		}
-
-		// dont keep user waiting longer than 1.5 second
-		if (!WaitThread(1500)) {
-			fprintf(stderr, "FilesSuggestor: timed out on '%s'\n", _dir_path.c_str());
+		if (oldest == _dirs.end()
+				|| (_dirs.size() <= SuggestorDirsLimit && names <= SuggestorNamesLimit)) {
+			break;
 		}
+		garbage.emplace_back(std::move(oldest->second.Watcher));
+		_dirs.erase(oldest);
 	}
+}
 
+void FilesSuggestorCache::OnChanged(const std::string &path)
+{
 	std::lock_guard<std::mutex> lock(_mtx);
-	for (const auto &suggestion : _suggestions) {
-		if (suggestion.name.size() >= name_prefix.size()
-				&& memcmp(suggestion.name.c_str(), name_prefix.c_str(), name_prefix.size()) == 0) {
-			result.push_back(suggestion);
-		}
+	auto it = _dirs.find(path);
+	if (it != _dirs.end()) {
+		it->second.Changed = true;
 	}
 }
 
-void *FilesSuggestor::ThreadProc()
+// returns false if enumeration was aborted
+bool FilesSuggestorCache::Enumerate(const std::string &path, bool prefetch)
 {
 	SudoClientRegion scr;
 	SudoSilentQueryRegion ssqr;
-	struct stat s;
-	// _dir_path modified only when thread is not active, so its safe to read it here
-	DIR *d = sdc_opendir(_dir_path.c_str());
-	if (d) {
-		try {
-			std::string stat_path = _dir_path;
-			if (!stat_path.empty() && stat_path.back() != GOOD_SLASH) {
-				stat_path+= GOOD_SLASH;
-			}
-			size_t stat_path_len = stat_path.size();
-			for (;;) {
-				struct dirent *de = sdc_readdir(d);
-				if (!de) {
-					break;
-				}
-				if (de->d_name[0] && strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
-					bool dir = false;
+	DIR *d = sdc_opendir(path.c_str());
+	if (!d) {
+		fprintf(stderr, "FilesSuggestor: error %u opendir '%s'\n", errno, path.c_str());
+		return true;
+	}
+
+	bool aborted = false;
+	try {
+		std::vector<Suggestion> batch;
+		std::string stat_path = path;
+		if (!stat_path.empty() && stat_path.back() != GOOD_SLASH) {
+			stat_path+= GOOD_SLASH;
+		}
+		const size_t stat_path_len = stat_path.size();
+		struct stat s;
+		for (;;) {
+			struct dirent *de = sdc_readdir(d);
+			if (de && de->d_name[0] && strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+				bool dir = false;
 #ifndef __HAIKU__
-					switch (de->d_type) {
-						case DT_DIR:
-							dir = true;
-							break;
-
-						case DT_BLK:
-						case DT_FIFO:
-						case DT_CHR:
-						case DT_SOCK:
-						case DT_REG:
-							dir = false;
-							break;
-
-						default:
+				switch (de->d_type) {
+					case DT_DIR:
+						dir = true;
+						break;
+
+					case DT_BLK:
+					case DT_FIFO:
+					case DT_CHR:
+					case DT_SOCK:
+					case DT_REG:
+						dir = false;
+						break;
+
+					default:
 #endif
-							stat_path.resize(stat_path_len);
-							stat_path+= de->d_name;
-							dir = (sdc_stat(stat_path.c_str(), &s) == 0 && S_ISDIR(s.st_mode));
+						stat_path.resize(stat_path_len);
+						stat_path+= de->d_name;
+						dir = (sdc_stat(stat_path.c_str(), &s) == 0 && S_ISDIR(s.st_mode));
 #ifndef __HAIKU__
-					}
+				}
 #endif
-					stat_path.resize(stat_path_len);
-					stat_path+= de->d_name;
-					dir = (sdc_stat(stat_path.c_str(), &s) == 0 && S_ISDIR(s.st_mode));
+				batch.emplace_back(Suggestion{de->d_name, dir});
+			}
 
-					std::lock_guard<std::mutex> lock(_mtx);
-					_suggestions.emplace_back(Suggestion{de->d_name, dir});
-					if (_stopping) {
-						break;
-					}
+			if (!de || batch.size() >= SuggestorPublishBatch) {
+				std::lock_guard<std::mutex> lock(_mtx);
+				auto it = _dirs.find(path);
+				if (it != _dirs.end()) {
+					it->second.Names.insert(it->second.Names.end(), batch.begin(), batch.end());
+				}
+				batch.clear();
+				if (_stop || (prefetch && _busy_prefetch && _abort_prefetch)) {
+					aborted = true;
+					break;
+				}
+				if (!de) {
+					break;
 				}
 			}
-		} catch (std::exception &e) {
-			fprintf(stderr, "FilesSuggestor: exception '%s'\n", e.what());
 		}
-		sdc_closedir(d);
+	} catch (std::exception &e) {
+		fprintf(stderr, "FilesSuggestor: exception '%s'\n", e.what());
+	}
+	sdc_closedir(d);
+	return !aborted;
+}
+
+void *FilesSuggestorCache::ThreadProc()
+{
+	std::unique_lock<std::mutex> lock(_mtx);
+	while (!_stop) {
+		if (_queue.empty()) {
+			_cond.wait(lock);
+			continue;
+		}
+
+		const std::string path = _queue.front();
+		_queue.pop_front();
+		auto it = _dirs.find(path);
+		if (it == _dirs.end())
+			continue;
+		it->second.Queued = false;
+		_busy = path;
+		_busy_prefetch = it->second.Prefetch;
+		_abort_prefetch = false;
+		lock.unlock();
+
+		struct stat st{};
+		bool ok = (sdc_stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+		std::unique_ptr<IFSNotify> watcher;
+
+		lock.lock();
+		it = _dirs.find(path);
+		const bool actual = ok && it != _dirs.end() && it->second.Complete
+			&& !it->second.Changed && SameTimes(it->second.St, st);
+		lock.unlock();
+
+		if (ok && !actual) {
+			// watch before enumerating to not miss changes that happen meanwhile
+			watcher.reset(IFSNotify_Create(path, false, FSNW_NAMES,
+				[this, path]() { OnChanged(path); }));
+
+			lock.lock();
+			it = _dirs.find(path);
+			if (it != _dirs.end()) {
+				it->second.St = st;
+				it->second.Names.clear();
+				it->second.Complete = false;
+				it->second.Changed = false;
+				it->second.Watcher.swap(watcher);
+			}
+			const bool prefetch = _busy_prefetch;
+			lock.unlock();
+			watcher.reset(); // previous one
+
+			fprintf(stderr, "FilesSuggestor: enum '%s'%s\n", path.c_str(), prefetch ? " (prefetch)" : "");
+			ok = Enumerate(path, prefetch);
+		}
+
+		lock.lock();
+		it = _dirs.find(path);
+		if (it != _dirs.end() && !actual) {
+			if (ok) {
+				std::sort(it->second.Names.begin(), it->second.Names.end());
+				it->second.Complete = true;
+			} else { // aborted prefetch or not a directory - forget it
+				watcher.swap(it->second.Watcher);
+				it->second.Names.clear();
+				it->second.Names.shrink_to_fit();
+			}
+		}
+		_busy.clear();
+		_busy_prefetch = false;
+		_done_cond.notify_all();
+		if (watcher) {
+			lock.unlock();
+			watcher.reset();
+			lock.lock();
+		}
+	}
+	return nullptr;
+}
+
+void FilesSuggestorCache::Query(const std::string &path, const struct stat &st,
+	const std::string &prefix, std::vector<Suggestion> &result)
+{
+	std::vector<std::unique_ptr<IFSNotify> > garbage; // destroyed after lock released
+	std::unique_lock<std::mutex> lock(_mtx);
+	if (!_started) {
+		_started = true;
+		if (!StartThread()) {
+			fprintf(stderr, "FilesSuggestor: thread start error %u\n", errno);
+			_stop = true;
+		}
+	}
+	if (_stop)
+		return;
+
+	Dir *dir = &_dirs[path];
+	dir->LastUsed = ++_use_counter;
+	if (!dir->Complete || dir->Changed || !SameTimes(dir->St, st)) {
+		if (_busy != path) {
+			Enqueue(path, *dir, false);
+		} else {
+			_busy_prefetch = false; // already being enumerated, just dont let it be aborted
+		}
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SuggestorWaitMSec);
+		while (!_stop && (dir->Queued || _busy == path)) {
+			if (_done_cond.wait_until(lock, deadline) == std::cv_status::timeout) {
+				fprintf(stderr, "FilesSuggestor: timed out on '%s'\n", path.c_str());
+				break;
+			}
+			dir = &_dirs[path];
+		}
+	}
+
+	auto it = dir->Names.begin();
+	if (dir->Complete) {
+		it = std::lower_bound(dir->Names.begin(), dir->Names.end(), Suggestion{prefix, false});
+	}
+	size_t subdirs = 0;
+	for (; it != dir->Names.end(); ++it) {
+		if (it->name.size() >= prefix.size()
+				&& memcmp(it->name.c_str(), prefix.c_str(), prefix.size()) == 0) {
+			result.push_back(*it);
+			if (it->dir) {
+				++subdirs;
+			}
+		} else if (dir->Complete) {
+			break;
+		}
+	}
+
+	// user likely to go into one of few matching subdirectories or back to parent
+	if (subdirs && subdirs <= SuggestorPrefetchSubdirs) {
+		for (const auto &suggestion : result) if (suggestion.dir) {
+			Prefetch((path == "/") ? path + suggestion.name : path + GOOD_SLASH + suggestion.name);
+		}
+	}
+	const size_t last_slash = path.rfind(GOOD_SLASH);
+	if (last_slash != std::string::npos && path.size() > 1) {
+		Prefetch(last_slash ? path.substr(0, last_slash) : std::string(1, GOOD_SLASH));
+	}
+
+	Trim(path, garbage);
+}
+
+static FilesSuggestorCache &FilesSuggestorCacheInstance()
+{
+	static FilesSuggestorCache s_cache;
+	return s_cache;
+}
+
+FilesSuggestor::~FilesSuggestor()
+{
+}
+
+void FilesSuggestor::Suggest(const std::string &filter, std::vector<Suggestion> &result)
+{
+	std::string dir_path, name_prefix;
+
+	size_t last_slash = filter.rfind(GOOD_SLASH);
+	if (last_slash != std::string::npos) {
+		name_prefix = filter.substr(last_slash + 1);
+		if (last_slash > 0) {
+			dir_path = filter.substr(0, last_slash);
+		} else {
+			dir_path = GOOD_SLASH;
+		}
 
 	} else {
-		fprintf(stderr, "FilesSuggestor: error %u opendir '%s'\n", errno, _dir_path.c_str());
+		name_prefix = filter;
 	}
 
-	return nullptr;
+	// cache is keyed by absolute pathes as current directory changes meanwhile
+	if (dir_path.empty() || dir_path[0] != GOOD_SLASH) {
+		char cwd[PATH_MAX + 1] = {};
+		if (!sdc_getcwd(cwd, sizeof(cwd) - 1) || cwd[0] != GOOD_SLASH) {
+			fprintf(stderr, "FilesSuggestor: error %u getcwd\n", errno);
+			return;
+		}
+		std::string abs_path = cwd;
+		if (!dir_path.empty()) {
+			if (abs_path.back() != GOOD_SLASH) {
+				abs_path+= GOOD_SLASH;
+			}
+			abs_path+= dir_path;
+		}
+		dir_path.swap(abs_path);
+	}
+	while (dir_path.size() > 1 && dir_path.back() == GOOD_SLASH) {
+		dir_path.pop_back();
+	}
+
+	struct stat dir_st{};
+	if (sdc_stat(dir_path.c_str(), &dir_st) == -1) {
+		fprintf(stderr, "FilesSuggestor: error %u stat '%s'\n", errno, dir_path.c_str());
+		return;
+	}
+
+	FilesSuggestorCacheInstance().Query(dir_path, dir_st, name_prefix, result);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
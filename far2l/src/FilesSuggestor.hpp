@@ -1,12 +1,14 @@
 #pragma once
 #include <sys/stat.h>
-#include <mutex>
 #include <string>
 #include <vector>
-#include <Threaded.h>
 #include "vmenu.hpp"
 
-class FilesSuggestor : protected Threaded
+// Suggestions come from process-wide cache of recently used directories:
+// listings are sorted by name for quick prefix lookup, kept until watcher
+// or directory's times tell they're outdated and enumerated by background
+// thread that also prefetches directories user likely to go next.
+class FilesSuggestor
 {
 public:
 	struct Suggestion {
@@ -15,19 +17,6 @@ public:
 		bool operator < (const Suggestion &another) const;
 	};
 
-private:
-	std::string _dir_path;
-	struct stat _dir_st{};
-	std::vector<Suggestion> _suggestions;
-	std::mutex _mtx;
-	bool _stopping = false;
-
-	bool StartEnum(const std::string &dir_path, const struct stat &dir_st);
-
-protected:
-	virtual void *ThreadProc();
-
-public:
 	virtual ~FilesSuggestor();
 	void Suggest(const std::string &filter, std::vector<Suggestion> &result);
 };
@@ -0,0 +1,349 @@
+#include "headers.hpp"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <CacheFile.h>
+#include "ViewerLineIndex.hpp"
+
+#define LINE_INDEX_DIR "viewer/lines"
+
+static const char LineIndexMagic[8] = {'F', 'V', 'L', 'I', 'D', 'X', '0', '2'};
+static const uint64_t LineIndexInitialStep = 256;
+static const size_t LineIndexPointsLimit = 0x10000;
+static const uint64_t LineIndexScanPortion = 0x1000000;
+static const uint64_t LineIndexMinSizeToSave = 0x1000000;
+static const size_t LineIndexFilesLimit = 32;
+
+struct LineIndexHeader
+{
+	CacheFileStamp Stamp; // state of file when index was saved
+	uint32_t CodePage;
+	uint32_t Eol;
+	uint64_t Step;
+	uint64_t Lines;
+	uint64_t Scanned;
+	uint64_t TailHash;
+	uint64_t PointsCount;
+};
+
+static unsigned int CodePageUnitSize(unsigned int codepage)
+{
+	switch (codepage) {
+		case CP_UTF32LE:
+		case CP_UTF32BE:
+			return 4;
+
+		case CP_UTF16LE:
+		case CP_UTF16BE:
+			return 2;
+
+		default:
+			return 1;
+	}
+}
+
+ViewerLineIndex::ViewerLineIndex(const std::string &path, unsigned int codepage, wchar_t eol)
+	: _path(path), _codepage(codepage), _eol(eol), _unit(CodePageUnitSize(codepage))
+{
+	_fd = open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat s{};
+	if (_fd == -1 || fstat(_fd, &s) == -1 || !S_ISREG(s.st_mode)) {
+		_complete = true;
+		return;
+	}
+
+	Load(s);
+
+	if (!StartThread()) {
+		_complete = true;
+	}
+}
+
+ViewerLineIndex::~ViewerLineIndex()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	WaitThread();
+
+	if (_fd != -1) {
+		struct stat s{};
+		if (_complete && _scanned >= LineIndexMinSizeToSave && fstat(_fd, &s) == 0) {
+			Save(s);
+		}
+		close(_fd);
+	}
+}
+
+bool ViewerLineIndex::Matches(const std::string &path, unsigned int codepage, wchar_t eol) const
+{
+	return _path == path && _codepage == codepage && _eol == eol;
+}
+
+void ViewerLineIndex::Actualize()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_kick = true;
+	}
+	_cond.notify_all();
+}
+
+// invokes callback with offset of each line start that follows terminator found within [from, to),
+// callback may return false to stop scan, then Scan also returns false, as well as on read error
+template <class LINE_START_CALLBACK>
+	bool ViewerLineIndex::Scan(uint64_t from, uint64_t to, LINE_START_CALLBACK callback) const
+{
+	const unsigned char eol = (unsigned char)_eol;
+	const bool be = (_codepage == CP_UTF16BE || _codepage == CP_UTF32BE);
+	std::vector<unsigned char> buf((size_t)std::min(to - from, (uint64_t)0x40000));
+
+	for (uint64_t base = from; base < to;) {
+		const size_t piece = (size_t)std::min(to - base, (uint64_t)buf.size());
+		ssize_t r = pread(_fd, buf.data(), piece, base);
+		if (r > 0) {
+			r-= r % _unit;
+		}
+		if (r <= 0) {
+			return false;
+		}
+
+		const unsigned char *b = buf.data(), *e = b + r;
+		for (const unsigned char *p = b; (p = (const unsigned char *)memchr(p, eol, e - p)) != nullptr; ++p) {
+			size_t unit_start = p - b;
+			if (_unit != 1) {
+				if (be) {
+					if ((unit_start + 1) % _unit != 0)
+						continue;
+					unit_start-= _unit - 1;
+				} else if (unit_start % _unit != 0) {
+					continue;
+				}
+				const unsigned char *u = b + unit_start;
+				bool zeroes = true;
+				for (unsigned int i = 0; i < _unit; ++i) {
+					if (&u[i] != p && u[i] != 0) {
+						zeroes = false;
+						break;
+					}
+				}
+				if (!zeroes)
+					continue;
+			}
+			if (!callback(base + unit_start + _unit)) {
+				return false;
+			}
+		}
+		base+= r;
+	}
+
+	return true;
+}
+
+void *ViewerLineIndex::ThreadProc()
+{
+	for (;;) {
+		uint64_t from, size = 0, step, lines;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			while (!_stop && _complete && !_kick) {
+				_cond.wait(lock);
+			}
+			if (_stop) {
+				break;
+			}
+			_kick = false;
+
+			struct stat s{};
+			if (fstat(_fd, &s) == 0) {
+				size = s.st_size - s.st_size % _unit;
+			}
+			if (size < _scanned) { // truncated - start over
+				_points.assign(1, 0);
+				_step = LineIndexInitialStep;
+				_lines = _scanned = 0;
+			}
+			from = _scanned;
+			step = _step;
+			lines = _lines;
+			_complete = false;
+		}
+
+		bool ok = true;
+		while (ok && from < size) {
+			const uint64_t to = std::min(size, from + LineIndexScanPortion);
+			std::vector<uint64_t> new_points;
+			ok = Scan(from, to, [&](uint64_t line_start) {
+				if ((++lines % step) == 0) {
+					new_points.emplace_back(line_start);
+				}
+				return true;
+			});
+
+			std::lock_guard<std::mutex> lock(_mtx);
+			if (!ok || _stop) {
+				// index remains consistent up to previous portion
+				lines = _lines;
+				break;
+			}
+			_points.insert(_points.end(), new_points.begin(), new_points.end());
+			_lines = lines;
+			_scanned = from = to;
+			while (_points.size() > LineIndexPointsLimit) {
+				for (size_t i = 1; 2 * i < _points.size(); ++i) {
+					_points[i] = _points[2 * i];
+				}
+				_points.resize((_points.size() + 1) / 2);
+				_step*= 2;
+			}
+			step = _step;
+		}
+
+		std::lock_guard<std::mutex> lock(_mtx);
+		_complete = true; // on read error too, to not spin, Actualize() will retry
+	}
+
+	return nullptr;
+}
+
+int64_t ViewerLineIndex::LineOfOffset(uint64_t offset) const
+{
+	offset-= offset % _unit;
+
+	uint64_t pos, line;
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		if (offset > _scanned) {
+			return -1;
+		}
+		auto it = std::upper_bound(_points.begin(), _points.end(), offset);
+		const size_t index = (it - _points.begin()) - 1;
+		pos = _points[index];
+		line = index * _step;
+	}
+
+	if (!Scan(pos, offset, [&](uint64_t) { ++line; return true; })) {
+		return -1;
+	}
+
+	return line;
+}
+
+int64_t ViewerLineIndex::OffsetOfLine(uint64_t line) const
+{
+	uint64_t pos, cur;
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		const size_t index = (size_t)std::min(line / _step, (uint64_t)_points.size() - 1);
+		pos = _points[index];
+		cur = index * _step;
+	}
+
+	if (cur == line) {
+		return pos;
+	}
+
+	struct stat s{};
+	if (fstat(_fd, &s) == -1) {
+		return -1;
+	}
+
+	int64_t out = -1;
+	Scan(pos, s.st_size - s.st_size % _unit, [&](uint64_t line_start) {
+		if (++cur != line) {
+			return true;
+		}
+		out = line_start;
+		return false;
+	});
+
+	return out;
+}
+
+////////////////////////////////////////////////////////////
+
+uint64_t ViewerLineIndex::TailHash(uint64_t end) const
+{
+	// FNV-1a of up to 4KB preceding end, enough to detect that indexed part of grown file is same
+	unsigned char buf[0x1000];
+	const uint64_t begin = (end > sizeof(buf)) ? end - sizeof(buf) : 0;
+	const ssize_t r = pread(_fd, buf, end - begin, begin);
+	if (r != ssize_t(end - begin)) {
+		return 0;
+	}
+
+	uint64_t out = 0xcbf29ce484222325ull;
+	for (ssize_t i = 0; i < r; ++i) {
+		out^= buf[i];
+		out*= 0x100000001b3ull;
+	}
+	return out;
+}
+
+bool ViewerLineIndex::Load(const struct stat &s)
+{
+	const std::string &path = CacheFilePath(LINE_INDEX_DIR, s, "idx");
+	FILE *f = fopen(path.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	// file of same size must be unchanged at all, while grown file is expected to be
+	// appended to, so only check that its indexed part still ends with same data
+	LineIndexHeader hdr{};
+	bool out = fread(&hdr, sizeof(hdr), 1, f) == 1
+		&& (hdr.Stamp.Matches(LineIndexMagic, s)
+			|| (memcmp(hdr.Stamp.Magic, LineIndexMagic, sizeof(hdr.Stamp.Magic)) == 0
+				&& hdr.Stamp.Size < (uint64_t)s.st_size))
+		&& hdr.CodePage == _codepage && hdr.Eol == (uint32_t)_eol
+		&& hdr.Step != 0 && hdr.PointsCount != 0 && hdr.PointsCount <= LineIndexPointsLimit
+		&& hdr.Scanned <= (uint64_t)s.st_size && hdr.Scanned % _unit == 0
+		&& hdr.TailHash == TailHash(hdr.Scanned);
+
+	std::vector<uint64_t> points;
+	if (out) {
+		points.resize(hdr.PointsCount);
+		out = fread(points.data(), points.size() * sizeof(points[0]), 1, f) == 1 && points[0] == 0;
+	}
+	fclose(f);
+
+	if (!out) {
+		return false;
+	}
+
+	CacheFileTouch(path);
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	_points.swap(points);
+	_step = hdr.Step;
+	_lines = hdr.Lines;
+	_scanned = hdr.Scanned;
+	return true;
+}
+
+void ViewerLineIndex::Save(const struct stat &s)
+{
+	LineIndexHeader hdr{};
+	hdr.Stamp.Fill(LineIndexMagic, s);
+	hdr.CodePage = _codepage;
+	hdr.Eol = (uint32_t)_eol;
+	hdr.Step = _step;
+	hdr.Lines = _lines;
+	hdr.Scanned = _scanned;
+	hdr.TailHash = TailHash(_scanned);
+	hdr.PointsCount = _points.size();
+
+	const std::string &path = CacheFilePath(LINE_INDEX_DIR, s, "idx");
+	std::string tmp_path;
+	FILE *f = CacheFileCreate(path, tmp_path);
+	if (!f) {
+		return;
+	}
+
+	const bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+		&& fwrite(_points.data(), _points.size() * sizeof(_points[0]), 1, f) == 1;
+	CacheFileCommit(f, tmp_path, path, ok, LineIndexFilesLimit);
+}
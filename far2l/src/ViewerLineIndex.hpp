@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <Threaded.h>
+
+// Sparse index of lines starts of viewed file, built by background thread: byte offset of
+// each Step-th line start is remembered, so line number of some offset or offset of some line
+// is found by binary search followed by scan of at most Step lines. When index grows over
+// limit - each second point is dropped and Step doubles, so memory usage remains bounded.
+// Complete index of big file is saved in cache dir and reused for same unchanged or grown file.
+class ViewerLineIndex : protected Threaded
+{
+	const std::string _path;
+	const unsigned int _codepage;
+	const wchar_t _eol;
+	const unsigned int _unit; // size of code unit in bytes: 1, 2 or 4
+	int _fd{-1};
+
+	mutable std::mutex _mtx;
+	std::condition_variable _cond;
+	bool _stop{false}, _kick{false}, _complete{false};
+	uint64_t _step{256};
+	uint64_t _lines{0};	// count of line terminators met in [0, _scanned)
+	uint64_t _scanned{0};
+	std::vector<uint64_t> _points{0}; // _points[i] is offset of start of line number i * _step
+
+	template <class LINE_START_CALLBACK>
+		bool Scan(uint64_t from, uint64_t to, LINE_START_CALLBACK callback) const;
+
+	uint64_t TailHash(uint64_t end) const;
+	bool Load(const struct stat &s);
+	void Save(const struct stat &s);
+
+	virtual void *ThreadProc();
+
+public:
+	ViewerLineIndex(const std::string &path, unsigned int codepage, wchar_t eol);
+	virtual ~ViewerLineIndex();
+
+	bool Matches(const std::string &path, unsigned int codepage, wchar_t eol) const;
+
+	// wakes indexer to continue from where it stopped, used when file grows or gets truncated
+	void Actualize();
+
+	// 0-based number of line that contains given byte offset, -1 if offset not indexed yet
+	int64_t LineOfOffset(uint64_t offset) const;
+
+	// byte offset of start of given 0-based line, scans not yet indexed part if needed,
+	// returns -1 if file has less lines
+	int64_t OffsetOfLine(uint64_t line) const;
+};
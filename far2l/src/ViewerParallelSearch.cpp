@@ -0,0 +1,200 @@
+#include "headers.hpp"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <chrono>
+#include "ViewerParallelSearch.hpp"
+
+static const uint64_t ParallelSearchFirstChunk = 0x100000;
+static const uint64_t ParallelSearchMaxChunk = 0x1000000;
+static const uint64_t ParallelSearchPiece = 0x100000;
+
+ViewerParallelSearch::ViewerParallelSearch(const std::string &path, std::unique_ptr<FindPattern> &&pattern, unsigned int unit)
+	: _pattern(std::move(pattern)), _unit(unit)
+{
+	_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat s{};
+	if (_fd == -1 || fstat(_fd, &s) == -1 || !S_ISREG(s.st_mode)) {
+		const int err = errno;
+		if (_fd != -1) {
+			close(_fd);
+		}
+		ThrowPrintf("can't open regular file, error %d", err);
+	}
+	_file_size = s.st_size;
+}
+
+ViewerParallelSearch::~ViewerParallelSearch()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_cancel = true;
+	}
+	_workers.clear(); // joins them
+	close(_fd);
+}
+
+bool ViewerParallelSearch::Start(uint64_t begin, uint64_t end, bool reverse)
+{
+	end = std::min(end, _file_size);
+	_reverse = reverse;
+
+	// chunks near start point are small to not make workers read much if match is near
+	for (uint64_t size = ParallelSearchFirstChunk; begin < end; size = std::min(size * 2, ParallelSearchMaxChunk)) {
+		_chunks.emplace_back();
+		if (reverse) {
+			_chunks.back().End = end;
+			end = (end - begin > size) ? end - size : begin;
+			_chunks.back().Begin = end;
+
+		} else {
+			_chunks.back().Begin = begin;
+			begin = (end - begin > size) ? begin + size : end;
+			_chunks.back().End = begin;
+		}
+		_total+= _chunks.back().End - _chunks.back().Begin;
+	}
+
+	const size_t threads_count = std::min((size_t)BestThreadsCount(), _chunks.size());
+	for (size_t i = 0; i < threads_count; ++i) {
+		_workers.emplace_back(this);
+		if (!_workers.back().Start()) {
+			_workers.pop_back();
+			break;
+		}
+	}
+
+	return !_workers.empty() || _chunks.empty();
+}
+
+ViewerParallelSearch::Status ViewerParallelSearch::Wait(unsigned int msec, uint64_t &hit, int &percent)
+{
+	std::unique_lock<std::mutex> lock(_mtx);
+	auto resolve = [&]() {
+		for (const auto &chunk : _chunks) {
+			if (chunk.State == CS_HIT) {
+				hit = chunk.Hit;
+				return S_FOUND;
+			}
+			if (chunk.State == CS_PENDING) {
+				return S_PENDING;
+			}
+		}
+		return S_NOT_FOUND;
+	};
+
+	Status out = resolve();
+	if (out == S_PENDING) {
+		_cond.wait_for(lock, std::chrono::milliseconds(msec));
+		out = resolve();
+	}
+
+	percent = _total ? int(_done * 100 / _total) : 100;
+	return out;
+}
+
+// chunk is not needed anymore if some nearer chunk already has match
+bool ViewerParallelSearch::Outdated(size_t index)
+{
+	return _cancel || _first_hit < index;
+}
+
+void ViewerParallelSearch::WorkerProc()
+{
+	std::vector<unsigned char> buf;
+	for (;;) {
+		size_t index;
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			if (_next_chunk == _chunks.size() || Outdated(_next_chunk)) {
+				break;
+			}
+			index = _next_chunk++;
+		}
+
+		uint64_t hit = 0;
+		const bool found = ScanChunk(index, buf, hit);
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			Chunk &chunk = _chunks[index];
+			chunk.State = found ? CS_HIT : CS_MISS;
+			chunk.Hit = hit;
+			_done+= chunk.End - chunk.Begin;
+			if (found && index < _first_hit) {
+				_first_hit = index;
+			}
+		}
+		_cond.notify_all();
+	}
+}
+
+bool ViewerParallelSearch::ScanChunk(size_t index, std::vector<unsigned char> &buf, uint64_t &hit)
+{
+	const uint64_t begin = _chunks[index].Begin, end = _chunks[index].End;
+	for (uint64_t done = 0; done < end - begin;) {
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			if (Outdated(index)) {
+				return false;
+			}
+		}
+		const uint64_t piece = std::min(end - begin - done, ParallelSearchPiece);
+		const uint64_t piece_begin = _reverse ? end - done - piece : begin + done;
+		if (ScanPiece(piece_begin, piece_begin + piece, buf, hit)) {
+			return true;
+		}
+		done+= piece;
+	}
+
+	return false;
+}
+
+bool ViewerParallelSearch::ScanPiece(uint64_t begin, uint64_t end, std::vector<unsigned char> &buf, uint64_t &hit)
+{
+	// read also some data around piece to match patterns crossing piece's end
+	// and to allow whole-words check of characters surrounding match
+	const uint64_t margin = _pattern->LookBehind() + 4;
+	const uint64_t window_begin = (begin > margin) ? begin - margin : 0;
+	const uint64_t window_end = std::min(end + margin, _file_size);
+
+	buf.resize(window_end - window_begin);
+	size_t len = 0;
+	while (len < buf.size()) {
+		const ssize_t r = pread(_fd, buf.data() + len, buf.size() - len, window_begin + len);
+		if (r < 0 && errno == EINTR) {
+			continue;
+		}
+		if (r <= 0) {
+			if (r < 0) {
+				fprintf(stderr, "ViewerParallelSearch: error %u reading at %llu\n",
+					errno, (unsigned long long)(window_begin + len));
+			}
+			break;
+		}
+		len+= r;
+	}
+
+	const bool last_fragment = (window_begin + len >= _file_size);
+	bool out = false;
+	for (size_t pos = 0; pos < len;) {
+		const auto &m = _pattern->FindMatch(buf.data() + pos, len - pos, window_begin == 0 && pos == 0, last_fragment);
+		if (m.first == (size_t)-1) {
+			break;
+		}
+		const uint64_t at = window_begin + pos + m.first;
+		if (at >= end) {
+			break;
+		}
+		if (at >= begin) {
+			hit = at;
+			out = true;
+			if (!_reverse) {
+				break;
+			}
+		}
+		pos+= m.first + _unit;
+	}
+
+	return out;
+}
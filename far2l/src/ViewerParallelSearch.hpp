@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <Threaded.h>
+#include "FindPattern.hpp"
+
+// Searches given bytes range of file for pattern using several threads: range is split into
+// chunks ordered by distance from search start point (growing in size to quickly find near
+// match), each worker thread takes next nearest chunk and scans it by large reads. Result is
+// nearest (first or, if reverse - last) matched offset that is known as soon as all chunks
+// between start point and chunk with match are scanned, so remaining work is abandoned then.
+class ViewerParallelSearch
+{
+	enum ChunkState
+	{
+		CS_PENDING,
+		CS_MISS,
+		CS_HIT
+	};
+
+	struct Chunk
+	{
+		uint64_t Begin, End;
+		ChunkState State{CS_PENDING};
+		uint64_t Hit{0};
+	};
+
+	struct Worker : Threaded
+	{
+		ViewerParallelSearch *Owner;
+
+		Worker(ViewerParallelSearch *owner) : Owner(owner) {}
+		virtual ~Worker() { WaitThread(); }
+		virtual void *ThreadProc() { Owner->WorkerProc(); return nullptr; }
+		bool Start() { return StartThread(); }
+	};
+
+	std::unique_ptr<FindPattern> _pattern;
+	const unsigned int _unit; // size of code unit in bytes, matches are aligned by it
+	int _fd{-1};
+	uint64_t _file_size{0};
+	bool _reverse{false};
+
+	std::mutex _mtx;
+	std::condition_variable _cond;
+	std::vector<Chunk> _chunks;
+	size_t _next_chunk{0};
+	size_t _first_hit{(size_t)-1};
+	uint64_t _total{0}, _done{0};
+	bool _cancel{false};
+
+	std::list<Worker> _workers;
+
+	void WorkerProc();
+	bool Outdated(size_t index);
+	bool ScanChunk(size_t index, std::vector<unsigned char> &buf, uint64_t &hit);
+	bool ScanPiece(uint64_t begin, uint64_t end, std::vector<unsigned char> &buf, uint64_t &hit);
+
+public:
+	enum Status
+	{
+		S_PENDING,
+		S_FOUND,
+		S_NOT_FOUND
+	};
+
+	// pattern must be already GetReady()-ed, throws if file can't be opened
+	ViewerParallelSearch(const std::string &path, std::unique_ptr<FindPattern> &&pattern, unsigned int unit);
+	~ViewerParallelSearch();
+
+	// searches for match starting within [begin, end), returns false if no threads started
+	bool Start(uint64_t begin, uint64_t end, bool reverse);
+
+	// waits up to msec for result, on S_FOUND - offset of match returned in hit
+	Status Wait(unsigned int msec, uint64_t &hit, int &percent);
+};
@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <StackHeapArray.hpp>
 #include <stdarg.h>
 #include <limits>
+#include <pthread.h>
 #include "lang.hpp"
 
 /// change to 1 to enable stats & leaks detection (slow!)
@@ -47,6 +48,8 @@ struct DbgStr
 {
 	std::mutex Mtx;
 	unsigned long long Addrefs = 0;
+	unsigned long long Allocs = 0;		// blocks taken from malloc
+	unsigned long long CacheHits = 0;	// blocks reused from per-thread cache
 	std::set<void *> Instances;
 };
 
@@ -72,6 +75,15 @@ void FN_NOINLINE dbgStrDestroyed(void *c, unsigned int Capacity)
 //		(unsigned long)DBGSTR().Instances.size(), DBGSTR().Addrefs, Capacity);
 }
 
+void FN_NOINLINE dbgStrAllocated(bool FromCache)
+{
+	std::lock_guard<std::mutex> lock(DBGSTR().Mtx);
+	if (FromCache)
+		++DBGSTR().CacheHits;
+	else
+		++DBGSTR().Allocs;
+}
+
 void FN_NOINLINE dbgStrAddref(const wchar_t *Data)
 {
 	std::lock_guard<std::mutex> lock(DBGSTR().Mtx);
@@ -86,8 +98,8 @@ void FARString::ScanForLeaks()
 {
 	std::lock_guard<std::mutex> lock(DBGSTR().Mtx);
 	const auto &strs = DBGSTR().Instances;
-	fprintf(stderr, "========= %s: Count=%lu Addrefs=%llu\n",
-		__FUNCTION__, (unsigned long)strs.size(), DBGSTR().Addrefs);
+	fprintf(stderr, "========= %s: Count=%lu Addrefs=%llu Allocs=%llu CacheHits=%llu\n",
+		__FUNCTION__, (unsigned long)strs.size(), DBGSTR().Addrefs, DBGSTR().Allocs, DBGSTR().CacheHits);
 
 //	fprintf(stderr, "dbgStrAddref: Instances=%lu Addrefs=%llu '%ls'\n",
 //		(unsigned long)DBGSTR().Instances.size(), DBGSTR().Addrefs, Data);
@@ -108,20 +120,90 @@ void FARString::ScanForLeaks()
 #else
 # define dbgStrCreated(c, Capacity)
 # define dbgStrDestroyed(c, Capacity)
+# define dbgStrAllocated(FromCache)
 # define dbgStrAddref(Data)
 void FARString::ScanForLeaks() { }
 #endif
 
 FARString::Content FARString::Content::sEmptyData{}; // all fields zero inited by loader
 
+/*
+	Панели, меню и диалоги постоянно создают и уничтожают множество коротких строк.
+	Чтобы не гонять их через malloc/free, емкость коротких строк округляется вверх
+	до одного из классов и освободившиеся блоки складываются в кэш потока, из которого
+	потом берутся новые строки того же класса. Кэш ограничен, лишнее отдается free().
+	Блок может быть освобожден не в том потоке, где создан - он просто попадет в кэш
+	освободившего потока.
+*/
+static constexpr unsigned int sSmallCapacities[] = {7, 15, 31, 63};
+static constexpr unsigned int sSmallCacheLimit = 256;	// блоков каждого класса на поток
+
+struct SmallContentCache
+{
+	void *Heads[ARRAYSIZE(sSmallCapacities)];	// односвязные списки, ссылка - в начале блока
+	unsigned int Counts[ARRAYSIZE(sSmallCapacities)];
+	bool Registered;	// назначена очистка при завершении потока
+	bool Gone;			// поток завершается, кэш уже очищен - больше не пользоваться
+};
+
+static thread_local SmallContentCache tSmallCache;	// zero-inited
+static pthread_key_t sSmallCacheKey;
+static pthread_once_t sSmallCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+static void SmallContentCacheCleanup(void *)
+{
+	tSmallCache.Gone = true;
+	for (auto &Head : tSmallCache.Heads)
+	{
+		while (Head)
+		{
+			void *Next = *(void **)Head;
+			free(Head);
+			Head = Next;
+		}
+	}
+}
+
+static void SmallContentCacheKeyCreate()
+{
+	pthread_key_create(&sSmallCacheKey, SmallContentCacheCleanup);
+}
+
+static inline size_t SmallCapacityClass(size_t nCapacity)
+{
+	size_t i = 0;
+	while (i < ARRAYSIZE(sSmallCapacities) && nCapacity > sSmallCapacities[i])
+		++i;
+	return i;
+}
+
 FARString::Content *FARString::Content::Create(size_t nCapacity)
 {
 	if (UNLIKELY(!nCapacity))
 		return EmptySingleton();
 
-	Content *out = (Content *)malloc(sizeof(Content) + sizeof(wchar_t) * nCapacity);
-	//Так как ни где выше в коде мы не готовы на случай что памяти не хватит
-	//то уж лучше и здесь не проверять, а сразу падать
+	Content *out = nullptr;
+	const size_t Class = SmallCapacityClass(nCapacity);
+	if (Class < ARRAYSIZE(sSmallCapacities))
+	{
+		nCapacity = sSmallCapacities[Class];
+		if (tSmallCache.Heads[Class])
+		{
+			out = (Content *)tSmallCache.Heads[Class];
+			tSmallCache.Heads[Class] = *(void **)out;
+			--tSmallCache.Counts[Class];
+			dbgStrAllocated(true);
+		}
+	}
+
+	if (!out)
+	{
+		out = (Content *)malloc(sizeof(Content) + sizeof(wchar_t) * nCapacity);
+		//Так как ни где выше в коде мы не готовы на случай что памяти не хватит
+		//то уж лучше и здесь не проверять, а сразу падать
+		dbgStrAllocated(false);
+	}
+
 	out->m_nRefCount = 1;
 	out->m_nCapacity = (unsigned int)std::min(nCapacity, (size_t)std::numeric_limits<unsigned int>::max());
 	out->m_nLength = 0;
@@ -144,6 +226,23 @@ void FN_NOINLINE FARString::Content::Destroy(Content *c)
 {
 	dbgStrDestroyed(c, c->m_nCapacity);
 	ASSERT(c != EmptySingleton());
+
+	const size_t Class = SmallCapacityClass(c->m_nCapacity);
+	if (Class < ARRAYSIZE(sSmallCapacities) && c->m_nCapacity == sSmallCapacities[Class]
+			&& !tSmallCache.Gone && tSmallCache.Counts[Class] < sSmallCacheLimit)
+	{
+		if (UNLIKELY(!tSmallCache.Registered))
+		{
+			pthread_once(&sSmallCacheKeyOnce, SmallContentCacheKeyCreate);
+			pthread_setspecific(sSmallCacheKey, &tSmallCache);
+			tSmallCache.Registered = true;
+		}
+		*(void **)c = tSmallCache.Heads[Class];
+		tSmallCache.Heads[Class] = c;
+		++tSmallCache.Counts[Class];
+		return;
+	}
+
 	free(c);
 }
 
@@ -158,9 +257,11 @@ void FARString::Content::AddRef()
 
 void FARString::Content::DecRef()
 {
-	// __atomic_load_n(relaxed) usually doesn't use any HW interlocking
-	// thus its a fast path for empty or single-owner strings
-	unsigned int n = __atomic_load_n(&m_nRefCount, __ATOMIC_RELAXED);
+	// __atomic_load_n(acquire) usually doesn't use any HW interlocking
+	// thus its a fast path for empty or single-owner strings; acquire
+	// ensures that content is not destroyed before other (ex-)owners
+	// finished accessing it
+	unsigned int n = __atomic_load_n(&m_nRefCount, __ATOMIC_ACQUIRE);
 	if (LIKELY(n == 0))
 	{  // (only) empty singletone has always-zero m_nRefCount
 		return;
@@ -168,7 +269,7 @@ void FARString::Content::DecRef()
 
 	if (LIKELY(n != 1))
 	{
-		if (LIKELY(__atomic_sub_fetch(&m_nRefCount, 1, __ATOMIC_RELEASE) != 0))
+		if (LIKELY(__atomic_sub_fetch(&m_nRefCount, 1, __ATOMIC_ACQ_REL) != 0))
 			return;
 	}
 
@@ -50,8 +50,14 @@ inline const wchar_t *NullToEmpty(const wchar_t *s) { return s ? s : L""; }
 		Use GetBuffer/ReleaseBuffer or simple plain assignment instead.
 		- Don't modify single FARString instance from different threads without serialization.
 		Create per-thread copies of FARString and modifying them from that threads is perfectly fine however.
+		Copies may be freely created, passed to and destroyed in other threads: reference counter
+		manipulations are atomic and ordered, so last owner always sees all writes done by previous owners.
 		- Avoid excessive copying. While its doesn't copy string content, it performs still slow HW-interlocked
 		reference counter manipulations, so better use passing-by-reference and std::move where possible.
+		- Pointer returned by CPtr() remains valid while any FARString that shares that content is alive,
+		even if FARString that it was obtained from was moved or destroyed. Code relies on this, so content
+		must not be stored inside FARString instance itself (i.e. no 'small string optimization' there).
+		Allocation of short strings content is cheap instead: their blocks are reused from per-thread cache.
 */
 
 class FARString
@@ -64,14 +70,16 @@ class FARString
 		runtime overhead. Using trivial class makes possible just to create global static variable that
 		will be resided in BSS and thus will have all fields zero-initialized by linker and ready to use
 		just upon app loading without using initializing c-tor. This is also main reason why cannot use
-		virtual methods, std::atomic<> instead of __atomic_* etc
+		virtual methods, std::atomic<> instead of __atomic_* etc.
+		Capacity of short contents is rounded up to one of few fixed size classes, so their blocks
+		can be reused via per-thread cache instead of going to malloc/free each time.
 	*/
 
 	class Content
 	{
 		static Content sEmptyData; //для оптимизации создания пустых FARString
 
-		volatile unsigned int m_nRefCount;
+		unsigned int m_nRefCount;	// accessed only by __atomic_* functions
 		unsigned int m_nCapacity;	// not including final NULL char
 		unsigned int m_nLength;		// not including final NULL char
 		wchar_t m_Data[1];
@@ -86,7 +94,9 @@ class FARString
 
 		void AddRef();
 		void DecRef();
-		unsigned int GetRefs() const { return __atomic_load_n(&m_nRefCount, __ATOMIC_RELAXED); }
+		// acquire so if sole owner going to modify content - it sees all changes done by other
+		// owners that dropped their references before, this pairs with release in DecRef
+		unsigned int GetRefs() const { return __atomic_load_n(&m_nRefCount, __ATOMIC_ACQUIRE); }
 
 		void SetLength(size_t nLength);
 		inline wchar_t *GetData() { return m_Data; }
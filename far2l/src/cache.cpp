@@ -56,6 +56,8 @@ bool BufferedFileView::Open(const std::string &PathName)
 		return false;
 	}
 
+	this->PathName = PathName;
+
 	HintFDSequentialAccess(FD);
 
 	FileSize = 0;
@@ -123,11 +125,47 @@ void BufferedFileView::ActualizeFileSize()
 {
 	struct stat s{};
 	if (FD != -1 && !PseudoFile && sdc_fstat(FD, &s) == 0 && FileSize != (UINT64)s.st_size) {
-		Clear();
+		// Если файл только дописался - буфер остаётся актуальным и читаться будет
+		// лишь добавленное, но если он был переписан целиком - буфер надо сбросить
+		if ((UINT64)s.st_size < FileSize || !BufferedTailIntact()) {
+			Clear();
+		}
 		FileSize = s.st_size;
 	}
 }
 
+bool BufferedFileView::BufferedTailIntact()
+{
+	if (BufferBounds.End <= BufferBounds.Ptr) {
+		return true;
+	}
+
+	unsigned char Tail[0x100];
+	const DWORD TailSize = (DWORD)std::min(UINT64(sizeof(Tail)), BufferBounds.End - BufferBounds.Ptr);
+	const UINT64 TailPtr = BufferBounds.End - TailSize;
+	return DirectReadAt(TailPtr, Tail, TailSize) == TailSize
+		&& memcmp(Tail, &Buffer[TailPtr - BufferBounds.Ptr], TailSize) == 0;
+}
+
+bool BufferedFileView::ReopenIfReplaced()
+{
+	struct stat s{}, fs{};
+	if (FD == -1 || PseudoFile || sdc_stat(PathName.c_str(), &s) != 0 || sdc_fstat(FD, &fs) != 0
+			|| (s.st_dev == fs.st_dev && s.st_ino == fs.st_ino)) {
+		return false;
+	}
+
+	const std::string SavedPathName = PathName;
+	const UINT64 SavedPtr = CurPtr;
+	if (!Open(SavedPathName)) {
+		return false;
+	}
+
+	CurPtr = std::min(SavedPtr, FileSize);
+	LastPtr = 0;
+	return true;
+}
+
 void BufferedFileView::Clear()
 {
 	BufferBounds.Ptr = 0;
@@ -51,6 +51,9 @@ public:
 
 	void ActualizeFileSize();
 
+	// if path now refers to another file than opened one (e.g. rotated log) - opens it instead
+	bool ReopenIfReplaced();
+
 	void SetPointer(INT64 Ptr, int Whence = SEEK_SET);
 	inline void GetPointer(INT64 &Ptr) const { Ptr = CurPtr; }
 	inline bool GetSize(UINT64 &Size) const
@@ -83,6 +86,7 @@ private:
 	} BufferBounds;
 
 	int FD = -1;
+	std::string PathName;
 
 	LPBYTE Buffer    = nullptr;
 	DWORD BufferSize = 0;
@@ -92,6 +96,7 @@ private:
 	bool PseudoFile = false;
 
 	DWORD DirectReadAt(UINT64 Ptr, LPVOID Data, DWORD DataSize);
+	bool BufferedTailIntact();
 	LPBYTE AllocBuffer(size_t Size);
 
 	void CalcBufferBounds(Bounds &bi, UINT64 Ptr, DWORD DataSize, DWORD CountLefter, DWORD CountRighter);
@@ -345,6 +345,7 @@ const ConfigOpt g_cfg_opts[] {
 	{OST_NONE,   NSecSystem, "AllCtrlAltShiftRule", &Opt.AllCtrlAltShiftRule, 0x0000FFFF},
 	{OST_COMMON, NSecSystem, "ScanJunction", &Opt.ScanJunction, 1},
 	{OST_COMMON, NSecSystem, "OnlyFilesSize", &Opt.OnlyFilesSize, 0},
+	{OST_NONE,   NSecSystem, "DirInfoCache", &Opt.DirInfoCache, 0},
 	{OST_NONE,   NSecSystem, "UsePrintManager", &Opt.UsePrintManager, 1},
 
 	{OST_COMMON, NSecSystem, "ExcludeCmdHistory", &Opt.ExcludeCmdHistory, 0}, //AN
@@ -400,6 +401,7 @@ const ConfigOpt g_cfg_opts[] {
 	{OST_NONE,   NSecPanel, "ShellRightLeftArrowsRule", &Opt.ShellRightLeftArrowsRule, 0},
 	{OST_COMMON, NSecPanel, "ShowHidden", &Opt.ShowHidden, 1},
 	{OST_COMMON, NSecPanel, "Highlight", &Opt.Highlight, 1},
+	{OST_COMMON, NSecPanel, "HighlightGitStatus", &Opt.HighlightGitStatus, 0},
 	{OST_COMMON, NSecPanel, "SortFolderExt", &Opt.SortFolderExt, 0},
 	{OST_COMMON, NSecPanel, "SelectFolders", &Opt.SelectFolders, 0},
 	{OST_COMMON, NSecPanel, "AttrStrStyle", &Opt.AttrStrStyle, 1},
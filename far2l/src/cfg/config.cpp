@@ -270,6 +270,9 @@ void PanelSettings()
 		auto HighlightMarksItem = Builder.AddButton(Msg::ConfigPanelHighlightMarksButton, HighlightMarksID);
 		HighlightMarksItem->Indent(2);
 		Builder.LinkFlags(CbHighlight, HighlightMarksItem, DIF_DISABLE);
+		auto CbHighlightGitStatus = Builder.AddCheckbox(Msg::ConfigHighlightGitStatus, &Opt.HighlightGitStatus);
+		CbHighlightGitStatus->Indent(2);
+		Builder.LinkFlags(CbHighlight, CbHighlightGitStatus, DIF_DISABLE);
 
 		int ChangeSizeColumnStyleID = -1;
 		auto ChangeSizeColumnStyleItem = Builder.AddButton(Msg::DirSettingsTitle, ChangeSizeColumnStyleID);
@@ -427,6 +427,7 @@ struct Options
 	DWORD ShowSymlinkSize;
 
 	int Highlight;
+	int HighlightGitStatus;
 	int CursorBlinkTime;
 
 	FARString strLeftFolder;
@@ -625,6 +626,7 @@ struct Options
 	int UseNumPad;
 	int ScanJunction;
 	int OnlyFilesSize;
+	int DirInfoCache;
 
 	DWORD ShowTimeoutDelFiles;	// таймаут в процессе удаления (в ms)
 	DWORD ShowTimeoutDACLFiles;
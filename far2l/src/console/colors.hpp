@@ -300,6 +300,9 @@ enum PaletteColors
 	COL_MENUPREFIX,
 	COL_MENUSELPREFIX,
 	COL_EDITORLINENUMBER,
+	COL_PANELGITMODIFIED,
+	COL_PANELGITUNTRACKED,
+	COL_PANELGITIGNORED,
 
 	COL_LASTPALETTECOLOR
 };
@@ -311,6 +311,12 @@ bool console::WriteOutput(const CHAR_INFO &Buffer, COORD BufferSize, COORD Buffe
 	return Result;
 }
 
+bool console::WriteOutputRegions(const CHAR_INFO &Buffer, COORD BufferSize, SMALL_RECT *WriteRegions, size_t Count)
+{
+	return WINPORT(WriteConsoleOutputRegions)(GetOutputHandle(), &Buffer, BufferSize, WriteRegions, (DWORD)Count)
+			!= FALSE;
+}
+
 bool console::Write(LPCWSTR Buffer, DWORD NumberOfCharsToWrite)
 {
 	DWORD NumberOfCharsWritten;
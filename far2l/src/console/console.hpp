@@ -77,6 +77,7 @@ public:
 	bool WriteInput(const INPUT_RECORD &Buffer);
 	bool ReadOutput(CHAR_INFO &Buffer, COORD BufferSize, COORD BufferCoord, SMALL_RECT &ReadRegion);
 	bool WriteOutput(const CHAR_INFO &Buffer, COORD BufferSize, COORD BufferCoord, SMALL_RECT &WriteRegion);
+	bool WriteOutputRegions(const CHAR_INFO &Buffer, COORD BufferSize, SMALL_RECT *WriteRegions, size_t Count);
 	bool Write(LPCWSTR Buffer, DWORD NumberOfCharsToWrite);
 
 	bool GetTextAttributes(uint64_t &Attributes);
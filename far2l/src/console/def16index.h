@@ -190,6 +190,9 @@ uint8_t DefaultColorsIndex16[SIZE_ARRAY_FARCOLORS] = {
 		F_BLACK | B_CYAN,               // COL_MENUPREFIX,
 		F_DARKGRAY | B_BLACK,           // COL_MENUSELPREFIX,
 		F_YELLOW | B_BLUE,              // COL_EDITORLINENUMBER,
+		F_LIGHTRED | B_BLUE,            // COL_PANELGITMODIFIED,
+		F_LIGHTGREEN | B_BLUE,          // COL_PANELGITUNTRACKED,
+		F_DARKGRAY | B_BLUE,            // COL_PANELGITIGNORED,
 };
 
 uint8_t BlackColorsIndex16[SIZE_ARRAY_FARCOLORS] = {
@@ -383,4 +386,7 @@ uint8_t BlackColorsIndex16[SIZE_ARRAY_FARCOLORS] = {
 		F_DARKGRAY | B_LIGHTGRAY,       // COL_MENUPREFIX,
 		F_LIGHTGRAY | B_BLACK,          // COL_MENUSELPREFIX,
 		F_WHITE | B_BLACK,              // COL_EDITORLINENUMBER,
+		F_WHITE | B_BLACK,              // COL_PANELGITMODIFIED,
+		F_LIGHTGRAY | B_BLACK,          // COL_PANELGITUNTRACKED,
+		F_DARKGRAY | B_BLACK,           // COL_PANELGITIGNORED,
 };
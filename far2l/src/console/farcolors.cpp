@@ -209,6 +209,9 @@ ColorsInit[]
 	{"Menu.Prefix",                                 F_DARKGRAY | B_CYAN,      }, // COL_MENUPREFIX,
 	{"Menu.Prefix.Selected",                        F_LIGHTGRAY | B_BLACK,    }, // COL_MENUSELPREFIX,
 	{"Editor.LineNumber",                           F_YELLOW | B_BLUE,        }, // COL_EDITORLINENUMBER,
+	{"Panel.Git.Modified",                          F_LIGHTRED | B_BLUE,      }, // COL_PANELGITMODIFIED,
+	{"Panel.Git.Untracked",                         F_LIGHTGREEN | B_BLUE,    }, // COL_PANELGITUNTRACKED,
+	{"Panel.Git.Ignored",                           F_DARKGRAY | B_BLUE,      }, // COL_PANELGITIGNORED,
 };
 
 static_assert(ARRAYSIZE(ColorsInit) == COL_LASTPALETTECOLOR);
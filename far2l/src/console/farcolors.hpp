@@ -39,7 +39,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <string>
 
-#define SIZE_ARRAY_FARCOLORS 160
+#define SIZE_ARRAY_FARCOLORS 163
 
 class FarColors : NonCopyable
 {
@@ -40,11 +40,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "interf.hpp"
 #include "farcolors.hpp"
 #include "config.hpp"
-#include "DList.hpp"
 #include "console.hpp"
 #include "savescr.hpp"
 
 #include <new>
+#include <chrono>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 enum
 {
@@ -64,15 +67,114 @@ extern int DirectRT;
 
 ScreenBuf ScrBuf;
 
-static bool AreSameCharInfoBuffers(const CHAR_INFO *left, const CHAR_INFO *right, size_t count)
-{	// use this instead of memcmp cuz it can produce wrong results due to uninitialized alignment gaps
-	for (; count; --count, ++left, ++right) {
-		if (left->Char.UnicodeChar != right->Char.UnicodeChar)
-			return false;
-		if (left->Attributes != right->Attributes)
-			return false;
+/*
+	Поиск изменений между буфером и теневым буфером.
+	CHAR_INFO - это два 64-битных поля без промежутков, поэтому ячейки сравниваются целиком,
+	по 4 за раз (через SSE2 если доступен), а поштучно - только на границах изменений.
+*/
+static_assert(sizeof(CHAR_INFO) == 2 * sizeof(DWORD64), "CHAR_INFO must have no padding");
+
+#define FLUSH_MIN_GAP         8		// столько неизменных ячеек подряд разделяют изменения строки на разные прямоугольники
+#define FLUSH_MAX_ROW_SPANS   4		// больше изменений в одной строке сливаются в последний
+#define FLUSH_MAX_MERGE_WASTE 64	// сколько неизмененных ячеек можно перевывести ради объединения прямоугольников
+#define FLUSH_MAX_REGIONS     32	// больше прямоугольников за один вывод не бывает
+
+static inline bool SameCell(const CHAR_INFO &Left, const CHAR_INFO &Right)
+{
+	return Left.Char.UnicodeChar == Right.Char.UnicodeChar && Left.Attributes == Right.Attributes;
+}
+
+static inline bool SameFourCells(const CHAR_INFO *Left, const CHAR_INFO *Right)
+{
+#ifdef __SSE2__
+	__m128i Diff = _mm_xor_si128(_mm_loadu_si128((const __m128i *)Left), _mm_loadu_si128((const __m128i *)Right));
+	for (int i = 1; i < 4; ++i) {
+		Diff = _mm_or_si128(Diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)(Left + i)),
+				_mm_loadu_si128((const __m128i *)(Right + i))));
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(Diff, _mm_setzero_si128())) == 0xFFFF;
+#else
+	DWORD64 Diff = 0;
+	for (int i = 0; i < 4; ++i) {
+		Diff|= (Left[i].Char.UnicodeChar ^ Right[i].Char.UnicodeChar) | (Left[i].Attributes ^ Right[i].Attributes);
+	}
+	return Diff == 0;
+#endif
+}
+
+// индекс первой отличающейся ячейки или Count если отличий нет
+static int FindFirstChange(const CHAR_INFO *Left, const CHAR_INFO *Right, int Count)
+{
+	int i = 0;
+	while (i + 4 <= Count && SameFourCells(Left + i, Right + i))
+		i+= 4;
+	while (i < Count && SameCell(Left[i], Right[i]))
+		++i;
+	return i;
+}
+
+// индекс последней отличающейся ячейки или -1 если отличий нет
+static int FindLastChange(const CHAR_INFO *Left, const CHAR_INFO *Right, int Count)
+{
+	int i = Count;
+	while (i >= 4 && SameFourCells(Left + i - 4, Right + i - 4))
+		i-= 4;
+	while (i > 0 && SameCell(Left[i - 1], Right[i - 1]))
+		--i;
+	return i - 1;
+}
+
+struct RowSpan
+{
+	SHORT Left, Right;
+};
+
+// Изменившиеся участки строки: отличающиеся ячейки, разделенные менее чем FLUSH_MIN_GAP
+// совпадающими, объединяются в один участок. Возвращает количество участков.
+static int FindRowChanges(const CHAR_INFO *RowBuf, const CHAR_INFO *RowShadow, int Width, RowSpan *Spans)
+{
+	const int First = FindFirstChange(RowBuf, RowShadow, Width);
+	if (First == Width)
+		return 0;
+
+	const int Last = First + FindLastChange(RowBuf + First, RowShadow + First, Width - First);
+	int Count = 0;
+	int SpanLeft = First;
+	for (int X = First; Count + 1 < FLUSH_MAX_ROW_SPANS;) {
+		int SameStart = X + 1;
+		while (SameStart <= Last && !SameCell(RowBuf[SameStart], RowShadow[SameStart]))
+			++SameStart;
+		if (SameStart > Last)
+			break;
+
+		const int Next = SameStart + FindFirstChange(RowBuf + SameStart, RowShadow + SameStart, Last + 1 - SameStart);
+		if (Next - SameStart >= FLUSH_MIN_GAP) {
+			Spans[Count].Left = SpanLeft;
+			Spans[Count].Right = SameStart - 1;
+			++Count;
+			SpanLeft = Next;
+		}
+		X = Next;
 	}
-	return true;
+	Spans[Count].Left = SpanLeft;
+	Spans[Count].Right = Last;
+	return Count + 1;
+}
+
+static inline int RectArea(const SMALL_RECT &Rect)
+{
+	return (Rect.Right - Rect.Left + 1) * (Rect.Bottom - Rect.Top + 1);
+}
+
+static inline SMALL_RECT RectUnion(const SMALL_RECT &A, const SMALL_RECT &B)
+{
+	return SMALL_RECT{Min(A.Left, B.Left), Min(A.Top, B.Top), Max(A.Right, B.Right), Max(A.Bottom, B.Bottom)};
+}
+
+// сколько лишних ячеек будет выведено, если вывести A и B одним прямоугольником
+static inline int MergeWaste(const SMALL_RECT &A, const SMALL_RECT &B)
+{
+	return RectArea(RectUnion(A, B)) - RectArea(A) - RectArea(B);
 }
 
 ScreenBuf::ScreenBuf()
@@ -87,7 +189,9 @@ ScreenBuf::ScreenBuf()
 	CurY(0),
 	CurVisible(false),
 	CurSize(0),
-	LockCount(0)
+	LockCount(0),
+	DirtyTop(0),
+	DirtyBottom(-1)
 {
 	SBFlags.Set(SBFLAGS_FLUSHED | SBFLAGS_FLUSHEDCURPOS | SBFLAGS_FLUSHEDCURTYPE);
 }
@@ -141,6 +245,7 @@ void ScreenBuf::AllocBuf(int X, int Y)
 
 	BufX = X;
 	BufY = Y;
+	MarkDirty();
 	//ResetShadow();
 }
 
@@ -156,6 +261,7 @@ void ScreenBuf::FillBuf()
 	SMALL_RECT ReadRegion = {0, 0, (SHORT)(BufX - 1), (SHORT)(BufY - 1)};
 	Console.ReadOutput(*Buf, BufferSize, BufferCoord, ReadRegion);
 	memcpy(Shadow, Buf, BufX * BufY * sizeof(CHAR_INFO));
+	MarkClean();
 	SBFlags.Set(SBFLAGS_USESHADOW);
 	COORD CursorPosition;
 	Console.GetCursorPosition(CursorPosition);
@@ -169,6 +275,7 @@ void ScreenBuf::FillBufWithRecompose(HANDLE Console)
 	SMALL_RECT ReadRegion = {0, 0, (SHORT)(BufX - 1), (SHORT)(BufY - 1)};
 	CONSOLE_SCREEN_BUFFER_INFO csbi{};
 	SBFlags.Clear(SBFLAGS_FLUSHED);
+	MarkDirty();
 	if (WINPORT(GetConsoleScreenBufferInfo)(Console, &csbi) && (csbi.dwSize.X != BufX || csbi.dwSize.Y != BufY)) {
 		// in case size different - fork&resize original console to enable lines recompisition to its job
 		ConsoleForkScope TmpConsole(Console);
@@ -212,6 +319,7 @@ void ScreenBuf::Write(int X, int Y, const CHAR_INFO *Text, int TextLength)
 		PtrBuf[i].Attributes = Text[i].Attributes;
 	}
 
+	MarkDirty(Y, Y);
 	SBFlags.Clear(SBFLAGS_FLUSHED);
 #ifdef DIRECT_SCREEN_OUT
 	Flush();
@@ -237,6 +345,7 @@ void ScreenBuf::SetExplicitLineBreak(int Y)
 		PtrBuf[i].Attributes &= ~EXPLICIT_LINE_BREAK;
 	}
 	PtrBuf[LastNonSpace].Attributes |= EXPLICIT_LINE_BREAK;
+	MarkDirty(Y, Y);
 }
 
 /*
@@ -276,6 +385,7 @@ void ScreenBuf::ApplyShadow(int X1, int Y1, int X2, int Y2, SaveScreen *ss)
 									(attr & 0x000000000000FF00ULL) | (cc ? cc : 8);
 		}
 	}
+	MarkDirty(Y1, Y2);
 
 #ifdef DIRECT_SCREEN_OUT
 	Flush();
@@ -309,6 +419,7 @@ void ScreenBuf::ApplyColorMask(int X1, int Y1, int X2, int Y2, DWORD64 ColorMask
 				PtrBuf->Attributes = 0x08;
 		}
 	}
+	MarkDirty(Y1, Y2);
 
 #ifdef DIRECT_SCREEN_OUT
 	Flush();
@@ -344,6 +455,7 @@ void ScreenBuf::ApplyColor(int X1, int Y1, int X2, int Y2, DWORD64 Color)
 			for (int J = 0; J < Width; J++, ++PtrBuf)
 				PtrBuf->Attributes = Color;
 		}
+		MarkDirty(Y1, Y2);
 
 #ifdef DIRECT_SCREEN_OUT
 		Flush();
@@ -378,6 +490,7 @@ void ScreenBuf::ApplyColor(int X1, int Y1, int X2, int Y2, DWORD64 Color, DWORD6
 				if (PtrBuf->Attributes != ExceptColor)
 					PtrBuf->Attributes = Color;
 		}
+		MarkDirty(Y1, Y2);
 
 #ifdef DIRECT_SCREEN_OUT
 		Flush();
@@ -411,6 +524,7 @@ void ScreenBuf::FillRect(int X1, int Y1, int X2, int Y2, WCHAR Ch, DWORD64 Color
 			*PtrBuf = CI;
 	}
 
+	MarkDirty(Y1, Y2);
 	SBFlags.Clear(SBFLAGS_FLUSHED);
 #ifdef DIRECT_SCREEN_OUT
 	Flush();
@@ -446,6 +560,7 @@ void ScreenBuf::Flush()
 				Buf[0].Char.UnicodeChar = L'P';
 				Buf[0].Attributes = 0x2F;
 			}
+			MarkDirty(0, 0);
 		}
 
 		if (!SBFlags.Check(SBFLAGS_FLUSHEDCURTYPE) && !CurVisible) {
@@ -461,83 +576,49 @@ void ScreenBuf::Flush()
 				ShowTime(FALSE);
 			}
 
-			DList<SMALL_RECT> WriteList;
-			bool Changes = false;
-
+			const auto CompareStart = std::chrono::steady_clock::now();
 			if (SBFlags.Check(SBFLAGS_USESHADOW)) {
-				PCHAR_INFO PtrBuf = Buf, PtrShadow = Shadow;
-
-				{
-					bool Started = false;
-					SMALL_RECT WriteRegion = {(SHORT)(BufX - 1), (SHORT)(BufY - 1), 0, 0};
-
-					for (SHORT I = 0; I < BufY; I++) {
-						for (SHORT J = 0; J < BufX; J++, ++PtrBuf, ++PtrShadow) {
-							if (!AreSameCharInfoBuffers(PtrBuf, PtrShadow, 1)) {
-								WriteRegion.Left = Min(WriteRegion.Left, J);
-								WriteRegion.Top = Min(WriteRegion.Top, I);
-								WriteRegion.Right = Max(WriteRegion.Right, J);
-								WriteRegion.Bottom = Max(WriteRegion.Bottom, I);
-								Changes = true;
-								Started = true;
-							} else if (Started && I > WriteRegion.Bottom && J >= WriteRegion.Left) {
-								bool Merge = false;
-								PSMALL_RECT Last = WriteList.Last();
-
-								if (Last) {
-#define MAX_DELTA 5
-
-									if (WriteRegion.Top - 1 == Last->Bottom
-											&& ((WriteRegion.Left >= Last->Left
-														&& WriteRegion.Left - Last->Left < MAX_DELTA)
-													|| (Last->Right >= WriteRegion.Right
-															&& Last->Right - WriteRegion.Right
-																	< MAX_DELTA))) {
-										Last->Bottom = WriteRegion.Bottom;
-										Last->Left = Min(Last->Left, WriteRegion.Left);
-										Last->Right = Max(Last->Right, WriteRegion.Right);
-										Merge = true;
-									}
-								}
-
-								if (!Merge)
-									WriteList.Push(&WriteRegion);
-
-								WriteRegion.Left = BufX - 1;
-								WriteRegion.Top = BufY - 1;
-								WriteRegion.Right = 0;
-								WriteRegion.Bottom = 0;
-								Started = false;
-							}
-						}
-					}
-
-					if (Started) {
-						WriteList.Push(&WriteRegion);
-					}
-				}
+				CollectChangedRegions();
 			} else {
-				Changes = true;
-				SMALL_RECT WriteRegion = {0, 0, (SHORT)(BufX - 1), (SHORT)(BufY - 1)};
-				WriteList.Push(&WriteRegion);
+				WriteRegions.clear();
+				WriteRegions.emplace_back(SMALL_RECT{0, 0, (SHORT)(BufX - 1), (SHORT)(BufY - 1)});
+				MarkDirty();
 			}
-
-			if (Changes) {
-				for (PSMALL_RECT PtrRect = WriteList.First(); PtrRect; PtrRect = WriteList.Next(PtrRect)) {
-					COORD BufferSize = {BufX, BufY}, BufferCoord = {PtrRect->Left, PtrRect->Top};
-					SMALL_RECT WriteRegion = *PtrRect;
-					Console.WriteOutput(*Buf, BufferSize, BufferCoord, WriteRegion);
+			const auto WriteStart = std::chrono::steady_clock::now();
+			FlushStats.Flushes++;
+			FlushStats.CompareUSec+= std::chrono::duration_cast<std::chrono::microseconds>(
+				WriteStart - CompareStart).count();
+
+			if (!WriteRegions.empty()) {
+				// все регионы пишутся одним вызовом - под одной блокировкой и с одним уведомлением бэкенда
+				COORD BufferSize = {BufX, BufY};
+				Console.WriteOutputRegions(*Buf, BufferSize, WriteRegions.data(), WriteRegions.size());
+
+				FlushStats.Writes++;
+				FlushStats.Regions+= WriteRegions.size();
+				for (const auto &Region : WriteRegions) {
+					FlushStats.Cells+= RectArea(Region);
 				}
-				memcpy(Shadow, Buf, BufX * BufY * sizeof(CHAR_INFO));
+				FlushStats.WriteUSec+= std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - WriteStart).count();
 			}
+
+			// вне грязных строк теневой буфер и так совпадает с основным
+			const int Top = Max(DirtyTop, 0), Bottom = Min(DirtyBottom, BufY - 1);
+			if (Top <= Bottom) {
+				memcpy(Shadow + Top * BufX, Buf + Top * BufX, (Bottom - Top + 1) * BufX * sizeof(CHAR_INFO));
+			}
+			MarkClean();
 		}
 
 		if (MacroCharUsed) {
 			Buf[0] = MacroChar;
+			MarkDirty(0, 0);
 		}
 
 		if (ElevationCharUsed && BufX > 0 && BufY > 0) {
 			Buf[BufX * BufY - 1] = ElevationChar;
+			MarkDirty(BufY - 1, BufY - 1);
 		}
 
 		if (!SBFlags.Check(SBFLAGS_FLUSHEDCURPOS)) {
@@ -556,6 +637,74 @@ void ScreenBuf::Flush()
 	}
 }
 
+/*
+	Собрать в WriteRegions прямоугольники, покрывающие все отличия буфера от теневого.
+	Сравниваются только грязные строки; изменения строки прикрепляются к прямоугольникам,
+	продолженным с предыдущей строки, если это не добавит много лишнего вывода.
+*/
+void ScreenBuf::CollectChangedRegions()
+{
+	WriteRegions.clear();
+
+	const int Top = Max(DirtyTop, 0), Bottom = Min(DirtyBottom, BufY - 1);
+	RowSpan Spans[FLUSH_MAX_ROW_SPANS];
+	size_t Open[FLUSH_MAX_ROW_SPANS], NextOpen[FLUSH_MAX_ROW_SPANS];	// прямоугольники, доходящие до предыдущей строки
+	int OpenCount = 0;
+
+	for (int I = Top; I <= Bottom; I++) {
+		const int SpansCount = FindRowChanges(Buf + I * BufX, Shadow + I * BufX, BufX, Spans);
+		int NextOpenCount = 0;
+		for (int K = 0; K < SpansCount; K++) {
+			const SMALL_RECT SpanRect = {Spans[K].Left, (SHORT)I, Spans[K].Right, (SHORT)I};
+			int Best = -1, BestWaste = FLUSH_MAX_MERGE_WASTE + 1;
+			for (int J = 0; J < OpenCount; J++) {
+				if (Open[J] != (size_t)-1) {
+					const int Waste = MergeWaste(WriteRegions[Open[J]], SpanRect);
+					if (Waste < BestWaste) {
+						BestWaste = Waste;
+						Best = J;
+					}
+				}
+			}
+
+			if (Best != -1) {
+				WriteRegions[Open[Best]] = RectUnion(WriteRegions[Open[Best]], SpanRect);
+				NextOpen[NextOpenCount++] = Open[Best];
+				Open[Best] = (size_t)-1;
+			} else {
+				NextOpen[NextOpenCount++] = WriteRegions.size();
+				WriteRegions.emplace_back(SpanRect);
+			}
+		}
+		memcpy(Open, NextOpen, NextOpenCount * sizeof(Open[0]));
+		OpenCount = NextOpenCount;
+	}
+
+	if (Top <= Bottom)
+		FlushStats.RowsCompared+= Bottom - Top + 1;
+
+	// слишком много прямоугольников - сливаем соседние пары, которые дают меньше всего лишнего
+	while (WriteRegions.size() > FLUSH_MAX_REGIONS) {
+		size_t BestIndex = 0;
+		int BestWaste = -1;
+		for (size_t J = 0; J + 1 < WriteRegions.size(); J++) {
+			const int Waste = MergeWaste(WriteRegions[J], WriteRegions[J + 1]);
+			if (BestWaste == -1 || Waste < BestWaste) {
+				BestWaste = Waste;
+				BestIndex = J;
+			}
+		}
+		WriteRegions[BestIndex] = RectUnion(WriteRegions[BestIndex], WriteRegions[BestIndex + 1]);
+		WriteRegions.erase(WriteRegions.begin() + BestIndex + 1);
+	}
+}
+
+void ScreenBuf::GetFlushStats(ScreenBufFlushStats &Stats)
+{
+	CriticalSectionLock Lock(CS);
+	Stats = FlushStats;
+}
+
 void ScreenBuf::Lock()
 {
 	LockCount++;
@@ -636,8 +785,10 @@ void ScreenBuf::Scroll(int Num)
 	if (!Buf)
 		return;
 
-	if (Num > 0 && Num < BufY)
+	if (Num > 0 && Num < BufY) {
 		memmove(Buf, Buf + Num * BufX, (BufY - Num) * BufX * sizeof(CHAR_INFO));
+		MarkDirty();
+	}
 
 #ifdef DIRECT_SCREEN_OUT
 	Flush();
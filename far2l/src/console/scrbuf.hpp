@@ -36,6 +36,19 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "bitflags.hpp"
 #include "CriticalSections.hpp"
 #include <WinCompat.h>
+#include <vector>
+
+// Накопительные счетчики ScreenBuf::Flush() для оценки стоимости отрисовки
+struct ScreenBufFlushStats
+{
+	DWORD64 Flushes;		// сколько раз сравнивался буфер с теневым
+	DWORD64 Writes;			// из них что-то пришлось вывести
+	DWORD64 RowsCompared;
+	DWORD64 Regions;		// выведено прямоугольников
+	DWORD64 Cells;			// выведено ячеек
+	DWORD64 CompareUSec;	// время сравнения и группировки изменений
+	DWORD64 WriteUSec;		// время вывода на консоль
+};
 
 class ScreenBuf
 {
@@ -56,8 +69,23 @@ private:
 
 	int LockCount;
 
+	// диапазон строк, которые могли измениться с прошлого Flush, пусто если DirtyTop > DirtyBottom
+	int DirtyTop, DirtyBottom;
+	std::vector<SMALL_RECT> WriteRegions;
+	ScreenBufFlushStats FlushStats{};
+
 	CriticalSection CS;
 
+	inline void MarkDirty(int Y1, int Y2)
+	{
+		if (Y1 < DirtyTop) DirtyTop = Y1;
+		if (Y2 > DirtyBottom) DirtyBottom = Y2;
+	}
+	inline void MarkDirty() { MarkDirty(0, BufY - 1); }
+	inline void MarkClean() { DirtyTop = BufY; DirtyBottom = -1; }
+
+	void CollectChangedRegions();
+
 public:
 	ScreenBuf();
 	~ScreenBuf();
@@ -94,6 +122,7 @@ public:
 
 	void Scroll(int);
 	void Flush();
+	void GetFlushStats(ScreenBufFlushStats &Stats);
 };
 
 extern ScreenBuf ScrBuf;
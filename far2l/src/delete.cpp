@@ -60,8 +60,19 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "wakeful.hpp"
 #include "execute.hpp"
 
+#include "MountInfo.h"
+
 #include <RandomString.h>
+#include <Threaded.h>
+#include <ScopeHelpers.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <atomic>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <condition_variable>
 
 enum DeletionResult
 {
@@ -169,6 +180,349 @@ static DeletionResult ShellConfirmDirectoryDeletion(const FARString &strFullName
 	return DELETE_YES;
 }
 
+static DeletionResult ShellDeleteTreeContents(ShellDeleteMsgState &SDMS, int ItemsCount, bool UpdateDiz,
+		Panel *SrcPanel, const FARString &strPath, bool Wipe, int Opt_DeleteToRecycleBin)
+{
+	ScanTree ScTree(TRUE, TRUE, FALSE);
+	ScTree.SetFindPath(strPath, L"*", 0);
+	FAR_FIND_DATA_EX FindData;
+	FARString strFullName;
+	DeletionResult DR;
+	while (ScTree.GetNextName(&FindData, strFullName)) {
+		if (!SDMS.Update(strFullName, Wipe, ProcessedItems, ItemsCount))
+			return DELETE_CANCEL;
+
+		if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			if (!ScTree.IsDirSearchDone()
+					&& (FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+				DR = ShellConfirmDirectoryDeletion(strFullName, Wipe);
+				if (DR == DELETE_SKIP)
+					ScTree.SkipDir();
+			} else {
+				if (FindData.dwFileAttributes & FILE_ATTRIBUTE_READONLY)
+					apiMakeWritable(strFullName);
+
+				DR = ERemoveDirectory(strFullName, Wipe);
+
+				if (DR == DELETE_SUCCESS)
+					TreeList::DelTreeName(strFullName);
+			}
+		} else
+			DR = ShellRemoveFile(strFullName, Wipe, Opt_DeleteToRecycleBin);
+
+		if (DR == DELETE_CANCEL)
+			return DELETE_CANCEL;
+
+		if (DR == DELETE_SUCCESS && UpdateDiz)
+			SrcPanel->DeleteDiz(strFullName);
+	}
+
+	return DELETE_SUCCESS;
+}
+
+/*
+	Параллельное удаление содержимого каталога без подтверждений для вложенных каталогов,
+	без уничтожения и без корзины. Каталоги читаются пулом потоков, файлы удаляются через
+	unlinkat() относительно дескриптора каталога, каталог удаляется после того как удалены
+	все его подкаталоги. Всё, что не удалось удалить напрямую, передаётся в основной поток
+	и обрабатывается там как раньше (ShellRemoveFile/ERemoveDirectory с их вопросами о
+	read-only, sudo и сообщениями об ошибках), так что все диалоги выводятся по очереди.
+*/
+class ParallelTreeDeleter
+{
+	struct Node
+	{
+		std::string Path;
+		std::shared_ptr<Node> Parent;
+		size_t Pending{1};	// own listing + not yet removed subdirectories, protected by _mtx
+		bool Removed{false};
+	};
+
+	typedef std::shared_ptr<Node> NodePtr;
+
+	struct Request
+	{
+		enum Kind
+		{
+			FILE,
+			DIRECTORY,
+			CONTENTS
+		} What;
+		const std::string &Path;
+		DeletionResult Result;
+		bool Done;
+	};
+
+	class Worker : public Threaded
+	{
+		ParallelTreeDeleter &_ptd;
+
+		virtual void *ThreadProc()
+		{
+			_ptd.WorkerProc();
+			return nullptr;
+		}
+
+	public:
+		Worker(ParallelTreeDeleter &ptd) : _ptd(ptd) {}
+		virtual ~Worker() { WaitThread(); }
+		bool Start() { return StartThread(); }
+	};
+
+	std::mutex _mtx;
+	std::condition_variable _jobs_cond, _requests_cond, _replies_cond;
+	std::deque<NodePtr> _jobs;
+	std::deque<Request *> _requests;
+	std::vector<NodePtr> _removed_dirs;
+	std::string _current_path;
+	size_t _busy{0};
+	bool _finished{false};
+	std::atomic<bool> _cancel{false};
+	std::atomic<ULONG> _processed{0};
+	std::list<Worker> _workers;
+
+	DeletionResult Delegate(Request::Kind What, const std::string &Path);
+	void Complete(NodePtr node);
+	void ProcessDirectory(const NodePtr &node);
+	void WorkerProc();
+	DeletionResult ServeRequest(Request &req, ShellDeleteMsgState &SDMS, int ItemsCount);
+	void Abort();
+
+public:
+	~ParallelTreeDeleter() { Abort(); }
+
+	DeletionResult Run(const FARString &strPath, ShellDeleteMsgState &SDMS, int ItemsCount);
+};
+
+// invoked by worker: let main thread deal with item and wait for its decision
+DeletionResult ParallelTreeDeleter::Delegate(Request::Kind What, const std::string &Path)
+{
+	Request req{What, Path, DELETE_CANCEL, false};
+	std::unique_lock<std::mutex> lock(_mtx);
+	if (_cancel) {
+		return DELETE_CANCEL;
+	}
+	_requests.emplace_back(&req);
+	_requests_cond.notify_one();
+	while (!req.Done) {
+		_replies_cond.wait(lock);
+	}
+	return req.Result;
+}
+
+void ParallelTreeDeleter::Complete(NodePtr node)
+{
+	while (node) {
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			if (--node->Pending != 0 || !node->Parent) {
+				return;
+			}
+		}
+		if (_cancel) {
+			return;
+		}
+		// all subdirectories of node are gone, so remove it
+		if (rmdir(node->Path.c_str()) == 0 || errno == ENOENT) {
+			++_processed;
+			node->Removed = true;
+		} else if (Delegate(Request::DIRECTORY, node->Path) == DELETE_SUCCESS) {
+			node->Removed = true;
+		}
+		if (node->Removed) {
+			std::lock_guard<std::mutex> lock(_mtx);
+			_removed_dirs.emplace_back(node);
+		}
+		node = node->Parent;
+	}
+}
+
+void ParallelTreeDeleter::ProcessDirectory(const NodePtr &node)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_current_path = node->Path;
+	}
+
+	FDScope dir_fd(open(node->Path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+	DIR *d = dir_fd.Valid() ? fdopendir(dir_fd) : nullptr;
+	if (!d) {
+		// let main thread scan it in old way, it may need sudo
+		Delegate(Request::CONTENTS, node->Path);
+		return;
+	}
+	dir_fd.Detach();
+
+	// read whole directory before removing its entries to not confuse readdir
+	std::vector<std::pair<std::string, bool> > entries;
+	for (struct dirent *de; !_cancel && (de = readdir(d)) != nullptr;) {
+		if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2]))) {
+			continue;
+		}
+		bool is_dir = (de->d_type == DT_DIR);
+		if (de->d_type == DT_UNKNOWN) {
+			struct stat s;
+			is_dir = (fstatat(dirfd(d), de->d_name, &s, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(s.st_mode));
+		}
+		entries.emplace_back(de->d_name, is_dir);
+	}
+
+	std::string path;
+	for (const auto &entry : entries) {
+		if (_cancel) {
+			break;
+		}
+		path = node->Path;
+		if (path.empty() || path.back() != GOOD_SLASH) {
+			path+= GOOD_SLASH;
+		}
+		path+= entry.first;
+
+		if (entry.second) {
+			NodePtr child = std::make_shared<Node>();
+			child->Path = std::move(path);
+			child->Parent = node;
+			std::lock_guard<std::mutex> lock(_mtx);
+			++node->Pending;
+			_jobs.emplace_back(child);
+			_jobs_cond.notify_one();
+
+		} else if (unlinkat(dirfd(d), entry.first.c_str(), 0) == 0 || errno == ENOENT) {
+			++_processed;
+
+		} else if (Delegate(Request::FILE, path) == DELETE_CANCEL) {
+			break;
+		}
+	}
+	closedir(d);
+}
+
+void ParallelTreeDeleter::WorkerProc()
+{
+	std::unique_lock<std::mutex> lock(_mtx);
+	for (;;) {
+		while (_jobs.empty() && _busy != 0 && !_cancel) {
+			_jobs_cond.wait(lock);
+		}
+		if (_jobs.empty() || _cancel) {
+			_finished = true;
+			_jobs_cond.notify_all();
+			_requests_cond.notify_all();
+			break;
+		}
+
+		// depth-first order keeps amount of pending directories small
+		NodePtr node = std::move(_jobs.back());
+		_jobs.pop_back();
+		++_busy;
+		lock.unlock();
+
+		ProcessDirectory(node);
+		Complete(node);
+
+		lock.lock();
+		--_busy;
+	}
+}
+
+DeletionResult ParallelTreeDeleter::ServeRequest(Request &req, ShellDeleteMsgState &SDMS, int ItemsCount)
+{
+	const FARString strFullName(req.Path);
+	switch (req.What) {
+		case Request::FILE:
+			return ShellRemoveFile(strFullName, false, 0);
+
+		case Request::DIRECTORY:
+			if (apiGetFileAttributes(strFullName) & FILE_ATTRIBUTE_READONLY)
+				apiMakeWritable(strFullName);
+			return ERemoveDirectory(strFullName, false);
+
+		case Request::CONTENTS:
+			return ShellDeleteTreeContents(SDMS, ItemsCount, false, nullptr, strFullName, false, 0);
+	}
+
+	return DELETE_CANCEL;
+}
+
+void ParallelTreeDeleter::Abort()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_cancel = true;
+		for (auto *req : _requests) {
+			req->Result = DELETE_CANCEL;
+			req->Done = true;
+		}
+		_requests.clear();
+		_jobs_cond.notify_all();
+		_replies_cond.notify_all();
+	}
+	_workers.clear();
+}
+
+DeletionResult ParallelTreeDeleter::Run(const FARString &strPath, ShellDeleteMsgState &SDMS, int ItemsCount)
+{
+	NodePtr root = std::make_shared<Node>();
+	root->Path = strPath.GetMB();
+	_jobs.emplace_back(root);
+
+	const unsigned int ThreadsCount = MountInfo().MetadataThreadsCount(root->Path);
+	for (unsigned int i = 0; i < ThreadsCount; ++i) {
+		_workers.emplace_back(*this);
+		if (!_workers.back().Start()) {
+			_workers.pop_back();
+			break;
+		}
+	}
+	if (_workers.empty()) {
+		return ShellDeleteTreeContents(SDMS, ItemsCount, false, nullptr, strPath, false, 0);
+	}
+
+	FARString strCurrentPath;
+	bool Cancelled = false;
+	while (!Cancelled) {
+		Request *req = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			if (_requests.empty() && !_finished) {
+				_requests_cond.wait_for(lock, std::chrono::milliseconds(RedrawTimeout));
+			}
+			if (!_requests.empty()) {
+				req = _requests.front();
+				_requests.pop_front();
+			} else if (_finished) {
+				break;
+			}
+			strCurrentPath = _current_path;
+		}
+
+		ProcessedItems+= _processed.exchange(0);
+		if (req) {
+			const DeletionResult DR = ServeRequest(*req, SDMS, ItemsCount);
+			std::lock_guard<std::mutex> lock(_mtx);
+			req->Result = DR;
+			req->Done = true;
+			_replies_cond.notify_all();
+			Cancelled = (DR == DELETE_CANCEL);
+
+		} else {
+			Cancelled = !SDMS.Update(strCurrentPath, false, ProcessedItems, ItemsCount);
+		}
+	}
+
+	Abort();
+	ProcessedItems+= _processed.exchange(0);
+
+	// removed directories could be cached by tree panel, its enough to tell only about topmost ones
+	for (const auto &node : _removed_dirs) {
+		if (!node->Parent->Removed) {
+			TreeList::DelTreeName(FARString(node->Path));
+		}
+	}
+
+	return Cancelled ? DELETE_CANCEL : DELETE_SUCCESS;
+}
+
 static DeletionResult ShellDeleteDirectory(int ItemsCount, bool UpdateDiz, Panel *SrcPanel,
 		FARString strSelName, DWORD FileAttr, bool Wipe, int Opt_DeleteToRecycleBin)
 {
@@ -186,40 +540,21 @@ static DeletionResult ShellDeleteDirectory(int ItemsCount, bool UpdateDiz, Panel
 
 	if (!DirSymLink && (!Opt_DeleteToRecycleBin || Wipe)) {
 		ShellDeleteMsgState SDMS;
-		ScanTree ScTree(TRUE, TRUE, FALSE);
 		FARString strSelFullName = PanelItemFullName(SrcPanel, strSelName);
 
-		ScTree.SetFindPath(strSelFullName, L"*", 0);
-		FAR_FIND_DATA_EX FindData;
-		FARString strFullName;
-		while (ScTree.GetNextName(&FindData, strFullName)) {
-			if (!SDMS.Update(strFullName, Wipe, ProcessedItems, ItemsCount))
-				return DELETE_CANCEL;
-
-			if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-				if (!ScTree.IsDirSearchDone()
-						&& (FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
-					DR = ShellConfirmDirectoryDeletion(strFullName, Wipe);
-					if (DR == DELETE_SKIP)
-						ScTree.SkipDir();
-				} else {
-					if (FindData.dwFileAttributes & FILE_ATTRIBUTE_READONLY)
-						apiMakeWritable(strFullName);
-
-					DR = ERemoveDirectory(strFullName, Wipe);
-
-					if (DR == DELETE_SUCCESS)
-						TreeList::DelTreeName(strFullName);
-				}
-			} else
-				DR = ShellRemoveFile(strFullName, Wipe, Opt_DeleteToRecycleBin);
-
-			if (DR == DELETE_CANCEL)
-				return DELETE_CANCEL;
-
-			if (DR == DELETE_SUCCESS && UpdateDiz)
-				SrcPanel->DeleteDiz(strFullName);
+		/*
+			описания файлов во вложенных каталогах не хранятся в файле описаний панели,
+			так что UpdateDiz для них неважен
+		*/
+		if (DeleteAllFolders && !Wipe) {
+			DR = ParallelTreeDeleter().Run(strSelFullName, SDMS, ItemsCount);
+		} else {
+			DR = ShellDeleteTreeContents(SDMS, ItemsCount, UpdateDiz, SrcPanel, strSelFullName, Wipe,
+					Opt_DeleteToRecycleBin);
 		}
+
+		if (DR == DELETE_CANCEL)
+			return DELETE_CANCEL;
 	}
 
 	if (FileAttr & FILE_ATTRIBUTE_READONLY)
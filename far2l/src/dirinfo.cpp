@@ -33,6 +33,16 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "headers.hpp"
 
+#include <atomic>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <dirent.h>
+
 #include "dirinfo.hpp"
 #include "plugapi.hpp"
 #include "keys.hpp"
@@ -51,6 +61,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "strmix.hpp"
 #include "wakeful.hpp"
 #include "config.hpp"
+#include "MountInfo.h"
+#include "Threaded.h"
+#include "ScopeHelpers.h"
 
 static void DrawGetDirInfoMsg(const wchar_t *Title, const wchar_t *Name, const UINT64 Size)
 {
@@ -77,63 +90,51 @@ static void PR_DrawGetDirInfoMsg()
 			reinterpret_cast<const UINT64>(preRedrawItem.Param.Param3));
 }
 
-int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount, uint32_t &FileCount,
-		uint64_t &FileSize, uint64_t &PhysicalSize, uint32_t &ClusterSize, clock_t MsgWaitTime,
-		FileFilter *Filter, DWORD Flags)
+struct DirInfoTotals
 {
-	FARString strFullDirName;
-	FARString strFullName, strCurDirName, strLastDirName;
-	ConvertNameToFull(DirName, strFullDirName);
-	SaveScreen SaveScr;
-	UndoGlobalSaveScrPtr UndSaveScr(&SaveScr);
-	TPreRedrawFuncGuard preRedrawFuncGuard(PR_DrawGetDirInfoMsg);
-	wakeful W;
-	ScanTree ScTree(FALSE, TRUE,
-			((Flags & GETDIRINFO_SCANSYMLINKDEF) ? -1 : ((Flags & GETDIRINFO_SCANSYMLINK) != 0)));
-	FAR_FIND_DATA_EX FindData;
-	clock_t StartTime = GetProcessUptimeMSec();
-	SetCursorType(FALSE, 0);
-	/*
-		$ 20.03.2002 DJ
-		для . - покажем имя родительского каталога
-	*/
-	const wchar_t *ShowDirName = DirName;
-
-	if (DirName[0] == L'.' && !DirName[1]) {
-		const wchar_t *p = LastSlash(strFullDirName);
+	uint32_t DirCount{0};
+	uint32_t FileCount{0};
+	uint64_t FileSize{0};
+	uint64_t PhysicalSize{0};
 
-		if (p)
-			ShowDirName = p + 1;
+	void Add(const DirInfoTotals &Other)
+	{
+		DirCount+= Other.DirCount;
+		FileCount+= Other.FileCount;
+		FileSize+= Other.FileSize;
+		PhysicalSize+= Other.PhysicalSize;
 	}
+};
 
+/*
+	Обработка прерывания пользователем и периодическая отрисовка сообщения о сканировании.
+	Вызывается только из основного потока.
+*/
+class DirInfoProgress
+{
+	const wchar_t *Title;
+	const wchar_t *ShowDirName;
+	clock_t MsgWaitTime;
+	clock_t StartTime;
+	DWORD Flags;
+	bool CanBreak;
 	ConsoleTitle OldTitle;
-	RefreshFrameManager frref(ScrX, ScrY, MsgWaitTime, Flags & GETDIRINFO_DONTREDRAWFRAME);
-	// DWORD SectorsPerCluster=0,BytesPerSector=0,FreeClusters=0,Clusters=0;
-
-	// Временные хранилища имён каталогов
-	strLastDirName.Clear();
-	strCurDirName.Clear();
-	DirCount = FileCount = 0;
-	FileSize = PhysicalSize = 0;
-	ClusterSize = 0;
-	ScTree.SetFindPath(DirName, L"*", 0);
-	ScannedINodes scanned_inodes;
-	const bool count_dir_size = !Opt.OnlyFilesSize;
-	const bool use_filter = (Flags & GETDIRINFO_USEFILTER) != 0;
-	const bool scan_symlinks = ScTree.IsSymlinksScanEnabled();
-	const bool can_break = !CtrlObject->Macro.IsExecuting() && !WinPortTesting();
 
-	struct stat s = {0};
-	if (sdc_stat(Wide2MB(DirName).c_str(), &s) == 0) {
-		if (count_dir_size) {	// include size of root dir's node
-			FileSize = s.st_size;
-			PhysicalSize = ((DWORD64)s.st_blocks) * 512;
-		}
-		ClusterSize = s.st_blksize;		// TODO: check if its best thing to be used here
-	}
-
-	while (ScTree.GetNextName(&FindData, strFullName)) {
-		if (can_break) {
+public:
+	DirInfoProgress(const wchar_t *Title_, const wchar_t *ShowDirName_, clock_t MsgWaitTime_, DWORD Flags_)
+		:
+		Title(Title_),
+		ShowDirName(ShowDirName_),
+		MsgWaitTime(MsgWaitTime_),
+		StartTime(GetProcessUptimeMSec()),
+		Flags(Flags_),
+		CanBreak(!CtrlObject->Macro.IsExecuting() && !WinPortTesting())
+	{}
+
+	// returns 1 to continue scan, 0 if user cancelled it, -1 if enhanced break requested
+	int Check(uint64_t FileSize)
+	{
+		if (CanBreak) {
 			INPUT_RECORD rec;
 
 			switch (PeekInputRecord(&rec)) {
@@ -175,21 +176,62 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 			}
 		}
 
+		return 1;
+	}
+};
+
+// ScannedINodes that can be shared by several scanning threads
+class ScannedINodesMT
+{
+	struct Shard
+	{
+		std::mutex Mtx;
+		ScannedINodes INodes;
+	} Shards[0x10];
+
+public:
+	bool Put(uint64_t d, uint64_t ino)
+	{
+		Shard &s = Shards[(ino ^ d) & 0xf];
+		std::lock_guard<std::mutex> lock(s.Mtx);
+		return s.INodes.Put(d, ino);
+	}
+};
+
+static int ScanTreeDirInfo(DirInfoProgress &Progress, const wchar_t *DirName, DirInfoTotals &Totals,
+		ScannedINodesMT &scanned_inodes, FileFilter *Filter, DWORD Flags)
+{
+	FARString strFullName, strCurDirName, strLastDirName;
+	ScanTree ScTree(FALSE, TRUE,
+			((Flags & GETDIRINFO_SCANSYMLINKDEF) ? -1 : ((Flags & GETDIRINFO_SCANSYMLINK) != 0)));
+	FAR_FIND_DATA_EX FindData;
+	ScTree.SetFindPath(DirName, L"*", 0);
+	const bool count_dir_size = !Opt.OnlyFilesSize;
+	const bool use_filter = (Flags & GETDIRINFO_USEFILTER) != 0;
+	const bool scan_symlinks = ScTree.IsSymlinksScanEnabled();
+	struct stat s = {0};
+
+	while (ScTree.GetNextName(&FindData, strFullName)) {
+		const int Checked = Progress.Check(Totals.FileSize);
+		if (Checked != 1) {
+			return Checked;
+		}
+
 		const DWORD file_attributes = FindData.dwFileAttributes;
 		const bool is_directory = (file_attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
 		const bool is_reparse_point = (file_attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
 
 		if (!is_directory || count_dir_size) {
-			PhysicalSize+= FindData.nPhysicalSize;
+			Totals.PhysicalSize+= FindData.nPhysicalSize;
 		}
 
 		if (is_reparse_point) {
 			// include symlink's own size to total size
 			if (count_dir_size && sdc_lstat(strFullName.GetMB().c_str(), &s) == 0) {
-				FileSize+= s.st_size;
+				Totals.FileSize+= s.st_size;
 			}
 
-			FileCount++;
+			Totals.FileCount++;
 			if (!scan_symlinks)
 				continue;
 		}
@@ -204,9 +246,9 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 				в противном случае это будем делать в подсчёте количества файлов
 			*/
 			if (!use_filter) {
-				DirCount++;
+				Totals.DirCount++;
 				if (count_dir_size)
-					FileSize+= FindData.nFileSize;
+					Totals.FileSize+= FindData.nFileSize;
 			} else {
 				/*
 					Если каталог не попадает под фильтр то его надо полностью
@@ -215,7 +257,7 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 				*/
 				if (Filter->FileInFilter(FindData)) {
 					if (count_dir_size)
-						FileSize+= FindData.nFileSize;	// TODO: add size at same condifion as DirCount increment
+						Totals.FileSize+= FindData.nFileSize;	// TODO: add size at same condifion as DirCount increment
 				} else
 					ScTree.SkipDir();
 			}
@@ -239,19 +281,546 @@ int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount,
 				CutToSlash(strCurDirName);	//???
 
 				if (StrCmp(strCurDirName, strLastDirName)) {
-					DirCount++;
+					Totals.DirCount++;
 					strLastDirName = strCurDirName;
 				}
 			}
 
-			FileCount++;
-			FileSize+= FindData.nFileSize;
+			Totals.FileCount++;
+			Totals.FileSize+= FindData.nFileSize;
 		}
 	}
 
 	return 1;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////
+// Parallel scan: directories are read by several threads using fstatat relatively to directory's fd
+// giving exactly same totals as ScanTreeDirInfo without filter. Directories that can't be read due to
+// access rights are scanned afterwards by ScanTreeDirInfo from main thread, so sudo may elevate it.
+
+struct DirInfoEntry
+{
+	enum : uint32_t
+	{
+		DIRECTORY = 0x1,
+		SYMLINK   = 0x2,
+	};
+	uint64_t Device;		// of symlink's target for symlinks
+	uint64_t INode;			// of symlink's target for symlinks
+	uint64_t Size;			// of symlink's target for symlinks, zero for broken symlinks
+	uint64_t PhysicalSize;	// of entry itself
+	uint32_t LinkSize;		// symlink's own size
+	uint32_t Flags;
+};
+
+struct DirInfoSubdir
+{
+	std::string Name;
+	uint64_t Device;
+	uint64_t INode;
+	bool Symlink;
+};
+
+struct DirInfoListing
+{
+	std::vector<DirInfoEntry> Entries;
+	std::vector<DirInfoSubdir> Subdirs;
+};
+
+typedef std::shared_ptr<const DirInfoListing> DirInfoListingPtr;
+
+static inline bool operator ==(const struct timespec &a, const struct timespec &b)
+{
+	return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+/*
+	Кэш содержимого каталогов для повторных подсчётов размеров (Opt.DirInfoCache).
+	Запись кэша действительна пока не изменились mtime и ctime каталога, т.е. пока
+	в нём не создавались, не удалялись и не переименовывались файлы. Изменение размера
+	уже существующих файлов не меняет времена каталога, поэтому кэш по умолчанию выключен.
+	Времена берутся fstat'ом открытого каталога, а не из листинга родителя - тот сам
+	может быть из кэша, и тогда изменения в глубине дерева остались бы незамеченными.
+*/
+class DirInfoCache
+{
+	struct Item
+	{
+		struct timespec MTime;
+		struct timespec CTime;
+		DirInfoListingPtr Listing;
+	};
+
+	std::mutex _mtx;
+	std::map<std::pair<uint64_t, uint64_t>, Item> _items;
+	size_t _entries_count{0};
+
+	enum { ENTRIES_LIMIT = 0x100000 };
+
+public:
+	DirInfoListingPtr Lookup(const struct stat &Dir)
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		auto it = _items.find(std::make_pair((uint64_t)Dir.st_dev, (uint64_t)Dir.st_ino));
+		if (it == _items.end()) {
+			return DirInfoListingPtr();
+		}
+		if (!(it->second.MTime == Dir.st_mtim) || !(it->second.CTime == Dir.st_ctim)) {
+			_entries_count-= it->second.Listing->Entries.size();
+			_items.erase(it);
+			return DirInfoListingPtr();
+		}
+		return it->second.Listing;
+	}
+
+	void Store(const struct stat &Dir, const DirInfoListingPtr &Listing)
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		if (_entries_count + Listing->Entries.size() > ENTRIES_LIMIT) {
+			return;
+		}
+		auto ir = _items.emplace(std::make_pair((uint64_t)Dir.st_dev, (uint64_t)Dir.st_ino),
+			Item{Dir.st_mtim, Dir.st_ctim, Listing});
+		if (!ir.second) {
+			_entries_count-= ir.first->second.Listing->Entries.size();
+			ir.first->second = Item{Dir.st_mtim, Dir.st_ctim, Listing};
+		}
+		_entries_count+= Listing->Entries.size();
+	}
+};
+
+static DirInfoCache s_dir_info_cache;
+
+// Chain of directories being scanned, used to detect recursion via symlinks same way as ScanTree does
+struct DirInfoAncestor
+{
+	std::string RealPath;
+	uint64_t Device;
+	uint64_t INode;
+	std::shared_ptr<const DirInfoAncestor> Parent;
+};
+
+typedef std::shared_ptr<const DirInfoAncestor> DirInfoAncestorPtr;
+
+struct DirInfoJob
+{
+	std::string Path;
+	DirInfoSubdir Dir;
+	DirInfoAncestorPtr Ancestor;
+};
+
+class DirInfoParallelScan
+{
+	class Worker : public Threaded
+	{
+		DirInfoParallelScan &_scan;
+
+		virtual void *ThreadProc()
+		{
+			_scan.WorkerProc();
+			return nullptr;
+		}
+
+	public:
+		Worker(DirInfoParallelScan &scan) : _scan(scan) {}
+		virtual ~Worker() { WaitThread(); }
+		bool Start() { return StartThread(); }
+	};
+
+	ScannedINodesMT &_scanned_inodes;
+	const bool _count_dir_size;
+	const bool _scan_symlinks;
+	const bool _use_cache;
+	time_t _racy_time;
+
+	std::mutex _mtx;
+	std::condition_variable _cond;
+	std::deque<DirInfoJob> _jobs;
+	std::vector<std::string> _denied;
+	DirInfoTotals _totals;
+	size_t _busy{0};
+	std::atomic<bool> _cancel{false};
+	std::list<Worker> _workers;
+
+	DirInfoListingPtr ObtainListing(const DirInfoJob &Job, bool &Denied);
+	void ProcessListing(const DirInfoJob &Job, const DirInfoListing &Listing,
+			DirInfoTotals &Totals, std::vector<DirInfoJob> &NewJobs);
+	void WorkerProc();
+
+public:
+	DirInfoParallelScan(ScannedINodesMT &scanned_inodes, bool count_dir_size, bool scan_symlinks)
+		:
+		_scanned_inodes(scanned_inodes),
+		_count_dir_size(count_dir_size),
+		_scan_symlinks(scan_symlinks),
+		_use_cache(Opt.DirInfoCache != 0),
+		_racy_time(time(nullptr) - 2)
+	{}
+
+	~DirInfoParallelScan()
+	{
+		Abort();
+	}
+
+	bool Start(const std::string &RootPath, const struct stat &RootStat, size_t ThreadsCount);
+
+	// waits for scan completion up to given time, returns true if scan completed
+	bool Wait(unsigned int msec);
+
+	void Abort()
+	{
+		_cancel = true;
+		{
+			std::lock_guard<std::mutex> lock(_mtx);
+			_cond.notify_all();
+		}
+		_workers.clear();
+	}
+
+	uint64_t CurrentFileSize()
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		return _totals.FileSize;
+	}
+
+	// following can be used only after Wait() returned true
+	const DirInfoTotals &Totals() const { return _totals; }
+	const std::vector<std::string> &Denied() const { return _denied; }
+};
+
+static bool IsAccessDenied(int err)
+{
+	return err == EACCES || err == EPERM;
+}
+
+// Reads directory's listing or takes it from cache if directory didn't change since then
+DirInfoListingPtr DirInfoParallelScan::ObtainListing(const DirInfoJob &Job, bool &Denied)
+{
+	Denied = false;
+	FDScope dir_fd(open(Job.Path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+	if (!dir_fd.Valid()) {
+		Denied = IsAccessDenied(errno);
+		return DirInfoListingPtr();
+	}
+
+	// stat'ed before reading, so modification during reading will invalidate stored listing
+	struct stat s_dir{};
+	const bool use_cache = _use_cache && fstat(dir_fd, &s_dir) == 0;
+	if (use_cache) {
+		DirInfoListingPtr Cached = s_dir_info_cache.Lookup(s_dir);
+		if (Cached) {
+			return Cached;
+		}
+	}
+
+	DIR *d = fdopendir(dir_fd);
+	if (!d) {
+		return DirInfoListingPtr();
+	}
+	dir_fd.Detach();
+
+	std::shared_ptr<DirInfoListing> Listing = std::make_shared<DirInfoListing>();
+	struct stat s_lnk{}, s_dst{};
+	for (struct dirent *de; !_cancel && (de = readdir(d)) != nullptr;) {
+		if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2]))) {
+			continue;
+		}
+
+		if (fstatat(dirfd(d), de->d_name, &s_lnk, AT_SYMLINK_NOFOLLOW) == -1) {
+			if (IsAccessDenied(errno)) {
+				Denied = true;
+				break;
+			}
+			continue;	// file disappeared or alike
+		}
+
+		DirInfoEntry e{};
+		e.PhysicalSize = ((uint64_t)s_lnk.st_blocks) * 512;
+		const struct stat *s = &s_lnk;
+		if (S_ISLNK(s_lnk.st_mode)) {
+			e.Flags|= DirInfoEntry::SYMLINK;
+			e.LinkSize = (uint32_t)s_lnk.st_size;
+			if (fstatat(dirfd(d), de->d_name, &s_dst, 0) == 0) {
+				s = &s_dst;
+			} else {
+				s_lnk.st_size = 0;	// broken symlink, like Statocaster does
+			}
+		}
+
+		e.Device = s->st_dev;
+		e.INode = s->st_ino;
+		e.Size = s->st_size;
+		if (S_ISDIR(s->st_mode)) {
+			e.Flags|= DirInfoEntry::DIRECTORY;
+			Listing->Subdirs.emplace_back(DirInfoSubdir{de->d_name, (uint64_t)s->st_dev, (uint64_t)s->st_ino,
+					S_ISLNK(s_lnk.st_mode)});
+		}
+		Listing->Entries.emplace_back(e);
+	}
+	closedir(d);
+
+	if (Denied || _cancel) {
+		return DirInfoListingPtr();
+	}
+
+	// dont cache directories modified just now: their further modifications may keep same mtime
+	if (use_cache && s_dir.st_mtim.tv_sec < _racy_time && s_dir.st_ctim.tv_sec < _racy_time) {
+		s_dir_info_cache.Store(s_dir, Listing);
+	}
+
+	return Listing;
+}
+
+void DirInfoParallelScan::ProcessListing(const DirInfoJob &Job, const DirInfoListing &Listing,
+		DirInfoTotals &Totals, std::vector<DirInfoJob> &NewJobs)
+{
+	for (const auto &e : Listing.Entries) {
+		const bool is_directory = (e.Flags & DirInfoEntry::DIRECTORY) != 0;
+		if (!is_directory || _count_dir_size) {
+			Totals.PhysicalSize+= e.PhysicalSize;
+		}
+
+		if (e.Flags & DirInfoEntry::SYMLINK) {
+			if (_count_dir_size) {
+				Totals.FileSize+= e.LinkSize;
+			}
+			Totals.FileCount++;
+			if (!_scan_symlinks)
+				continue;
+		}
+
+		if (!_scanned_inodes.Put(e.Device, e.INode)) {
+			continue;
+		}
+
+		if (is_directory) {
+			Totals.DirCount++;
+			if (_count_dir_size)
+				Totals.FileSize+= e.Size;
+		} else {
+			Totals.FileCount++;
+			Totals.FileSize+= e.Size;
+		}
+	}
+
+	for (const auto &sd : Listing.Subdirs) {
+		if (sd.Symlink && !_scan_symlinks) {
+			continue;
+		}
+
+		std::string Path = Job.Path;
+		if (Path.empty() || Path.back() != GOOD_SLASH) {
+			Path+= GOOD_SLASH;
+		}
+		Path+= sd.Name;
+
+		std::string RealPath;
+		if (sd.Symlink) {
+			char *rp = realpath(Path.c_str(), nullptr);
+			if (rp) {
+				RealPath = rp;
+				free(rp);
+			} else {
+				RealPath = Path;
+			}
+			// same recursion check as in ScanTree::CheckForEnterSubdir
+			bool Recursion = false;
+			for (auto a = Job.Ancestor; a && !Recursion; a = a->Parent) {
+				Recursion = (a->Device == sd.Device && a->INode == sd.INode)
+					|| (StrStartsFrom(a->RealPath, RealPath.c_str())
+						&& (a->RealPath.size() == RealPath.size() || a->RealPath[RealPath.size()] == GOOD_SLASH
+							|| RealPath.size() == 1));
+			}
+			if (Recursion) {
+				continue;
+			}
+		} else {
+			RealPath = Path;
+		}
+
+		NewJobs.emplace_back(DirInfoJob{std::move(Path), sd,
+			std::make_shared<DirInfoAncestor>(DirInfoAncestor{std::move(RealPath), sd.Device, sd.INode, Job.Ancestor})});
+	}
+}
+
+void DirInfoParallelScan::WorkerProc()
+{
+	std::vector<DirInfoJob> NewJobs;
+	DirInfoTotals Totals;
+	std::string DeniedPath;
+
+	std::unique_lock<std::mutex> lock(_mtx);
+	for (;;) {
+		_totals.Add(Totals);
+		if (!DeniedPath.empty()) {
+			_denied.emplace_back(std::move(DeniedPath));
+			DeniedPath.clear();
+		}
+		for (auto &NewJob : NewJobs) {
+			_jobs.emplace_back(std::move(NewJob));
+		}
+		if (NewJobs.size() > 1) {
+			_cond.notify_all();
+		} else if (!NewJobs.empty()) {
+			_cond.notify_one();
+		}
+		NewJobs.clear();
+
+		while (_jobs.empty() && _busy != 0 && !_cancel) {
+			_cond.wait(lock);
+		}
+		if (_jobs.empty() || _cancel) {
+			_cond.notify_all();	// wakeup other workers and main thread waiting in Wait()
+			break;
+		}
+
+		// depth-first order keeps amount of pending jobs small
+		const DirInfoJob Job = std::move(_jobs.back());
+		_jobs.pop_back();
+		++_busy;
+		lock.unlock();
+
+		Totals = DirInfoTotals();
+		bool Denied;
+		DirInfoListingPtr Listing = ObtainListing(Job, Denied);
+		if (Denied) {
+			DeniedPath = Job.Path;
+		}
+		if (Listing && !_cancel) {
+			ProcessListing(Job, *Listing, Totals, NewJobs);
+		}
+
+		lock.lock();
+		--_busy;
+	}
+}
+
+bool DirInfoParallelScan::Start(const std::string &RootPath, const struct stat &RootStat, size_t ThreadsCount)
+{
+	FARString strRealPath;
+	ConvertNameToReal(FARString(RootPath).CPtr(), strRealPath);
+
+	DirInfoJob RootJob{RootPath,
+		DirInfoSubdir{std::string(), (uint64_t)RootStat.st_dev, (uint64_t)RootStat.st_ino, false},
+		std::make_shared<DirInfoAncestor>(DirInfoAncestor{strRealPath.GetMB(),
+			(uint64_t)RootStat.st_dev, (uint64_t)RootStat.st_ino, DirInfoAncestorPtr()})};
+	_jobs.emplace_back(std::move(RootJob));
+
+	for (size_t i = 0; i < ThreadsCount; ++i) {
+		_workers.emplace_back(*this);
+		if (!_workers.back().Start()) {
+			_workers.pop_back();
+			break;
+		}
+	}
+
+	return !_workers.empty();
+}
+
+bool DirInfoParallelScan::Wait(unsigned int msec)
+{
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		_cond.wait_for(lock, std::chrono::milliseconds(msec),
+			[this] { return _busy == 0 && _jobs.empty(); });
+		if (_busy != 0 || !_jobs.empty()) {
+			return false;
+		}
+	}
+	_workers.clear();
+	return true;
+}
+
+int GetDirInfo(const wchar_t *Title, const wchar_t *DirName, uint32_t &DirCount, uint32_t &FileCount,
+		uint64_t &FileSize, uint64_t &PhysicalSize, uint32_t &ClusterSize, clock_t MsgWaitTime,
+		FileFilter *Filter, DWORD Flags)
+{
+	FARString strFullDirName;
+	ConvertNameToFull(DirName, strFullDirName);
+	SaveScreen SaveScr;
+	UndoGlobalSaveScrPtr UndSaveScr(&SaveScr);
+	TPreRedrawFuncGuard preRedrawFuncGuard(PR_DrawGetDirInfoMsg);
+	wakeful W;
+	SetCursorType(FALSE, 0);
+	/*
+		$ 20.03.2002 DJ
+		для . - покажем имя родительского каталога
+	*/
+	const wchar_t *ShowDirName = DirName;
+
+	if (DirName[0] == L'.' && !DirName[1]) {
+		const wchar_t *p = LastSlash(strFullDirName);
+
+		if (p)
+			ShowDirName = p + 1;
+	}
+
+	DirInfoProgress Progress(Title, ShowDirName, MsgWaitTime, Flags);
+	RefreshFrameManager frref(ScrX, ScrY, MsgWaitTime, Flags & GETDIRINFO_DONTREDRAWFRAME);
+	// DWORD SectorsPerCluster=0,BytesPerSector=0,FreeClusters=0,Clusters=0;
+
+	DirCount = FileCount = 0;
+	FileSize = PhysicalSize = 0;
+	ClusterSize = 0;
+	DirInfoTotals Totals;
+	ScannedINodesMT scanned_inodes;
+	const bool count_dir_size = !Opt.OnlyFilesSize;
+	const bool use_filter = (Flags & GETDIRINFO_USEFILTER) != 0;
+	const bool scan_symlinks = (Flags & GETDIRINFO_SCANSYMLINKDEF)
+		? Opt.ScanJunction != 0 : (Flags & GETDIRINFO_SCANSYMLINK) != 0;
+
+	struct stat s = {0};
+	const bool root_exists = (sdc_stat(Wide2MB(DirName).c_str(), &s) == 0);
+	if (root_exists) {
+		if (count_dir_size) {	// include size of root dir's node
+			Totals.FileSize = s.st_size;
+			Totals.PhysicalSize = ((DWORD64)s.st_blocks) * 512;
+		}
+		ClusterSize = s.st_blksize;		// TODO: check if its best thing to be used here
+	}
+
+	int Result;
+
+	/*
+		Фильтр требует обхода в порядке ScanTree (подсчёт каталогов с подходящими файлами),
+		поэтому параллельно считаем только без него.
+	*/
+	if (!use_filter && root_exists && S_ISDIR(s.st_mode)) {
+		std::string strRootPath = strFullDirName.GetMB();
+		if (strRootPath.size() > 1 && strRootPath.back() == GOOD_SLASH) {
+			strRootPath.pop_back();
+		}
+		DirInfoParallelScan ParallelScan(scanned_inodes, count_dir_size, scan_symlinks);
+		if (ParallelScan.Start(strRootPath, s, MountInfo().MetadataThreadsCount(strRootPath))) {
+			for (Result = 1; Result == 1 && !ParallelScan.Wait(50);) {
+				Result = Progress.Check(Totals.FileSize + ParallelScan.CurrentFileSize());
+			}
+			if (Result == 1) {
+				Totals.Add(ParallelScan.Totals());
+				for (const auto &Path : ParallelScan.Denied()) {
+					Result = ScanTreeDirInfo(Progress, FARString(Path).CPtr(), Totals, scanned_inodes, Filter, Flags);
+					if (Result != 1) {
+						break;
+					}
+				}
+			}
+
+		} else {
+			Result = ScanTreeDirInfo(Progress, DirName, Totals, scanned_inodes, Filter, Flags);
+		}
+
+	} else {
+		Result = ScanTreeDirInfo(Progress, DirName, Totals, scanned_inodes, Filter, Flags);
+	}
+
+	DirCount = Totals.DirCount;
+	FileCount = Totals.FileCount;
+	FileSize = Totals.FileSize;
+	PhysicalSize = Totals.PhysicalSize;
+	return Result;
+}
+
 int GetPluginDirInfo(HANDLE hPlugin, const wchar_t *DirName, uint32_t &DirCount, uint32_t &FileCount,
 		uint64_t &FileSize, uint64_t &PhysicalSize)
 {
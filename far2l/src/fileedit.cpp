@@ -58,6 +58,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "filestr.hpp"
 #include "TPreRedrawFunc.hpp"
 #include "syslog.hpp"
+#include "EditorSaveEncoder.hpp"
 #include "interf.hpp"
 #include "message.hpp"
 #include "config.hpp"
@@ -1640,8 +1641,8 @@ bool FileEditor::ReloadFile(const wchar_t *Name)
 }
 
 // TextFormat и Codepage используются ТОЛЬКО, если bSaveAs = true!
-void FileEditor::SaveContent(const wchar_t *Name, BaseContentWriter *Writer, bool bSaveAs, int TextFormat,
-		UINT codepage, bool AddSignature, int Phase)
+bool FileEditor::SaveContent(const wchar_t *Name, BaseContentWriter *Writer, bool bSaveAs, int TextFormat,
+		UINT codepage, bool AddSignature, int Phase, int Phases, bool Cancellable)
 {
 	DWORD dwSignature = 0;
 	DWORD SignLength = 0;
@@ -1682,18 +1683,21 @@ void FileEditor::SaveContent(const wchar_t *Name, BaseContentWriter *Writer, boo
 
 	DWORD StartTime = WINPORT(GetTickCount)();
 	size_t LineNumber = 0;
+	// строки перекодируются крупными блоками в нескольких потоках,
+	// а здесь готовые блоки по порядку отдаются на запись
+	EditorSaveEncoder Encoder(codepage);
+	std::string Encoded;
 
 	for (Edit *CurPtr = m_editor->TopList; CurPtr; CurPtr = CurPtr->m_next, LineNumber++) {
 		DWORD CurTime = WINPORT(GetTickCount)();
 
 		if (CurTime - StartTime > RedrawTimeout) {
 			StartTime = CurTime;
-			if (Phase == 0)
-				Editor::EditorShowMsg(Msg::EditTitle, Msg::EditSaving, Name,
-						(int)(LineNumber * 50 / m_editor->NumLastLine));
-			else
-				Editor::EditorShowMsg(Msg::EditTitle, Msg::EditSaving, Name,
-						(int)(50 + (LineNumber * 50 / m_editor->NumLastLine)));
+			Editor::EditorShowMsg(Msg::EditTitle, Msg::EditSaving, Name,
+					(int)((Phase * 100 + LineNumber * 100 / m_editor->NumLastLine) / Phases));
+
+			if (Cancellable && CheckForEscSilent() && ConfirmAbortOp())
+				return false;
 		}
 
 		const wchar_t *SaveStr, *EndSeq;
@@ -1710,35 +1714,16 @@ void FileEditor::SaveContent(const wchar_t *Name, BaseContentWriter *Writer, boo
 			CurPtr->SetEOL(EndSeq);
 		}
 
-		Writer->EncodeAndWrite(codepage, SaveStr, Length);
-		Writer->EncodeAndWrite(codepage, EndSeq, StrLength(EndSeq));
+		Encoder.Add(SaveStr, Length);
+		Encoder.Add(EndSeq, StrLength(EndSeq));
+		while (Encoder.Fetch(Encoded, false))
+			Writer->Write(Encoded.data(), Encoded.size());
 	}
-}
-
-void FileEditor::BaseContentWriter::EncodeAndWrite(UINT codepage, const wchar_t *Str, size_t Length)
-{
-	if (!Length)
-		return;
-
-	if (codepage == CP_WIDE_LE) {
-		Write(Str, Length * sizeof(wchar_t));
-	} else if (codepage == CP_UTF8) {
-		Wide2MB(Str, Length, _tmpstr);
-		Write(_tmpstr.data(), _tmpstr.size());
-	} else {
-		int cnt = WINPORT(WideCharToMultiByte)(codepage, 0, Str, Length, nullptr, 0, nullptr, nullptr);
-
-		if (cnt <= 0)
-			return;
 
-		if (_tmpcvec.size() < (size_t)cnt)
-			_tmpcvec.resize(cnt + 0x20);
+	while (Encoder.Fetch(Encoded, true))
+		Writer->Write(Encoded.data(), Encoded.size());
 
-		cnt = WINPORT(WideCharToMultiByte)(codepage, 0, Str, Length, _tmpcvec.data(), _tmpcvec.size(),
-				nullptr, nullptr);
-		if (cnt > 0)
-			Write(_tmpcvec.data(), cnt);
-	}
+	return true;
 }
 
 struct ContentMeasurer : FileEditor::BaseContentWriter
@@ -1771,6 +1756,145 @@ public:
 	}
 };
 
+/*
+	Сохранение во временный файл рядом с исходным с последующим переименованием
+	его поверх исходного: при сбое или отмене исходный файл остаётся нетронутым.
+	Применимо, только если исходный файл можно подменить без потери его свойств,
+	то есть это обычный файл (не симлинк) без жёстких ссылок, принадлежащий нам.
+	Возвращает -1, если способ неприменим или не удался - тогда сохраняем по-старому.
+*/
+int FileEditor::SaveFileViaTemp(const wchar_t *Name, bool bSaveAs, int TextFormat, UINT codepage,
+		bool AddSignature)
+{
+	if (FileUnmakeWritable)
+		return -1;
+
+	const std::string strMBName = Wide2MB(Name);
+	struct stat s{};
+	const bool Exists = (sdc_lstat(strMBName.c_str(), &s) == 0);
+	if (Exists && (!S_ISREG(s.st_mode) || s.st_nlink != 1 || s.st_uid != geteuid()))
+		return -1;
+
+	if (!Exists && errno != ENOENT)
+		return -1;
+
+	FARString strTempName;
+	strTempName.Format(L"%ls.%x.far2l-save", Name, (unsigned int)getpid());
+	const std::string strMBTempName = strTempName.GetMB();
+
+	const DWORD UnixMode = s.st_mode & 07777;
+	File TempFile;
+	if (!TempFile.Open(strTempName, GENERIC_WRITE, FILE_SHARE_READ, Exists ? &UnixMode : nullptr, CREATE_NEW,
+				FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN)) {
+		return -1;
+	}
+
+	int Result = -1;
+	try {
+		struct stat ts{};
+		if (sdc_fstat(TempFile.Descriptor(), &ts) != 0)
+			throw WINPORT(GetLastError)();
+
+		if (Exists) {
+			// временный файл мог создаться через sudo или унаследовать группу каталога
+			if (ts.st_uid != s.st_uid)
+				throw (DWORD)EPERM;
+
+			if (ts.st_gid != s.st_gid && sdc_chown(strMBTempName.c_str(), (uid_t)-1, s.st_gid) != 0)
+				throw (DWORD)errno;
+
+			File OrigFile;
+			FileExtendedAttributes xattr;
+			if (OrigFile.Open(Name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING)
+					&& OrigFile.QueryFileExtendedAttributes(xattr) != FB_NO && !xattr.empty()
+					&& TempFile.SetFileExtendedAttributes(xattr) != FB_YES) {
+				throw (DWORD)ENOTSUP;
+			}
+
+			// режим мог урезаться umask'ом при создании
+			if (ts.st_mode != s.st_mode && !TempFile.Chmod(UnixMode))
+				throw WINPORT(GetLastError)();
+		}
+
+		ContentSaver cs(TempFile);
+		if (!SaveContent(Name, &cs, bSaveAs, TextFormat, codepage, AddSignature, 0, 1, true)) {
+			Result = SAVEFILE_CANCEL;
+			throw (DWORD)ECANCELED;
+		}
+		cs.Flush();
+
+		// данные должны оказаться на диске раньше, чем переименование
+		if (fdatasync(TempFile.Descriptor()) != 0)
+			throw (DWORD)errno;
+
+		TempFile.Close();
+		if (sdc_rename(strMBTempName.c_str(), strMBName.c_str()) != 0)
+			throw (DWORD)errno;
+
+		Result = SAVEFILE_SUCCESS;
+
+	} catch (DWORD ErrorCode) {
+		if (Result != SAVEFILE_CANCEL) {
+			fprintf(stderr, "FileEditor::SaveFileViaTemp: error %u for '%ls'\n", ErrorCode, Name);
+		}
+		TempFile.Close();
+		sdc_unlink(strMBTempName.c_str());
+
+	} catch (...) {
+		TempFile.Close();
+		sdc_unlink(strMBTempName.c_str());
+		throw;
+	}
+
+	return Result;
+}
+
+int FileEditor::SaveFileInPlace(const wchar_t *Name, bool bSaveAs, int TextFormat, UINT codepage,
+		bool AddSignature)
+{
+	ContentMeasurer cm;
+	if (!SaveContent(Name, &cm, bSaveAs, TextFormat, codepage, AddSignature, 0, 2, true))
+		return SAVEFILE_CANCEL;
+
+	try {
+		File EditFile;
+		bool EditFileOpened = EditFile.Open(Name, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+				OPEN_ALWAYS, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN);
+		if (!EditFileOpened
+				&& (WINPORT(GetLastError)() == ERROR_NOT_SUPPORTED
+						|| WINPORT(GetLastError)() == ERROR_CALL_NOT_IMPLEMENTED)) {
+			EditFileOpened = EditFile.Open(Name, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+					CREATE_ALWAYS, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN);
+			if (EditFileOpened) {
+				fprintf(stderr, "FileEditor::SaveFile: CREATE_ALWAYS for '%ls'\n", Name);
+			}
+		}
+		if (!EditFileOpened) {
+			throw WINPORT(GetLastError)();
+		}
+
+		if (!Flags.Check(FFILEEDIT_NEW)) {
+			if (!EditFile.AllocationRequire(cm.MeasuredSize))
+				throw WINPORT(GetLastError)();
+		}
+
+		// файл перезаписывается на месте, так что прерывать запись уже нельзя
+		ContentSaver cs(EditFile);
+		SaveContent(Name, &cs, bSaveAs, TextFormat, codepage, AddSignature, 1, 2, false);
+		cs.Flush();
+
+		EditFile.SetEnd();
+
+	} catch (...) {
+		if (Flags.Check(FFILEEDIT_NEW))
+			apiDeleteFile(Name);
+
+		throw;
+	}
+
+	return SAVEFILE_SUCCESS;
+}
+
 int FileEditor::SaveFile(const wchar_t *Name, int Ask, bool bSaveAs, int TextFormat, UINT codepage,
 		bool AddSignature)
 {
@@ -1986,44 +2110,13 @@ int FileEditor::SaveFile(const wchar_t *Name, int Ask, bool bSaveAs, int TextFor
 		SetCursorType(FALSE, 0);
 		TPreRedrawFuncGuard preRedrawFuncGuard(Editor::PR_EditorShowMsg);
 
-		try {
-			ContentMeasurer cm;
-			SaveContent(Name, &cm, bSaveAs, TextFormat, codepage, AddSignature, 0);
-
-			try {
-				File EditFile;
-				bool EditFileOpened = EditFile.Open(Name, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
-						OPEN_ALWAYS, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN);
-				if (!EditFileOpened
-						&& (WINPORT(GetLastError)() == ERROR_NOT_SUPPORTED
-								|| WINPORT(GetLastError)() == ERROR_CALL_NOT_IMPLEMENTED)) {
-					EditFileOpened = EditFile.Open(Name, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
-							CREATE_ALWAYS, FILE_ATTRIBUTE_ARCHIVE | FILE_FLAG_SEQUENTIAL_SCAN);
-					if (EditFileOpened) {
-						fprintf(stderr, "FileEditor::SaveFile: CREATE_ALWAYS for '%ls'\n", Name);
-					}
-				}
-				if (!EditFileOpened) {
-					throw WINPORT(GetLastError)();
-				}
+		auto *UndoSavePos = m_editor->UndoSavePos;
+		const bool UndoSavePosLost = m_editor->Flags.Check(FEDITOR_UNDOSAVEPOSLOST);
 
-				if (!Flags.Check(FFILEEDIT_NEW)) {
-					if (!EditFile.AllocationRequire(cm.MeasuredSize))
-						throw WINPORT(GetLastError)();
-				}
-
-				ContentSaver cs(EditFile);
-				SaveContent(Name, &cs, bSaveAs, TextFormat, codepage, AddSignature, 1);
-				cs.Flush();
-
-				EditFile.SetEnd();
-
-			} catch (...) {
-				if (Flags.Check(FFILEEDIT_NEW))
-					apiDeleteFile(Name);
-
-				throw;
-			}
+		try {
+			RetCode = SaveFileViaTemp(Name, bSaveAs, TextFormat, codepage, AddSignature);
+			if (RetCode == -1)
+				RetCode = SaveFileInPlace(Name, bSaveAs, TextFormat, codepage, AddSignature);
 		} catch (DWORD ErrorCode) {
 			SysErrorCode = ErrorCode;
 			RetCode = SAVEFILE_ERROR;
@@ -2032,6 +2125,12 @@ int FileEditor::SaveFile(const wchar_t *Name, int Ask, bool bSaveAs, int TextFor
 			SysErrorCode = ENOMEM;
 			RetCode = SAVEFILE_ERROR;
 		}
+
+		if (RetCode == SAVEFILE_CANCEL) {
+			m_editor->UndoSavePos = UndoSavePos;
+			if (UndoSavePosLost)
+				m_editor->Flags.Set(FEDITOR_UNDOSAVEPOSLOST);
+		}
 	}
 
 	if (FHP && RetCode != SAVEFILE_ERROR)
@@ -83,12 +83,7 @@ class FileEditor : public Frame
 public:
 	struct BaseContentWriter
 	{
-		void EncodeAndWrite(UINT codepage, const wchar_t *Str, size_t Length);
 		virtual void Write(const void *Data, size_t Length) = 0;
-
-	private:
-		std::string _tmpstr;
-		std::vector<char> _tmpcvec;
 	};
 
 	FileEditor(FileHolderPtr NewFileHolder, UINT codepage, DWORD InitFlags, int StartLine = -1, int StartChar = -1,
@@ -186,8 +181,11 @@ private:
 	int LoadFile(const wchar_t *Name, int &UserBreak);
 	bool ReloadFile(const wchar_t *Name);
 	// TextFormat, Codepage и AddSignature используются ТОЛЬКО, если bSaveAs = true!
-	void SaveContent(const wchar_t *Name, BaseContentWriter *Writer, bool bSaveAs, int TextFormat,
-			UINT codepage, bool AddSignature, int Phase);
+	// Возвращает false, если пользователь прервал сохранение (возможно только при Cancellable)
+	bool SaveContent(const wchar_t *Name, BaseContentWriter *Writer, bool bSaveAs, int TextFormat,
+			UINT codepage, bool AddSignature, int Phase, int Phases, bool Cancellable);
+	int SaveFileViaTemp(const wchar_t *Name, bool bSaveAs, int TextFormat, UINT codepage, bool AddSignature);
+	int SaveFileInPlace(const wchar_t *Name, bool bSaveAs, int TextFormat, UINT codepage, bool AddSignature);
 	int SaveFile(const wchar_t *Name, int Ask, bool bSaveAs, int TextFormat = 0, UINT Codepage = CP_UTF8,
 			bool AddSignature = false);
 	void SetTitle(const wchar_t *Title);
@@ -173,6 +173,14 @@ public:
 	bool FileInFilter(const FAR_FIND_DATA_EX &fde, uint64_t CurrentTime) const;
 	bool FileInFilter(const FAR_FIND_DATA &fd, uint64_t CurrentTime) const;
 
+	// Добавляет литеральные маски фильтра в общий индекс под номером Id.
+	// Возвращает true, если файл может попасть под фильтр только при
+	// срабатывании индекса для Id.
+	bool ExportMaskToIndex(FileMasksIndex &Index, size_t Id) const
+	{
+		return FMask.Used && FMask.FilterMask.ExportToIndex(Index, FMask.IgnoreCase, Id);
+	}
+
 	void RefreshMask() { if(FMask.Used) FMask.FilterMask.Set(FMask.strMask, FMF_SILENT); }
 };
 
@@ -48,4 +48,8 @@ class CFileMask : private NonCopyable
 	public:
 		bool Set(const wchar_t *Masks, DWORD Flags);
 		bool Compare(const wchar_t *Name, bool ignorecase, bool SkipPath=true) const;
+		bool ExportToIndex(FileMasksIndex &Index, bool ignorecase, size_t Id) const
+		{
+			return FileMask.ExportToIndex(Index, ignorecase, Id);
+		}
 };
@@ -0,0 +1,77 @@
+/*
+FileMasksIndex.cpp
+
+Hash index of literal file masks: '*.ext', 'name', 'prefix*' and '*suffix'.
+*/
+
+#include "headers.hpp"
+
+#include "FileMasksIndex.hpp"
+
+static bool IsLiteral(const wchar_t *s, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		if (s[i] == L'*' || s[i] == L'?' || s[i] == L'[') {
+			return false;
+		}
+	}
+	return true;
+}
+
+void FileMasksIndex::FoldCase(std::wstring &s)
+{
+	for (auto &c : s) {
+		c = Upper(c);
+	}
+}
+
+bool FileMasksIndex::Add(const wchar_t *Mask, bool IgnoreCase, size_t Id)
+{
+	const size_t len = wcslen(Mask);
+	if (!len) {
+		return false;
+	}
+
+	const bool lead_asterisk = (Mask[0] == L'*');
+	const bool trail_asterisk = (len > 1 && Mask[len - 1] == L'*');
+	if (lead_asterisk && trail_asterisk) {
+		return false;
+	}
+
+	std::wstring literal(Mask + (lead_asterisk ? 1 : 0), len - ((lead_asterisk || trail_asterisk) ? 1 : 0));
+	if (literal.empty() || !IsLiteral(literal.c_str(), literal.size())) {
+		return false;
+	}
+
+	Table &table = IgnoreCase ? _folded : _exact;
+	if (IgnoreCase) {
+		FoldCase(literal);
+	}
+
+	if (!lead_asterisk && !trail_asterisk) {
+		table.names[literal].emplace_back(Id);
+
+	} else if (lead_asterisk && literal.size() > 1 && literal[0] == L'.'
+			&& literal.find(L'.', 1) == std::wstring::npos) {
+		// '*.ext' matches exactly names which last extension is 'ext'
+		table.exts[literal.substr(1)].emplace_back(Id);
+
+	} else if (lead_asterisk) {
+		const wchar_t key = literal.back();
+		table.suffixes[key].emplace_back(std::move(literal), Id);
+
+	} else {
+		const wchar_t key = literal.front();
+		table.prefixes[key].emplace_back(std::move(literal), Id);
+	}
+
+	++_count;
+	return true;
+}
+
+void FileMasksIndex::Reset()
+{
+	_exact = Table();
+	_folded = Table();
+	_count = 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+FileMasksIndex.hpp
+
+Hash index of literal file masks: '*.ext', 'name', 'prefix*' and '*suffix'.
+Such masks are not compared one by one but looked up by file extension,
+whole name or boundary character, so cost of matching a name doesn't grow
+with amount of masks. Each indexed mask carries an id that is reported
+to lookup's visitor, that allows to merge masks of many filters into single
+index and find out which of filters may match given name.
+*/
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cwchar>
+
+class FileMasksIndex
+{
+	struct Table
+	{
+		std::unordered_map<std::wstring, std::vector<size_t>> exts, names;
+		std::unordered_map<wchar_t, std::vector<std::pair<std::wstring, size_t>>> prefixes, suffixes;
+	};
+
+	Table _exact, _folded;
+	size_t _count{0};
+
+	static void FoldCase(std::wstring &s);
+
+	template <class VisitorT>
+		static bool LookupBuckets(const std::unordered_map<wchar_t, std::vector<std::pair<std::wstring, size_t>>> &buckets,
+			const std::wstring &name, bool suffix, VisitorT &visitor)
+	{
+		const auto &it = buckets.find(suffix ? name.back() : name.front());
+		if (it != buckets.end()) {
+			for (const auto &literal : it->second) {
+				if (literal.first.size() <= name.size()
+						&& wmemcmp(literal.first.c_str(),
+							name.c_str() + (suffix ? name.size() - literal.first.size() : 0),
+							literal.first.size()) == 0
+						&& visitor(literal.second)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	template <class VisitorT>
+		static bool LookupIds(const std::unordered_map<std::wstring, std::vector<size_t>> &keys,
+			const std::wstring &key, VisitorT &visitor)
+	{
+		const auto &it = keys.find(key);
+		if (it != keys.end()) {
+			for (const auto id : it->second) {
+				if (visitor(id)) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+public:
+	/// Returns false if Mask contains wildcards that can't be indexed, such
+	/// masks has to be compared with CmpName by caller as before.
+	bool Add(const wchar_t *Mask, bool IgnoreCase, size_t Id);
+
+	void Reset();
+	bool Empty() const { return _count == 0; }
+
+	/// Invokes visitor(Id) for each indexed mask that matches Name until visitor returns true.
+	/// Name must not contain path. Only masks added with same IgnoreCase are considered.
+	/// Returns true if visitor returned true.
+	template <class VisitorT>
+		bool Lookup(const wchar_t *Name, bool IgnoreCase, VisitorT visitor) const
+	{
+		if (!_count || !*Name) {
+			return false;
+		}
+
+		const Table &table = IgnoreCase ? _folded : _exact;
+		std::wstring name(Name);
+		if (IgnoreCase) {
+			FoldCase(name);
+		}
+
+		if (LookupIds(table.names, name, visitor)) {
+			return true;
+		}
+
+		if (!table.exts.empty()) {
+			const size_t dot = name.rfind(L'.');
+			if (dot != std::wstring::npos && dot + 1 < name.size()
+					&& LookupIds(table.exts, name.substr(dot + 1), visitor)) {
+				return true;
+			}
+		}
+
+		return LookupBuckets(table.prefixes, name, false, visitor)
+			|| LookupBuckets(table.suffixes, name, true, visitor);
+	}
+};
@@ -138,6 +138,9 @@ void FileMasksProcessor::Reset()
 
 	IncludeMasks.clear();
 	ExcludeMasks.clear();
+	IncludeLiterals.clear();
+	IncludeIndex.Reset();
+	ExcludeIndex.Reset();
 }
 
 /*
@@ -181,10 +184,11 @@ bool FileMasksProcessor::Set(const wchar_t *masks, DWORD Flags)
 		}
 
 		if (rc)
-			rc = SetPart(*pInclude ? pInclude : L"*", Flags & FMF_ADDASTERISK, IncludeMasks);
+			rc = SetPart(*pInclude ? pInclude : L"*", Flags & FMF_ADDASTERISK,
+				IncludeMasks, IncludeIndex, &IncludeLiterals);
 
 		if (rc && pExclude)
-			rc = SetPart(pExclude, 0, ExcludeMasks);
+			rc = SetPart(pExclude, 0, ExcludeMasks, ExcludeIndex, nullptr);
 
 		free(MasksStr);
 	}
@@ -200,7 +204,8 @@ bool FileMasksProcessor::Set(const wchar_t *masks, DWORD Flags)
  Принимает список масок, разделенных запятой или точкой с запятой.
  Возвращает FALSE при неудаче (например, длина одной из масок равна 0).
 */
-bool FileMasksProcessor::SetPart(const wchar_t *masks, DWORD Flags, std::vector<BaseFileMask*> &Target)
+bool FileMasksProcessor::SetPart(const wchar_t *masks, DWORD Flags, std::vector<BaseFileMask*> &Target,
+		FileMasksIndex &TargetIndex, std::vector<FARString> *TargetLiterals)
 {
 	DWORD flags = ULF_PACKASTERISKS | ULF_PROCESSBRACKETS | ULF_PROCESSREGEXP;
 
@@ -236,6 +241,14 @@ bool FileMasksProcessor::SetPart(const wchar_t *masks, DWORD Flags, std::vector<
 				}
 			}
 
+			if (!baseMask && *onemask != L'/'
+				&& TargetIndex.Add(onemask, false, 0) && TargetIndex.Add(onemask, true, 0))
+			{
+				if (TargetLiterals)
+					TargetLiterals->emplace_back(onemask);
+				continue;
+			}
+
 			if (!baseMask)
 			{
 				if (*onemask == L'/')
@@ -266,16 +279,43 @@ bool FileMasksProcessor::SetPart(const wchar_t *masks, DWORD Flags, std::vector<
    Путь к файлу в FileName НЕ игнорируется */
 bool FileMasksProcessor::Compare(const wchar_t *FileName, bool ignorecase) const
 {
+	const auto AnyMatch = [](size_t) { return true; };
+
+	bool Included = IncludeIndex.Lookup(FileName, ignorecase, AnyMatch);
+	for (auto I = IncludeMasks.begin(); !Included && I != IncludeMasks.end(); ++I)
+	{
+		Included = (*I)->Compare(FileName, ignorecase);
+	}
+
+	if (!Included)
+		return false;
+
+	if (ExcludeIndex.Lookup(FileName, ignorecase, AnyMatch))
+		return false;
+
+	for (auto J: ExcludeMasks)
+	{
+		if (J->Compare(FileName, ignorecase))	return false;
+	}
+	return true;
+}
+
+/* Позволяет объединить литеральные маски нескольких фильтров в общий индекс.
+   Маски исключения не экспортируются: они могут лишь отклонить имя,
+   поэтому индекс остаётся верным надмножеством. */
+bool FileMasksProcessor::ExportToIndex(FileMasksIndex &Index, bool ignorecase, size_t Id) const
+{
+	for (const auto &Literal: IncludeLiterals)
+	{
+		Index.Add(Literal.CPtr(), ignorecase, Id);
+	}
+
+	bool Complete = true;
 	for (auto I: IncludeMasks)
 	{
-		if (I->Compare(FileName, ignorecase))
-		{
-			for (auto J: ExcludeMasks)
-			{
-				if (J->Compare(FileName, ignorecase))	return false;
-			}
-			return true;
-		}
+		if (!I->ExportToIndex(Index, ignorecase, Id))
+			Complete = false;
 	}
-	return false;
+
+	return Complete;
 }
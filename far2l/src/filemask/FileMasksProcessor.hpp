@@ -38,6 +38,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "noncopyable.hpp"
 #include "RegExp.hpp"
 #include "FARString.hpp"
+#include "FileMasksIndex.hpp"
 
 #define EXCLUDEMASKSEPARATOR (L'|')
 
@@ -57,6 +58,10 @@ class BaseFileMask : private NonCopyable
 		virtual bool Set(const wchar_t *Masks, DWORD Flags) = 0;
 		virtual bool Compare(const wchar_t *Name, bool ignorecase) const = 0;
 		virtual void Reset() = 0;
+
+		// Adds masks that may match into Index under given Id. Returns true only if
+		// all such masks were added, i.e. name can't match if Index doesn't report Id.
+		virtual bool ExportToIndex(FileMasksIndex &Index, bool ignorecase, size_t Id) const { return false; }
 };
 
 class SingleFileMask : public BaseFileMask
@@ -99,14 +104,20 @@ class FileMasksProcessor : public BaseFileMask
 		bool Set(const wchar_t *Masks, DWORD Flags) override;
 		bool Compare(const wchar_t *Name, bool ignorecase) const override;
 		void Reset() override;
+		bool ExportToIndex(FileMasksIndex &Index, bool ignorecase, size_t Id) const override;
 
 	private:
 		std::vector<BaseFileMask*> IncludeMasks;
 		std::vector<BaseFileMask*> ExcludeMasks;
+		// literal masks are not kept in vectors above but indexed
+		std::vector<FARString> IncludeLiterals;
+		FileMasksIndex IncludeIndex;
+		FileMasksIndex ExcludeIndex;
 		const int CallDepth;
 
 	private:
 		FileMasksProcessor(int aCallDepth);
-		bool SetPart(const wchar_t *Masks, DWORD Flags, std::vector<BaseFileMask*>& Target);
+		bool SetPart(const wchar_t *Masks, DWORD Flags, std::vector<BaseFileMask*>& Target,
+			FileMasksIndex &TargetIndex, std::vector<FARString> *TargetLiterals);
 };
 
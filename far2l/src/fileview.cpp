@@ -563,6 +563,16 @@ void FileViewer::ShowStatus()
 	if (NameLength < 20)
 		NameLength = 20;
 
+	const int64_t line = View.GetCurrentLine();
+	FARString str_line;
+	if (line > 0) {
+		str_line.Format(L"%ls %lld ", Msg::ViewerStatusLine.CPtr(), (long long)line);
+	}
+	if (View.FollowMode) {
+		str_line.Insert(0, FARString(Msg::ViewerStatusFollow) + L" ");
+	}
+	NameLength = std::max(20, NameLength - (int)str_line.GetLength());
+
 	TruncPathStr(strName, NameLength);
 	const int percent = View.LastPage ? 100 : ToPercent64(View.FilePos, View.FileSize);
 	FARString str_codepage;
@@ -574,6 +584,7 @@ void FileViewer::ShowStatus()
 			<< L' '
 			<< fmt::Expand(13) << View.FileSize
 			<< L' '
+			<< str_line
 			<< fmt::Size(7) << Msg::ViewerStatusCol
 			<< L' '
 			<< fmt::LeftAlign() << fmt::Expand(4) << View.LeftPos
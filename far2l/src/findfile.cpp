@@ -1099,8 +1099,8 @@ struct ScanFileWorkItem : IThreadedWorkItem
 			AddMenuRecord(_hDlg, _FileToReport, _FindData, _ArcIndex);
 	}
 
-	// invoked within worker thread, so make sure no FARString copied within this function
-	// as it has not thread-safe (but fast!) reference counters implementation
+	// invoked within worker thread, FARString copies are fine here but FARString
+	// members must not be modified as they're accessed by main thread too
 	virtual void FN_NOINLINE WorkProc()
 	{
 		SudoClientRegion scr;
@@ -57,6 +57,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <unordered_set>
 #include "color.hpp"
 #include "MaskGroups.hpp"
+#include "pathmix.hpp"
 
 struct HighlightStrings
 {
@@ -176,6 +177,17 @@ HighlightFiles::HighlightFiles()
 	UpdateCurrentTime();
 }
 
+void HighlightFiles::RebuildMasksIndex()
+{
+	HiMasksIndex.Reset();
+	HiAlwaysCheck.assign(HiData.getCount(), true);
+
+	for (size_t i = 0; i < HiData.getCount(); i++) {
+		if (HiData.getItem(i)->ExportMaskToIndex(HiMasksIndex, i))
+			HiAlwaysCheck[i] = false;
+	}
+}
+
 static void LoadFilter(FileFilterParams *HData, ConfigReader &cfg_reader, const wchar_t *Mask, int SortGroup,
 		bool bSortGroup)
 {
@@ -341,6 +353,8 @@ void HighlightFiles::InitHighlightFiles()
 				break;
 		}
 	}
+
+	RebuildMasksIndex();
 }
 
 HighlightFiles::~HighlightFiles()
@@ -352,6 +366,7 @@ void HighlightFiles::ClearData()
 {
 	HiData.Free();
 	FirstCount = UpperCount = LowerCount = LastCount = 0;
+	RebuildMasksIndex();
 }
 
 static const DWORD FarColor[] = {COL_PANELTEXT, COL_PANELSELECTEDTEXT, COL_PANELCURSOR,
@@ -477,6 +492,8 @@ class HighlightFilesChunk : protected Threaded
 {
 	uint64_t _CurrentTime;
 	const TPointerArray<FileFilterParams> &_HiData;
+	const FileMasksIndex &_HiMasksIndex;
+	const std::vector<bool> &_HiAlwaysCheck;
 	FileListItem **_FileItem;
 	size_t _FileCount, _MarkLM;
 	bool _UseAttrHighlighting;
@@ -488,10 +505,13 @@ class HighlightFilesChunk : protected Threaded
 
 public:
 	HighlightFilesChunk(uint64_t CurrentTime, const TPointerArray<FileFilterParams> &HiData,
+			const FileMasksIndex &HiMasksIndex, const std::vector<bool> &HiAlwaysCheck,
 			FileListItem **FileItem, size_t FileCount, bool UseAttrHighlighting)
 		:
 		_CurrentTime(CurrentTime),
 		_HiData(HiData),
+		_HiMasksIndex(HiMasksIndex),
+		_HiAlwaysCheck(HiAlwaysCheck),
 		_FileItem(FileItem),
 		_FileCount(FileCount),
 		_MarkLM(0),
@@ -502,6 +522,9 @@ public:
 
 	void *DoNow()
 	{
+		const bool UseIndex = (_HiAlwaysCheck.size() == _HiData.getCount());
+		std::vector<bool> Candidates;
+
 		for (size_t FCnt = 0; FCnt < _FileCount; ++FCnt) {
 		    if (!_FileItem[FCnt])   // проверка на null
 		        continue;
@@ -510,7 +533,22 @@ public:
 		    HighlightDataColor Colors = DefaultStartingColors;
 		    ApplyStartColors(&Colors);
 
+		    // группы, чьи маски заведомо не подходят к имени, даже не проверяем
+		    if (UseIndex) {
+		        Candidates = _HiAlwaysCheck;
+		        const wchar_t *Name = PointToName(fli.strName.CPtr());
+		        const auto MarkCandidate = [&](size_t Id) {
+		            Candidates[Id] = true;
+		            return false;
+		        };
+		        _HiMasksIndex.Lookup(Name, false, MarkCandidate);
+		        _HiMasksIndex.Lookup(Name, true, MarkCandidate);
+		    }
+
 		    for (size_t i = 0; i < _HiData.getCount(); i++) {
+		        if (UseIndex && !Candidates[i])
+		            continue;
+
 		        const FileFilterParams *CurHiData = _HiData.getConstItem(i);
 		        if (!CurHiData)      // проверка на null
 		            continue;
@@ -567,7 +605,8 @@ void HighlightFiles::GetHiColor(FileListItem **FileItem, size_t FileCount, bool
 		size_t FilePerCPU = std::max(FileCount / BestThreadsNum, (size_t)0x400u);
 
 		while (FileCount > FilePerCPU && async_hfc.size() + 1 < BestThreadsNum) {
-			async_hfc.emplace_back(CurrentTime, HiData, FileItem, FilePerCPU, UseAttrHighlighting);
+			async_hfc.emplace_back(CurrentTime, HiData, HiMasksIndex, HiAlwaysCheck,
+					FileItem, FilePerCPU, UseAttrHighlighting);
 			if (!async_hfc.back().DoAsync()) {
 				async_hfc.pop_back();
 				break;
@@ -577,7 +616,8 @@ void HighlightFiles::GetHiColor(FileListItem **FileItem, size_t FileCount, bool
 		}
 	}
 
-	MarkLM = (size_t)HighlightFilesChunk(CurrentTime, HiData, FileItem, FileCount, UseAttrHighlighting).DoNow();
+	MarkLM = (size_t)HighlightFilesChunk(CurrentTime, HiData, HiMasksIndex, HiAlwaysCheck,
+			FileItem, FileCount, UseAttrHighlighting).DoNow();
 
 	while(!async_hfc.empty( )) {
 		size_t len = (size_t)async_hfc.back().GetResult();
@@ -659,6 +699,8 @@ void HighlightFiles::FillMenu(VMenu *HiMenu, int MenuPos)
 
 void HighlightFiles::ProcessGroups()
 {
+	RebuildMasksIndex();
+
 	for (int i = 0; i < FirstCount; i++)
 		HiData.getItem(i)->SetSortGroup(DEFAULT_SORT_GROUP);
 
@@ -1130,6 +1172,7 @@ void HighlightFiles::UpdateHighlighting(bool RefreshMasks)
 		for (size_t i = 0; i < HiData.getCount(); i++) {
 			HiData.getItem(i)->RefreshMask();
 		}
+		RebuildMasksIndex();
 	}
 
 	CtrlObject->Cp()->LeftPanel->Update(UPDATE_KEEP_SELECTION);
@@ -78,9 +78,14 @@ private:
 	int FirstCount, UpperCount, LowerCount, LastCount;
 	uint64_t CurrentTime;
 
+	// литеральные маски всех групп, чтобы не сравнивать каждый файл с каждой группой
+	FileMasksIndex HiMasksIndex;
+	std::vector<bool> HiAlwaysCheck;
+
 private:
 	void InitHighlightFiles();
 	void ClearData();
+	void RebuildMasksIndex();
 
 	int MenuPosToRealPos(int MenuPos, int **Count, bool Insert = false);
 	void FillMenu(VMenu *HiMenu, int MenuPos);
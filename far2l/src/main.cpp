@@ -362,6 +362,16 @@ static int MainProcess(FARString strEditViewArg, FARString strDestName1, FARStri
 		ScrBuf.ResetShadow();
 		ScrBuf.Flush();
 		MoveRealCursor(0, 0);
+
+		ScreenBufFlushStats FlushStats;
+		ScrBuf.GetFlushStats(FlushStats);
+		fprintf(stderr,
+				"ScreenBuf: %llu flushes, %llu writes, %llu rows compared, %llu regions, %llu cells,"
+				" compare %llu usec, write %llu usec\n",
+				(unsigned long long)FlushStats.Flushes, (unsigned long long)FlushStats.Writes,
+				(unsigned long long)FlushStats.RowsCompared, (unsigned long long)FlushStats.Regions,
+				(unsigned long long)FlushStats.Cells, (unsigned long long)FlushStats.CompareUSec,
+				(unsigned long long)FlushStats.WriteUSec);
 	}
 	CloseConsole();
 	return 0;
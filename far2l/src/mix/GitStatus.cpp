@@ -0,0 +1,1023 @@
+#include "headers.hpp"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include <algorithm>
+#include <FSNotify.h>
+#include <Threaded.h>
+#include "GitStatus.hpp"
+
+static const size_t GitStatusDirsLimit = 16;
+static const size_t GitStatusReposLimit = 4;
+static const size_t GitListingsNamesLimit = 0x100000;
+
+// index entry flags
+#define GIE_ASSUME_VALID   0x8000
+#define GIE_EXTENDED       0x4000
+#define GIE_STAGE_MASK     0x3000
+// index entry extended flags
+#define GIE_SKIP_WORKTREE  0x4000
+#define GIE_INTENT_TO_ADD  0x2000
+
+////////////////////////////////////////////////////////////
+// SHA-1 is needed only to compare content of files which stat doesn't match index entry
+
+class GitSHA1
+{
+	uint32_t _h[5]{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	unsigned char _buf[64];
+	size_t _buf_len{0};
+	uint64_t _total{0};
+
+	static inline uint32_t Rol(uint32_t v, unsigned int n) { return (v << n) | (v >> (32 - n)); }
+	void Block(const unsigned char *p);
+
+public:
+	void Update(const void *data, size_t len);
+	void Final(unsigned char *out);
+};
+
+void GitSHA1::Block(const unsigned char *p)
+{
+	uint32_t w[80];
+	for (int i = 0; i < 16; ++i) {
+		w[i] = (uint32_t(p[i * 4]) << 24) | (uint32_t(p[i * 4 + 1]) << 16) | (uint32_t(p[i * 4 + 2]) << 8) | p[i * 4 + 3];
+	}
+	for (int i = 16; i < 80; ++i) {
+		w[i] = Rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+
+	uint32_t a = _h[0], b = _h[1], c = _h[2], d = _h[3], e = _h[4];
+	for (int i = 0; i < 80; ++i) {
+		uint32_t f, k;
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+		const uint32_t t = Rol(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = Rol(b, 30);
+		b = a;
+		a = t;
+	}
+	_h[0]+= a;
+	_h[1]+= b;
+	_h[2]+= c;
+	_h[3]+= d;
+	_h[4]+= e;
+}
+
+void GitSHA1::Update(const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	_total+= len;
+	if (_buf_len) {
+		const size_t n = std::min(len, sizeof(_buf) - _buf_len);
+		memcpy(_buf + _buf_len, p, n);
+		_buf_len+= n;
+		p+= n;
+		len-= n;
+		if (_buf_len < sizeof(_buf))
+			return;
+		Block(_buf);
+		_buf_len = 0;
+	}
+	for (; len >= sizeof(_buf); p+= sizeof(_buf), len-= sizeof(_buf)) {
+		Block(p);
+	}
+	memcpy(_buf, p, len);
+	_buf_len = len;
+}
+
+void GitSHA1::Final(unsigned char *out)
+{
+	const uint64_t bits = _total * 8;
+	unsigned char pad[72]{0x80};
+	const size_t pad_len = ((_buf_len < 56) ? 56 : 120) - _buf_len;
+	for (int i = 0; i < 8; ++i) {
+		pad[pad_len + i] = (unsigned char)(bits >> (56 - i * 8));
+	}
+	Update(pad, pad_len + 8);
+	for (int i = 0; i < 20; ++i) {
+		out[i] = (unsigned char)(_h[i / 4] >> (24 - (i % 4) * 8));
+	}
+}
+
+////////////////////////////////////////////////////////////
+
+static uint64_t StatSignature(const struct stat &s)
+{
+	uint64_t out = (uint64_t)s.st_mtim.tv_sec * 1000000000ull + s.st_mtim.tv_nsec;
+	out = out * 31 + (uint64_t)s.st_ctim.tv_sec * 1000000000ull + s.st_ctim.tv_nsec;
+	out = out * 31 + (uint64_t)s.st_size;
+	out = out * 31 + (uint64_t)s.st_ino;
+	out = out * 31 + (uint64_t)s.st_mode;
+	return out ? out : 1;
+}
+
+// gitignore glob: '*' and '?' don't match slash, '**/' matches any count of directories
+static bool GitGlobMatch(const char *p, const char *s)
+{
+	for (;; ++p, ++s) {
+		switch (*p) {
+			case 0:
+				return !*s;
+
+			case '?':
+				if (!*s || *s == '/')
+					return false;
+				break;
+
+			case '*':
+				if (p[1] == '*' && !p[2])
+					return true;
+
+				if (p[1] == '*' && p[2] == '/') {
+					for (const char *t = s;; ++t) {
+						if (GitGlobMatch(p + 3, t))
+							return true;
+						t = strchr(t, '/');
+						if (!t)
+							return false;
+					}
+				}
+
+				for (;; ++s) {
+					if (GitGlobMatch(p + 1, s))
+						return true;
+					if (!*s || *s == '/')
+						return false;
+				}
+
+			case '[': {
+				if (!*s || *s == '/')
+					return false;
+				const char *q = p + 1;
+				const bool negate = (*q == '!' || *q == '^');
+				if (negate)
+					++q;
+				bool matched = false;
+				for (bool first = true; *q && (first || *q != ']'); first = false, ++q) {
+					if (q[1] == '-' && q[2] && q[2] != ']') {
+						if ((unsigned char)*s >= (unsigned char)*q && (unsigned char)*s <= (unsigned char)q[2])
+							matched = true;
+						q+= 2;
+					} else if (*q == *s) {
+						matched = true;
+					}
+				}
+				if (!*q || matched == negate)
+					return false;
+				p = q;
+			} break;
+
+			case '\\':
+				if (p[1])
+					++p;
+				// fallthrough
+
+			default:
+				if (*p != *s)
+					return false;
+		}
+	}
+}
+
+struct GitIgnoreRule
+{
+	std::string Pattern;
+	bool Negative;
+	bool DirOnly;
+	bool Anchored;	// pattern contains slash, so its matched against path relative to .gitignore location
+};
+
+struct GitIgnoreFile
+{
+	uint64_t Sig{0};
+	unsigned int Epoch{0};
+	std::vector<GitIgnoreRule> Rules;
+
+	void Load(const std::string &path, unsigned int epoch);
+
+	// 1 - ignored, -1 - explicitly not ignored, 0 - no matching rule
+	int Match(const char *rel_path, const char *name, bool is_dir) const;
+};
+
+void GitIgnoreFile::Load(const std::string &path, unsigned int epoch)
+{
+	if (Epoch == epoch)
+		return;
+
+	Epoch = epoch;
+	struct stat s{};
+	const uint64_t sig = (stat(path.c_str(), &s) == 0) ? StatSignature(s) : 0;
+	if (sig == Sig)
+		return;
+
+	Sig = sig;
+	Rules.clear();
+	std::string content;
+	if (!sig || !ReadWholeFile(path.c_str(), content, 0x1000000))
+		return;
+
+	for (size_t pos = 0; pos < content.size();) {
+		size_t end = content.find('\n', pos);
+		if (end == std::string::npos)
+			end = content.size();
+		std::string line = content.substr(pos, end - pos);
+		pos = end + 1;
+
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\'))
+			line.pop_back();
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		GitIgnoreRule rule{};
+		if (line[0] == '!') {
+			rule.Negative = true;
+			line.erase(0, 1);
+		}
+		if (!line.empty() && line.back() == '/') {
+			rule.DirOnly = true;
+			line.pop_back();
+		}
+		if (line.find('/') != std::string::npos) {
+			rule.Anchored = true;
+			if (line[0] == '/')
+				line.erase(0, 1);
+		}
+		if (!line.empty()) {
+			rule.Pattern.swap(line);
+			Rules.emplace_back(std::move(rule));
+		}
+	}
+}
+
+int GitIgnoreFile::Match(const char *rel_path, const char *name, bool is_dir) const
+{
+	for (auto it = Rules.rbegin(); it != Rules.rend(); ++it) {
+		if ((!it->DirOnly || is_dir) && GitGlobMatch(it->Pattern.c_str(), it->Anchored ? rel_path : name))
+			return it->Negative ? -1 : 1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+
+struct GitIndexEntry
+{
+	std::string Path;
+	uint32_t CTimeSec, CTimeNSec, MTimeSec, MTimeNSec;
+	uint32_t Ino, Mode, Uid, Gid, Size;
+	unsigned char Hash[32];
+	uint16_t Flags, ExtFlags;
+	// stat signature of file when it was checked last time and result of that check
+	uint64_t CheckedSig;
+	GitFileStatus CheckedStatus;
+};
+
+struct GitDirListing
+{
+	uint64_t Sig{0};
+	std::vector<std::pair<std::string, bool> > Entries; // name and if its a directory
+};
+
+static bool GitIndexEntryLess(const GitIndexEntry &e, const std::string &path)
+{
+	return e.Path < path;
+}
+
+static inline uint32_t GitBE32(const unsigned char *p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static inline uint16_t GitBE16(const unsigned char *p)
+{
+	return uint16_t((p[0] << 8) | p[1]);
+}
+
+// All status information is obtained from index and work tree only, so its difference between
+// work tree and index that is reported, like 'git status' shows as 'not staged' and 'untracked'.
+// Stat data of each file compared with one recorded in index like git does, and only files
+// which stat data changed but size not, or which timestamp is racy - get hashed. Results are
+// remembered per index entry, so unchanged files are not rehashed until index reloaded.
+class GitRepo
+{
+	const std::string _root, _git_dir;
+	std::string _common_dir, _global_exclude_path;
+	const std::atomic<bool> &_abort;
+	size_t _hash_size{20};
+
+	uint64_t _index_sig{0};
+	struct timespec _index_mtime{};
+	std::vector<GitIndexEntry> _index;
+
+	unsigned int _epoch{0};
+	GitIgnoreFile _exclude, _global_exclude;
+	std::unordered_map<std::string, GitIgnoreFile> _ignores; // by directory relative to root
+	std::unordered_map<std::string, GitDirListing> _listings;
+	size_t _listings_names{0};
+
+	bool LoadIndex();
+	GitFileStatus CheckEntry(GitIndexEntry &e);
+	bool ContentMatches(const GitIndexEntry &e, const std::string &path, const struct stat &s);
+	bool IsTracked(const std::string &rel) const;
+	bool IsIgnored(const std::string &rel, bool is_dir);
+	bool HasUntracked(const std::string &rel_dir);
+	const GitDirListing &List(const std::string &rel_dir);
+
+public:
+	std::unique_ptr<IFSNotify> Watcher; // watches git dir for index changes
+	uint64_t LastUsed{0};
+
+	GitRepo(const std::string &root, const std::string &git_dir, const std::atomic<bool> &abort);
+
+	const std::string &Root() const { return _root; }
+	const std::string &GitDir() const { return _git_dir; }
+
+	// returns nullptr if index can't be read or if aborted
+	std::shared_ptr<GitDirStatus> DirStatus(const std::string &rel_dir);
+};
+
+GitRepo::GitRepo(const std::string &root, const std::string &git_dir, const std::atomic<bool> &abort)
+	: _root(root), _git_dir(git_dir), _common_dir(git_dir), _abort(abort)
+{
+	// linked work trees keep shared stuff like config and info/exclude in common dir
+	std::string str;
+	if (ReadWholeFile((_git_dir + "/commondir").c_str(), str, 0x1000)) {
+		StrTrim(str, " \t\r\n");
+		if (!str.empty())
+			_common_dir = (str[0] == '/') ? str : _git_dir + '/' + str;
+	}
+
+	if (ReadWholeFile((_common_dir + "/config").c_str(), str, 0x100000)) {
+		std::transform(str.begin(), str.end(), str.begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c; });
+		const size_t pos = str.find("objectformat");
+		if (pos != std::string::npos && str.find("sha256", pos) != std::string::npos)
+			_hash_size = 32;
+	}
+
+	const char *xdg_config = getenv("XDG_CONFIG_HOME");
+	if (xdg_config && *xdg_config) {
+		_global_exclude_path = xdg_config;
+	} else {
+		const char *home = getenv("HOME");
+		_global_exclude_path = home ? home : "";
+		_global_exclude_path+= "/.config";
+	}
+	_global_exclude_path+= "/git/ignore";
+}
+
+bool GitRepo::LoadIndex()
+{
+	const std::string &path = _git_dir + "/index";
+	struct stat s{};
+	if (stat(path.c_str(), &s) == -1) {
+		// no index in fresh repository, so everything is untracked
+		_index.clear();
+		_index_sig = 0;
+		return true;
+	}
+
+	const uint64_t sig = StatSignature(s);
+	if (sig == _index_sig)
+		return true;
+
+	std::string data;
+	if (!ReadWholeFile(path.c_str(), data) || data.size() < 12 + _hash_size || memcmp(data.data(), "DIRC", 4) != 0)
+		return false;
+
+	const unsigned char *p = (const unsigned char *)data.data() + 12;
+	const unsigned char *end = (const unsigned char *)data.data() + data.size() - _hash_size;
+	const uint32_t version = GitBE32(p - 8), count = GitBE32(p - 4);
+	const size_t fixed = 40 + _hash_size + 2;
+	if (version < 2 || version > 4 || count > data.size() / fixed)
+		return false;
+
+	std::vector<GitIndexEntry> entries(count);
+	for (size_t i = 0; i < entries.size(); ++i) {
+		GitIndexEntry &e = entries[i];
+		if (end - p < (ptrdiff_t)fixed)
+			return false;
+
+		e.CTimeSec = GitBE32(p);
+		e.CTimeNSec = GitBE32(p + 4);
+		e.MTimeSec = GitBE32(p + 8);
+		e.MTimeNSec = GitBE32(p + 12);
+		// device at p + 16 is not compared by git by default, so skip it too
+		e.Ino = GitBE32(p + 20);
+		e.Mode = GitBE32(p + 24);
+		e.Uid = GitBE32(p + 28);
+		e.Gid = GitBE32(p + 32);
+		e.Size = GitBE32(p + 36);
+		memcpy(e.Hash, p + 40, _hash_size);
+		e.Flags = GitBE16(p + 40 + _hash_size);
+		e.ExtFlags = 0;
+		e.CheckedSig = 0;
+		e.CheckedStatus = GFS_CLEAN;
+
+		const unsigned char *name = p + fixed;
+		if (version >= 3 && (e.Flags & GIE_EXTENDED)) {
+			if (end - name < 2)
+				return false;
+			e.ExtFlags = GitBE16(name);
+			name+= 2;
+		}
+
+		size_t strip = 0;
+		if (version == 4) {
+			// path is prefix-compressed against previous entry
+			if (name >= end)
+				return false;
+			unsigned char c = *(name++);
+			strip = c & 0x7f;
+			while (c & 0x80) {
+				if (name >= end)
+					return false;
+				c = *(name++);
+				strip = ((strip + 1) << 7) | (c & 0x7f);
+			}
+			if (strip > (i ? entries[i - 1].Path.size() : 0))
+				return false;
+		}
+
+		const unsigned char *name_end = (const unsigned char *)memchr(name, 0, end - name);
+		if (!name_end)
+			return false;
+
+		if (version == 4) {
+			if (i)
+				e.Path.assign(entries[i - 1].Path, 0, entries[i - 1].Path.size() - strip);
+			e.Path.append((const char *)name, name_end - name);
+			p = name_end + 1;
+		} else {
+			e.Path.assign((const char *)name, name_end - name);
+			const size_t len = ((name_end - p) + 8) & ~size_t(7);
+			if ((size_t)(end - p) < len)
+				return false;
+			p+= len;
+		}
+	}
+
+	_index.swap(entries);
+	_index_sig = sig;
+	_index_mtime = s.st_mtim;
+	return true;
+}
+
+bool GitRepo::ContentMatches(const GitIndexEntry &e, const std::string &path, const struct stat &s)
+{
+	if (_hash_size != 20)
+		return false; // SHA-256 repositories are not supported yet, so such files reported as modified
+
+	GitSHA1 sha;
+	const std::string &header = StrPrintf("blob %llu", (unsigned long long)s.st_size);
+	sha.Update(header.c_str(), header.size() + 1);
+
+	char buf[0x10000];
+	uint64_t hashed = 0;
+	if (S_ISLNK(s.st_mode)) {
+		const ssize_t r = readlink(path.c_str(), buf, sizeof(buf));
+		if (r < 0)
+			return false;
+		sha.Update(buf, r);
+		hashed = r;
+
+	} else {
+		const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			return false;
+		for (;;) {
+			const ssize_t r = read(fd, buf, sizeof(buf));
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r <= 0 || _abort)
+				break;
+			sha.Update(buf, r);
+			hashed+= r;
+		}
+		close(fd);
+	}
+
+	if (hashed != (uint64_t)s.st_size)
+		return false;
+
+	unsigned char digest[20];
+	sha.Final(digest);
+	return memcmp(digest, e.Hash, sizeof(digest)) == 0;
+}
+
+GitFileStatus GitRepo::CheckEntry(GitIndexEntry &e)
+{
+	if (e.Flags & GIE_STAGE_MASK)
+		return GFS_MODIFIED; // unmerged
+
+	if ((e.Flags & GIE_ASSUME_VALID) || (e.ExtFlags & GIE_SKIP_WORKTREE))
+		return GFS_CLEAN;
+
+	if (e.ExtFlags & GIE_INTENT_TO_ADD)
+		return GFS_MODIFIED;
+
+	const uint32_t type = e.Mode & S_IFMT;
+	if (type != S_IFREG && type != S_IFLNK)
+		return GFS_CLEAN; // submodule or sparse directory
+
+	const std::string &path = _root + '/' + e.Path;
+	struct stat s{};
+	if (lstat(path.c_str(), &s) == -1)
+		return GFS_MODIFIED; // removed
+
+	const uint64_t sig = StatSignature(s);
+	if (sig == e.CheckedSig)
+		return e.CheckedStatus;
+
+	GitFileStatus status = GFS_CLEAN;
+	if ((s.st_mode & S_IFMT) != type || (type == S_IFREG && ((s.st_mode ^ e.Mode) & 0100))
+			|| (uint32_t)s.st_size != e.Size) {
+		status = GFS_MODIFIED;
+
+	} else {
+		const bool stat_matches = (uint32_t)s.st_mtim.tv_sec == e.MTimeSec
+			&& (uint32_t)s.st_mtim.tv_nsec == e.MTimeNSec
+			&& (uint32_t)s.st_ctim.tv_sec == e.CTimeSec
+			&& (uint32_t)s.st_ctim.tv_nsec == e.CTimeNSec
+			&& (uint32_t)s.st_ino == e.Ino
+			&& (uint32_t)s.st_uid == e.Uid
+			&& (uint32_t)s.st_gid == e.Gid;
+
+		// file modified within same timestamp tick when index was written may have unchanged stat
+		const bool racy = e.MTimeSec > (uint32_t)_index_mtime.tv_sec
+			|| (e.MTimeSec == (uint32_t)_index_mtime.tv_sec && e.MTimeNSec >= (uint32_t)_index_mtime.tv_nsec);
+
+		if ((!stat_matches || racy) && !ContentMatches(e, path, s))
+			status = GFS_MODIFIED;
+	}
+
+	if (!_abort) {
+		e.CheckedSig = sig;
+		e.CheckedStatus = status;
+	}
+	return status;
+}
+
+bool GitRepo::IsTracked(const std::string &rel) const
+{
+	auto it = std::lower_bound(_index.begin(), _index.end(), rel, GitIndexEntryLess);
+	return it != _index.end() && it->Path == rel;
+}
+
+bool GitRepo::IsIgnored(const std::string &rel, bool is_dir)
+{
+	const size_t slash = rel.rfind('/');
+	const char *name = rel.c_str() + ((slash == std::string::npos) ? 0 : slash + 1);
+
+	// .gitignore of deeper directory takes precedence
+	for (size_t dir_len = (slash == std::string::npos) ? 0 : slash;;) {
+		const std::string dir = rel.substr(0, dir_len);
+		GitIgnoreFile &gi = _ignores[dir];
+		gi.Load(dir.empty() ? _root + "/.gitignore" : _root + '/' + dir + "/.gitignore", _epoch);
+		const int r = gi.Match(rel.c_str() + (dir_len ? dir_len + 1 : 0), name, is_dir);
+		if (r)
+			return r > 0;
+		if (!dir_len)
+			break;
+		const size_t up = rel.rfind('/', dir_len - 1);
+		dir_len = (up == std::string::npos) ? 0 : up;
+	}
+
+	int r = _exclude.Match(rel.c_str(), name, is_dir);
+	if (!r)
+		r = _global_exclude.Match(rel.c_str(), name, is_dir);
+	return r > 0;
+}
+
+const GitDirListing &GitRepo::List(const std::string &rel_dir)
+{
+	const std::string &path = rel_dir.empty() ? _root : _root + '/' + rel_dir;
+	struct stat s{};
+	const uint64_t sig = (stat(path.c_str(), &s) == 0) ? StatSignature(s) : 0;
+	GitDirListing &l = _listings[rel_dir];
+	if (sig && l.Sig == sig)
+		return l;
+
+	_listings_names-= l.Entries.size();
+	l.Entries.clear();
+	l.Sig = sig;
+	DIR *d = sig ? opendir(path.c_str()) : nullptr;
+	if (d) {
+		while (struct dirent *de = readdir(d)) {
+			if (de->d_name[0] == '.' && (!de->d_name[1] || (de->d_name[1] == '.' && !de->d_name[2])))
+				continue;
+			bool is_dir = (de->d_type == DT_DIR);
+			if (de->d_type == DT_UNKNOWN) {
+				struct stat es{};
+				is_dir = (lstat((path + '/' + de->d_name).c_str(), &es) == 0 && S_ISDIR(es.st_mode));
+			}
+			l.Entries.emplace_back(de->d_name, is_dir);
+		}
+		closedir(d);
+	}
+	_listings_names+= l.Entries.size();
+	return l;
+}
+
+// checks if directory contains, maybe in subdirectories, files that are neither tracked nor ignored
+bool GitRepo::HasUntracked(const std::string &rel_dir)
+{
+	if (_abort)
+		return false;
+
+	for (const auto &e : List(rel_dir).Entries) {
+		if (e.first == ".git")
+			return true; // nested repository that is not a submodule
+
+		const std::string &rel = rel_dir + '/' + e.first;
+		if (e.second) {
+			// submodule is tracked as a file
+			if (!IsTracked(rel) && !IsIgnored(rel, true) && HasUntracked(rel))
+				return true;
+
+		} else if (!IsTracked(rel) && !IsIgnored(rel, false)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::shared_ptr<GitDirStatus> GitRepo::DirStatus(const std::string &rel_dir)
+{
+	if (!LoadIndex())
+		return nullptr;
+
+	if (_listings_names > GitListingsNamesLimit) {
+		_listings.clear();
+		_ignores.clear();
+		_listings_names = 0;
+	}
+	++_epoch;
+	_exclude.Load(_common_dir + "/info/exclude", _epoch);
+	_global_exclude.Load(_global_exclude_path, _epoch);
+
+	auto out = std::make_shared<GitDirStatus>();
+	const std::string &prefix = rel_dir.empty() ? std::string() : rel_dir + '/';
+
+	// index is sorted, so entries of each child of directory are contiguous
+	std::unordered_set<std::string> tracked_names;
+	std::string name;
+	GitFileStatus status = GFS_CLEAN;
+	bool is_dir = false;
+	auto flush = [&]() {
+		if (name.empty())
+			return;
+		tracked_names.insert(name);
+		if (status == GFS_CLEAN && is_dir && HasUntracked(prefix + name))
+			status = GFS_UNTRACKED;
+		if (status != GFS_CLEAN)
+			out->Entries.emplace(StrMB2Wide(name), status);
+	};
+
+	for (auto it = std::lower_bound(_index.begin(), _index.end(), prefix, GitIndexEntryLess);
+			it != _index.end() && it->Path.compare(0, prefix.size(), prefix) == 0; ++it) {
+		if (_abort)
+			return nullptr;
+		const char *tail = it->Path.c_str() + prefix.size();
+		const char *slash = strchr(tail, '/');
+		const size_t len = slash ? slash - tail : strlen(tail);
+		if (!len)
+			continue;
+		if (name.size() != len || name.compare(0, len, tail, len) != 0) {
+			flush();
+			name.assign(tail, len);
+			status = GFS_CLEAN;
+			is_dir = (slash != nullptr);
+		}
+		if (status != GFS_MODIFIED && CheckEntry(*it) != GFS_CLEAN)
+			status = GFS_MODIFIED;
+	}
+	flush();
+
+	// if directory is within ignored one then all its untracked content is ignored as well
+	bool dir_ignored = false;
+	for (size_t slash = 0; !dir_ignored && slash != std::string::npos && !rel_dir.empty();) {
+		slash = rel_dir.find('/', slash + 1);
+		dir_ignored = IsIgnored(rel_dir.substr(0, slash), true);
+	}
+
+	for (const auto &e : List(rel_dir).Entries) {
+		if (e.first == ".git" || tracked_names.count(e.first))
+			continue;
+
+		const std::string &rel = prefix + e.first;
+		if (dir_ignored || IsIgnored(rel, e.second)) {
+			out->Entries.emplace(StrMB2Wide(e.first), GFS_IGNORED);
+		} else if (!e.second || HasUntracked(rel)) {
+			out->Entries.emplace(StrMB2Wide(e.first), GFS_UNTRACKED);
+		}
+	}
+
+	if (_abort)
+		return nullptr;
+
+	return out;
+}
+
+////////////////////////////////////////////////////////////
+
+// finds root of work tree that contains given directory and its git dir
+static bool GitFindWorkTree(const std::string &dir, std::string &root, std::string &git_dir)
+{
+	if (dir.find("/.git/") != std::string::npos || StrEndsBy(dir, "/.git"))
+		return false;
+
+	for (root = dir; !root.empty();) {
+		const std::string &dot_git = root + "/.git";
+		struct stat s{};
+		if (lstat(dot_git.c_str(), &s) == 0) {
+			if (S_ISDIR(s.st_mode)) {
+				git_dir = dot_git;
+				return true;
+			}
+			// linked work tree or submodule
+			std::string content;
+			if (S_ISREG(s.st_mode) && ReadWholeFile(dot_git.c_str(), content, 0x1000)
+					&& StrStartsFrom(content, "gitdir:")) {
+				content.erase(0, 7);
+				StrTrim(content, " \t\r\n");
+				if (!content.empty()) {
+					git_dir = (content[0] == '/') ? content : root + '/' + content;
+					return true;
+				}
+			}
+		}
+		const size_t slash = root.rfind('/');
+		root.resize((slash == std::string::npos) ? 0 : slash);
+	}
+	return false;
+}
+
+class GitStatusCache : protected Threaded
+{
+	struct Dir
+	{
+		GitDirStatusPtr Status;
+		std::unique_ptr<IFSNotify> Watcher;
+		std::string Root; // root of work tree or empty if not known yet or not in work tree
+		uint64_t LastUsed{0};
+		bool Known{false};
+		bool Queued{false};
+	};
+
+	std::mutex _mtx;
+	std::condition_variable _cond;
+	std::map<std::string, Dir> _dirs;
+	std::deque<std::string> _queue;
+	uint64_t _use_counter{0};
+	bool _started{false};
+	std::atomic<bool> _stop{false};
+	std::atomic<unsigned int> _generation{0};
+
+	// accessed only by worker thread
+	std::map<std::string, std::unique_ptr<GitRepo> > _repos;
+	uint64_t _repos_use_counter{0};
+
+	void Enqueue(const std::string &path, Dir &dir);
+	void Invalidate(const std::string &path);
+	void InvalidateRepo(const std::string &root);
+	GitRepo *RepoFor(const std::string &path, std::string &rel_dir);
+
+	virtual void *ThreadProc();
+
+public:
+	virtual ~GitStatusCache();
+
+	GitDirStatusPtr Query(const std::string &path, bool revalidate);
+
+	unsigned int Generation() const { return _generation; }
+};
+
+GitStatusCache::~GitStatusCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stop = true;
+	}
+	_cond.notify_all();
+	WaitThread();
+
+	// destroy watchers without lock held as their callbacks take it
+	std::vector<std::unique_ptr<IFSNotify> > watchers;
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		for (auto &it : _dirs) {
+			watchers.emplace_back(std::move(it.second.Watcher));
+		}
+	}
+	watchers.clear();
+	_repos.clear();
+}
+
+void GitStatusCache::Enqueue(const std::string &path, Dir &dir)
+{
+	if (!dir.Queued) {
+		dir.Queued = true;
+		_queue.emplace_back(path);
+		_cond.notify_all();
+	}
+}
+
+void GitStatusCache::Invalidate(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	auto it = _dirs.find(path);
+	if (!_stop && it != _dirs.end()) {
+		Enqueue(path, it->second);
+	}
+}
+
+void GitStatusCache::InvalidateRepo(const std::string &root)
+{
+	std::lock_guard<std::mutex> lock(_mtx);
+	for (auto &it : _dirs) {
+		if (!_stop && it.second.Root == root) {
+			Enqueue(it.first, it.second);
+		}
+	}
+}
+
+GitRepo *GitStatusCache::RepoFor(const std::string &path, std::string &rel_dir)
+{
+	std::string root, git_dir;
+	if (!GitFindWorkTree(path, root, git_dir))
+		return nullptr;
+
+	rel_dir = (path.size() > root.size()) ? path.substr(root.size() + 1) : std::string();
+
+	auto &repo = _repos[root];
+	if (!repo || repo->GitDir() != git_dir) {
+		while (_repos.size() > GitStatusReposLimit) {
+			auto oldest = _repos.end();
+			for (auto it = _repos.begin(); it != _repos.end(); ++it) {
+				if (it->second && it->first != root
+						&& (oldest == _repos.end() || it->second->LastUsed < oldest->second->LastUsed))
+					oldest = it;
+			}
+			if (oldest == _repos.end())
+				break;
+			_repos.erase(oldest);
+		}
+		repo.reset(new GitRepo(root, git_dir, _stop));
+	}
+	repo->LastUsed = ++_repos_use_counter;
+
+	// index is replaced by renaming of new file, so watching names in git dir is enough
+	if (!repo->Watcher || repo->Watcher->Check()) {
+		repo->Watcher.reset(IFSNotify_Create(git_dir, false, FSNW_NAMES_AND_STATS,
+			[this, root]() { InvalidateRepo(root); }));
+	}
+	return repo.get();
+}
+
+void *GitStatusCache::ThreadProc()
+{
+	std::unique_lock<std::mutex> lock(_mtx);
+	while (!_stop) {
+		if (_queue.empty()) {
+			_cond.wait(lock);
+			continue;
+		}
+
+		const std::string path = _queue.front();
+		_queue.pop_front();
+		auto it = _dirs.find(path);
+		if (it == _dirs.end())
+			continue;
+		it->second.Queued = false;
+		lock.unlock();
+
+		std::string rel_dir;
+		GitRepo *repo = RepoFor(path, rel_dir);
+		std::shared_ptr<GitDirStatus> status = repo ? repo->DirStatus(rel_dir) : nullptr;
+		std::unique_ptr<IFSNotify> watcher;
+		if (status) {
+			watcher.reset(IFSNotify_Create(path, false, FSNW_NAMES_AND_STATS,
+				[this, path]() { Invalidate(path); }));
+		}
+
+		lock.lock();
+		it = _dirs.find(path);
+		if (it != _dirs.end()) {
+			Dir &dir = it->second;
+			dir.Known = true;
+			dir.Root = repo ? repo->Root() : std::string();
+			dir.Watcher.swap(watcher);
+			if (!(dir.Status == status || (dir.Status && status && dir.Status->Entries == status->Entries))) {
+				dir.Status = status;
+				++_generation;
+			}
+		}
+		lock.unlock();
+		watcher.reset(); // previous one
+		lock.lock();
+	}
+	return nullptr;
+}
+
+GitDirStatusPtr GitStatusCache::Query(const std::string &path, bool revalidate)
+{
+	std::vector<std::unique_ptr<IFSNotify> > garbage; // destroyed after lock released
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (!_started) {
+		_started = true;
+		if (!StartThread()) {
+			_stop = true;
+		}
+	}
+	if (_stop)
+		return nullptr;
+
+	Dir &dir = _dirs[path];
+	dir.LastUsed = ++_use_counter;
+	if (revalidate || !dir.Known) {
+		Enqueue(path, dir);
+	}
+	GitDirStatusPtr out = dir.Status;
+
+	while (_dirs.size() > GitStatusDirsLimit) {
+		auto oldest = _dirs.end();
+		for (auto it = _dirs.begin(); it != _dirs.end(); ++it) {
+			if (!it->second.Queued && (oldest == _dirs.end() || it->second.LastUsed < oldest->second.LastUsed))
+				oldest = it;
+		}
+		if (oldest == _dirs.end())
+			break;
+		garbage.emplace_back(std::move(oldest->second.Watcher));
+		_dirs.erase(oldest);
+	}
+	return out;
+}
+
+static GitStatusCache &GitStatusCacheInstance()
+{
+	static GitStatusCache s_cache;
+	return s_cache;
+}
+
+////////////////////////////////////////////////////////////
+
+GitFileStatus GitDirStatus::Get(const FARString &Name) const
+{
+	if (Entries.empty())
+		return GFS_CLEAN;
+
+	auto it = Entries.find(std::wstring(Name.CPtr(), Name.GetLength()));
+	return (it != Entries.end()) ? it->second : GFS_CLEAN;
+}
+
+GitDirStatusPtr GitStatusQuery(const FARString &Dir, bool Revalidate)
+{
+	std::string path = Dir.GetMB();
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+
+	if (path.empty() || path[0] != '/')
+		return nullptr;
+
+	return GitStatusCacheInstance().Query(path, Revalidate);
+}
+
+unsigned int GitStatusGeneration()
+{
+	return GitStatusCacheInstance().Generation();
+}
+
+wchar_t GitStatusChar(GitFileStatus Status)
+{
+	switch (Status) {
+		case GFS_MODIFIED:
+			return L'M';
+		case GFS_UNTRACKED:
+			return L'?';
+		case GFS_IGNORED:
+			return L'!';
+		default:
+			return L' ';
+	}
+}
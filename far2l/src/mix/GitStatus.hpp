@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "FARString.hpp"
+
+enum GitFileStatus : unsigned char
+{
+	GFS_CLEAN = 0,
+	GFS_MODIFIED,	// tracked file differs from index, for directory - something inside modified or removed
+	GFS_UNTRACKED,	// not in index, for directory - contains untracked files
+	GFS_IGNORED
+};
+
+// Status of entries of some directory within git work tree, entries not mentioned are clean
+struct GitDirStatus
+{
+	std::unordered_map<std::wstring, GitFileStatus> Entries;
+
+	GitFileStatus Get(const FARString &Name) const;
+};
+
+typedef std::shared_ptr<const GitDirStatus> GitDirStatusPtr;
+
+// Returns last known status of given directory entries or nullptr if its not known yet or
+// directory is not within git work tree. Status is computed in background from git index
+// directly, without invoking git. Its recomputed if not known yet, if Revalidate is set or
+// if directory or git index changed since it was computed.
+GitDirStatusPtr GitStatusQuery(const FARString &Dir, bool Revalidate);
+
+// Incremented each time background computation produces changed status of some directory
+unsigned int GitStatusGeneration();
+
+wchar_t GitStatusChar(GitFileStatus Status);
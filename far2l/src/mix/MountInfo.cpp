@@ -428,3 +428,19 @@ bool MountInfo::IsMultiThreadFriendly(const std::string &path) const
 	}
 	return out;
 }
+
+unsigned int MountInfo::MetadataThreadsCount(const std::string &path) const
+{
+	if (IsMultiThreadFriendly(path)) {
+		return std::min(std::max(BestThreadsCount() * 2, 4u), 16u);
+	}
+
+	// network filesystems serve concurrent metadata requests well even if not 'multi-thread friendly'
+	const std::string &fs = GetFileSystem(path);
+	if (fs == "nfs" || fs == "nfs4" || fs == "cifs" || fs == "smb3" || fs == "smbfs"
+			|| fs == "ceph" || fs == "lustre" || fs == "fuse.glusterfs") {
+		return 8;
+	}
+
+	return 1;
+}
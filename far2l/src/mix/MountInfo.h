@@ -44,4 +44,7 @@ public:
 
 	/// Returns true if path fine to be used multi-threaded-ly
 	bool IsMultiThreadFriendly(const std::string &path) const;
+
+	/// Returns amount of threads good for parallel metadata operations (stat, unlink etc) under path
+	unsigned int MetadataThreadsCount(const std::string &path) const;
 };
@@ -41,6 +41,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <functional>
 #include <unordered_map>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <atomic>
 #include <wctype.h>
 #include <cwctype>
 #include <string.h>
@@ -484,6 +487,655 @@ struct RegExp::REOpCode: public REOpCode_data
 	}
 };
 
+//----------------------------------------------------------------------------
+// Fast rejection path of SearchEx: lazily built DFA and required literal.
+// DFA is constructed from op-codes of expressions without back-references,
+// named brackets and lookarounds. Language it recognizes is a superset of
+// what InnerMatch can match (large quantifiers are relaxed to unbounded ones),
+// so if it reports possible match then backtracking matcher still runs to find
+// exact match and brackets positions. But texts without matches, that is most
+// of lines when searching through big file, are rejected in linear time.
+
+class RegExp::FastSearch
+{
+	enum
+	{
+		MAX_NODES   = 0x4000,
+		MAX_UNROLL  = 0x40,
+		MAX_STATES  = 0x400,
+		MAX_FLUSHES = 0x40,
+	};
+
+	enum NodeKind : uint8_t
+	{
+		NK_CHAR,	// consumes char matching op
+		NK_SPLIT,	// epsilon transition to both out1 and out2
+		NK_ASSERT,	// epsilon transition to out1 if zero-width assertion op holds
+		NK_MATCH,
+	};
+
+	enum Context : uint8_t
+	{
+		CTX_DATASTART = 0x01,
+		CTX_LINESTART = 0x02,
+		CTX_PREVWORD  = 0x04,
+		CTX_COUNT     = 0x08,
+	};
+
+	struct Node
+	{
+		NodeKind kind;
+		int op{};
+		wchar_t symbol{};
+		const UniSet *symbolclass{};
+		CharType type{};
+		int out1{-1};
+		int out2{-1};
+	};
+
+	struct Condition
+	{
+		uint8_t ctx;
+		bool at_end;
+		bool next_eol;
+		bool next_word;
+	};
+
+	// DFA state: set of NFA nodes closed over epsilon transitions except assertions
+	// that depend on next char and so resolved when transition is computed.
+	// Transitions are stored as (target << 1) | (match ends before char), -1 if not computed yet.
+	struct DState
+	{
+		std::vector<int> nodes;
+		uint8_t ctx;
+		int8_t end_match{-1};
+		int ascii_next[0x80];
+		std::unordered_map<wchar_t, int> other_next;
+	};
+
+	const bool ignorecase;
+	std::wstring literal;
+
+	std::vector<Node> nodes;
+	int start_node{-1};
+	std::atomic<bool> dfa_usable{false}; // may be reset by one thread while others check it
+
+	std::mutex mtx;
+	std::vector<DState> states;
+	std::map<std::vector<int>, int> states_index;
+	int start_states[CTX_COUNT];
+	int flushes{0};
+	std::vector<unsigned int> marks;
+	unsigned int mark{0};
+	std::vector<int> work;
+
+	int NewNode(NodeKind kind, int out1 = -1, int out2 = -1)
+	{
+		if (nodes.size() >= MAX_NODES)
+			return -1;
+
+		nodes.emplace_back();
+		nodes.back().kind = kind;
+		nodes.back().out1 = out1;
+		nodes.back().out2 = out2;
+		return static_cast<int>(nodes.size() - 1);
+	}
+
+	int CharNode(const REOpCode& op, int next)
+	{
+		const int n = NewNode(NK_CHAR, next);
+		if (n == -1)
+			return -1;
+
+		auto& node = nodes[n];
+		switch (op.op)
+		{
+			case opSymbol:
+			case opNotSymbol:
+			case opSymbolIgnoreCase:
+			case opNotSymbolIgnoreCase:
+				node.op = op.op;
+				node.symbol = op.symbol;
+				break;
+			case opSymbolClass:
+				node.op = op.op;
+				node.symbolclass = op.symbolclass;
+				break;
+			case opType:
+			case opNotType:
+				node.op = op.op;
+				node.type = op.type;
+				break;
+			case opCharAny:
+			case opCharAnyAll:
+				node.op = op.op;
+				break;
+			case opSymbolRange:
+			case opSymbolMinRange:
+				node.op = ignorecase ? opSymbolIgnoreCase : opSymbol;
+				node.symbol = op.range.symbol;
+				break;
+			case opNotSymbolRange:
+			case opNotSymbolMinRange:
+				node.op = ignorecase ? opNotSymbolIgnoreCase : opNotSymbol;
+				node.symbol = op.range.symbol;
+				break;
+			case opAnyRange:
+			case opAnyMinRange:
+				node.op = op.range.op;
+				break;
+			case opTypeRange:
+			case opTypeMinRange:
+				node.op = opType;
+				node.type = op.range.type;
+				break;
+			case opNotTypeRange:
+			case opNotTypeMinRange:
+				node.op = opNotType;
+				node.type = op.range.type;
+				break;
+			case opClassRange:
+			case opClassMinRange:
+				node.op = opSymbolClass;
+				node.symbolclass = op.range.symbolclass;
+				break;
+			default:
+				return -1;
+		}
+
+		return n;
+	}
+
+	template <class BuildOneT>
+	int Repeat(const BuildOneT& build_one, int min, int max, int next)
+	{
+		// unroll bounded quantifiers, too big counts are relaxed to X{n,} that only widens language
+		if (min > MAX_UNROLL)
+			min = MAX_UNROLL;
+
+		if (max >= 0 && max - min > MAX_UNROLL)
+			max = -1;
+
+		int out = next;
+		if (max < 0)
+		{
+			const int loop = NewNode(NK_SPLIT, -1, next);
+			if (loop == -1)
+				return -1;
+
+			const int body = build_one(loop);
+			if (body == -1)
+				return -1;
+
+			nodes[loop].out1 = body;
+			out = loop;
+		}
+		else
+		{
+			for (int i = min; i < max; ++i)
+			{
+				const int body = build_one(out);
+				if (body == -1)
+					return -1;
+
+				out = NewNode(NK_SPLIT, body, next);
+				if (out == -1)
+					return -1;
+			}
+		}
+
+		for (int i = 0; i < min && out != -1; ++i)
+			out = build_one(out);
+
+		return out;
+	}
+
+	int Sequence(const REOpCode* from, const REOpCode* to, int next)
+	{
+		for (const auto* op = to; op != from && next != -1; )
+		{
+			--op;
+			switch (op->op)
+			{
+				case opType:
+				case opNotType:
+				case opCharAny:
+				case opCharAnyAll:
+				case opSymbol:
+				case opNotSymbol:
+				case opSymbolIgnoreCase:
+				case opNotSymbolIgnoreCase:
+				case opSymbolClass:
+					next = CharNode(*op, next);
+					break;
+
+				case opSymbolRange:
+				case opSymbolMinRange:
+				case opNotSymbolRange:
+				case opNotSymbolMinRange:
+				case opAnyRange:
+				case opAnyMinRange:
+				case opTypeRange:
+				case opTypeMinRange:
+				case opNotTypeRange:
+				case opNotTypeMinRange:
+				case opClassRange:
+				case opClassMinRange:
+					next = Repeat([&](int n) { return CharNode(*op, n); }, op->range.min, op->range.max, next);
+					break;
+
+				case opLineStart:
+				case opLineEnd:
+				case opDataStart:
+				case opDataEnd:
+				case opWordBound:
+				case opNotWordBound:
+					next = NewNode(NK_ASSERT, next);
+					if (next != -1)
+						nodes[next].op = op->op;
+					break;
+
+				case opClosingBracket:
+				{
+					const auto* open = op->bracket.pairindex;
+					switch (open->op)
+					{
+						case opOpenBracket:
+						case opNamedBracket:
+							next = Alternatives(open, op, next);
+							break;
+						case opBracketRange:
+						case opBracketMinRange:
+							next = Repeat([&](int n) { return Alternatives(open, op, n); },
+								open->range.min, open->range.max, next);
+							break;
+						default:
+							return -1;
+					}
+					op = open;
+					break;
+				}
+
+				default:
+					return -1;
+			}
+		}
+
+		return next;
+	}
+
+	int Alternatives(const REOpCode* open, const REOpCode* close, int next)
+	{
+		if (!open->bracket.nextalt)
+			return Sequence(open + 1, close, next);
+
+		// first branch is from open to first alternative, each alternative op starts next branch
+		std::vector<std::pair<const REOpCode*, const REOpCode*>> branches{{open + 1, open->bracket.nextalt}};
+		for (const auto* alt = open->bracket.nextalt; alt; alt = alt->alternative.nextalt)
+			branches.emplace_back(alt + 1, alt->alternative.nextalt ? alt->alternative.nextalt : close);
+
+		int out = -1;
+		for (const auto& branch : branches)
+		{
+			const int n = Sequence(branch.first, branch.second, next);
+			if (n == -1)
+				return -1;
+
+			out = (out == -1) ? n : NewNode(NK_SPLIT, n, out);
+			if (out == -1)
+				return -1;
+		}
+
+		return out;
+	}
+
+	void ExtractLiteral(const std::vector<REOpCode>& code)
+	{
+		// longest run of plain symbols at top level - any match must contain it
+		if (code.empty() || code[0].bracket.nextalt)
+			return;
+
+		std::wstring run;
+		for (const auto* op = &code[1], *end = code[0].bracket.pairindex; op < end; ++op)
+		{
+			if (op->op == opSymbol)
+			{
+				run+= op->symbol;
+				continue;
+			}
+
+			if (run.size() > literal.size())
+				literal = run;
+
+			run.clear();
+
+			switch (op->op)
+			{
+				case opOpenBracket:
+				case opNamedBracket:
+				case opBracketRange:
+				case opBracketMinRange:
+					op = op->bracket.pairindex;
+					break;
+				case opLookAhead:
+				case opNotLookAhead:
+				case opLookBehind:
+				case opNotLookBehind:
+					op = op->assert.pairindex;
+					break;
+			}
+		}
+
+		if (run.size() > literal.size())
+			literal = run;
+	}
+
+	static bool ContainsLiteral(const wchar_t* begin, const wchar_t* end, const std::wstring& lit)
+	{
+		const size_t len = lit.size();
+		for (auto p = begin; static_cast<size_t>(end - p) >= len; ++p)
+		{
+			p = wmemchr(p, lit[0], static_cast<size_t>(end - p) - len + 1);
+			if (!p)
+				return false;
+
+			if (wmemcmp(p, lit.data(), len) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	static bool CharMatches(const Node& node, wchar_t c)
+	{
+		switch (node.op)
+		{
+			case opSymbol: return c == node.symbol;
+			case opNotSymbol: return c != node.symbol;
+			case opSymbolIgnoreCase: return TOLOWER(c) == node.symbol;
+			case opNotSymbolIgnoreCase: return TOLOWER(c) != node.symbol;
+			case opSymbolClass: return node.symbolclass->GetBit(c);
+			case opType: return isType(c, node.type);
+			case opNotType: return !isType(c, node.type);
+			case opCharAny: return !IsEol(c);
+			case opCharAnyAll: return true;
+			default: return false;
+		}
+	}
+
+	static bool AssertionHolds(int op, const Condition& cond)
+	{
+		switch (op)
+		{
+			case opLineStart: return (cond.ctx & CTX_LINESTART) != 0;
+			case opLineEnd: return cond.at_end || cond.next_eol;
+			case opDataStart: return (cond.ctx & CTX_DATASTART) != 0;
+			case opDataEnd: return cond.at_end;
+			case opWordBound:
+			case opNotWordBound:
+			{
+				// same as InnerMatch: empty text has no word boundaries
+				const bool bound = !((cond.ctx & CTX_DATASTART) && cond.at_end)
+					&& ((cond.ctx & CTX_PREVWORD) != 0) != cond.next_word;
+				return (op == opWordBound) ? bound : !bound;
+			}
+			default: return false;
+		}
+	}
+
+	// Appends to out nodes reachable from n via epsilon transitions. If cond is null then
+	// assertions are not resolved but kept in out, otherwise followed only if hold.
+	void Closure(int n, std::vector<int>& out, const Condition* cond)
+	{
+		work.emplace_back(n);
+		while (!work.empty())
+		{
+			n = work.back();
+			work.pop_back();
+			if (marks[n] == mark)
+				continue;
+
+			marks[n] = mark;
+			const auto& node = nodes[n];
+			switch (node.kind)
+			{
+				case NK_SPLIT:
+					work.emplace_back(node.out2);
+					work.emplace_back(node.out1);
+					break;
+				case NK_ASSERT:
+					if (!cond)
+						out.emplace_back(n);
+					else if (AssertionHolds(node.op, *cond))
+						work.emplace_back(node.out1);
+					break;
+				default:
+					out.emplace_back(n);
+			}
+		}
+	}
+
+	void NextMark()
+	{
+		if (++mark == 0)
+		{
+			std::fill(marks.begin(), marks.end(), 0);
+			mark = 1;
+		}
+	}
+
+	int InternState(std::vector<int>& set, uint8_t ctx)
+	{
+		std::sort(set.begin(), set.end());
+		set.emplace_back(-1 - ctx);
+		const auto ir = states_index.emplace(set, static_cast<int>(states.size()));
+		set.pop_back();
+		if (ir.second)
+		{
+			states.emplace_back();
+			auto& st = states.back();
+			st.nodes = set;
+			st.ctx = ctx;
+			std::fill_n(st.ascii_next, ARRAYSIZE(st.ascii_next), -1);
+		}
+
+		return ir.first->second;
+	}
+
+	int StartState(uint8_t ctx)
+	{
+		if (start_states[ctx] == -1)
+		{
+			std::vector<int> set;
+			NextMark();
+			Closure(start_node, set, nullptr);
+			start_states[ctx] = InternState(set, ctx);
+		}
+
+		return start_states[ctx];
+	}
+
+	// Expands assertions of state s for given condition, returns true if match node reached.
+	bool Expand(int s, const Condition& cond, std::vector<int>& out)
+	{
+		NextMark();
+		bool matched = false;
+		for (const int n : states[s].nodes)
+			Closure(n, out, &cond);
+
+		for (const int n : out)
+		{
+			if (nodes[n].kind == NK_MATCH)
+				matched = true;
+		}
+
+		return matched;
+	}
+
+	int ComputeNext(int s, wchar_t c)
+	{
+		const Condition cond{states[s].ctx, false, IsEol(c), ISWORD(c)};
+		std::vector<int> expanded;
+		const bool matched = Expand(s, cond, expanded);
+
+		std::vector<int> set;
+		NextMark();
+		for (const int n : expanded)
+		{
+			if (nodes[n].kind == NK_CHAR && CharMatches(nodes[n], c))
+				Closure(nodes[n].out1, set, nullptr);
+		}
+
+		// search is unanchored: match can start at any position
+		Closure(start_node, set, nullptr);
+
+		const uint8_t ctx = (IsEol(c) ? CTX_LINESTART : 0) | (ISWORD(c) ? CTX_PREVWORD : 0);
+		return (InternState(set, ctx) << 1) | (matched ? 1 : 0);
+	}
+
+	int Next(int s, wchar_t c)
+	{
+		const bool ascii = (static_cast<unsigned int>(c) < ARRAYSIZE(states[s].ascii_next));
+		if (ascii)
+		{
+			if (states[s].ascii_next[c] != -1)
+				return states[s].ascii_next[c];
+		}
+		else
+		{
+			const auto it = states[s].other_next.find(c);
+			if (it != states[s].other_next.end())
+				return it->second;
+		}
+
+		const int r = ComputeNext(s, c);
+		if (ascii)
+			states[s].ascii_next[c] = r;
+		else
+			states[s].other_next.emplace(c, r);
+
+		return r;
+	}
+
+	bool EndMatches(int s)
+	{
+		if (states[s].end_match == -1)
+		{
+			const Condition cond{states[s].ctx, true, true, false};
+			std::vector<int> expanded;
+			states[s].end_match = Expand(s, cond, expanded) ? 1 : 0;
+		}
+
+		return states[s].end_match != 0;
+	}
+
+	// Drops all cached states except current one to keep memory bounded
+	int Flush(int s)
+	{
+		std::vector<int> set = std::move(states[s].nodes);
+		const uint8_t ctx = states[s].ctx;
+		states.clear();
+		states_index.clear();
+		std::fill_n(start_states, ARRAYSIZE(start_states), -1);
+		return InternState(set, ctx);
+	}
+
+public:
+	FastSearch(const std::vector<REOpCode>& code, bool ignorecase_, bool build_dfa)
+		: ignorecase(ignorecase_)
+	{
+		std::fill_n(start_states, ARRAYSIZE(start_states), -1);
+		ExtractLiteral(code);
+
+		if (!build_dfa || code.empty())
+			return;
+
+		const int match_node = NewNode(NK_MATCH);
+		start_node = Alternatives(&code[0], code[0].bracket.pairindex, match_node);
+		if (start_node == -1)
+		{
+			nodes.clear();
+			return;
+		}
+
+		marks.resize(nodes.size(), 0);
+		dfa_usable.store(true, std::memory_order_release);
+	}
+
+	bool Usable() const { return dfa_usable.load(std::memory_order_acquire) || !literal.empty(); }
+
+	/*! Returns false if text definitely has no match within [textstart, strend),
+		true if match is possible and full matcher must be used to find it.
+	*/
+	bool MayMatch(const wchar_t* start, const wchar_t* textstart, const wchar_t* strend)
+	{
+		if (!literal.empty() && !ContainsLiteral(textstart, strend, literal))
+			return false;
+
+		if (!dfa_usable.load(std::memory_order_acquire))
+			return true;
+
+		// can be used by several threads at once, e.g. in files highlighting - dont wait
+		std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+		if (!lock.owns_lock())
+			return true;
+
+		// other thread could give up DFA and clear its states meanwhile
+		if (!dfa_usable.load(std::memory_order_relaxed))
+			return true;
+
+		uint8_t ctx = 0;
+		if (textstart == start)
+		{
+			ctx = CTX_DATASTART | CTX_LINESTART;
+		}
+		else
+		{
+			if (IsEol(textstart[-1]))
+				ctx|= CTX_LINESTART;
+			if (ISWORD(textstart[-1]))
+				ctx|= CTX_PREVWORD;
+		}
+
+		int s = StartState(ctx);
+		for (auto str = textstart; str < strend; ++str)
+		{
+			const auto c = *str;
+			int r;
+			if (static_cast<unsigned int>(c) < ARRAYSIZE(states[s].ascii_next)
+					&& (r = states[s].ascii_next[c]) != -1)
+			{
+				if (r & 1)
+					return true;
+
+				s = r >> 1;
+				continue;
+			}
+
+			if (states.size() >= MAX_STATES)
+			{
+				if (++flushes > MAX_FLUSHES)
+				{
+					// expression leads to states explosion, DFA doesn't worth it
+					dfa_usable.store(false, std::memory_order_release);
+					states.clear();
+					states_index.clear();
+					return true;
+				}
+				s = Flush(s);
+			}
+
+			r = Next(s, c);
+			if (r & 1)
+				return true;
+
+			s = r >> 1;
+		}
+
+		return EndMatches(s);
+	}
+};
+
 RegExp::RegExp():
 	slashChar('/'),
 	backslashChar('\\'),
@@ -670,6 +1322,7 @@ bool RegExp::Compile(ReStringView const src, int options)
 	havefirst=0;
 
 	code.clear();
+	fastsearch.reset();
 
 	ReStringView Regex;
 
@@ -722,6 +1375,13 @@ bool RegExp::Compile(ReStringView const src, int options)
 	if (options&OP_OPTIMIZE)
 		Optimize();
 
+	if (!(options&OP_NOFASTSEARCH))
+	{
+		fastsearch.reset(new FastSearch(code, ignorecase, !maxbackref && !havenamedbrackets && !havelookahead));
+		if (!fastsearch->Usable())
+			fastsearch.reset();
+	}
+
 	return true;
 }
 
@@ -3521,6 +4181,9 @@ bool RegExp::SearchEx(ReStringView const text, size_t const From, RegExpMatch* m
 	if (minlength && tempend-start<minlength)
 		return false;
 
+	if (fastsearch && !fastsearch->MayMatch(start, textstart, tempend))
+		return false;
+
 	std::vector<StateStackItem> stack;
 	stack.reserve(8);
 
@@ -3757,4 +4420,36 @@ TEST_CASE("regex")
 	}
 
 }
+
+TEST_CASE("regex.fastsearch")
+{
+	const wchar_t* Patterns[] =
+	{
+		L"/ERROR.*timeout/", L"/^ab/", L"/ab$/", L"/\\bfoo\\b/", L"/(ab|cd)+e/", L"/a{2,3}b/", L"/(a|b)*c/i",
+		L"/[^ab]c/", L"/a(b(c|d))?e/", L"/^$/", L"/(ab){2}/", L"/a.*?b/", L"/(a|)b/", L"/\\Aab/", L"/(a*)*b/",
+	};
+
+	const wchar_t* Texts[] =
+	{
+		L"", L"ab", L"xab", L"abx", L"foo bar", L"foobar", L"cdabe", L"aaab", L"xc", L"ace", L"abab", L"a\nb",
+		L"ERROR: connection timeout", L"ERROR: connection reset", L"b", L"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaac",
+	};
+
+	for (const auto Pattern: Patterns)
+	{
+		RegExp Fast, Slow;
+		REQUIRE(Fast.Compile(Pattern, OP_PERLSTYLE|OP_OPTIMIZE));
+		REQUIRE(Slow.Compile(Pattern, OP_PERLSTYLE|OP_OPTIMIZE|OP_NOFASTSEARCH));
+
+		for (const auto Text: Texts)
+		{
+			RegExpMatch FastMatch = { -1, -1 }, SlowMatch = { -1, -1 };
+			int FastCount = 1, SlowCount = 1;
+			const bool FastFound = Fast.Search(Text, &FastMatch, FastCount);
+			REQUIRE(FastFound == Slow.Search(Text, &SlowMatch, SlowCount));
+			REQUIRE(FastMatch.start == SlowMatch.start);
+			REQUIRE(FastMatch.end == SlowMatch.end);
+		}
+	}
+}
 #endif
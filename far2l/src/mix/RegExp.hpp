@@ -169,6 +169,7 @@ enum
 	//! Replace backslash with slash, used
 	//! when RegExp source embedded in c++ sources
 	OP_CPPMODE      =0x0080,
+	OP_NOFASTSEARCH =0x0100, // dont use DFA-based rejection in Search, i.e. only backtracking matcher
 };
 
 //! Hash table with match info
@@ -188,6 +189,7 @@ public:
 	struct REOpCode;
 	class UniSet;
 	struct StateStackItem;
+	class FastSearch;
 
 private:
 		// code
@@ -198,6 +200,8 @@ private:
 		std::unique_ptr<UniSet> firstptr;
 		UniSet& first;
 
+		std::unique_ptr<FastSearch> fastsearch;
+
 		int havefirst{};
 		int havelookahead{};
 
@@ -65,13 +65,13 @@ enum PANEL_COLUMN_TYPE
 	GROUP_COLUMN,
 	NUMLINK_COLUMN,
 	RESERVED_COLUMN1,
-	RESERVED_COLUMN2,
+	GITSTATUS_COLUMN,
 	CUSTOM_COLUMN0,
 	CUSTOM_COLUMN_LAST = CUSTOM_COLUMN0 + 19,
 };
 #endif
 
-int ColumnTypeWidth[32] = {0, 9, 9, 8, 5, 14, 14, 14, 14, 10, 0, 0, 3, 3, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+int ColumnTypeWidth[32] = {0, 9, 9, 8, 5, 14, 14, 14, 14, 10, 0, 0, 3, 3, 6, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 		0, 0, 0, 0, 0 };
 
 static const wchar_t *ColumnSymbol[] = {L"N", L"S", L"P", L"D", L"T", L"DM", L"DC", L"DA", L"DE", L"A", L"Z",
@@ -286,7 +286,10 @@ void TextToViewSettings(const wchar_t *ColumnTitles, const wchar_t *ColumnWidths
 
 				Ptr++;
 			}
+		} else if (strArgName == ColumnSymbol[GITSTATUS_COLUMN]) {
+			ViewColumnTypes[ColumnCount] = GITSTATUS_COLUMN;
 		} else {
+			// G with size modifiers is legacy alias of P kept for old configs
 			if (strArgName.At(0) == L'S' || strArgName.At(0) == L'P' || strArgName.At(0) == L'G') {
 				unsigned int &ColumnType = ViewColumnTypes[ColumnCount];
 				ColumnType = (strArgName.At(0) == L'S') ? SIZE_COLUMN : PHYSICAL_COLUMN;
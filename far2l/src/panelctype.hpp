@@ -49,7 +49,7 @@ enum PANEL_COLUMN_TYPE
 	GROUP_COLUMN,
 	NUMLINK_COLUMN,
 	RESERVED_COLUMN1,
-	RESERVED_COLUMN2,
+	GITSTATUS_COLUMN,
 	CUSTOM_COLUMN0,
 	CUSTOM_COLUMN_LAST = CUSTOM_COLUMN0 + 19,
 };
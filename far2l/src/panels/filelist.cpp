@@ -2946,6 +2946,7 @@ void FileList::SetViewMode(int ViewMode)
 	int OldPhysical = IsColumnDisplayed(PHYSICAL_COLUMN);
 	int OldNumLink = IsColumnDisplayed(NUMLINK_COLUMN);
 	int OldDiz = IsColumnDisplayed(DIZ_COLUMN);
+	int OldGitStatus = IsColumnDisplayed(GITSTATUS_COLUMN);
 	PrepareViewSettings(ViewMode, nullptr);
 	int NewOwner = IsColumnDisplayed(OWNER_COLUMN);
 	int NewGroup = IsColumnDisplayed(GROUP_COLUMN);
@@ -2963,6 +2964,9 @@ void FileList::SetViewMode(int ViewMode)
 	if (!OldDiz && NewDiz)
 		ReadDiz();
 
+	if (!OldGitStatus && IsColumnDisplayed(GITSTATUS_COLUMN))
+		UpdateGitStatus(true);
+
 	if (ViewSettings.FullScreen && !CurFullScreen) {
 		if (Y2 > 0)
 			SetPosition(0, Y1, ScrX, Y2);
@@ -41,6 +41,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "plugins.hpp"
 #include "ConfigRW.hpp"
 #include "FSNotify.h"
+#include "GitStatus.hpp"
 #include <memory>
 #include <map>
 #include <vector>
@@ -187,6 +188,8 @@ private:
 	DList<PrevDataItem *> PrevDataList;
 	DList<PluginsListItem *> PluginsList;
 	std::unique_ptr<IFSNotify> ListChange;
+	GitDirStatusPtr GitStatus;
+	unsigned int GitStatusGen = 0;
 	long UpperFolderTopFile, LastCurFile;
 	long ReturnCurrentFile;
 	long SelFileCount;
@@ -252,6 +255,8 @@ private:
 		IgnoreVisible - обновить, даже если панель невидима
 	*/
 	void ReadFileNames(int KeepSelection, int IgnoreVisible, int DrawMessage, int CanBeAnnoying);
+	bool NeedGitStatus();
+	bool UpdateGitStatus(bool Revalidate);
 	void UpdatePlugin(int KeepSelection, int IgnoreVisible);
 
 	void MoveSelection(ListDataVec &NewList, ListDataVec &OldList);
@@ -175,6 +175,9 @@ void FileList::ShowFileList(int Fast)
 				case NUMLINK_COLUMN:
 					IDMessage = Msg::ColumnMumLinks;
 					break;
+				case GITSTATUS_COLUMN:
+					IDMessage = Msg::ColumnGitStatus;
+					break;
 			}
 
 			if (IDMessage != FARLANGMSGID_BAD)
@@ -400,6 +403,20 @@ void FileList::ShowFileList(int Fast)
 		CtrlObject->Cp()->RedrawKeyBar();
 }
 
+static int GitStatusColor(GitFileStatus Status)
+{
+	switch (Status) {
+		case GFS_MODIFIED:
+			return COL_PANELGITMODIFIED;
+		case GFS_UNTRACKED:
+			return COL_PANELGITUNTRACKED;
+		case GFS_IGNORED:
+			return COL_PANELGITIGNORED;
+		default:
+			return -1;
+	}
+}
+
 DWORD64 FileList::GetShowColor(int Position, int ColorType)
 {
 	DWORD64 ColorAttr = FarColorToReal(COL_PANELTEXT);
@@ -419,6 +436,13 @@ DWORD64 FileList::GetShowColor(int Position, int ColorType)
 
 		if (!ColorAttr || !Opt.Highlight)
 			ColorAttr = FarColorToReal(FarColor[Pos]);
+
+		if (Pos == HIGHLIGHTCOLOR_NORMAL && ColorType == HIGHLIGHTCOLORTYPE_FILE && GitStatus
+				&& Opt.Highlight && Opt.HighlightGitStatus) {
+			int GitColor = GitStatusColor(GitStatus->Get(ListData[Position]->strName));
+			if (GitColor >= 0)
+				ColorAttr = FarColorToReal(GitColor);
+		}
 	}
 
 //	return (4 << 4) + 15;
@@ -1249,6 +1273,20 @@ void FileList::ShowList(int ShowStatus, int StartColumn, OpenPluginInfo &Info)
 							FS << fmt::Cells() << fmt::Size(ColumnWidth) << ListData[ListPos]->NumberOfLinks;
 							break;
 						}
+
+						case GITSTATUS_COLUMN: {
+							const GitFileStatus Status =
+									GitStatus ? GitStatus->Get(ListData[ListPos]->strName) : GFS_CLEAN;
+							const int GitColor = GitStatusColor(Status);
+
+							if (!ShowStatus && GitColor >= 0 && !ListData[ListPos]->Selected
+									&& (CurFile != ListPos || !Focus))
+								SetFarColor(GitColor);
+
+							const wchar_t StatusStr[2] = {GitStatusChar(Status), 0};
+							FS << fmt::Cells() << fmt::LeftAlign() << fmt::Size(ColumnWidth) << StatusStr;
+							break;
+						}
 					}
 				}
 			} else {
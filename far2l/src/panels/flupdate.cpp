@@ -407,6 +407,7 @@ void FileList::ReadFileNames(int KeepSelection, int IgnoreVisible, int DrawMessa
 		CtrlObject->HiFiles->GetHiColor(&ListData[0], ListData.Count(), false, &MarkLM);
 
 	CreateChangeNotification(FALSE);
+	UpdateGitStatus(true);
 	CorrectPosition();
 
 	if (KeepSelection || PrevSelFileCount > 0) {
@@ -440,6 +441,27 @@ void FileList::ReadFileNames(int KeepSelection, int IgnoreVisible, int DrawMessa
 	FarChDir(strSaveDir);	//???
 }
 
+bool FileList::NeedGitStatus()
+{
+	return PanelMode == NORMAL_PANEL
+			&& (IsColumnDisplayed(GITSTATUS_COLUMN) || (Opt.Highlight && Opt.HighlightGitStatus));
+}
+
+// возвращает true если статус изменился и панель надо перерисовать
+bool FileList::UpdateGitStatus(bool Revalidate)
+{
+	GitStatusGen = GitStatusGeneration();
+	GitDirStatusPtr NewGitStatus;
+	if (NeedGitStatus())
+		NewGitStatus = GitStatusQuery(strCurDir, Revalidate);
+
+	if (NewGitStatus == GitStatus)
+		return false;
+
+	GitStatus.swap(NewGitStatus);
+	return true;
+}
+
 /*
 	$ 22.06.2001 SKV
 	Добавлен параметр для вызова после исполнения команды.
@@ -447,6 +469,11 @@ void FileList::ReadFileNames(int KeepSelection, int IgnoreVisible, int DrawMessa
 int FileList::UpdateIfChanged(int UpdateMode)
 {
 	//_SVS(SysLog(L"CurDir='%ls' Opt.AutoUpdateLimit=%d <= FileCount=%d",CurDir,Opt.AutoUpdateLimit,ListData.Count()));
+	// статус git вычисляется в фоне, подхватываем готовый результат
+	if (GitStatusGen != GitStatusGeneration() && IsVisible() && UpdateGitStatus(false)
+			&& UpdateMode == UIC_UPDATE_NORMAL)
+		Redraw();
+
 	if (!Opt.AutoUpdateLimit || DWORD(ListData.Count()) <= Opt.AutoUpdateLimit) {
 		/*
 			$ 19.12.2001 VVM
@@ -558,6 +585,7 @@ void FileList::UpdatePlugin(int KeepSelection, int IgnoreVisible)
 	FARString strCurName, strNextCurName;
 	ListDataVec OldData;
 	CloseChangeNotification();
+	GitStatus.reset();
 	LastCurFile = -1;
 	OpenPluginInfo Info;
 	CtrlObject->Plugins.GetOpenPluginInfo(hPlugin, &Info);
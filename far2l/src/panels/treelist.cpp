@@ -80,6 +80,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "filestr.hpp"
 #include "wakeful.hpp"
 #include <algorithm>
+#include <unordered_map>
 
 static int _cdecl SortCacheList(const void *el1, const void *el2);
 static int StaticSortNumeric;
@@ -178,6 +179,128 @@ static struct TreeListCache
 
 } TreeCache, tempTreeCache;
 
+/*
+	Файл дерева хранится в двоичном виде: заголовок и записи фиксированного
+	размера, за каждой из которых следует хвост имени. Имя записи задается
+	длиной общей с предыдущим именем части и этим хвостом, так что файл
+	читается одним Read() и не требует разбора строк.
+*/
+struct TreeFileHeader
+{
+	char Magic[4];
+	uint32_t CharSize;
+	uint32_t Count;
+	uint32_t Reserved;
+};
+
+struct TreeFileRecord
+{
+	uint64_t DirStamp;
+	uint32_t Shared;	// длина общей с предыдущим именем части
+	uint32_t Length;	// длина хвоста имени, следующего за записью
+	uint32_t Flags;
+	uint32_t Reserved;
+};
+
+enum TREEFILE_FLAGS
+{
+	TREEFILE_EXPANDABLE = 0x1,
+	TREEFILE_COLLAPSED  = 0x2,
+};
+
+static const char TreeFileMagic[4] = {'F', 'T', 'r', '2'};
+
+class TreeFileWriter
+{
+	CachedWrite Cache;
+	std::wstring LastName;
+	bool Success;
+
+public:
+	TreeFileWriter(File &TreeFile, uint32_t Count) : Cache(TreeFile)
+	{
+		TreeFileHeader Header{};
+		memcpy(Header.Magic, TreeFileMagic, sizeof(Header.Magic));
+		Header.CharSize = sizeof(wchar_t);
+		Header.Count = Count;
+		Success = Cache.Write(&Header, sizeof(Header));
+	}
+
+	void Add(const wchar_t *Name, size_t Length, uint32_t Flags, uint64_t DirStamp)
+	{
+		size_t Shared = 0;
+		for (const size_t MaxShared = std::min(Length, LastName.size());
+				Shared < MaxShared && LastName[Shared] == Name[Shared];)
+			++Shared;
+
+		TreeFileRecord Record{};
+		Record.DirStamp = DirStamp;
+		Record.Shared = static_cast<uint32_t>(Shared);
+		Record.Length = static_cast<uint32_t>(Length - Shared);
+		Record.Flags = Flags;
+		LastName.assign(Name, Length);
+
+		if (Success)
+			Success = Cache.Write(&Record, sizeof(Record))
+				&& (!Record.Length || Cache.Write(Name + Shared, Record.Length * sizeof(wchar_t)));
+	}
+
+	bool Finish() { return Cache.Flush() && Success; }
+};
+
+/*
+	Вызывает Visitor(Name, Flags, DirStamp) для каждой записи файла дерева.
+	Возвращает false, если файл испорчен или записан в другом формате.
+*/
+template <class VisitorT>
+static bool ReadTreeFileRecords(File &TreeFile, VisitorT Visitor)
+{
+	UINT64 FileSize = 0;
+	if (!TreeFile.GetSize(FileSize) || FileSize < sizeof(TreeFileHeader) || FileSize > 0x40000000)
+		return false;
+
+	std::vector<char> Data(static_cast<size_t>(FileSize));
+	for (size_t Pos = 0; Pos < Data.size();) {
+		DWORD ReadSize = 0;
+		if (!TreeFile.Read(&Data[Pos], static_cast<DWORD>(Data.size() - Pos), &ReadSize) || !ReadSize)
+			return false;
+		Pos+= ReadSize;
+	}
+
+	TreeFileHeader Header;
+	memcpy(&Header, Data.data(), sizeof(Header));
+	if (memcmp(Header.Magic, TreeFileMagic, sizeof(Header.Magic)) != 0 || Header.CharSize != sizeof(wchar_t))
+		return false;
+
+	std::wstring Name;
+	size_t Pos = sizeof(Header);
+	for (uint32_t I = 0; I < Header.Count; ++I) {
+		TreeFileRecord Record;
+		if (Data.size() - Pos < sizeof(Record))
+			return false;
+
+		memcpy(&Record, &Data[Pos], sizeof(Record));
+		Pos+= sizeof(Record);
+
+		const size_t TailSize = static_cast<size_t>(Record.Length) * sizeof(wchar_t);
+		if (Record.Shared > Name.size() || Data.size() - Pos < TailSize)
+			return false;
+
+		Name.resize(Record.Shared + Record.Length);
+		memcpy(&Name[Record.Shared], &Data[Pos], TailSize);
+		Pos+= TailSize;
+
+		Visitor(Name, Record.Flags, Record.DirStamp);
+	}
+
+	return true;
+}
+
+static uint64_t TreeDirStamp(const FAR_FIND_DATA_EX &fdata)
+{
+	return (uint64_t(fdata.ftLastWriteTime.dwHighDateTime) << 32) | fdata.ftLastWriteTime.dwLowDateTime;
+}
+
 TreeList::TreeList(int IsPanel)
 	:
 	PrevMacroMode(-1),
@@ -423,34 +546,12 @@ void TreeList::Update(int Mode)
 
 		SyncDir();
 
-		bool removedInvalid = false;
-		for (int i = TreeCount - 1; i >= 0; --i) {
-			TreeItem *item = ListData[i].get();
-			if (!item)
-				continue;
-			if (apiGetFileAttributes(item->strName) == INVALID_FILE_ATTRIBUTES) {
-				ListData.erase(ListData.begin() + i);
-				removedInvalid = true;
-				if (CurFile > i)
-					--CurFile;
-				if (CurTopFile > i)
-					--CurTopFile;
-				if (WorkDir > i)
-					--WorkDir;
-			}
-		}
-
-		if (removedInvalid) {
-			TreeCount = static_cast<long>(ListData.size());
-			VisibleDirty = true;
-			if (TreeCount > 0) {
-				FillLastData();
-				if (!strPanelDir.IsEmpty() && !SetDirPosition(strPanelDir))
-					SyncDir();
-				CorrectPosition();
-				SaveTreeFile();
-			} else
-				Show();
+		// вместо проверки каждого элемента дерева перечитываем только видимые
+		// каталоги, изменившиеся с момента последнего чтения
+		if (RevalidateVisible()) {
+			if (!strPanelDir.IsEmpty() && !SetDirPosition(strPanelDir))
+				SyncDir();
+			CorrectPosition();
 		}
 	}
 	else if (!RetFromReadTree) {
@@ -486,6 +587,8 @@ int TreeList::ReadTree(int depth)
 	ListData.emplace_back(std::make_unique<TreeItem>());
 	ListData[0]->Clear();
 	ListData[0]->strName = strRoot;
+	if (apiGetFindDataEx(strRoot, fdata))
+		ListData[0]->DirStamp = TreeDirStamp(fdata);
 	SaveScreen SaveScrTree;
 	UndoGlobalSaveScrPtr UndSaveScr(&SaveScrTree);
 	/*
@@ -525,12 +628,19 @@ int TreeList::ReadTree(int depth)
 		auto item = std::make_unique<TreeItem>();
 		item->Clear();
 		item->strName = strFullName;
+		item->DirStamp = TreeDirStamp(fdata);
 		if (fdata.dwFileAttributes & FILE_ATTRIBUTE_PINNED)
 			item->Expandable = true;
 		ListData.emplace_back(std::move(item));
 		TreeCount = static_cast<long>(ListData.size());
 	}
 
+	// прочитанное не полностью дерево должно быть перепроверено при показе
+	if (AscAbort) {
+		for (auto &item : ListData)
+			item->DirStamp = 0;
+	}
+
 	if (AscAbort && !Flags.Check(FTREELIST_ISPANEL)) {
 		VisibleDirty = true;
 		ListData.clear();
@@ -587,23 +697,21 @@ void TreeList::SaveTreeFile()
 		/* tran $ */
 	}
 
-	bool Success = true;
-	CachedWrite Cache(TreeFile);
-	for (I = 0; I < TreeCount && Success; I++) {
-		FARString line;
-		if (RootLength >= ListData[I]->strName.GetLength())
-			line = L"/";
-		else
-			line = ListData[I]->strName.SubStr(RootLength);
-
-		line+= L'\2';
-		line+= (L'0' + (ListData[I]->Expandable ? 1 : 0) + (ListData[I]->Collapsed  ? 2 : 0));
-		line+= L'\n';
-
-		DWORD Size = static_cast<DWORD>(line.GetLength() * sizeof(WCHAR));
-		Success = Cache.Write(line.CPtr(), Size);
+	bool Success;
+	{
+		TreeFileWriter Writer(TreeFile, static_cast<uint32_t>(TreeCount));
+		for (I = 0; I < TreeCount; I++) {
+			const TreeItem *Item = ListData[I].get();
+			const uint32_t ItemFlags = (Item->Expandable ? TREEFILE_EXPANDABLE : 0)
+					| (Item->Collapsed ? TREEFILE_COLLAPSED : 0);
+			if (RootLength >= Item->strName.GetLength())
+				Writer.Add(L"/", 1, ItemFlags, Item->DirStamp);
+			else
+				Writer.Add(Item->strName.CPtr() + RootLength, Item->strName.GetLength() - RootLength,
+						ItemFlags, Item->DirStamp);
+		}
+		Success = Writer.Finish();
 	}
-	Cache.Flush();
 	TreeFile.Close();
 
 	if (!Success) {
@@ -848,11 +956,11 @@ bool TreeList::ExpandDirectory(const wchar_t *Path, int depth)
 	FAR_FIND_DATA_EX fdata;
 	FARString strDirName;
 	FARString strFullName;
-	DWORD FileAttr = apiGetFileAttributes(Path);
 
-	if (FileAttr == INVALID_FILE_ATTRIBUTES || !(FileAttr & FILE_ATTRIBUTE_DIRECTORY))
+	if (!apiGetFindDataEx(Path, fdata) || !(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
 		return false;
 
+	const uint64_t PathStamp = TreeDirStamp(fdata);
 	const size_t originalSize = ListData.size();
 	int Count = 0;
 	int FirstCall = TRUE;
@@ -889,6 +997,7 @@ bool TreeList::ExpandDirectory(const wchar_t *Path, int depth)
 		auto item = std::make_unique<TreeItem>();
 		item->Clear();
 		item->strName = strFullName;
+		item->DirStamp = TreeDirStamp(fdata);
 		if (fdata.dwFileAttributes & FILE_ATTRIBUTE_PINNED)
 			item->Expandable = true;
 		ListData.emplace_back(std::move(item));
@@ -916,9 +1025,211 @@ bool TreeList::ExpandDirectory(const wchar_t *Path, int depth)
 		return false;
 	}
 
+	const long PathIndex = FindFile(strDirName);
+	if (PathIndex >= 0)
+		ListData[PathIndex]->DirStamp = PathStamp;
+
 	return true;
 }
 
+/*
+	Перечитывает непосредственные подкаталоги тех из указанных каталогов,
+	время модификации которых изменилось с момента их последнего чтения:
+	добавляет появившиеся (их содержимое будет прочитано при разворачивании)
+	и удаляет исчезнувшие вместе с их поддеревьями.
+	Возвращает true, если структура дерева изменилась.
+*/
+bool TreeList::RevalidateDirectories(std::vector<int> Indices)
+{
+	if (TreeCount <= 0 || !Flags.Check(FTREELIST_TREEISPREPARED))
+		return false;
+
+	std::sort(Indices.begin(), Indices.end());
+	Indices.erase(std::unique(Indices.begin(), Indices.end()), Indices.end());
+
+	const auto SubtreeEnd = [&](int Index) {
+		int End = Index + 1;
+		while (End < static_cast<int>(ListData.size()) && ListData[End]->Depth > ListData[Index]->Depth)
+			++End;
+		return End;
+	};
+
+	const FARString strCurName(ListData[std::clamp<int>(CurFile, 0, TreeCount - 1)]->strName);
+	const FARString strTopName(ListData[std::clamp<int>(CurTopFile, 0, TreeCount - 1)]->strName);
+	const FARString strWorkName(ListData[std::clamp<int>(WorkDir, 0, TreeCount - 1)]->strName);
+
+	std::vector<std::unique_ptr<TreeItem>> NewItems;
+	bool Restructured = false, StampsChanged = false;
+	FAR_FIND_DATA_EX fdata;
+	FARString strFullName;
+
+	// обходим с конца, чтобы удаление поддеревьев не сдвигало еще не обработанные индексы
+	for (auto it = Indices.rbegin(); it != Indices.rend(); ++it) {
+		const int Index = *it;
+		if (Index < 0 || Index >= static_cast<int>(ListData.size()))
+			continue;
+
+		TreeItem *Item = ListData[Index].get();
+		if (Item->Expandable)
+			continue;
+
+		if (!apiGetFindDataEx(Item->strName, fdata) || !(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+			if (Index > 0) {
+				ListData.erase(ListData.begin() + Index, ListData.begin() + SubtreeEnd(Index));
+				Restructured = true;
+			}
+			continue;
+		}
+
+		const uint64_t Stamp = TreeDirStamp(fdata);
+		if (Stamp == Item->DirStamp)
+			continue;
+
+		Item->DirStamp = Stamp;
+		StampsChanged = true;
+		if (fdata.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+			continue;
+
+		std::unordered_map<std::wstring, int> Children;
+		for (int J = Index + 1, End = SubtreeEnd(Index); J < End; ++J) {
+			if (ListData[J]->Depth == Item->Depth + 1)
+				Children.emplace(ListData[J]->strName.CPtr(), J);
+		}
+
+		ScanTree ScTree(FALSE, FALSE); // only direct children, deeper levels are revalidated by own stamps
+		ScTree.SetFindPath(Item->strName, L"*", FSCANTREE_NOFILES | FSCANTREE_NODEVICES, Opt.Tree.ExclSubTreeMask);
+		while (ScTree.GetNextName(&fdata, strFullName)) {
+			if (!(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				continue;
+
+			const auto &Child = Children.find(strFullName.CPtr());
+			if (Child != Children.end()) {
+				Child->second = -1;
+				continue;
+			}
+
+			auto NewItem = std::make_unique<TreeItem>();
+			NewItem->Clear();
+			NewItem->strName = strFullName;
+			NewItem->Expandable = !(fdata.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+			NewItems.emplace_back(std::move(NewItem));
+		}
+
+		std::vector<int> Vanished;
+		for (const auto &Child : Children) {
+			if (Child.second >= 0)
+				Vanished.push_back(Child.second);
+		}
+
+		std::sort(Vanished.rbegin(), Vanished.rend());
+		for (const int J : Vanished)
+			ListData.erase(ListData.begin() + J, ListData.begin() + SubtreeEnd(J));
+
+		Restructured = Restructured || !Vanished.empty();
+	}
+
+	if (!NewItems.empty()) {
+		for (auto &NewItem : NewItems)
+			ListData.emplace_back(std::move(NewItem));
+		Restructured = true;
+	}
+
+	if (Restructured) {
+		SortAndDeduplicate();
+		FillLastData();
+		CurFile = FindNearest(strCurName);
+		CurTopFile = FindNearest(strTopName);
+		WorkDir = FindNearest(strWorkName);
+	}
+
+	if (Restructured || StampsChanged)
+		SaveTreeFile();
+
+	return Restructured;
+}
+
+bool TreeList::RevalidateVisible()
+{
+	if (TreeCount <= 0 || CurFile < 0 || CurFile >= TreeCount)
+		return false;
+
+	std::vector<int> Indices;
+	for (int I = CurFile; I >= 0; I = ListData[I]->ParentIndex)
+		Indices.push_back(I);
+
+	for (int Vis = std::max(ToVisibleIndex(CurTopFile), 0), Height = GetVisibleHeight(); Height > 0; ++Vis, --Height) {
+		const int I = FromVisibleIndex(Vis);
+		if (I < 0)
+			break;
+
+		if (!ListData[I]->Collapsed)
+			Indices.push_back(I);
+
+		if (ListData[I]->ParentIndex >= 0)
+			Indices.push_back(ListData[I]->ParentIndex);
+	}
+
+	return RevalidateDirectories(std::move(Indices));
+}
+
+long TreeList::FindNearest(FARString strName)
+{
+	for (;;) {
+		const long Pos = FindFile(strName);
+		if (Pos >= 0)
+			return Pos;
+
+		if (!CutToSlash(strName))
+			return 0;
+
+		DeleteEndSlash(strName, true);
+		if (strName.IsEmpty())
+			return 0;
+	}
+}
+
+/*
+	Следим за каталогом, подкаталоги которого окружают курсор: изменения в нем
+	перечитываются в UpdateIfChanged() без ожидания явного обновления панели.
+*/
+void TreeList::UpdateChangeNotification(bool Rearm)
+{
+	if (TreeCount <= 0 || CurFile < 0 || CurFile >= TreeCount)
+		return;
+
+	const TreeItem *Item = ListData[CurFile].get();
+	const FARString &strDir = (Item->ParentIndex >= 0) ? ListData[Item->ParentIndex]->strName : Item->strName;
+	if (!Rearm && TreeChange && !StrCmp(strDir, strTreeChangeDir))
+		return;
+
+	strTreeChangeDir = strDir;
+	TreeChange.reset();
+	TreeChange.reset(IFSNotify_Create(strDir.GetMB(), false, FSNW_NAMES));
+}
+
+int TreeList::UpdateIfChanged(int UpdateMode)
+{
+	if (!IsVisible() || TreeCount <= 0 || !Flags.Check(FTREELIST_TREEISPREPARED)) {
+		TreeChange.reset();
+		strTreeChangeDir.Clear();
+		return FALSE;
+	}
+
+	const bool Changed = TreeChange && TreeChange->Check();
+	UpdateChangeNotification(Changed);
+
+	if (!Changed && UpdateMode == UIC_UPDATE_NORMAL)
+		return FALSE;
+
+	if (!RevalidateVisible())
+		return FALSE;
+
+	if (UpdateMode == UIC_UPDATE_NORMAL)
+		Show();
+
+	return TRUE;
+}
+
 UINT TreeList::CountSlash(const wchar_t *Str)
 {
 	UINT Count = 0;
@@ -1387,7 +1698,8 @@ void TreeList::Expand()
 		Redraw();
 		SaveTreeFile();
 		saved = true;
-	}
+	} else if (RevalidateDirectories(std::vector<int>{CurFile}))
+		saved = true;
 	VisibleDirty = true;
 	DisplayTree(TRUE);
 
@@ -1701,73 +2013,36 @@ int TreeList::ReadTreeFile()
 	VisibleDirty = true;
 	ListData.clear();
 	TreeCount = 0;
-	uint64_t file_size;
-	TreeFile.GetSize(file_size);
-	if (file_size > 0)
-		ListData.reserve(static_cast<size_t>(file_size / 64)); 
-
 	{
-		FARString strLastDirName;
-		GetFileString GetStr(TreeFile);
-		LPWSTR Record = nullptr;
-		int RecordLength = 0;
 		FARString prefix;
 		if (RootLength)
 			prefix = FARString(strRoot, RootLength);
 
-		std::vector<wchar_t> last_record;
-		size_t last_record_len = 0;
-		while (GetStr.GetString(&Record, CP_WIDE_LE, RecordLength) > 0) {
-			if (!Record || RecordLength <= 0)
-				continue;
-			wchar_t* begin = Record;
-			wchar_t* end   = Record + RecordLength;
-
-			if (end > begin && *(end - 1) == L'\n')
-				--end;
-
-			size_t record_len = static_cast<size_t>(end - begin);
-			if (!record_len)
-				continue;
-
-			if (record_len == last_record_len &&
-				(last_record_len == 0 || memcmp(begin, last_record.data(), record_len * sizeof(wchar_t)) == 0)) {
-				continue;
-			}
-
-			last_record.assign(begin, end);
-			last_record_len = record_len;
-
-			bool expandableFlag = false;
-			bool collapsedFlag = false;
-			if (record_len >= 2 && *(end - 2) == L'\2')
-			{
-				expandableFlag = (*(end - 1) - L'0') & 1;
-				collapsedFlag = (*(end - 1) - L'0') & 2;
-				end -= 2;
-				record_len -= 2;
-				if (!record_len)
-					continue;
-			}
+		const bool Valid = ReadTreeFileRecords(TreeFile,
+			[&](const std::wstring &Name, uint32_t ItemFlags, uint64_t DirStamp) {
+				FARString strDirName;
+				if (RootLength)
+					strDirName = prefix;
 
-			FARString strDirName;
-			if (RootLength)
-				strDirName = prefix;
+				strDirName.Append(Name.c_str(), Name.size());
 
-			strDirName.Append(begin, record_len);
+				if (RootLength > 0 && strDirName.At(RootLength - 1) != L':' && IsSlash(strDirName.At(RootLength))
+						&& !strDirName.At(RootLength + 1)) {
+					strDirName.Truncate(RootLength);
+				}
 
-			if (RootLength > 0 && strDirName.At(RootLength - 1) != L':' && IsSlash(strDirName.At(RootLength))
-					&& !strDirName.At(RootLength + 1)) {
-				strDirName.Truncate(RootLength);
-			}
+				auto item = std::make_unique<TreeItem>();
+				item->Clear();
+				item->strName = strDirName;
+				item->Expandable = (ItemFlags & TREEFILE_EXPANDABLE) != 0;
+				item->Collapsed = (ItemFlags & TREEFILE_COLLAPSED) != 0;
+				item->DirStamp = DirStamp;
+				ListData.emplace_back(std::move(item));
+			});
 
-			auto item = std::make_unique<TreeItem>();
-			item->Clear();
-			item->strName = strDirName;
-			item->Expandable = expandableFlag;
-			item->Collapsed = collapsedFlag;
-			ListData.emplace_back(std::move(item));
-		}
+		// файл старого формата или испорченный - дерево будет перечитано
+		if (!Valid)
+			ListData.clear();
 	}
 
 	TreeFile.Close();
@@ -1986,7 +2261,7 @@ void TreeList::ClearCache(int EnableFreeMem)
 void TreeList::ReadCache(const wchar_t *TreeRoot)
 {
 	FARString strTreeName;
-	FILE *TreeFile = nullptr;
+	File TreeFile;
 
 	if (!StrCmp(MkTreeFileName(TreeRoot, strTreeName), TreeCache.strTreeName))
 		return;
@@ -1994,67 +2269,51 @@ void TreeList::ReadCache(const wchar_t *TreeRoot)
 	if (TreeCache.TreeCount)
 		FlushCache();
 
-	if (MustBeCached(TreeRoot) || !(TreeFile = fopen(Wide2MB(strTreeName).c_str(), FOPEN_READ)))
+	if (MustBeCached(TreeRoot) || !TreeFile.Open(strTreeName, FILE_READ_DATA, FILE_SHARE_READ, nullptr, OPEN_EXISTING))
 		if (!GetCacheTreeName(TreeRoot, strTreeName, FALSE)
-				|| !(TreeFile = fopen(Wide2MB(strTreeName).c_str(), FOPEN_READ))) {
+				|| !TreeFile.Open(strTreeName, FILE_READ_DATA, FILE_SHARE_READ, nullptr, OPEN_EXISTING)) {
 			ClearCache(1);
 			return;
 		}
 
-	TreeCache.strTreeName = strTreeName;
-	wchar_t *DirName = new (std::nothrow) wchar_t[NT_MAX_PATH];
-
-	if (DirName) {
-		while (fgetws(DirName, NT_MAX_PATH, TreeFile)) {
-			if (!IsSlash(*DirName))
-				continue;
-
-			wchar_t *ChPtr = wcschr(DirName, L'\n');
-
-			if (ChPtr)
-				*ChPtr = 0;
+	const bool Valid = ReadTreeFileRecords(TreeFile, [](const std::wstring &Name, uint32_t, uint64_t) {
+		if (!Name.empty() && IsSlash(Name[0]))
+			TreeCache.Add(Name.c_str());
+	});
 
-			ChPtr = wcschr(DirName, L'\2');
-
-			if (ChPtr)
-				*ChPtr = 0;
-
-			TreeCache.Add(DirName);
-		}
-
-		delete[] DirName;
-	}
-
-	fclose(TreeFile);
+	if (Valid)
+		TreeCache.strTreeName = strTreeName;
+	else
+		ClearCache(1);
 }
 
 void TreeList::FlushCache()
 {
-	FILE *TreeFile;
-
 	if (!TreeCache.strTreeName.IsEmpty()) {
 		DWORD FileAttributes = apiGetFileAttributes(TreeCache.strTreeName);
 
 		if (FileAttributes != INVALID_FILE_ATTRIBUTES)
 			apiSetFileAttributes(TreeCache.strTreeName, FILE_ATTRIBUTE_NORMAL);
 
-		if (!(TreeFile = fopen(Wide2MB(TreeCache.strTreeName).c_str(), FOPEN_WRITE))) {
+		File TreeFile;
+		if (!TreeFile.Open(TreeCache.strTreeName, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+					FILE_ATTRIBUTE_NORMAL)) {
 			ClearCache(1);
 			return;
 		}
 
 		far_qsort(TreeCache.ListName, TreeCache.TreeCount, sizeof(wchar_t *), SortCacheList);
 
-		bool SaveFailed = false;
-		for (int i = 0; i < TreeCache.TreeCount; i++) {
-			if (fwprintf(TreeFile, L"%ls\n", TreeCache.ListName[i]) < 0)
-				SaveFailed = true;
-		}
+		bool SaveFailed;
+		{
+			TreeFileWriter Writer(TreeFile, static_cast<uint32_t>(TreeCache.TreeCount));
+			for (int i = 0; i < TreeCache.TreeCount; i++)
+				Writer.Add(TreeCache.ListName[i], wcslen(TreeCache.ListName[i]), 0, 0);
 
-		if (fflush(TreeFile) == EOF)
-			SaveFailed = true;
+			SaveFailed = !Writer.Finish();
+		}
 
-		fclose(TreeFile);
+		TreeFile.Close();
 
 		if (SaveFailed) {
 			apiDeleteFile(TreeCache.strTreeName);
@@ -37,6 +37,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include "FARString.hpp"
 #include "panel.hpp"
+#include "FSNotify.h"
 
 enum
 {
@@ -55,6 +56,7 @@ struct TreeItem
 	bool Collapsed;
 	int Depth;	// уровень вложенности
 	int ParentIndex;
+	uint64_t DirStamp;	// время модификации каталога на момент чтения его подкаталогов, 0 - неизвестно
 
 	TreeItem() { Clear(); }
 
@@ -68,6 +70,7 @@ struct TreeItem
 		Collapsed = false;
 		Depth = 0;
 		ParentIndex = -1;
+		DirStamp = 0;
 	}
 };
 
@@ -97,6 +100,8 @@ private:
 	struct TreeItem *SaveListData;
 	long SaveTreeCount;
 	long SaveWorkDir;
+	std::unique_ptr<IFSNotify> TreeChange;
+	FARString strTreeChangeDir;
 
 private:
 	void SetMacroMode(int Restore = FALSE);
@@ -114,6 +119,10 @@ private:
 	int SetDirPosition(const wchar_t *NewDir);
 	void SortAndDeduplicate();
 	bool ExpandDirectory(const wchar_t *Path, int depth = -1);
+	bool RevalidateDirectories(std::vector<int> Indices);
+	bool RevalidateVisible();
+	void UpdateChangeNotification(bool Rearm);
+	long FindNearest(FARString strName);
 	void GetRoot();
 	Panel *GetRootPanel();
 	void SyncDir();
@@ -154,6 +163,7 @@ public:
 	virtual int64_t VMProcess(MacroOpcode OpCode, void *vParam = nullptr, int64_t iParam = 0);
 	//	virtual void KillFocus();
 	virtual void Update(int Mode);
+	virtual int UpdateIfChanged(int UpdateMode);
 	int ReadTree(int depth = -1);
 
 	virtual BOOL SetCurDir(const wchar_t *NewDir, int ClosePlugin);
@@ -226,12 +226,15 @@ void SetColors()
 		{(const wchar_t *)Msg::SetColorPanelTotalInfo,       0,            0},
 		{(const wchar_t *)Msg::SetColorPanelSelectedInfo,    0,            0},
 		{(const wchar_t *)Msg::SetColorPanelScrollbar,       0,            0},
-		{(const wchar_t *)Msg::SetColorPanelScreensNumber,   0,            0}
+		{(const wchar_t *)Msg::SetColorPanelScreensNumber,   0,            0},
+		{(const wchar_t *)Msg::SetColorPanelGitModified,     0,            0},
+		{(const wchar_t *)Msg::SetColorPanelGitUntracked,    0,            0},
+		{(const wchar_t *)Msg::SetColorPanelGitIgnored,      0,            0}
 	};
 	int PanelPaletteItems[] = {COL_PANELTEXT, COL_PANELSELECTEDTEXT, COL_PANELINFOTEXT, COL_PANELDRAGTEXT,
 			COL_PANELBOX, COL_PANELCURSOR, COL_PANELSELECTEDCURSOR, COL_PANELTITLE, COL_PANELSELECTEDTITLE,
 			COL_PANELCOLUMNTITLE, COL_PANELTOTALINFO, COL_PANELSELECTEDINFO, COL_PANELSCROLLBAR,
-			COL_PANELSCREENSNUMBER};
+			COL_PANELSCREENSNUMBER, COL_PANELGITMODIFIED, COL_PANELGITUNTRACKED, COL_PANELGITIGNORED};
 	MenuDataEx DialogItems[] = {
 		{(const wchar_t *)Msg::SetColorDialogNormal,                           LIF_SELECTED, 0},
 		{(const wchar_t *)Msg::SetColorDialogHighlighted,                      0,            0},
@@ -69,6 +69,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "WideMB.h"
 #include "UtfConvert.hpp"
 #include "LinkHighlighter.hpp"
+#include "ViewerParallelSearch.hpp"
 #include <algorithm>
 #include <cwctype>
 #include <vector>
@@ -82,6 +83,22 @@ static int InitHex = FALSE, SearchHex = FALSE;
 
 static int NextViewerID = 0;
 
+// не чаще ~25 раз в секунду перерисовываемся при изменениях файла
+static const unsigned int FileChangeCoalesceMSec = 40;
+
+static int64_t UnitsToBytes(UINT CodePage, int64_t Units)
+{
+	switch (CodePage) {
+		case CP_UTF32LE:
+		case CP_UTF32BE:
+			return Units * 4;
+		case CP_UTF16LE:
+		case CP_UTF16BE:
+			return Units * 2;
+	}
+	return Units;
+}
+
 static int CalcByteDistance(UINT CodePage, const wchar_t *begin, const wchar_t *end)
 {
 	if (begin > end)
@@ -231,6 +248,8 @@ void Viewer::SavePosCache()
 Viewer::~Viewer()
 {
 	KeepInitParameters();
+	FileChange.reset();
+	LineIndex.reset();
 
 	if (ViewFile.Opened()) {
 		ViewFile.Close();
@@ -288,6 +307,10 @@ int Viewer::OpenFile(FileHolderPtr NewFileHolder, int warning)
 	OpenFailed = false;
 
 	ViewFile.Close();
+	FileChange.reset();
+	FollowMode = false;
+	LineIndex.reset();
+	strIndexPathName.clear();
 
 	const auto &GotPathName = NewFileHolder->GetPathName();
 	DWORD FileAttr = apiGetFileAttributes(GotPathName);
@@ -360,6 +383,7 @@ int Viewer::OpenFile(FileHolderPtr NewFileHolder, int warning)
 
 	FHP = NewFileHolder;
 	CodePageChangedByUser = FALSE;
+	strIndexPathName = OpenPathName.GetMB();
 
 	ConvertNameToFull(GotPathName, strFullFileName);
 	apiGetFindDataForExactPathName(GotPathName, ViewFindData);
@@ -1529,6 +1553,19 @@ int Viewer::ProcessKey(FarKey Key)
 			return TRUE;
 		}
 		// включить/выключить скролбар
+		case KEY_CTRLF: {
+			if (m_bQuickView)
+				return FALSE;
+
+			FollowMode = !FollowMode;
+
+			if (FollowMode)
+				ProcessKey(KEY_CTRLEND);
+			else
+				Show();
+
+			return TRUE;
+		}
 		case KEY_CTRLS: {
 			ViOpt.ShowScrollbar = !ViOpt.ShowScrollbar;
 			Opt.ViOpt.ShowScrollbar = ViOpt.ShowScrollbar;
@@ -1539,41 +1576,14 @@ int Viewer::ProcessKey(FarKey Key)
 			Show();
 			return (TRUE);
 		}
-		case KEY_IDLE: {
-			if (ViewFile.Opened()) {
-				// TODO: strFullFileName -> if (DriveType!=DRIVE_REMOVABLE && !IsDriveTypeCDROM(DriveType))
-				{
-					FAR_FIND_DATA_EX NewViewFindData;
-
-					if (!apiGetFindDataForExactPathName(strFullFileName, NewViewFindData))
-						return TRUE;
+		case KEY_NONE:
+			// разбудил наблюдатель за изменениями файла
+			if (FileChange && FileChange->Check())
+				ActualizeFile();
 
-					ViewFile.ActualizeFileSize();
-					vseek(0, SEEK_END);
-					int64_t CurFileSize = vtell();
-
-					if (ViewFindData.ftLastWriteTime.dwLowDateTime
-									!= NewViewFindData.ftLastWriteTime.dwLowDateTime
-							|| ViewFindData.ftLastWriteTime.dwHighDateTime
-									!= NewViewFindData.ftLastWriteTime.dwHighDateTime
-							|| CurFileSize != FileSize) {
-						ViewFindData = NewViewFindData;
-						FileSize = CurFileSize;
-
-						if (FilePos > FileSize)
-							ProcessKey(KEY_CTRLEND);
-						else {
-							int64_t PrevLastPage = LastPage;
-							Show();
-
-							if (PrevLastPage && !LastPage) {
-								ProcessKey(KEY_CTRLEND);
-								LastPage = TRUE;
-							}
-						}
-					}
-				}
-			}
+			return FALSE;
+		case KEY_IDLE: {
+			ActualizeFile();
 
 			if (Opt.ViewerEditorClock && HostFileViewer && HostFileViewer->IsFullScreen()
 					&& Opt.ViOpt.ShowTitleBar)
@@ -2172,6 +2182,83 @@ int Viewer::ProcessKey(FarKey Key)
 	return FALSE;
 }
 
+void Viewer::WatchFileChange()
+{
+	FileChange.reset(IFSNotify_Create(strIndexPathName, false, FSNW_NAMES_AND_STATS, []() {
+		// даём изменениям накопиться, чтобы не перерисовываться чаще кадровой частоты,
+		// затем будим главный цикл - он доставит KEY_NONE
+		usleep(FileChangeCoalesceMSec * 1000);
+		INPUT_RECORD ir{};
+		ir.EventType = NOOP_EVENT;
+		DWORD dw = 0;
+		WINPORT(WriteConsoleInput)(0, &ir, 1, &dw);
+	}));
+}
+
+/*
+	Проверка изменения просматриваемого файла. Если он дописывается, то
+	закешированные данные остаются в силе и дочитывается только добавленное.
+	Пока показывается конец файла (или включено слежение) - изменения
+	отслеживаются наблюдателем, который будит вьювер сразу после записи,
+	иначе достаточно опроса по KEY_IDLE.
+*/
+void Viewer::ActualizeFile()
+{
+	if (!ViewFile.Opened())
+		return;
+
+	if (FollowMode && !LastPage) {
+		// пользователь ушёл от конца файла - слежение прекращаем
+		FollowMode = false;
+		ShowStatus();
+	}
+
+	if ((FollowMode || LastPage) && !strIndexPathName.empty()) {
+		if (!FileChange || FileChange->Check())
+			WatchFileChange();
+
+	} else
+		FileChange.reset();
+
+	bool Replaced = false;
+	if (FollowMode && ViewFile.ReopenIfReplaced()) {
+		// файл подменили (например ротация лога) - следим за новым
+		LineIndex.reset();
+		WatchFileChange();
+		Replaced = true;
+	}
+
+	// TODO: strFullFileName -> if (DriveType!=DRIVE_REMOVABLE && !IsDriveTypeCDROM(DriveType))
+	FAR_FIND_DATA_EX NewViewFindData;
+
+	if (!apiGetFindDataForExactPathName(strFullFileName, NewViewFindData))
+		return;
+
+	ViewFile.ActualizeFileSize();
+	vseek(0, SEEK_END);
+	int64_t CurFileSize = vtell();
+
+	if (Replaced
+			|| ViewFindData.ftLastWriteTime.dwLowDateTime != NewViewFindData.ftLastWriteTime.dwLowDateTime
+			|| ViewFindData.ftLastWriteTime.dwHighDateTime != NewViewFindData.ftLastWriteTime.dwHighDateTime
+			|| CurFileSize != FileSize) {
+		ViewFindData = NewViewFindData;
+		SetFileSize();
+
+		if (FollowMode || FilePos > FileSize)
+			ProcessKey(KEY_CTRLEND);
+		else {
+			int64_t PrevLastPage = LastPage;
+			Show();
+
+			if (PrevLastPage && !LastPage) {
+				ProcessKey(KEY_CTRLEND);
+				LastPage = TRUE;
+			}
+		}
+	}
+}
+
 int Viewer::ProcessMouse(MOUSE_EVENT_RECORD *MouseEvent)
 {
 	if (!(MouseEvent->dwButtonState & 3))
@@ -2690,6 +2777,85 @@ void ViewerSearchMsg(const wchar_t *MsgStr, int Percent)
 	2 - Продолжить поиск с начала файла
 */
 
+// меньшие диапазоны быстрее просмотреть последовательно, чем запускать потоки
+static const int64_t ParallelSearchMinSize = 0x400000;
+
+/*
+	Поиск в большом файле: оставшийся диапазон делится на куски, которые
+	просматриваются несколькими потоками, начиная с ближайших к позиции поиска.
+	Возвращает false если такой поиск неприменим (кодировка, размер диапазона
+	и т.п.) и надо искать по-старому.
+*/
+bool Viewer::ParallelSearch(const FARString &strSearchStr, const FARString &strMsgStr, bool Case,
+		bool WholeWords, bool ReverseSearch, int64_t &MatchPos, bool &Match, bool &Aborted)
+{
+	if (strIndexPathName.empty() || IsUTF7(VM.CodePage))
+		return false;
+
+	const int64_t Begin = ReverseSearch ? 0 : LastSelPos;
+	const int64_t End = ReverseSearch ? std::min(LastSelPos + 1, FileSize) : FileSize;
+	if (Begin < 0 || End - Begin < 1 || UnitsToBytes(VM.CodePage, End - Begin) < ParallelSearchMinSize)
+		return false;
+
+	const unsigned int Unit = (unsigned int)UnitsToBytes(VM.CodePage, 1);
+	std::unique_ptr<ViewerParallelSearch> Searcher;
+	try {
+		std::unique_ptr<FindPattern> Pattern(new FindPattern(Case && !SearchHex, WholeWords && !SearchHex));
+		if (SearchHex) {
+			// в UTF-16 hex-поиск сравнивает 16-битные значения, пусть так и остаётся
+			if (Unit != 1)
+				return false;
+
+			std::vector<uint8_t> Bytes;
+			for (size_t i = 0; i < strSearchStr.GetLength(); ++i) {
+				Bytes.emplace_back((uint8_t)strSearchStr.At(i));
+			}
+			Pattern->AddBytesPattern(Bytes.data(), Bytes.size());
+
+		} else {
+			CPINFO cpi{};
+			if (!IsUTF8(VM.CodePage) && !IsUTF16(VM.CodePage) && !IsUTF32(VM.CodePage)
+					&& (!WINPORT(GetCPInfo)(VM.CodePage, &cpi) || cpi.MaxCharSize != 1))
+				return false;
+
+			Pattern->AddTextPattern(strSearchStr.CPtr(), VM.CodePage);
+		}
+		Pattern->GetReady();
+		Searcher.reset(new ViewerParallelSearch(strIndexPathName, std::move(Pattern), Unit));
+
+	} catch (std::exception &e) {
+		fprintf(stderr, "%s: %s\n", __FUNCTION__, e.what());
+		return false;
+	}
+
+	if (!Searcher->Start(UnitsToBytes(VM.CodePage, Begin), UnitsToBytes(VM.CodePage, End), ReverseSearch))
+		return false;
+
+	wakeful W;
+	for (;;) {
+		uint64_t Hit = 0;
+		int Percent = 0;
+		const auto Status = Searcher->Wait(RedrawTimeout, Hit, Percent);
+		if (Status == ViewerParallelSearch::S_FOUND) {
+			Match = true;
+			MatchPos = Hit / Unit;
+			break;
+		}
+
+		if (Status == ViewerParallelSearch::S_NOT_FOUND)
+			break;
+
+		ViewerSearchMsg(strMsgStr, Percent);
+
+		if (CheckForEscSilent() && ConfirmAbortOp()) {
+			Aborted = true;
+			break;
+		}
+	}
+
+	return true;
+}
+
 static inline bool CheckBufMatchesCaseInsensitive(size_t MatchLen, const wchar_t *Buf,
 		const wchar_t *MatchUpperCase, const wchar_t *MatchLowerCase)
 {
@@ -2866,8 +3032,16 @@ void Viewer::Search(int Next, int FirstChar)
 
 		vseek(LastSelPos, SEEK_SET);
 		Match = false;
+		bool Aborted = false;
 
-		if (SearchWChars > 0 && (!ReverseSearch || LastSelPos >= 0)) {
+		if (ParallelSearch(strSearchStr, strMsgStr, Case != 0, WholeWords != 0, ReverseSearch != 0,
+					MatchPos, Match, Aborted)) {
+			if (Aborted) {
+				Redraw();
+				return;
+			}
+
+		} else if (SearchWChars > 0 && (!ReverseSearch || LastSelPos >= 0)) {
 			const int buf_size = 16384;
 			std::vector<wchar_t> Buf(buf_size);
 
@@ -3292,22 +3466,24 @@ bool Viewer::vgetc(WCHAR &C)
 #define RB_PRC 3
 #define RB_HEX 4
 #define RB_DEC 5
+#define RB_LINE 6
 
 void Viewer::GoTo(int ShowDlg, int64_t Offset, DWORD Flags)
 {
 	int64_t Relative = 0;
 	const wchar_t *LineHistoryName = L"ViewerOffset";
 	DialogDataEx GoToDlgData[] = {
-		{DI_DOUBLEBOX,   3, 1, 31, 7, {0}, 0,Msg::ViewerGoTo },
+		{DI_DOUBLEBOX,   3, 1, 31, 8, {0}, 0,Msg::ViewerGoTo },
 		{DI_EDIT,        5, 2, 29, 2, {(DWORD_PTR)LineHistoryName}, DIF_FOCUS | DIF_DEFAULT | DIF_HISTORY | DIF_USELASTHISTORY, L""},
 		{DI_TEXT,        3, 3, 0,  3, {0}, DIF_SEPARATOR, L""},
 		{DI_RADIOBUTTON, 5, 4, 0,  4, {0}, DIF_GROUP,     Msg::GoToPercent},
 		{DI_RADIOBUTTON, 5, 5, 0,  5, {0}, 0, Msg::GoToHex    },
-		{DI_RADIOBUTTON, 5, 6, 0,  6, {0}, 0, Msg::GoToDecimal}
+		{DI_RADIOBUTTON, 5, 6, 0,  6, {0}, 0, Msg::GoToDecimal},
+		{DI_RADIOBUTTON, 5, 7, 0,  7, {0}, 0, Msg::GoToLine   }
 	};
 	MakeDialogItemsEx(GoToDlgData, GoToDlg);
 	static int PrevMode = 0;
-	GoToDlg[3].Selected = GoToDlg[4].Selected = GoToDlg[5].Selected = 0;
+	GoToDlg[3].Selected = GoToDlg[4].Selected = GoToDlg[5].Selected = GoToDlg[6].Selected = 0;
 
 	if (VM.Hex)
 		PrevMode = 1;
@@ -3317,7 +3493,7 @@ void Viewer::GoTo(int ShowDlg, int64_t Offset, DWORD Flags)
 		if (ShowDlg) {
 			Dialog Dlg(GoToDlg, ARRAYSIZE(GoToDlg));
 			Dlg.SetHelp(L"ViewerGotoPos");
-			Dlg.SetPosition(-1, -1, 35, 9);
+			Dlg.SetPosition(-1, -1, 35, 10);
 			Dlg.Process();
 
 			if (Dlg.GetExitCode() <= 0)
@@ -3335,12 +3511,12 @@ void Viewer::GoTo(int ShowDlg, int64_t Offset, DWORD Flags)
 
 			if (GoToDlg[1].strData.Contains(L'%'))		// он хочет процентов
 			{
-				GoToDlg[RB_HEX].Selected = GoToDlg[RB_DEC].Selected = 0;
+				GoToDlg[RB_HEX].Selected = GoToDlg[RB_DEC].Selected = GoToDlg[RB_LINE].Selected = 0;
 				GoToDlg[RB_PRC].Selected = 1;
 			} else if (!StrCmpNI(GoToDlg[1].strData, L"0x", 2) || GoToDlg[1].strData.At(0) == L'$' || GoToDlg[1].strData.Contains(L'h')
 					|| GoToDlg[1].strData.Contains(L'H'))		// он умный - hex код ввел!
 			{
-				GoToDlg[RB_PRC].Selected = GoToDlg[RB_DEC].Selected = 0;
+				GoToDlg[RB_PRC].Selected = GoToDlg[RB_DEC].Selected = GoToDlg[RB_LINE].Selected = 0;
 				GoToDlg[RB_HEX].Selected = 1;
 
 				if (!StrCmpNI(GoToDlg[1].strData, L"0x", 2))
@@ -3389,6 +3565,26 @@ void Viewer::GoTo(int ShowDlg, int64_t Offset, DWORD Flags)
 				PrevMode = 2;
 				Offset = wcstoull(GoToDlg[1].strData, nullptr, 10);
 			}
+
+			if (GoToDlg[RB_LINE].Selected) {
+				// номер строки переводится в смещение по индексу строк
+				PrevMode = 3;
+				int64_t Line = wcstoull(GoToDlg[1].strData, nullptr, 10);
+				if (Relative) {
+					const int64_t CurLine = GetCurrentLine();
+					if (!CurLine)
+						return;
+					Line = CurLine + Line * Relative;
+					Relative = 0;
+				}
+
+				ViewerLineIndex *Index = GetLineIndex();
+				if (!Index)
+					return;
+
+				const int64_t LineOffset = Index->OffsetOfLine(Line > 1 ? Line - 1 : 0);
+				Offset = (LineOffset >= 0) ? LineOffset : UnitsToBytes(VM.CodePage, FileSize);
+			}
 		}		// ShowDlg
 		else {
 			Relative = Flags & VSP_RELATIVE;
@@ -3520,6 +3716,9 @@ void Viewer::SetFileSize()
 	ViewFile.GetSize(uFileSize);
 	FileSize = uFileSize;
 
+	if (LineIndex)
+		LineIndex->Actualize();
+
 	/*
 		$ 20.02.2003 IS
 		Везде сравниваем FilePos с FileSize, FilePos для юникодных файлов
@@ -3538,6 +3737,31 @@ void Viewer::SetFileSize()
 	}
 }
 
+/*
+	Индекс строк строится в фоне для текущей кодировки и символа конца строки,
+	при их смене пересоздается
+*/
+ViewerLineIndex *Viewer::GetLineIndex()
+{
+	if (strIndexPathName.empty())
+		return nullptr;
+
+	if (!LineIndex || !LineIndex->Matches(strIndexPathName, VM.CodePage, (wchar_t)CRSym))
+		LineIndex.reset(new ViewerLineIndex(strIndexPathName, VM.CodePage, (wchar_t)CRSym));
+
+	return LineIndex.get();
+}
+
+int64_t Viewer::GetCurrentLine()
+{
+	ViewerLineIndex *Index = VM.Hex ? nullptr : GetLineIndex();
+	if (!Index)
+		return 0;
+
+	const int64_t Line = Index->LineOfOffset(UnitsToBytes(VM.CodePage, FilePos));
+	return (Line >= 0) ? Line + 1 : 0;
+}
+
 void Viewer::GetSelectedParam(int64_t &Pos, int64_t &Length, DWORD &Flags)
 {
 	Pos = SelectPos;
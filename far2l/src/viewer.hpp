@@ -41,8 +41,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "cache.hpp"
 #include "fileholder.hpp"
 #include "ViewerStrings.hpp"
+#include "ViewerLineIndex.hpp"
+#include "FSNotify.h"
 #include <vector>
 #include <string>
+#include <memory>
 
 #define VIEWER_UNDO_COUNT 64
 
@@ -161,6 +164,11 @@ private:
 
 	FileHolderPtr FHP;
 
+	std::string strIndexPathName;
+	std::unique_ptr<ViewerLineIndex> LineIndex;
+	std::unique_ptr<IFSNotify> FileChange;
+	bool FollowMode = false;
+
 private:
 	virtual void DisplayObject();
 
@@ -196,6 +204,11 @@ private:
 	int64_t vtell();
 	bool vgetc(WCHAR &C);
 	void SetFileSize();
+	ViewerLineIndex *GetLineIndex();
+	void WatchFileChange();
+	void ActualizeFile();
+	bool ParallelSearch(const FARString &strSearchStr, const FARString &strMsgStr, bool Case, bool WholeWords,
+			bool ReverseSearch, int64_t &MatchPos, bool &Match, bool &Aborted);
 	int GetStrBytesNum(const wchar_t *Str, int Length);
 
 	FARString ComposeCacheName();
@@ -243,6 +256,7 @@ public:
 	int64_t GetFilePos() const { return FilePos; };
 	int64_t GetViewFilePos() const { return FilePos; };
 	int64_t GetViewFileSize() const { return FileSize; };
+	int64_t GetCurrentLine();	// 1-based, 0 if not known yet
 
 	void SetPluginData(const wchar_t *PluginData);
 	void SetNamesList(NamesList *List);
@@ -38,6 +38,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "headers.hpp"
 #include <vector>
 #include <algorithm>
+#include <thread>
 #include "vmenu.hpp"
 #include "keyboard.hpp"
 #include "lang.hpp"
@@ -61,6 +62,62 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "UsedChars.hpp"
 #include "help.hpp"
 
+// начиная с такого количества пунктов фильтр проверяет их в нескольких потоках
+#define VMENU_FILTER_PARALLEL_ITEMS 16384
+#define VMENU_FILTER_MAX_THREADS    8
+
+// Индекс для фильтра: имена пунктов в нижнем регистре одной строкой и для
+// каждого пункта маска встречающихся в имени символов, по которой большинство
+// неподходящих пунктов отсекается без сравнения строк. Строится при первом
+// использовании фильтра, сбрасывается при изменении состава или имен пунктов.
+struct VMenuFilterIndex
+{
+	std::vector<const MenuItemEx *> Items;
+	std::vector<size_t> Offsets;	// начало имени пункта в Text
+	std::vector<uint64_t> Masks;
+	std::wstring Text;	// имена, разделенные L'\0'
+
+	static uint64_t MaskOf(const wchar_t *s)
+	{
+		uint64_t Mask = 0;
+		for (; *s; ++s)
+			Mask|= 1ull << ((*s ^ (*s >> 6)) & 63);
+		return Mask;
+	}
+
+	void Build(MenuItemEx **Item, int ItemCount)
+	{
+		size_t Total = 0;
+		for (int i = 0; i < ItemCount; i++)
+			Total+= Item[i]->strName.GetLength() + 1;
+
+		Items.assign(Item, Item + ItemCount);
+		Offsets.resize(ItemCount);
+		Masks.resize(ItemCount);
+		Text.clear();
+		Text.reserve(Total);
+		for (int i = 0; i < ItemCount; i++) {
+			Offsets[i] = Text.size();
+			Text.append(Item[i]->strName.CPtr(), Item[i]->strName.GetLength());
+			Text+= L'\0';
+		}
+		LowerBuf(&Text[0], (int)Text.size());
+		for (int i = 0; i < ItemCount; i++)
+			Masks[i] = MaskOf(Text.c_str() + Offsets[i]);
+	}
+
+	bool IsValidFor(MenuItemEx **Item, int ItemCount) const
+	{
+		return Items.size() == (size_t)ItemCount
+			&& std::equal(Items.begin(), Items.end(), Item);
+	}
+
+	bool Matches(int i, const wchar_t *Filter, uint64_t FilterMask) const
+	{
+		return (Masks[i] & FilterMask) == FilterMask && wcsstr(Text.c_str() + Offsets[i], Filter);
+	}
+};
+
 VMenu::VMenu(const wchar_t *Title,		// заголовок меню
 		MenuDataEx *Data,				// пункты меню
 		int ItemCount,					// количество пунктов меню
@@ -439,6 +496,7 @@ int VMenu::AddItem(const MenuItemEx *NewItem, int PosAdd)
 		SelectPos++;
 
 	ItemCount++;
+	FilterIndex.reset();
 
 	Item[PosAdd] = new MenuItemEx;
 	Item[PosAdd]->Clear();
@@ -481,6 +539,7 @@ int VMenu::UpdateItem(const FarListUpdate *NewItem)
 		FarList2MenuItem(&NewItem->Item, &MItem);
 
 		PItem->strName = MItem.strName;
+		FilterIndex.reset();
 
 		UpdateItemFlags(NewItem->Index, MItem.Flags);
 
@@ -526,6 +585,7 @@ int VMenu::DeleteItem(int ID, int Count)
 		memmove(Item + ID, Item + ID + Count, sizeof(*Item) * (ItemCount - (ID + Count)));	// BUGBUG
 
 	ItemCount-= Count;
+	FilterIndex.reset();
 
 	// коррекция текущей позиции
 	if (SelectPos >= ID && SelectPos < ID + Count) {
@@ -561,6 +621,7 @@ void VMenu::DeleteItems()
 	Item = nullptr;
 	ItemCount = 0;
 	ItemHiddenCount = 0;
+	FilterIndex.reset();
 	ItemSubMenusCount = 0;
 	SelectPos = -1;
 	TopPos = 0;
@@ -617,28 +678,51 @@ void VMenu::RestoreFilteredItems()
 
 void VMenu::FilterStringUpdated(bool bLonger)
 {
-
-	if (bLonger) {
-		// строка фильтра увеличилась
-		for (int i = 0; i < ItemCount; i++) {
-			if (ItemIsVisible(Item[i]->Flags) && !ItemIsSeparator(Item[i]->Flags) && !StrStrI(Item[i]->strName, strFilter)) {
-				Item[i]->Flags|= LIF_HIDDEN;
-				Item[i]->FilteredOut = true;
-				ItemHiddenCount++;
-				if (SelectPos == i) {
-					Item[i]->Flags&= ~LIF_SELECTED;
-					SelectPos = -1;
-				}
-			}
-		}
-	} else {
-		// строка фильтра сократилась
-		for (int i = 0; i < ItemCount; i++) {
-			if (Item[i]->FilteredOut && !ItemIsSeparator(Item[i]->Flags) && StrStrI(Item[i]->strName, strFilter)) {
-				Item[i]->Flags&= ~LIF_HIDDEN;
-				Item[i]->FilteredOut = false;
-				ItemHiddenCount--;
+	if (!FilterIndex || !FilterIndex->IsValidFor(Item, ItemCount)) {
+		FilterIndex.reset(new VMenuFilterIndex);
+		FilterIndex->Build(Item, ItemCount);
+	}
+
+	FARString strLowerFilter(strFilter);
+	strLowerFilter.Lower();
+	const wchar_t *Filter = strLowerFilter.CPtr();
+	const uint64_t FilterMask = VMenuFilterIndex::MaskOf(Filter);
+
+	// строка фильтра увеличилась - проверяются видимые пункты, сократилась - скрытые фильтром
+	std::vector<char> Toggle(ItemCount);
+	auto CheckItems = [&](int From, int To) {
+		for (int i = From; i < To; i++) {
+			const DWORD Flags = Item[i]->Flags;
+			if (!ItemIsSeparator(Flags) && (bLonger ? ItemIsVisible(Flags) : Item[i]->FilteredOut))
+				Toggle[i] = FilterIndex->Matches(i, Filter, FilterMask) != bLonger;
+		}
+	};
+
+	const int Threads = std::min(VMENU_FILTER_MAX_THREADS, (int)std::thread::hardware_concurrency());
+	if (ItemCount >= VMENU_FILTER_PARALLEL_ITEMS && Threads > 1) {
+		const int Chunk = (ItemCount + Threads - 1) / Threads;
+		std::vector<std::thread> Workers;
+		for (int From = Chunk; From < ItemCount; From+= Chunk)
+			Workers.emplace_back(CheckItems, From, std::min(From + Chunk, ItemCount));
+		CheckItems(0, Chunk);
+		for (auto &Worker : Workers)
+			Worker.join();
+	} else
+		CheckItems(0, ItemCount);
+
+	for (int i = 0; i < ItemCount; i++) if (Toggle[i]) {
+		if (bLonger) {
+			Item[i]->Flags|= LIF_HIDDEN;
+			Item[i]->FilteredOut = true;
+			ItemHiddenCount++;
+			if (SelectPos == i) {
+				Item[i]->Flags&= ~LIF_SELECTED;
+				SelectPos = -1;
 			}
+		} else {
+			Item[i]->Flags&= ~LIF_HIDDEN;
+			Item[i]->FilteredOut = false;
+			ItemHiddenCount--;
 		}
 	}
 
@@ -2790,6 +2874,8 @@ void VMenu::SortItems(int Direction, int Offset, BOOL SortForDataDWORD)
 		far_qsortex((char *)Item, ItemCount, sizeof(*Item), (qsortex_fn)SortItemDataDWORD, &Param);
 	}
 
+	FilterIndex.reset();
+
 	// скорректируем SelectPos
 	UpdateSelectPos();
 
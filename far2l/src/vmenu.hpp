@@ -44,6 +44,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "keybar.hpp"
 #include "bitflags.hpp"
 #include "CriticalSections.hpp"
+#include <memory>
 
 // Цветовые атрибуты - индексы в массиве цветов
 enum
@@ -232,6 +233,7 @@ struct MenuDataEx
 };
 
 class ConsoleTitle;
+struct VMenuFilterIndex;
 
 class VMenu : public Modal
 {
@@ -263,6 +265,7 @@ private:
 	bool bFilterEnabled;
 	bool bFilterLocked;
 	FARString strFilter;
+	std::unique_ptr<VMenuFilterIndex> FilterIndex;
 
 	MenuItemEx **Item;
 
@@ -0,0 +1,300 @@
+#include "LineDiff.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+	// beyond that Myers trace would take too much memory, so such gap is reported as fully replaced
+	const int MYERS_MAX_D = 1024;
+	const int ANCHORS_MAX_DEPTH = 16;
+
+	struct Match
+	{
+		int a;
+		int b;
+		int len;
+	};
+
+	class Differ
+	{
+		const uint64_t *_a;
+		const uint64_t *_b;
+		std::vector<Match> &_matches;
+
+		void AddMatch(int a, int b, int len)
+		{
+			if (len > 0) {
+				_matches.push_back(Match{a, b, len});
+			}
+		}
+
+		bool ByAnchors(int a_lo, int a_hi, int b_lo, int b_hi, int depth);
+		void Myers(int a_lo, int a_hi, int b_lo, int b_hi);
+
+	public:
+		Differ(const uint64_t *a, const uint64_t *b, std::vector<Match> &matches)
+			: _a(a), _b(b), _matches(matches)
+		{
+		}
+
+		void Diff(int a_lo, int a_hi, int b_lo, int b_hi, int depth);
+	};
+
+	void Differ::Diff(int a_lo, int a_hi, int b_lo, int b_hi, int depth)
+	{
+		int prefix = 0;
+		while (a_lo + prefix < a_hi && b_lo + prefix < b_hi && _a[a_lo + prefix] == _b[b_lo + prefix]) {
+			++prefix;
+		}
+		AddMatch(a_lo, b_lo, prefix);
+		a_lo+= prefix;
+		b_lo+= prefix;
+
+		int suffix = 0;
+		while (a_lo < a_hi - suffix && b_lo < b_hi - suffix && _a[a_hi - suffix - 1] == _b[b_hi - suffix - 1]) {
+			++suffix;
+		}
+		a_hi-= suffix;
+		b_hi-= suffix;
+
+		if (a_lo < a_hi && b_lo < b_hi) {
+			if (depth >= ANCHORS_MAX_DEPTH || !ByAnchors(a_lo, a_hi, b_lo, b_hi, depth)) {
+				Myers(a_lo, a_hi, b_lo, b_hi);
+			}
+		}
+
+		AddMatch(a_hi, b_hi, suffix);
+	}
+
+	bool Differ::ByAnchors(int a_lo, int a_hi, int b_lo, int b_hi, int depth)
+	{
+		// count occurrences: low 32 bits - in a, high - in b; remember position of last one
+		std::unordered_map<uint64_t, std::pair<uint64_t, std::pair<int, int> > > occurs;
+		occurs.reserve((a_hi - a_lo) + (b_hi - b_lo));
+		for (int i = a_lo; i < a_hi; ++i) {
+			auto &o = occurs[_a[i]];
+			o.first+= 1;
+			o.second.first = i;
+		}
+		for (int i = b_lo; i < b_hi; ++i) {
+			auto it = occurs.find(_b[i]);
+			if (it != occurs.end()) {
+				it->second.first+= 0x100000000ull;
+				it->second.second.second = i;
+			}
+		}
+
+		std::vector<std::pair<int, int> > pairs;
+		for (const auto &it : occurs) {
+			if (it.second.first == 0x100000001ull) {
+				pairs.emplace_back(it.second.second);
+			}
+		}
+		if (pairs.empty()) {
+			return false;
+		}
+		std::sort(pairs.begin(), pairs.end());
+
+		// longest increasing subsequence by b positions gives anchors that don't cross each other
+		std::vector<size_t> tails, prev(pairs.size(), (size_t)-1);
+		for (size_t i = 0; i < pairs.size(); ++i) {
+			auto it = std::lower_bound(tails.begin(), tails.end(), pairs[i].second,
+				[&](size_t t, int b) { return pairs[t].second < b; });
+			if (it != tails.begin()) {
+				prev[i] = *(it - 1);
+			}
+			if (it == tails.end()) {
+				tails.push_back(i);
+			} else {
+				*it = i;
+			}
+		}
+
+		std::vector<size_t> anchors;
+		for (size_t i = tails.back(); i != (size_t)-1; i = prev[i]) {
+			anchors.push_back(i);
+		}
+		std::reverse(anchors.begin(), anchors.end());
+
+		for (size_t i : anchors) {
+			Diff(a_lo, pairs[i].first, b_lo, pairs[i].second, depth + 1);
+			AddMatch(pairs[i].first, pairs[i].second, 1);
+			a_lo = pairs[i].first + 1;
+			b_lo = pairs[i].second + 1;
+		}
+		Diff(a_lo, a_hi, b_lo, b_hi, depth + 1);
+		return true;
+	}
+
+	// picks furthest point on diagonal k after d edits from points after d - 1 edits (-1 means
+	// diagonal is unreachable), returns its x or -1 if unreachable, prev_k - where it came from
+	template <class V>
+		static int MyersStep(const V &v, int k, int d, int n, int m, int &prev_k)
+	{
+		int x = -1;
+		if (k < d && v(k + 1) >= 0 && v(k + 1) - k <= m) { // down from k + 1
+			x = v(k + 1);
+			prev_k = k + 1;
+		}
+		if (k > -d && v(k - 1) >= 0 && v(k - 1) + 1 <= n && v(k - 1) + 1 >= x) { // right from k - 1
+			x = v(k - 1) + 1;
+			prev_k = k - 1;
+		}
+		return x;
+	}
+
+	void Differ::Myers(int a_lo, int a_hi, int b_lo, int b_hi)
+	{
+		const int n = a_hi - a_lo, m = b_hi - b_lo;
+		const int max_d = std::min(n + m, MYERS_MAX_D);
+		const int off = max_d + 1;
+		std::vector<int> v(2 * max_d + 3, -1);
+		// trace[d] holds v[-d-1 .. d+1] as it was before step d
+		std::vector<std::vector<int> > trace;
+
+		for (int d = 0; d <= max_d; ++d) {
+			trace.emplace_back(v.begin() + off - d - 1, v.begin() + off + d + 2);
+			for (int k = -d; k <= d; k+= 2) {
+				int prev_k = 0;
+				int x = (d == 0) ? 0 : MyersStep([&](int kk) { return v[off + kk]; }, k, d, n, m, prev_k);
+				if (x < 0) {
+					v[off + k] = -1;
+					continue;
+				}
+				int y = x - k;
+				while (x < n && y < m && _a[a_lo + x] == _b[b_lo + y]) {
+					++x;
+					++y;
+				}
+				v[off + k] = x;
+				if (x < n || y < m) {
+					continue;
+				}
+
+				// reached end - backtrack collecting diagonals
+				std::vector<Match> matches;
+				for (int dd = d; dd > 0; --dd) {
+					const std::vector<int> &tv = trace[dd];
+					const int kk = x - y;
+					int prev_kk = 0;
+					MyersStep([&](int i) { return tv[i + dd + 1]; }, kk, dd, n, m, prev_kk);
+					const int prev_x = tv[prev_kk + dd + 1], prev_y = prev_x - prev_kk;
+					const int mid_x = (prev_kk == kk + 1) ? prev_x : prev_x + 1;
+					if (x > mid_x) {
+						matches.push_back(Match{a_lo + mid_x, b_lo + mid_x - kk, x - mid_x});
+					}
+					x = prev_x;
+					y = prev_y;
+				}
+				if (x > 0) {
+					matches.push_back(Match{a_lo, b_lo, x});
+				}
+				_matches.insert(_matches.end(), matches.rbegin(), matches.rend());
+				return;
+			}
+		}
+		// too different - no matches, whole gap becomes single hunk
+	}
+}
+
+void LineDiff(const uint64_t *a, int a_count, const uint64_t *b, int b_count, std::vector<LineDiffHunk> &out)
+{
+	std::vector<Match> matches;
+	Differ(a, b, matches).Diff(0, a_count, 0, b_count, 0);
+
+	int a_pos = 0, b_pos = 0;
+	matches.push_back(Match{a_count, b_count, 0});
+	for (const auto &m : matches) {
+		if (m.a > a_pos || m.b > b_pos) {
+			out.push_back(LineDiffHunk{a_pos, m.a - a_pos, b_pos, m.b - b_pos});
+		}
+		a_pos = m.a + m.len;
+		b_pos = m.b + m.len;
+	}
+}
+
+uint64_t LineDiffHash(const wchar_t *s, size_t len)
+{
+	uint64_t out = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < len; ++i) {
+		out^= (uint32_t)s[i];
+		out*= 0x100000001b3ull;
+	}
+	return out;
+}
+
+////////////////////////////////////////////////////////////
+
+void IncrementalLineDiff::SetBase(const std::vector<uint64_t> &base)
+{
+	_base = base;
+	_valid = false;
+}
+
+void IncrementalLineDiff::Full()
+{
+	_hunks.clear();
+	LineDiff(_base.data(), (int)_base.size(), _cur.data(), (int)_cur.size(), _hunks);
+	_valid = true;
+}
+
+bool IncrementalLineDiff::Update(std::vector<uint64_t> &cur)
+{
+	_cur.swap(cur);
+	if (!_valid) {
+		Full();
+		return true;
+	}
+
+	// find range that changed since previous update: [p, prev_end) became [p, cur_end)
+	const int prev_count = (int)cur.size(), cur_count = (int)_cur.size();
+	const int common = std::min(prev_count, cur_count);
+	int p = 0;
+	while (p < common && cur[p] == _cur[p]) {
+		++p;
+	}
+	if (p == prev_count && p == cur_count) {
+		return false;
+	}
+	int s = 0;
+	while (s < common - p && cur[prev_count - 1 - s] == _cur[cur_count - 1 - s]) {
+		++s;
+	}
+	const int prev_end = prev_count - s;
+	const int delta = cur_count - prev_count;
+
+	// extend range to hunks it touches, old side range is known as lines outside hunks are aligned
+	size_t i = 0;
+	int offset = 0;
+	while (i < _hunks.size() && _hunks[i].new_start + _hunks[i].new_count < p) {
+		offset+= _hunks[i].old_count - _hunks[i].new_count;
+		++i;
+	}
+	size_t j = i;
+	int offset_end = offset, new_lo = p, new_hi = prev_end;
+	while (j < _hunks.size() && _hunks[j].new_start <= prev_end) {
+		new_lo = std::min(new_lo, _hunks[j].new_start);
+		new_hi = std::max(new_hi, _hunks[j].new_start + _hunks[j].new_count);
+		offset_end+= _hunks[j].old_count - _hunks[j].new_count;
+		++j;
+	}
+	const int old_lo = new_lo + offset, old_hi = new_hi + offset_end;
+	if (old_lo < 0 || old_lo > old_hi || old_hi > (int)_base.size() || new_hi + delta > cur_count) {
+		Full(); // shouldn't happen
+		return true;
+	}
+
+	std::vector<LineDiffHunk> sub;
+	LineDiff(_base.data() + old_lo, old_hi - old_lo, _cur.data() + new_lo, new_hi + delta - new_lo, sub);
+	for (auto &h : sub) {
+		h.old_start+= old_lo;
+		h.new_start+= new_lo;
+	}
+	for (size_t k = j; k < _hunks.size(); ++k) {
+		_hunks[k].new_start+= delta;
+	}
+	_hunks.erase(_hunks.begin() + i, _hunks.begin() + j);
+	_hunks.insert(_hunks.begin() + i, sub.begin(), sub.end());
+	return true;
+}
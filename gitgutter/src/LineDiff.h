@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Changed range in terms of 'diff --unified=0' hunk, but with 0-based starts,
+// for pure insertion/deletion start of empty side is position of the gap.
+struct LineDiffHunk
+{
+	int old_start;
+	int old_count;
+	int new_start;
+	int new_count;
+};
+
+// Diffs two sequences of line hashes appending hunks to out: common prefix and suffix are
+// skipped, lines that are unique on both sides serve as anchors (like in patience/histogram
+// diff) and gaps between anchors are diffed by Myers algorithm.
+void LineDiff(const uint64_t *a, int a_count, const uint64_t *b, int b_count, std::vector<LineDiffHunk> &out);
+
+uint64_t LineDiffHash(const wchar_t *s, size_t len);
+
+// Keeps diff of baseline against current text up to date: on Update only range that changed
+// since previous Update together with hunks it touches is re-diffed, other hunks are reused.
+class IncrementalLineDiff
+{
+	std::vector<uint64_t> _base;
+	std::vector<uint64_t> _cur;
+	std::vector<LineDiffHunk> _hunks;
+	bool _valid = false;
+
+	void Full();
+
+public:
+	void SetBase(const std::vector<uint64_t> &base);
+
+	// returns false if hunks remain same
+	bool Update(std::vector<uint64_t> &cur);
+
+	const std::vector<LineDiffHunk> &Hunks() const { return _hunks; }
+};
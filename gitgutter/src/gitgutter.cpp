@@ -8,12 +8,17 @@
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
+#include <memory>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "LineDiff.h"
+
 static PluginStartupInfo g_info{};
 static FarStandardFunctions g_fsf{};
 
@@ -70,44 +75,6 @@ static void SplitLines(const std::string &s, std::vector<std::string> &out)
 	}
 }
 
-static bool FileExists(const std::string &path)
-{
-	return access(path.c_str(), F_OK) == 0;
-}
-
-static bool MakeTempFile(std::string &path, FILE *&f)
-{
-	f = nullptr;
-	std::string tmpl = "/tmp/far2l_gitgutter_XXXXXX";
-	std::vector<char> buf(tmpl.begin(), tmpl.end());
-	buf.push_back('\0');
-	const int fd = mkstemp(buf.data());
-	if (fd == -1) {
-		return false;
-	}
-	f = fdopen(fd, "wb");
-	if (!f) {
-		close(fd);
-		unlink(buf.data());
-		return false;
-	}
-	path.assign(buf.data());
-	return true;
-}
-
-static bool WriteTextToTempFile(const std::string &text, std::string &path)
-{
-	FILE *f = nullptr;
-	if (!MakeTempFile(path, f)) {
-		return false;
-	}
-	if (!text.empty()) {
-		fwrite(text.data(), 1, text.size(), f);
-	}
-	fclose(f);
-	return true;
-}
-
 static bool RunCommand(const std::string &cmd, std::string &out)
 {
 	out.clear();
@@ -238,14 +205,30 @@ struct Hunk
 	std::wstring text;
 };
 
+struct BaselineText
+{
+	std::vector<std::wstring> lines;
+	std::vector<uint64_t> hashes;
+	bool no_eol = false;
+};
+
+// parsed baselines by blob id, shared by editors of same file
+static std::map<std::string, std::shared_ptr<BaselineText>> g_baselines;
+static const size_t BASELINES_CACHE_LIMIT = 16;
+
 struct EditorState
 {
 	int editor_id = -1;
 	std::wstring file_w;
 	std::string file;
 	std::string repo_root;
-	std::string rel_path;
-	std::string temp_path;
+	std::string git_dir;
+	std::string base_signature;
+	std::shared_ptr<BaselineText> base;
+	IncrementalLineDiff diff;
+	int cur_count = 0;
+	bool cur_no_eol = false;
+	bool prev_no_eol = false;
 	uint64_t last_update_ms = 0;
 	bool dirty = true;
 	bool gutter_forced = false;
@@ -626,81 +609,6 @@ static bool GetRelativePath(const std::string &repo_root, const std::string &fil
 	return !rel_path.empty();
 }
 
-static bool WriteEditorBufferToTemp(std::string &path)
-{
-	EditorInfo ei{};
-	if (!GetEditorInfo(ei)) {
-		return false;
-	}
-	FILE *f = nullptr;
-	if (path.empty()) {
-		if (!MakeTempFile(path, f)) {
-			return false;
-		}
-	} else {
-		f = fopen(path.c_str(), "wb");
-		if (!f) {
-			unlink(path.c_str());
-			path.clear();
-			if (!MakeTempFile(path, f)) {
-				return false;
-			}
-		}
-	}
-	EditorGetString egs{};
-	for (int i = 0; i < ei.TotalLines; ++i) {
-		egs.StringNumber = i;
-		if (!g_info.EditorControl(ECTL_GETSTRING, &egs)) {
-			fclose(f);
-			unlink(path.c_str());
-			path.clear();
-			return false;
-		}
-		if (egs.StringText && egs.StringLength > 0) {
-			std::wstring wline(egs.StringText, egs.StringText + egs.StringLength);
-			const std::string mb = Wide2MB(wline.c_str());
-			if (!mb.empty()) {
-				fwrite(mb.data(), 1, mb.size(), f);
-			}
-		}
-		if (egs.StringEOL && *egs.StringEOL) {
-			const std::string eol_mb = Wide2MB(egs.StringEOL);
-			if (!eol_mb.empty()) {
-				fwrite(eol_mb.data(), 1, eol_mb.size(), f);
-			}
-		} else if (i + 1 < ei.TotalLines) {
-			fwrite("\n", 1, 1, f);
-		}
-	}
-	fclose(f);
-	return true;
-}
-
-static bool WriteBaselineToTemp(const std::string &repo_root, const std::string &rel_path,
-		const std::string &baseline, std::string &path)
-{
-	std::string root_arg = repo_root;
-	QuoteCmdArgIfNeed(root_arg);
-	std::string spec;
-	if (baseline == "head") {
-		spec = "HEAD:" + rel_path;
-	} else if (baseline == "index") {
-		spec = ":" + rel_path;
-	} else if (baseline == "unstaged") {
-		return false;
-	} else {
-		spec = baseline + ":" + rel_path;
-	}
-	std::string spec_arg = spec;
-	QuoteCmdArgIfNeed(spec_arg);
-	const std::string cmd = "git -C " + root_arg + " show " + spec_arg;
-	std::string out;
-	if (!RunCommand(cmd, out)) {
-		return false;
-	}
-	return WriteTextToTempFile(out, path);
-}
-
 static bool ParseHunkHeader(const std::string &line, int &old_start, int &old_count, int &new_start, int &new_count)
 {
 	if (line.rfind("@@ ", 0) != 0)
@@ -824,48 +732,214 @@ static void BuildMarksFromDiff(const std::string &diff, EditorState &st)
 	}
 }
 
-static bool GetRepoRoot(const std::string &file_path, std::string &repo_root)
+static bool GetRepoPaths(const std::string &file_path, std::string &repo_root, std::string &git_dir)
 {
 	repo_root.clear();
+	git_dir.clear();
 	const size_t slash = file_path.find_last_of('/');
 	const std::string dir = (slash == std::string::npos) ? "." : file_path.substr(0, slash);
 	std::string dir_arg = dir;
 	QuoteCmdArgIfNeed(dir_arg);
-	const std::string cmd = "git -C " + dir_arg + " rev-parse --show-toplevel";
+	const std::string cmd = "git -C " + dir_arg + " rev-parse --show-toplevel --absolute-git-dir";
 	std::string out;
 	if (!RunCommand(cmd, out)) {
 		return false;
 	}
-	repo_root = TrimLineEnd(out);
-	return !repo_root.empty();
+	std::vector<std::string> lines;
+	SplitLines(out, lines);
+	if (lines.size() < 2) {
+		return false;
+	}
+	repo_root = lines[0];
+	git_dir = lines[1];
+	return !repo_root.empty() && !git_dir.empty();
+}
+
+// Baseline is fetched from git only when git metadata that may affect it changes
+// and parsed baselines are shared between editors by blob id.
+static std::string BaselineSignature(const EditorState &st)
+{
+	std::string out = g_settings.baseline;
+	auto append_stat = [&](const std::string &path) {
+		struct stat s{};
+		if (stat(path.c_str(), &s) == 0) {
+			out+= StrPrintf(":%llx-%llx-%llx", (unsigned long long)s.st_ino,
+				(unsigned long long)s.st_mtime, (unsigned long long)s.st_size);
+		} else {
+			out+= ":-";
+		}
+	};
+	if (g_settings.baseline == "unstaged") {
+		append_stat(st.file);
+	} else {
+		append_stat(st.git_dir + "/index");
+		append_stat(st.git_dir + "/HEAD");
+		append_stat(st.git_dir + "/logs/HEAD");
+		append_stat(st.git_dir + "/packed-refs");
+	}
+	return out;
+}
+
+static std::shared_ptr<BaselineText> ParseBaseline(const std::string &content)
+{
+	auto out = std::make_shared<BaselineText>();
+	out->no_eol = !content.empty() && content.back() != '\n';
+	for (size_t pos = 0; pos < content.size();) {
+		size_t end = content.find('\n', pos);
+		if (end == std::string::npos) {
+			end = content.size();
+		}
+		const size_t len = (end > pos && content[end - 1] == '\r') ? end - 1 - pos : end - pos;
+		out->lines.emplace_back();
+		MB2Wide(content.data() + pos, len, out->lines.back());
+		out->hashes.emplace_back(LineDiffHash(out->lines.back().c_str(), out->lines.back().size()));
+		pos = end + 1;
+	}
+	return out;
+}
+
+static bool RefreshBaseline(EditorState &st)
+{
+	const std::string &signature = BaselineSignature(st);
+	if (st.base && signature == st.base_signature) {
+		return true;
+	}
+	st.base_signature = signature;
+
+	std::string key, content;
+	if (g_settings.baseline == "unstaged") {
+		key = "file:" + st.file + signature;
+	} else {
+		std::string rel_path;
+		if (!GetRelativePath(st.repo_root, st.file, rel_path)) {
+			st.base.reset();
+			return false;
+		}
+		std::string spec;
+		if (g_settings.baseline == "head") {
+			spec = "HEAD:" + rel_path;
+		} else if (g_settings.baseline == "index") {
+			spec = ":" + rel_path;
+		} else {
+			spec = g_settings.baseline + ":" + rel_path;
+		}
+		std::string root_arg = st.repo_root;
+		QuoteCmdArgIfNeed(root_arg);
+		QuoteCmdArgIfNeed(spec);
+		if (!RunCommand("git -C " + root_arg + " rev-parse --verify -q " + spec, key)) {
+			st.base.reset();
+			return false;
+		}
+		key = TrimLineEnd(key);
+	}
+
+	auto it = g_baselines.find(key);
+	if (it == g_baselines.end()) {
+		if (g_settings.baseline == "unstaged") {
+			FILE *f = fopen(st.file.c_str(), "rb");
+			if (f) {
+				char buf[0x10000];
+				for (size_t r; (r = fread(buf, 1, sizeof(buf), f)) != 0;) {
+					content.append(buf, r);
+				}
+				fclose(f);
+			}
+		} else {
+			std::string root_arg = st.repo_root;
+			QuoteCmdArgIfNeed(root_arg);
+			if (!RunCommand("git -C " + root_arg + " cat-file blob " + key, content)) {
+				st.base.reset();
+				return false;
+			}
+		}
+		if (g_baselines.size() >= BASELINES_CACHE_LIMIT) {
+			for (auto drop = g_baselines.begin(); drop != g_baselines.end();) {
+				if (drop->second.use_count() == 1) {
+					drop = g_baselines.erase(drop);
+				} else {
+					++drop;
+				}
+			}
+		}
+		it = g_baselines.emplace(key, ParseBaseline(content)).first;
+	}
+
+	if (st.base != it->second) {
+		st.base = it->second;
+		st.diff.SetBase(st.base->hashes);
+	}
+	return true;
+}
+
+static bool ReadEditorHashes(std::vector<uint64_t> &hashes, bool &no_eol)
+{
+	hashes.clear();
+	no_eol = false;
+	EditorInfo ei{};
+	if (!GetEditorInfo(ei)) {
+		return false;
+	}
+	hashes.reserve(ei.TotalLines);
+	EditorGetString egs{};
+	for (int i = 0; i < ei.TotalLines; ++i) {
+		egs.StringNumber = i;
+		if (!g_info.EditorControl(ECTL_GETSTRING, &egs)) {
+			return false;
+		}
+		const int len = egs.StringText ? egs.StringLength : 0;
+		if (i + 1 == ei.TotalLines) {
+			// last line without EOL: if empty - previous line ends with EOL, otherwise file doesn't
+			if (len == 0) {
+				break;
+			}
+			no_eol = !egs.StringEOL || !*egs.StringEOL;
+		}
+		hashes.emplace_back(LineDiffHash(egs.StringText, len));
+	}
+	return true;
 }
 
-static std::string MakeDiffCommandBaseline(const std::string &repo_root, const std::string &file_path, const std::string &baseline)
+static void AppendHunkRange(std::string &out, int start, int count)
 {
-	std::string root_arg = repo_root;
-	std::string file_arg = file_path;
-	QuoteCmdArgIfNeed(root_arg);
-	QuoteCmdArgIfNeed(file_arg);
-	std::string base_arg = baseline;
-	QuoteCmdArgIfNeed(base_arg);
-
-	std::string cmd = "git -C " + root_arg + " diff --no-color --unified=0 ";
-	if (baseline == "head") {
-		cmd += "HEAD ";
-	} else if (baseline == "index") {
-		cmd += "--cached ";
-	} else if (baseline == "unstaged") {
-		// default diff shows unstaged changes
+	if (count == 1) {
+		out+= StrPrintf("%d", start + 1);
 	} else {
-		cmd += base_arg + " ";
+		out+= StrPrintf("%d,%d", count ? start + 1 : start, count);
 	}
-	cmd += "-- " + file_arg;
-	return cmd;
 }
 
-static std::string MakeDiffCommand(const std::string &repo_root, const std::string &file_path)
+// composes same text as 'git diff --unified=0' would output for hunks
+static void BuildDiffText(const EditorState &st, std::string &out)
 {
-	return MakeDiffCommandBaseline(repo_root, file_path, g_settings.baseline);
+	out.clear();
+	const int old_total = static_cast<int>(st.base->lines.size());
+	EditorGetString egs{};
+	for (const auto &h : st.diff.Hunks()) {
+		out+= "@@ -";
+		AppendHunkRange(out, h.old_start, h.old_count);
+		out+= " +";
+		AppendHunkRange(out, h.new_start, h.new_count);
+		out+= " @@\n";
+		for (int i = h.old_start; i < h.old_start + h.old_count; ++i) {
+			out+= '-';
+			Wide2MB(st.base->lines[i].c_str(), st.base->lines[i].size(), out, true);
+			out+= '\n';
+		}
+		if (h.old_count && h.old_start + h.old_count == old_total && st.base->no_eol) {
+			out+= "\\ No newline at end of file\n";
+		}
+		for (int i = h.new_start; i < h.new_start + h.new_count; ++i) {
+			out+= '+';
+			egs.StringNumber = i;
+			if (g_info.EditorControl(ECTL_GETSTRING, &egs) && egs.StringText) {
+				Wide2MB(egs.StringText, egs.StringLength, out, true);
+			}
+			out+= '\n';
+		}
+		if (h.new_count && h.new_start + h.new_count == st.cur_count && st.cur_no_eol) {
+			out+= "\\ No newline at end of file\n";
+		}
+	}
 }
 
 static void ApplyMarksToEditor(const EditorState &st)
@@ -881,11 +955,6 @@ static void UpdateEditorState(EditorState &st)
 	if (!IsPluginActive()) {
 		return;
 	}
-	const uint64_t now = NowMs();
-	if (now - st.last_update_ms < static_cast<uint64_t>(g_settings.interval_ms)) {
-		return;
-	}
-	st.last_update_ms = now;
 	EditorInfo ei{};
 	bool show_gutter = false;
 	if (GetEditorInfo(ei)) {
@@ -908,7 +977,8 @@ static void UpdateEditorState(EditorState &st)
 		st.file_w = file_w;
 		st.file = Wide2MB(file_w.c_str());
 		st.repo_root.clear();
-		st.rel_path.clear();
+		st.git_dir.clear();
+		st.base.reset();
 	}
 
 	if (st.file.empty()) {
@@ -916,46 +986,38 @@ static void UpdateEditorState(EditorState &st)
 	}
 
 	if (st.repo_root.empty()) {
-		if (!GetRepoRoot(st.file, st.repo_root)) {
+		if (!GetRepoPaths(st.file, st.repo_root, st.git_dir)) {
 			return;
 		}
 	}
 
+	// diff itself is cheap, so only baseline actuality is checked not more often than interval
+	const uint64_t now = NowMs();
+	bool have_base = !!st.base;
+	if (!have_base || now - st.last_update_ms >= static_cast<uint64_t>(g_settings.interval_ms)) {
+		st.last_update_ms = now;
+		have_base = RefreshBaseline(st);
+	}
+
 	std::string out;
-	if (WriteEditorBufferToTemp(st.temp_path)) {
-		std::string base_path;
-		std::string base_temp;
-		if (g_settings.baseline == "unstaged") {
-			base_path = st.file;
-			if (!FileExists(base_path)) {
-				base_path = "/dev/null";
-			}
-		} else {
-			std::string rel_path;
-			if (!GetRelativePath(st.repo_root, st.file, rel_path)
-					|| !WriteBaselineToTemp(st.repo_root, rel_path, g_settings.baseline, base_temp)) {
-				unlink(st.temp_path.c_str());
-				st.temp_path.clear();
-				goto fallback;
-			}
-			base_path = base_temp;
+	if (have_base) {
+		std::vector<uint64_t> hashes;
+		if (!ReadEditorHashes(hashes, st.cur_no_eol)) {
+			return;
 		}
-		std::string root_arg = st.repo_root;
-		std::string base_arg = base_path;
-		std::string temp_arg = st.temp_path;
-		QuoteCmdArgIfNeed(root_arg);
-		QuoteCmdArgIfNeed(base_arg);
-		QuoteCmdArgIfNeed(temp_arg);
-		const std::string cmd = "git -C " + root_arg
-				+ " diff --no-color --unified=0 --no-index -- " + base_arg + " " + temp_arg;
-		RunCommand(cmd, out);
-		if (!base_temp.empty()) {
-			unlink(base_temp.c_str());
+		st.cur_count = static_cast<int>(hashes.size());
+		const bool eol_changed = (st.cur_no_eol != st.prev_no_eol);
+		st.prev_no_eol = st.cur_no_eol;
+		if (!st.diff.Update(hashes) && !eol_changed) {
+			// same hunks as before, just make sure editor shows them
+			if (!st.marks.empty() && !show_gutter) {
+				st.gutter_request = 1;
+			}
+			ApplyMarksToEditor(st);
+			st.dirty = false;
+			return;
 		}
-	} else {
-fallback:
-		std::string cmd = MakeDiffCommand(st.repo_root, st.file);
-		RunCommand(cmd, out);
+		BuildDiffText(st, out);
 	}
 
 	if (out.empty()) {
@@ -967,6 +1029,7 @@ fallback:
 				st.gutter_request = 0;
 			}
 		}
+		st.dirty = false;
 		return;
 	}
 
@@ -1575,6 +1638,7 @@ static int ShowConfigDialog()
 				EditorState &st = g_editors[ei.EditorID];
 				st.editor_id = ei.EditorID;
 				st.dirty = true;
+				st.last_update_ms = 0;
 				UpdateEditorState(st);
 				ApplyGutterRequest(st);
 			}
@@ -1624,16 +1688,8 @@ SHAREDSYMBOL int WINAPI ProcessEditorEventW(int Event, void *Param)
 			closed_id = *reinterpret_cast<int *>(Param);
 		}
 		if (closed_id != -1) {
-			auto it = g_editors.find(closed_id);
-			if (it != g_editors.end() && !it->second.temp_path.empty()) {
-				unlink(it->second.temp_path.c_str());
-			}
 			g_editors.erase(closed_id);
 		} else {
-			auto it = g_editors.find(ei.EditorID);
-			if (it != g_editors.end() && !it->second.temp_path.empty()) {
-				unlink(it->second.temp_path.c_str());
-			}
 			g_editors.erase(ei.EditorID);
 		}
 		return 0;
@@ -1647,6 +1703,9 @@ SHAREDSYMBOL int WINAPI ProcessEditorEventW(int Event, void *Param)
 
 	if (content_change_event) {
 		st.dirty = true;
+		if (Event != EE_REDRAW) {
+			st.last_update_ms = 0; // file on disk or its git state may have changed
+		}
 		UpdateEditorState(st);
 		if (st.dirty) {
 			MaybeScheduleTick();
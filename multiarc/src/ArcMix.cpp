@@ -73,6 +73,8 @@ extern "C" int ha_main(int argc, char *argv[]);
 
 #ifdef HAVE_LIBARCHIVE
 extern "C" int libarch_main(int numargs, char *args[]);
+#elif defined(HAVE_ZLIB)
+extern "C" int targz_main(int numargs, char *args[]);
 #endif
 
 SHAREDSYMBOL int BuiltinMain(int argc, char *argv[])
@@ -95,6 +97,9 @@ SHAREDSYMBOL int BuiltinMain(int argc, char *argv[])
 #ifdef HAVE_LIBARCHIVE
 	} else if (strcmp(argv[0], "libarch") == 0) {
 		r = libarch_main(argc, &argv[0]);
+#elif defined(HAVE_ZLIB)
+	} else if (strcmp(argv[0], "targz") == 0) {
+		r = targz_main(argc, &argv[0]);
 #endif
 	} else
 		fprintf(stderr, "BuiltinMain: bad target '%s'\n", argv[0]);
@@ -39,6 +39,7 @@ SHAREDSYMBOL void WINAPI _export SetStartupInfo(const struct PluginStartupInfo *
 	// Opt.UserBackground=GetRegKey(HKEY_CURRENT_USER,"","Background",0); // $ 06.02.2002 AA
 	Opt.OldUserBackground = 0;	// $ 02.07.2002 AY
 	Opt.AllowChangeDir = kfh.GetInt("AllowChangeDir", 0);
+	Opt.ListingCache = kfh.GetInt("ListingCache", 1);
 
 	kfh.GetChars(Opt.CommandPrefix1, sizeof(Opt.CommandPrefix1), "Prefix1", "ma");
 
@@ -158,6 +158,8 @@ private:
 	bool FarLangChanged();
 	bool EnsureFindDataUpToDate(int OpMode);
 	int ReadArchive(const char *Name, int OpMode);
+	bool LoadListingCache(const char *Name);
+	void SaveListingCache(const char *Name, DWORD ReadTime);
 
 public:
 	PluginClass(int ArcPluginNumber);
@@ -280,6 +282,7 @@ struct Options
 	// BOOL ExactArcName;   // $ 30.11.2001 AA
 	MAAdvFlags AdvFlags;		//$ 06.03.2002 AA
 	char CommandPrefix1[50];	//$ 23.01.2003 AY
+	int ListingCache;
 };
 
 /*
@@ -0,0 +1,332 @@
+/*
+  Persistent cache of archives listings.
+
+  Listing of archive is saved into cache directory as flat sequence of records
+  of ArcData tree nodes in depth-first order, so its loading doesn't involve
+  format module at all and tree is rebuilt by appending to already sorted maps.
+  Cache file is identified by archive's device and inode and validated by
+  archive's path, size, modification time and format module that produced it.
+*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <set>
+#include <tuple>
+#include <algorithm>
+#include <ScopeHelpers.h>
+#include <CacheFile.h>
+#include "MultiArc.hpp"
+
+#define LISTING_CACHE_DIR "plugins/multiarc/listings"
+
+static const char ListingCacheMagic[8] = {'M', 'A', 'L', 'S', 'T', '0', '0', '2'};
+static const size_t ListingCacheFilesLimit = 64;
+static const DWORD ListingCacheMinReadTime = 500;	// msec
+static const size_t ListingCacheMinItems = 0x1000;
+static const uint32_t ListingCacheNoString = 0xffffffff;
+
+struct ListingCacheHeader
+{
+	CacheFileStamp Stamp;
+	uint64_t Dev;
+	uint64_t Ino;
+	int32_t PluginNumber;
+	int32_t PluginType;
+	int32_t DizPresent;
+	uint32_t PathLength;	// path of archive follows header
+	uint64_t ArcDataCount;
+	int64_t TotalSize;
+	int64_t PackedSize;
+	struct ArcInfo CurArcInfo;
+};
+
+struct ListingCacheRecord
+{
+	uint32_t Depth;
+	uint32_t NameLength;
+	int32_t Solid, Comment, Encrypted, DictSize, UnpVer, Chapter, Codepage;
+	uint32_t FileAttributes, UnixMode, Flags, NumberOfLinks, CRC32;
+	FILETIME CreationTime, LastAccessTime, LastWriteTime;
+	uint64_t PhysicalSize;
+	uint64_t FileSize;
+	// lengths of strings that follow record in same order, ListingCacheNoString if absent
+	uint32_t HostOSLength, DescriptionLength, LinkNameLength, PrefixLength;
+};
+
+// HostOS of items expected to point to static literal, so keep loaded ones forever
+static const char *InternHostOS(const std::string &HostOS)
+{
+	static std::set<std::string> s_host_os;
+	return s_host_os.insert(HostOS).first->c_str();
+}
+
+static uint32_t OptionalStringLength(const char *s)
+{
+	return s ? (uint32_t)strlen(s) : ListingCacheNoString;
+}
+
+static uint32_t OptionalStringLength(const std::unique_ptr<std::string> &s)
+{
+	return s ? (uint32_t)s->size() : ListingCacheNoString;
+}
+
+class ListingCacheWriter
+{
+	FILE *_f;
+	bool _ok = true;
+
+	void Write(const void *Data, size_t Size)
+	{
+		if (_ok && Size && fwrite(Data, 1, Size, _f) != Size)
+			_ok = false;
+	}
+
+	void WriteOptional(const std::unique_ptr<std::string> &s)
+	{
+		if (s)
+			Write(s->data(), s->size());
+	}
+
+public:
+	ListingCacheWriter(FILE *f) : _f(f) {}
+
+	bool OK() const { return _ok; }
+
+	void WriteHeader(const ListingCacheHeader &Header, const std::string &Path)
+	{
+		Write(&Header, sizeof(Header));
+		Write(Path.data(), Path.size());
+	}
+
+	void WriteRecord(const ArcItemAttributes &Node, uint32_t Depth, const std::string &Name)
+	{
+		ListingCacheRecord Record{};
+		Record.Depth = Depth;
+		Record.NameLength = (uint32_t)Name.size();
+		Record.Solid = Node.Solid;
+		Record.Comment = Node.Comment;
+		Record.Encrypted = Node.Encrypted;
+		Record.DictSize = Node.DictSize;
+		Record.UnpVer = Node.UnpVer;
+		Record.Chapter = Node.Chapter;
+		Record.Codepage = Node.Codepage;
+		Record.FileAttributes = Node.dwFileAttributes;
+		Record.UnixMode = Node.dwUnixMode;
+		Record.Flags = Node.Flags;
+		Record.NumberOfLinks = Node.NumberOfLinks;
+		Record.CRC32 = Node.CRC32;
+		Record.CreationTime = Node.ftCreationTime;
+		Record.LastAccessTime = Node.ftLastAccessTime;
+		Record.LastWriteTime = Node.ftLastWriteTime;
+		Record.PhysicalSize = Node.nPhysicalSize;
+		Record.FileSize = Node.nFileSize;
+		Record.HostOSLength = OptionalStringLength(Node.HostOS);
+		Record.DescriptionLength = OptionalStringLength(Node.Description);
+		Record.LinkNameLength = OptionalStringLength(Node.LinkName);
+		Record.PrefixLength = OptionalStringLength(Node.Prefix);
+
+		Write(&Record, sizeof(Record));
+		Write(Name.data(), Name.size());
+		if (Node.HostOS)
+			Write(Node.HostOS, Record.HostOSLength);
+		WriteOptional(Node.Description);
+		WriteOptional(Node.LinkName);
+		WriteOptional(Node.Prefix);
+	}
+
+	void WriteNode(const ArcItemNode &Node, uint32_t Depth, const std::string &Name)
+	{
+		WriteRecord(Node, Depth, Name);
+		for (const auto &it : Node) {
+			WriteNode(it.second, Depth + 1, it.first);
+		}
+	}
+};
+
+class ListingCacheReader
+{
+	const char *_ptr, *_end;
+
+public:
+	ListingCacheReader(const void *Data, size_t Size)
+		: _ptr((const char *)Data), _end((const char *)Data + Size) {}
+
+	bool AtEnd() const { return _ptr == _end; }
+
+	template <class T>
+		bool Read(T &v)
+	{
+		if (size_t(_end - _ptr) < sizeof(T))
+			return false;
+		memcpy(&v, _ptr, sizeof(T));
+		_ptr+= sizeof(T);
+		return true;
+	}
+
+	bool ReadString(std::string &s, uint32_t Length)
+	{
+		if (size_t(_end - _ptr) < Length)
+			return false;
+		s.assign(_ptr, Length);
+		_ptr+= Length;
+		return true;
+	}
+
+	bool ReadOptional(std::unique_ptr<std::string> &s, uint32_t Length)
+	{
+		if (Length == ListingCacheNoString)
+			return true;
+		s.reset(new std::string);
+		return ReadString(*s, Length);
+	}
+};
+
+static void FillHeader(ListingCacheHeader &Header, const struct stat &ArcStat, int PluginNumber)
+{
+	Header.Stamp.Fill(ListingCacheMagic, ArcStat);
+	Header.Dev = ArcStat.st_dev;
+	Header.Ino = ArcStat.st_ino;
+	Header.PluginNumber = PluginNumber;
+}
+
+bool PluginClass::LoadListingCache(const char *Name)
+{
+	if (!Opt.ListingCache)
+		return false;
+
+	const std::string &CachePath = CacheFilePath(LISTING_CACHE_DIR, ArcStat, "lst");
+	FDScope fd(open(CachePath.c_str(), O_RDONLY | O_CLOEXEC));
+	struct stat CacheStat{};
+	if (!fd.Valid() || fstat(fd, &CacheStat) == -1 || (size_t)CacheStat.st_size < sizeof(ListingCacheHeader))
+		return false;
+
+	void *Data = mmap(NULL, CacheStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (Data == MAP_FAILED)
+		return false;
+
+	ItemsInfo = ArcItemInfo{};
+	ZeroFill(CurArcInfo);
+	ListingCacheReader Reader(Data, CacheStat.st_size);
+	ListingCacheHeader Header{}, Expected{};
+	FillHeader(Expected, ArcStat, ArcPluginNumber);
+	std::string Path;
+	if (!Reader.Read(Header) || !Header.Stamp.Matches(ListingCacheMagic, ArcStat)
+			|| Header.Dev != Expected.Dev || Header.Ino != Expected.Ino
+			|| Header.PluginNumber != Expected.PluginNumber
+			|| !Reader.ReadString(Path, Header.PathLength) || Path != Name) {
+		// outdated listing, will be overwritten after archive reread
+		munmap(Data, CacheStat.st_size);
+		return false;
+	}
+
+	bool OK = true;
+	std::vector<ArcItemNode *> Parents;
+	std::string NodeName, HostOS;
+	ListingCacheRecord Record;
+	for (bool First = true; OK && !Reader.AtEnd(); First = false) {
+		OK = Reader.Read(Record) && Reader.ReadString(NodeName, Record.NameLength);
+		if (!OK)
+			break;
+
+		// first record keeps ItemsInfo, next ones - nodes of ArcData, root first
+		ArcItemAttributes *Attrs;
+		if (First) {
+			Attrs = &ItemsInfo;
+
+		} else if (Record.Depth == 0) {
+			Parents.assign(1, &ArcData);
+			Attrs = &ArcData;
+
+		} else if (Record.Depth <= Parents.size()) {
+			Parents.resize(Record.Depth);
+			auto *Parent = Parents.back();
+			auto it = Parent->emplace_hint(Parent->end(), std::piecewise_construct,
+				std::forward_as_tuple(NodeName), std::forward_as_tuple());
+			Parents.emplace_back(&it->second);
+			Attrs = &it->second;
+
+		} else {
+			OK = false;
+			break;
+		}
+
+		Attrs->Solid = Record.Solid;
+		Attrs->Comment = Record.Comment;
+		Attrs->Encrypted = Record.Encrypted;
+		Attrs->DictSize = Record.DictSize;
+		Attrs->UnpVer = Record.UnpVer;
+		Attrs->Chapter = Record.Chapter;
+		Attrs->Codepage = Record.Codepage;
+		Attrs->dwFileAttributes = Record.FileAttributes;
+		Attrs->dwUnixMode = Record.UnixMode;
+		Attrs->Flags = Record.Flags;
+		Attrs->NumberOfLinks = Record.NumberOfLinks;
+		Attrs->CRC32 = Record.CRC32;
+		Attrs->ftCreationTime = Record.CreationTime;
+		Attrs->ftLastAccessTime = Record.LastAccessTime;
+		Attrs->ftLastWriteTime = Record.LastWriteTime;
+		Attrs->nPhysicalSize = Record.PhysicalSize;
+		Attrs->nFileSize = Record.FileSize;
+		if (Record.HostOSLength != ListingCacheNoString) {
+			OK = Reader.ReadString(HostOS, Record.HostOSLength);
+			Attrs->HostOS = InternHostOS(HostOS);
+		}
+		OK = OK && Reader.ReadOptional(Attrs->Description, Record.DescriptionLength)
+			&& Reader.ReadOptional(Attrs->LinkName, Record.LinkNameLength)
+			&& Reader.ReadOptional(Attrs->Prefix, Record.PrefixLength);
+	}
+
+	munmap(Data, CacheStat.st_size);
+
+	if (!OK || Parents.empty()) {
+		fprintf(stderr, "MA::LoadListingCache: bad cache '%s' for '%s'\n", CachePath.c_str(), Name);
+		FreeArcData();
+		ItemsInfo = ArcItemInfo{};
+		unlink(CachePath.c_str());
+		return false;
+	}
+
+	ArcPluginType = Header.PluginType;
+	DizPresent = Header.DizPresent;
+	ArcDataCount = (size_t)Header.ArcDataCount;
+	TotalSize = Header.TotalSize;
+	PackedSize = Header.PackedSize;
+	CurArcInfo = Header.CurArcInfo;
+
+	CacheFileTouch(CachePath);
+	return true;
+}
+
+void PluginClass::SaveListingCache(const char *Name, DWORD ReadTime)
+{
+	if (!Opt.ListingCache || (ReadTime < ListingCacheMinReadTime && ArcDataCount < ListingCacheMinItems))
+		return;
+
+	// don't leak names from archives with encrypted headers into cache
+	if ((CurArcInfo.Flags & AF_HDRENCRYPTED) != 0)
+		return;
+
+	const std::string &CachePath = CacheFilePath(LISTING_CACHE_DIR, ArcStat, "lst");
+	std::string TempPath;
+	FILE *f = CacheFileCreate(CachePath, TempPath);
+	if (!f)
+		return;
+
+	ListingCacheHeader Header{};
+	FillHeader(Header, ArcStat, ArcPluginNumber);
+	Header.PluginType = ArcPluginType;
+	Header.DizPresent = DizPresent;
+	Header.PathLength = (uint32_t)strlen(Name);
+	Header.ArcDataCount = ArcDataCount;
+	Header.TotalSize = TotalSize;
+	Header.PackedSize = PackedSize;
+	Header.CurArcInfo = CurArcInfo;
+
+	ListingCacheWriter Writer(f);
+	Writer.WriteHeader(Header, Name);
+
+	Writer.WriteRecord(ItemsInfo, 0, std::string());
+	Writer.WriteNode(ArcData, 0, std::string());
+
+	CacheFileCommit(f, TempPath, CachePath, Writer.OK(), ListingCacheFilesLimit);
+}
@@ -49,6 +49,10 @@ int PluginClass::ReadArchive(const char *Name, int OpMode)
 	if (sdc_stat(Name, &ArcStat) == -1)
 		return FALSE;
 
+	if (LoadListingCache(Name))
+		return TRUE;
+
+	const DWORD ReadStartTime = GetProcessUptimeMSec();
 	if (!ArcPlugin->OpenArchive(ArcPluginNumber, Name, &ArcPluginType, (OpMode & OPM_SILENT) != 0))
 		return FALSE;
 
@@ -174,6 +178,8 @@ int PluginClass::ReadArchive(const char *Name, int OpMode)
 		return FALSE;	// Mantis#0001241
 	}
 
+	SaveListingCache(Name, GetProcessUptimeMSec() - ReadStartTime);
+
 	// Info.RestoreScreen(NULL);
 	// Info.RestoreScreen(hScreen);
 	return TRUE;
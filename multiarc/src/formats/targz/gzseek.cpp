@@ -0,0 +1,305 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <utils.h>
+#include <CacheFile.h>
+#include "gzseek.h"
+
+#define GZSEEK_INDEX_DIR "plugins/multiarc/gzindex"
+
+static const char GZSeekIndexMagic[8] = {'M', 'A', 'G', 'Z', 'I', '0', '0', '2'};
+static const size_t GZSeekIndexFilesLimit = 16;
+static const size_t GZSeekWindowSize = 32768;
+
+struct GZSeekIndexHeader
+{
+	CacheFileStamp Stamp;
+	uint64_t Span;
+	uint64_t PointsCount;
+	uint64_t EntriesCount;
+};
+
+struct GZSeekPointRecord
+{
+	uint64_t Out;
+	uint64_t In;
+	uint32_t Bits;
+	uint32_t WindowSize;	// deflated window follows record
+};
+
+struct GZSeekEntryRecord
+{
+	uint64_t Offset;
+	uint32_t PathLength;	// path follows record
+};
+
+
+const GZSeekPoint *GZSeekIndex::Nearest(uint64_t Out) const
+{
+	auto it = std::upper_bound(Points.begin(), Points.end(), Out,
+		[](uint64_t v, const GZSeekPoint &p) { return v < p.Out; });
+	return (it == Points.begin()) ? nullptr : &*(--it);
+}
+
+bool GZSeekIndex::Load(const struct stat &ArcStat)
+{
+	const std::string &Path = CacheFilePath(GZSEEK_INDEX_DIR, ArcStat, "gzi");
+	FILE *f = fopen(Path.c_str(), "rb");
+	if (!f)
+		return false;
+
+	GZSeekIndexHeader Header{};
+	bool out = fread(&Header, sizeof(Header), 1, f) == 1
+		&& Header.Stamp.Matches(GZSeekIndexMagic, ArcStat)
+		&& Header.Span != 0;
+
+	if (out) {
+		Span = Header.Span;
+		Points.resize(Header.PointsCount);
+		for (auto &Point : Points) {
+			GZSeekPointRecord Record;
+			if (fread(&Record, sizeof(Record), 1, f) != 1
+					|| Record.WindowSize > compressBound(GZSeekWindowSize)) {
+				out = false;
+				break;
+			}
+			Point.Out = Record.Out;
+			Point.In = Record.In;
+			Point.Bits = Record.Bits;
+			Point.Window.resize(Record.WindowSize);
+			if (Record.WindowSize && fread(Point.Window.data(), Record.WindowSize, 1, f) != 1) {
+				out = false;
+				break;
+			}
+		}
+	}
+
+	if (out) {
+		Entries.resize(Header.EntriesCount);
+		for (auto &Entry : Entries) {
+			GZSeekEntryRecord Record;
+			if (fread(&Record, sizeof(Record), 1, f) != 1 || Record.PathLength > 0x100000) {
+				out = false;
+				break;
+			}
+			Entry.Offset = Record.Offset;
+			Entry.Path.resize(Record.PathLength);
+			if (Record.PathLength && fread(&Entry.Path[0], Record.PathLength, 1, f) != 1) {
+				out = false;
+				break;
+			}
+		}
+	}
+
+	fclose(f);
+
+	if (!out) {
+		Points.clear();
+		Entries.clear();
+		return false;
+	}
+
+	CacheFileTouch(Path);
+	return true;
+}
+
+void GZSeekIndex::Save(const struct stat &ArcStat) const
+{
+	const std::string &Path = CacheFilePath(GZSEEK_INDEX_DIR, ArcStat, "gzi");
+	std::string TempPath;
+	FILE *f = CacheFileCreate(Path, TempPath);
+	if (!f)
+		return;
+
+	GZSeekIndexHeader Header{};
+	Header.Stamp.Fill(GZSeekIndexMagic, ArcStat);
+	Header.Span = Span;
+	Header.PointsCount = Points.size();
+	Header.EntriesCount = Entries.size();
+	bool out = fwrite(&Header, sizeof(Header), 1, f) == 1;
+
+	for (const auto &Point : Points) {
+		if (!out)
+			break;
+		const GZSeekPointRecord Record{Point.Out, Point.In, Point.Bits, (uint32_t)Point.Window.size()};
+		out = fwrite(&Record, sizeof(Record), 1, f) == 1
+			&& (Point.Window.empty() || fwrite(Point.Window.data(), Point.Window.size(), 1, f) == 1);
+	}
+
+	for (const auto &Entry : Entries) {
+		if (!out)
+			break;
+		const GZSeekEntryRecord Record{Entry.Offset, (uint32_t)Entry.Path.size()};
+		out = fwrite(&Record, sizeof(Record), 1, f) == 1
+			&& (Entry.Path.empty() || fwrite(Entry.Path.data(), Entry.Path.size(), 1, f) == 1);
+	}
+
+	CacheFileCommit(f, TempPath, Path, out, GZSeekIndexFilesLimit);
+}
+
+////////////////////////////////////////////////////////////
+
+GZSeekReader::GZSeekReader(int fd, GZSeekIndex &index)
+	: _fd(fd), _index(index)
+{
+	if (inflateInit2(&_zs, 15 + 16) != Z_OK) {
+		_eof = true;
+	}
+	lseek(_fd, 0, SEEK_SET);
+}
+
+GZSeekReader::~GZSeekReader()
+{
+	inflateEnd(&_zs);
+}
+
+bool GZSeekReader::FillInput()
+{
+	ssize_t r = read(_fd, _in, sizeof(_in));
+	if (r <= 0)
+		return false;
+
+	_zs.next_in = _in;
+	_zs.avail_in = (uInt)r;
+	_in_offset+= r;
+	return true;
+}
+
+bool GZSeekReader::NextMember()
+{
+	if (_raw) { // raw inflate leaves member's CRC32 and ISIZE unconsumed
+		for (uInt skip = 8; skip;) {
+			if (!_zs.avail_in && !FillInput())
+				return false;
+			const uInt n = std::min(skip, _zs.avail_in);
+			_zs.next_in+= n;
+			_zs.avail_in-= n;
+			skip-= n;
+		}
+		_raw = false;
+	}
+
+	if (!_zs.avail_in && !FillInput())
+		return false;
+
+	// concatenated gzip members are valid gzip stream, but trailing zeroes padding is not
+	if (*_zs.next_in != 0x1f)
+		return false;
+
+	return inflateReset2(&_zs, 15 + 16) == Z_OK;
+}
+
+void GZSeekReader::AddPoint()
+{
+	if (_out < (_index.Points.empty() ? _index.Span : _index.Points.back().Out + _index.Span))
+		return;
+
+	unsigned char Window[GZSeekWindowSize];
+	uInt WindowLen = sizeof(Window);
+	if (inflateGetDictionary(&_zs, Window, &WindowLen) != Z_OK)
+		return;
+
+	GZSeekPoint Point;
+	Point.Out = _out;
+	Point.In = _in_offset - _zs.avail_in;
+	Point.Bits = _zs.data_type & 7;
+	uLongf PackedLen = compressBound(WindowLen);
+	Point.Window.resize(PackedLen);
+	if (compress2(Point.Window.data(), &PackedLen, Window, WindowLen, 1) != Z_OK)
+		return;
+
+	Point.Window.resize(PackedLen);
+	Point.Window.shrink_to_fit();
+	_index.Points.emplace_back(std::move(Point));
+}
+
+size_t GZSeekReader::Read(void *buf, size_t len)
+{
+	_zs.next_out = (Bytef *)buf;
+	_zs.avail_out = (uInt)std::min(len, (size_t)0x40000000);
+	const uInt avail_initial = _zs.avail_out;
+
+	while (_zs.avail_out && !_eof) {
+		if (!_zs.avail_in && !FillInput()) {
+			fprintf(stderr, "GZSeekReader: unexpected end of data at %llu\n", (unsigned long long)_out);
+			_eof = true;
+			break;
+		}
+
+		const uInt avail_before = _zs.avail_out;
+		int r = inflate(&_zs, Z_BLOCK);
+		_out+= avail_before - _zs.avail_out;
+
+		if (r == Z_STREAM_END) {
+			if (!NextMember())
+				_eof = true;
+
+		} else if (r != Z_OK && r != Z_BUF_ERROR) {
+			fprintf(stderr, "GZSeekReader: inflate error %d (%s) at %llu\n",
+				r, _zs.msg ? _zs.msg : "", (unsigned long long)_out);
+			_eof = true;
+
+		} else if ((_zs.data_type & 128) != 0 && (_zs.data_type & 64) == 0) {
+			AddPoint();
+		}
+	}
+
+	return avail_initial - _zs.avail_out;
+}
+
+bool GZSeekReader::Skip(uint64_t len)
+{
+	unsigned char buf[0x10000];
+	while (len) {
+		const size_t piece = (size_t)std::min(len, (uint64_t)sizeof(buf));
+		if (Read(buf, piece) != piece)
+			return false;
+		len-= piece;
+	}
+	return true;
+}
+
+bool GZSeekReader::SeekTo(uint64_t out)
+{
+	const GZSeekPoint *Point = _index.Nearest(out);
+	if (out >= _out && (!Point || Point->Out <= _out + _index.Span / 4))
+		return Skip(out - _out);
+
+	_eof = false;
+	_zs.avail_in = 0;
+
+	if (!Point) {
+		if (lseek(_fd, 0, SEEK_SET) == -1 || inflateReset2(&_zs, 15 + 16) != Z_OK)
+			return false;
+		_in_offset = 0;
+		_out = 0;
+		_raw = false;
+		return Skip(out);
+	}
+
+	const uint64_t In = Point->In - (Point->Bits ? 1 : 0);
+	if (lseek(_fd, In, SEEK_SET) == -1 || inflateReset2(&_zs, -15) != Z_OK)
+		return false;
+
+	_in_offset = In;
+	if (Point->Bits) {
+		if (!FillInput())
+			return false;
+		const int Byte = *_zs.next_in;
+		++_zs.next_in;
+		--_zs.avail_in;
+		inflatePrime(&_zs, Point->Bits, Byte >> (8 - Point->Bits));
+	}
+
+	unsigned char Window[GZSeekWindowSize];
+	uLongf WindowLen = sizeof(Window);
+	if (uncompress(Window, &WindowLen, Point->Window.data(), Point->Window.size()) != Z_OK
+			|| inflateSetDictionary(&_zs, Window, (uInt)WindowLen) != Z_OK)
+		return false;
+
+	_raw = true;
+	_out = Point->Out;
+	return Skip(out - _out);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// zran-like random access into gzip stream: decompressor state at some deflate blocks
+// boundaries is remembered as access point, so reading from arbitrary uncompressed offset
+// requires decompression only from nearest preceding access point instead of stream start.
+
+struct GZSeekPoint
+{
+	uint64_t Out;		// offset in uncompressed data
+	uint64_t In;		// offset in compressed file of first byte that has complete bits of block
+	uint32_t Bits;		// count of bits of preceding byte that belong to block
+	std::vector<unsigned char> Window;	// deflated last 32KB of uncompressed data before Out
+};
+
+struct GZSeekEntry
+{
+	uint64_t Offset;	// offset of item's first tar header in uncompressed data
+	std::string Path;
+};
+
+struct GZSeekIndex
+{
+	uint64_t Span{4 * 1024 * 1024};
+	std::vector<GZSeekPoint> Points;
+	std::vector<GZSeekEntry> Entries;	// filled by tar walker, saved only if walk was complete
+
+	const GZSeekPoint *Nearest(uint64_t Out) const;
+
+	bool Load(const struct stat &ArcStat);
+	void Save(const struct stat &ArcStat) const;
+};
+
+class GZSeekReader
+{
+	int _fd;
+	GZSeekIndex &_index;
+	z_stream _zs{};
+	bool _raw{false};	// inflating raw deflate data after seek, so gzip trailer has to be skipped manually
+	bool _eof{false};
+	uint64_t _in_offset{0};	// file offset of byte following last read into _in
+	uint64_t _out{0};
+	unsigned char _in[0x10000];
+
+	bool FillInput();
+	bool NextMember();
+	void AddPoint();
+
+public:
+	GZSeekReader(int fd, GZSeekIndex &index);
+	~GZSeekReader();
+
+	size_t Read(void *buf, size_t len);
+	bool Skip(uint64_t len);
+	bool SeekTo(uint64_t out);
+
+	inline uint64_t Tell() const { return _out; }
+};
@@ -13,9 +13,19 @@
 #include <utils.h>
 #include <string.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <memory>
+#include <algorithm>
+#include <ScopeHelpers.h>
+#include <PathParts.h>
 #include <farplug-mb.h>
 using namespace oldfar;
 #include "fmt.hpp"
+#ifdef HAVE_ZLIB
+#include "gzseek.h"
+#endif
 
 #if defined(__BORLANDC__)
 #pragma option -a1
@@ -121,7 +131,8 @@ enum
 	GZ_FORMAT,
 	Z_FORMAT,
 	BZ_FORMAT,
-	XZ_FORMAT
+	XZ_FORMAT,
+	TGZ_FORMAT	// tar inside gzip, listed and extracted directly using seek index
 };
 
 typedef union
@@ -138,6 +149,12 @@ static int IsTarHeader(const unsigned char *Data, int DataSize);
 static int64_t GetOctal(const char *Str);
 static int GetArcItemGZIP(struct ArcItemInfo *Info);
 static int GetArcItemTAR(struct ArcItemInfo *Info);
+#ifdef HAVE_ZLIB
+static bool IsTarGZ(const unsigned char *Data, int DataSize);
+static int GetArcItemTGZ(struct ArcItemInfo *Info);
+static bool OpenArchiveTGZ(const char *Name);
+static void CloseArchiveTGZ();
+#endif
 static int64_t Oct2Size(const char *where0, size_t digs0);
 
 static HANDLE ArcHandle;
@@ -172,8 +189,15 @@ BOOL WINAPI _export TARGZ_IsArchive(const char *Name, const unsigned char *Data,
 	if (DataSize < 2)
 		return (FALSE);
 
-	if (Data[0] == 0x1f && Data[1] == 0x8b)
+	if (Data[0] == 0x1f && Data[1] == 0x8b) {
 		ArcType = GZ_FORMAT;
+#ifdef HAVE_ZLIB
+		if (IsTarGZ(Data, DataSize)) {
+			ArcType = TGZ_FORMAT;
+			return (TRUE);
+		}
+#endif
+	}
 	else if (Data[0] == 0x1f && Data[1] == 0x9d)
 		ArcType = Z_FORMAT;
 	else if (Data[0] == 'B' && Data[1] == 'Z')
@@ -199,6 +223,12 @@ BOOL WINAPI _export TARGZ_IsArchive(const char *Name, const unsigned char *Data,
 
 BOOL WINAPI _export TARGZ_OpenArchive(const char *Name, int *Type, bool Silent)
 {
+#ifdef HAVE_ZLIB
+	if (ArcType == TGZ_FORMAT) {
+		*Type = ArcType;
+		return OpenArchiveTGZ(Name);
+	}
+#endif
 	ArcHandle = WINPORT(CreateFile)(MB2Wide(Name).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
 			NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
 	if (ArcHandle == INVALID_HANDLE_VALUE)
@@ -218,6 +248,10 @@ DWORD WINAPI _export TARGZ_GetSFXPos(void)
 
 int WINAPI _export TARGZ_GetArcItem(struct ArcItemInfo *Info)
 {
+#ifdef HAVE_ZLIB
+	if (ArcType == TGZ_FORMAT)
+		return GetArcItemTGZ(Info);
+#endif
 	if (ArcType != TAR_FORMAT) {
 		if (!ZipName.empty()) {
 			switch (ArcType) {
@@ -313,6 +347,79 @@ static int GetArcItemGZIP(struct ArcItemInfo *Info)
 	return (GETARC_SUCCESS);
 }
 
+// pax extended header consists of sequence of "len key=value\n" strings, Data must be NUL-terminated
+static bool PaxRecordValue(const char *Data, size_t Size, const char *Key, std::string &Value)
+{
+	const size_t KeyLen = strlen(Key);
+	bool out = false;
+	for (size_t i = 0; i < Size;) {
+		int len = atoi(&Data[i]);
+		if (len <= 0 || (size_t)len > Size - i) {
+			fprintf(stderr, "%s: ext record bad len=%d at %lx\n", __FUNCTION__, len, (unsigned long)i);
+			break;
+		}
+
+		const char *spc = strchr(&Data[i], ' ');
+		const char *eq = strchr(&Data[i], '=');
+		if (!spc || !eq || eq < spc || Data[i + len - 1] != '\n') {
+			fprintf(stderr, "%s: ext record bad at %lx\n", __FUNCTION__, (unsigned long)i);
+			break;
+		}
+		if (size_t(eq - spc - 1) == KeyLen && strncmp(spc + 1, Key, KeyLen) == 0) {
+			Value.assign(eq + 1, &Data[i + len - 1]);
+			out = true;
+		}
+		i+= len;
+	}
+	return out;
+}
+
+static void TarHeaderToItemInfo(const TARHeader &TAR_hdr, struct ArcItemInfo *Info)
+{
+	Info->nFileSize = 0;
+	DWORD dwUnixMode = (DWORD)GetOctal(TAR_hdr.header.mode);
+	switch (TAR_hdr.header.typeflag) {
+		case REGTYPE:
+		case AREGTYPE:
+			dwUnixMode|= S_IFREG;
+			break;
+
+		case SYMTYPE:
+			// fallthrough
+		case LNKTYPE:
+			dwUnixMode|= S_IFLNK;
+			break;
+
+		case CHRTYPE:
+			dwUnixMode|= S_IFCHR;
+			break;
+
+		case BLKTYPE:
+			dwUnixMode|= S_IFBLK;
+			break;
+
+		case FIFOTYPE:
+			dwUnixMode|= S_IFIFO;
+			break;
+
+		case DIRTYPE:
+			dwUnixMode|= S_IFDIR;
+			break;
+	}
+
+	if ((dwUnixMode & S_IFMT) == S_IFLNK)		// TAR_hdr.header.typeflag == SYMTYPE || TAR_hdr.header.typeflag == LNKTYPE
+	{
+		Info->LinkName.reset(new std::string(TAR_hdr.header.linkname));
+		if (TAR_hdr.header.typeflag == LNKTYPE)
+			Info->LinkName->insert(0, "/");
+	}
+
+	Info->dwFileAttributes = WINPORT(EvaluateAttributesA)(dwUnixMode, Info->PathName.c_str());
+	Info->dwUnixMode = dwUnixMode;
+
+	UnixTimeToFileTime((DWORD)GetOctal(TAR_hdr.header.mtime), &Info->ftLastWriteTime);
+}
+
 static int GetArcItemTAR(struct ArcItemInfo *Info)
 {
 	TARHeader TAR_hdr;
@@ -341,7 +448,6 @@ static int GetArcItemTAR(struct ArcItemInfo *Info)
 			SkipItem = TRUE;
 		} else {
 			// TODO: GNUTYPE_LONGLINK
-			DWORD dwUnixMode = 0;
 			SkipItem = FALSE;
 			if (!LongName.empty()) {
 				Info->PathName = LongName.data();
@@ -354,48 +460,7 @@ static int GetArcItemTAR(struct ArcItemInfo *Info)
 				CharArrayAppendToStr(Info->PathName, TAR_hdr.header.name);
 			}
 
-			Info->nFileSize = 0;
-			dwUnixMode = (DWORD)GetOctal(TAR_hdr.header.mode);
-			switch (TAR_hdr.header.typeflag) {
-				case REGTYPE:
-				case AREGTYPE:
-					dwUnixMode|= S_IFREG;
-					break;
-
-				case SYMTYPE:
-					// fallthrough
-				case LNKTYPE:
-					dwUnixMode|= S_IFLNK;
-					break;
-
-				case CHRTYPE:
-					dwUnixMode|= S_IFCHR;
-					break;
-
-				case BLKTYPE:
-					dwUnixMode|= S_IFBLK;
-					break;
-
-				case FIFOTYPE:
-					dwUnixMode|= S_IFIFO;
-					break;
-
-				case DIRTYPE:
-					dwUnixMode|= S_IFDIR;
-					break;
-			}
-
-			if ((dwUnixMode & S_IFMT) == S_IFLNK)		// TAR_hdr.header.typeflag == SYMTYPE || TAR_hdr.header.typeflag == LNKTYPE
-			{
-				Info->LinkName.reset(new std::string(TAR_hdr.header.linkname));
-				if (TAR_hdr.header.typeflag == LNKTYPE)
-					Info->LinkName->insert(0, "/");
-			}
-
-			Info->dwFileAttributes = WINPORT(EvaluateAttributesA)(dwUnixMode, Info->PathName.c_str());
-			Info->dwUnixMode = dwUnixMode;
-
-			UnixTimeToFileTime((DWORD)GetOctal(TAR_hdr.header.mtime), &Info->ftLastWriteTime);
+			TarHeaderToItemInfo(TAR_hdr, Info);
 		}
 
 		DWORD64 TarItemSize = (TAR_hdr.header.typeflag == DIRTYPE)		// #348
@@ -437,27 +502,13 @@ static int GetArcItemTAR(struct ArcItemInfo *Info)
 
 			if (TAR_hdr.header.typeflag == GNUTYPE_PAXHDR) {	// pax extended header: consists of sequence of "len key=value\n" strings
 				// currently using only "path" key - its a modern way to specify long file path
-				std::vector<char> PathRecord;
-				for (DWORD i = 0; i < BytesRead;) {
-					int len = atoi(&LongName[i]);
-					if (len <= 0 || (DWORD)len > BytesRead - i) {
-						fprintf(stderr, "%s: ext record bad len=%d at %x\n", __FUNCTION__, len, i);
-						break;
-					}
-
-					char *spc = strchr(&LongName[i], ' ');
-					char *eq = strchr(&LongName[i], '=');
-					if (!spc || !eq || eq < spc || LongName[i + len - 1] != '\n') {
-						fprintf(stderr, "%s: ext record bad at %x\n", __FUNCTION__, i);
-						break;
-					}
-					if (strncmp(spc, " path=", 6) == 0) {
-						PathRecord.assign(eq + 1, &LongName[i + len - 1]);
-						PathRecord.emplace_back(0);
-					}
-					i+= len;
+				std::string Path;
+				const bool HasPath = PaxRecordValue(LongName.data(), BytesRead, "path", Path);
+				LongName.clear();
+				if (HasPath) {
+					LongName.assign(Path.begin(), Path.end());
+					LongName.emplace_back(0);
 				}
-				LongName.swap(PathRecord);
 			}
 		}
 
@@ -466,19 +517,510 @@ static int GetArcItemTAR(struct ArcItemInfo *Info)
 	return (GETARC_SUCCESS);
 }
 
+#ifdef HAVE_ZLIB
+
+struct TGZItem
+{
+	TARHeader Hdr;
+	uint64_t Offset;	// of item's first header, including preceding long name and pax headers
+	uint64_t Size;		// of data that follows header
+	std::string Path, Link;
+};
+
+static int TGZFd = -1;
+static struct stat TGZStat;
+static std::unique_ptr<GZSeekIndex> TGZIndex;
+static std::unique_ptr<GZSeekReader> TGZReader;
+static uint64_t TGZNext;
+static bool TGZIndexLoaded, TGZComplete;
+
+static bool IsTarGZ(const unsigned char *Data, int DataSize)
+{
+	TARHeader Hdr;
+	z_stream zs{};
+	if (inflateInit2(&zs, 15 + 16) != Z_OK)
+		return false;
+
+	zs.next_in = (Bytef *)Data;
+	zs.avail_in = DataSize;
+	zs.next_out = (Bytef *)&Hdr;
+	zs.avail_out = sizeof(Hdr);
+	while (zs.avail_out && inflate(&zs, Z_NO_FLUSH) == Z_OK) {
+	}
+	inflateEnd(&zs);
+
+	return zs.avail_out == 0 && IsTarHeader((const BYTE *)&Hdr, sizeof(Hdr));
+}
+
+static int ReadTGZItem(GZSeekReader &Reader, TGZItem &Item)
+{
+	Item.Offset = Reader.Tell();
+	Item.Path.clear();
+	Item.Link.clear();
+	std::vector<char> Ext;
+	for (;;) {
+		const size_t ReadSize = Reader.Read(&Item.Hdr, sizeof(Item.Hdr));
+		if (ReadSize == 0 || (ReadSize == sizeof(Item.Hdr) && *Item.Hdr.header.name == 0))
+			return GETARC_EOF;
+
+		if (ReadSize != sizeof(Item.Hdr))
+			return GETARC_UNEXPEOF;
+
+		const char Type = Item.Hdr.header.typeflag;
+		const int64_t Size = (Type == DIRTYPE)		// #348
+				? 0
+				: Oct2Size(Item.Hdr.header.size, sizeof(Item.Hdr.header.size));
+		if (Size < 0)
+			return GETARC_BROKEN;
+
+		if (Type != GNUTYPE_LONGNAME && Type != GNUTYPE_LONGLINK && Type != GNUTYPE_PAXHDR) {
+			if (Item.Path.empty()) {
+				if (Item.Hdr.header.prefix[0]) {
+					CharArrayAssignToStr(Item.Path, Item.Hdr.header.prefix);
+					Item.Path+= '/';
+				}
+				CharArrayAppendToStr(Item.Path, Item.Hdr.header.name);
+			}
+			if (Item.Link.empty()) {
+				CharArrayAssignToStr(Item.Link, Item.Hdr.header.linkname);
+			}
+			// for LNKTYPE - only header
+			Item.Size = (Type == LNKTYPE) ? 0 : Size;
+			return GETARC_SUCCESS;
+		}
+
+		if (Size > 0x100000)
+			return GETARC_BROKEN;
+
+		Ext.resize(((Size + 511) & ~int64_t(511)) + 1);
+		if (Reader.Read(Ext.data(), Ext.size() - 1) != Ext.size() - 1)
+			return GETARC_UNEXPEOF;
+
+		Ext[Size] = 0;
+		if (Type == GNUTYPE_LONGNAME) {
+			Item.Path = Ext.data();
+		} else if (Type == GNUTYPE_LONGLINK) {
+			Item.Link = Ext.data();
+		} else {
+			PaxRecordValue(Ext.data(), Size, "path", Item.Path);
+			PaxRecordValue(Ext.data(), Size, "linkpath", Item.Link);
+		}
+	}
+}
+
+static int GetArcItemTGZ(struct ArcItemInfo *Info)
+{
+	if (!TGZReader->SeekTo(TGZNext))
+		return GETARC_UNEXPEOF;
+
+	TGZItem Item;
+	int r = ReadTGZItem(*TGZReader, Item);
+	if (r != GETARC_SUCCESS) {
+		TGZComplete = (r == GETARC_EOF);
+		return r;
+	}
+
+	TGZNext = TGZReader->Tell() + ((Item.Size + 511) & ~uint64_t(511));
+	TGZIndex->Entries.emplace_back(GZSeekEntry{Item.Offset, Item.Path});
+
+	Info->PathName = Item.Path;
+	TarHeaderToItemInfo(Item.Hdr, Info);
+	if (Info->LinkName) {
+		Info->LinkName.reset(new std::string(Item.Link));
+		if (Item.Hdr.header.typeflag == LNKTYPE)
+			Info->LinkName->insert(0, "/");
+	}
+
+	Info->nFileSize = Item.Size;
+	Info->nPhysicalSize = Item.Size;
+	Info->HostOS = (TarArchiveFormat == POSIX_FORMAT)
+			? "POSIX"
+			: (TarArchiveFormat == V7_FORMAT ? "V7" : nullptr);
+	Info->UnpVer = 256 + 11 + (TarArchiveFormat >= POSIX_FORMAT ? 1 : 0);	//!!!
+
+	return GETARC_SUCCESS;
+}
+
+static bool OpenArchiveTGZ(const char *Name)
+{
+	TGZFd = open(Name, O_RDONLY | O_CLOEXEC);
+	if (TGZFd == -1)
+		return false;
+
+	if (fstat(TGZFd, &TGZStat) == -1) {
+		close(TGZFd);
+		TGZFd = -1;
+		return false;
+	}
+
+	FileSize.i64 = TGZStat.st_size;
+	TGZIndex.reset(new GZSeekIndex);
+	TGZIndexLoaded = TGZIndex->Load(TGZStat);
+	TGZIndex->Entries.clear();	// listing refills them
+	TGZReader.reset(new GZSeekReader(TGZFd, *TGZIndex));
+	TGZNext = 0;
+	TGZComplete = false;
+	return true;
+}
+
+static void CloseArchiveTGZ()
+{
+	// small archives decompressed faster than any index could help
+	if (TGZComplete && !TGZIndexLoaded && !TGZIndex->Points.empty())
+		TGZIndex->Save(TGZStat);
+
+	TGZReader.reset();
+	TGZIndex.reset();
+	close(TGZFd);
+	TGZFd = -1;
+}
+
+////////////////////////////////////////////////////////////
+// ^targz <command> <archive_name> [-@OPTIONAL ARCHIVE ROOT] [--] [OPTIONAL LIST OF FILES]
+// extracts/tests items of tar.gz, if seek index is available - starting decompression
+// from nearest access point preceding each wanted item instead of start of archive
+
+// Resolves "." and ".." components same way as libarch does, leading slashes are dropped.
+// Fails if some ".." leads out of archive root.
+static bool TGZNormalizePath(const std::string &Path, std::string &Out)
+{
+	std::vector<std::string> Components;
+	StrExplode(Components, Path, "/");
+	size_t Depth = 0;
+	for (const auto &C : Components) {
+		if (C == "..") {
+			if (Depth == 0)
+				return false;
+			--Depth;
+		} else if (C != ".")
+			++Depth;
+	}
+
+	PathParts Parts;
+	Parts.Traverse(Path);
+	Out = Parts.Join();
+	return true;
+}
+
+static std::string TGZNormalizePath(const char *Path)
+{
+	std::string out;
+	if (!TGZNormalizePath(Path, out))
+		out.clear();
+	return out;
+}
+
+// Checks that directory where item is going to be created really is within extraction
+// directory, i.e. wasn't reached via symlink leading out of it, and returns its depth there
+static bool TGZDestDepth(const std::string &Dest, const std::string &RealRoot, size_t &Depth)
+{
+	const size_t Slash = Dest.rfind('/');
+	char *RealParent = realpath((Slash == std::string::npos) ? "." : Dest.substr(0, Slash).c_str(), nullptr);
+	if (!RealParent)
+		return false;
+
+	const std::string Parent(RealParent);
+	free(RealParent);
+	if (Parent == RealRoot) {
+		Depth = 0;
+		return true;
+	}
+
+	const size_t Prefix = (RealRoot == "/") ? 0 : RealRoot.size();
+	if (Parent.size() <= Prefix || Parent.compare(0, Prefix, RealRoot, 0, Prefix) != 0 || Parent[Prefix] != '/')
+		return false;
+
+	Depth = std::count(Parent.begin() + Prefix, Parent.end(), '/');
+	return true;
+}
+
+// Symlink must point within extraction directory: no absolute targets, leading ".." only
+// up to extraction directory and none after descending, as descent may go via symlinks
+static bool TGZIsSafeSymlink(const std::string &Target, size_t Depth)
+{
+	if (Target.empty() || Target[0] == '/')
+		return false;
+
+	std::vector<std::string> Components;
+	StrExplode(Components, Target, "/");
+	bool Descended = false;
+	for (const auto &C : Components) {
+		if (C == "..") {
+			if (Descended || Depth == 0)
+				return false;
+			--Depth;
+		} else if (C != ".")
+			Descended = true;
+	}
+	return true;
+}
+
+static bool TGZMatchesWanteds(const std::string &Path, const std::vector<std::string> &Wanteds)
+{
+	if (Wanteds.empty())
+		return true;
+
+	for (const auto &W : Wanteds) {
+		if (W == "*" || (Path.size() >= W.size() && Path.compare(0, W.size(), W) == 0
+				&& (Path.size() == W.size() || Path[W.size()] == '/')))
+			return true;
+	}
+	return false;
+}
+
+static std::string TGZExtractPath(char Cmd, const std::string &Path, const std::string &Root)
+{
+	if (Cmd == 'x') {
+		const size_t Slash = Path.rfind('/');
+		return "./" + ((Slash == std::string::npos) ? Path : Path.substr(Slash + 1));
+	}
+
+	if (!Root.empty() && Path.size() > Root.size() && Path.compare(0, Root.size(), Root) == 0
+			&& Path[Root.size()] == '/') {
+		return "." + Path.substr(Root.size());
+	}
+
+	return "./" + Path;
+}
+
+static void TGZMakeParents(const std::string &Path)
+{
+	for (size_t i = Path.find('/', 2); i != std::string::npos; i = Path.find('/', i + 1)) {
+		mkdir(Path.substr(0, i).c_str(), S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH | S_IXUSR | S_IXGRP | S_IXOTH);
+	}
+}
+
+static bool TGZExtractItem(GZSeekReader &Reader, const TGZItem &Item, char Cmd,
+	const std::string &Root, const std::string &Dest, size_t DestDepth)
+{
+	const mode_t Mode = (mode_t)GetOctal(Item.Hdr.header.mode) & 07777;
+	const struct timespec Times[2] = {
+		{(time_t)GetOctal(Item.Hdr.header.mtime), 0}, {(time_t)GetOctal(Item.Hdr.header.mtime), 0}};
+
+	switch (Item.Hdr.header.typeflag) {
+		case DIRTYPE:
+			if (Cmd == 'x')
+				return true;
+			if (mkdir(Dest.c_str(), Mode | S_IRWXU) == -1 && errno != EEXIST)
+				return false;
+			utimensat(AT_FDCWD, Dest.c_str(), Times, 0);
+			return true;
+
+		case SYMTYPE:
+			if (!TGZIsSafeSymlink(Item.Link, DestDepth)) {
+				fprintf(stderr, "Unsafe symlink target: '%s' -> '%s'\n", Item.Path.c_str(), Item.Link.c_str());
+				errno = EPERM;
+				return false;
+			}
+			unlink(Dest.c_str());
+			return symlink(Item.Link.c_str(), Dest.c_str()) == 0;
+
+		case LNKTYPE: {
+			std::string Target;
+			if (Item.Link.empty() || Item.Link[0] == '/' || !TGZNormalizePath(Item.Link, Target) || Target.empty()) {
+				fprintf(stderr, "Unsafe link target: '%s' -> '%s'\n", Item.Path.c_str(), Item.Link.c_str());
+				errno = EPERM;
+				return false;
+			}
+			unlink(Dest.c_str());
+			return link(TGZExtractPath(Cmd, Target, Root).c_str(), Dest.c_str()) == 0;
+		}
+
+		case REGTYPE:
+		case AREGTYPE:
+		case CONTTYPE: {
+			FDScope fd(open(Dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, Mode | S_IWUSR));
+			if (!fd.Valid())
+				return false;
+
+			char Buf[0x10000];
+			for (uint64_t Left = Item.Size; Left;) {
+				const size_t Piece = (size_t)std::min(Left, (uint64_t)sizeof(Buf));
+				if (Reader.Read(Buf, Piece) != Piece || WriteAll(fd, Buf, Piece) != Piece)
+					return false;
+				Left-= Piece;
+			}
+			futimens(fd, Times);
+			return true;
+		}
+
+		default:
+			fprintf(stderr, "Unsupported type '%c': '%s'\n", Item.Hdr.header.typeflag, Item.Path.c_str());
+			return true;
+	}
+}
+
+extern "C" int targz_main(int numargs, char *args[])
+{
+	if (numargs < 3) {
+		printf("Usage: ^targz <command> <archive_name> [-@OPTIONAL ARCHIVE ROOT] [--] [OPTIONAL LIST OF FILES]\n\n"
+			"<Commands>\n"
+			"  t: Test integrity of archive\n"
+			"  x: Extract files from archive (without using directory names)\n"
+			"  X: eXtract files with full paths\n");
+		return 1;
+	}
+
+	const char Cmd = *args[1];
+	if (Cmd != 't' && Cmd != 'x' && Cmd != 'X') {
+		fprintf(stderr, "Bad command: %s\n", args[1]);
+		return -1;
+	}
+
+	int files_cnt = numargs - 3;
+	char **files = &args[3];
+	std::string Root;
+	while (files_cnt > 0 && files[0][0] == '-') {
+		if (files[0][1] == '@') {
+			Root = TGZNormalizePath(files[0] + 2);
+
+		} else {
+			if (files[0][1] == '-') {
+				++files;
+				--files_cnt;
+			} else
+				fprintf(stderr, "Unknown option: %s - treating as file\n", files[0]);
+
+			break;
+		}
+		++files;
+		--files_cnt;
+	}
+
+	std::vector<std::string> Wanteds;
+	for (int i = 0; i < files_cnt; ++i) {
+		std::string W = TGZNormalizePath(files[i]);
+		if (!Root.empty() && W != "*" && (W.size() <= Root.size() || W.compare(0, Root.size(), Root) != 0
+				|| W[Root.size()] != '/')) {
+			fprintf(stderr, "Fixup root for path: '%s'\n", files[i]);
+			W.insert(0, Root + "/");
+		}
+		if (W.empty()) {
+			fprintf(stderr, "Skipping empty path: '%s'\n", files[i]);
+		} else {
+			Wanteds.emplace_back(std::move(W));
+		}
+	}
+
+	if (Wanteds.empty() && files_cnt > 0)
+		return 1;
+
+	FDScope fd(open(args[2], O_RDONLY | O_CLOEXEC));
+	struct stat ArcStat{};
+	if (!fd.Valid() || fstat(fd, &ArcStat) == -1) {
+		fprintf(stderr, "Error %u opening '%s'\n", errno, args[2]);
+		return -1;
+	}
+
+	std::string RealRoot;
+	if (Cmd != 't') {
+		char *cwd = realpath(".", nullptr);
+		if (!cwd) {
+			fprintf(stderr, "Error %u resolving extraction directory\n", errno);
+			return -1;
+		}
+		RealRoot = cwd;
+		free(cwd);
+	}
+
+	GZSeekIndex Index;
+	const bool IndexLoaded = Index.Load(ArcStat);
+	GZSeekReader Reader(fd, Index);
+	bool out = true;
+
+	auto ProcessItem = [&](const TGZItem &Item) {
+		if (Cmd == 't') {
+			if (!Reader.Skip(Item.Size)) {
+				fprintf(stderr, "Error: '%s'\n", Item.Path.c_str());
+				out = false;
+			} else
+				fprintf(stderr, "Tested: '%s'\n", Item.Path.c_str());
+			return;
+		}
+
+		std::string Path;
+		if (!TGZNormalizePath(Item.Path, Path) || Path.empty()) {
+			fprintf(stderr, "Unsafe path: '%s'\n", Item.Path.c_str());
+			out = false;
+			return;
+		}
+
+		const std::string &Dest = TGZExtractPath(Cmd, Path, Root);
+		TGZMakeParents(Dest);
+		size_t DestDepth;
+		if (!TGZDestDepth(Dest, RealRoot, DestDepth)) {
+			fprintf(stderr, "Unsafe destination: '%s' -> '%s'\n", Item.Path.c_str(), Dest.c_str());
+			out = false;
+			return;
+		}
+		if (!TGZExtractItem(Reader, Item, Cmd, Root, Dest, DestDepth)) {
+			fprintf(stderr, "Error %u: '%s' -> '%s'\n", errno, Item.Path.c_str(), Dest.c_str());
+			out = false;
+		} else
+			fprintf(stderr, "Extracted: '%s' -> '%s'\n", Item.Path.c_str(), Dest.c_str());
+	};
+
+	TGZItem Item;
+	if (IndexLoaded && !Wanteds.empty()) {
+		for (const auto &Entry : Index.Entries) {
+			if (!TGZMatchesWanteds(TGZNormalizePath(Entry.Path.c_str()), Wanteds))
+				continue;
+
+			if (!Reader.SeekTo(Entry.Offset) || ReadTGZItem(Reader, Item) != GETARC_SUCCESS) {
+				fprintf(stderr, "Error reading '%s' at %llu\n",
+					Entry.Path.c_str(), (unsigned long long)Entry.Offset);
+				out = false;
+				break;
+			}
+			ProcessItem(Item);
+		}
+
+	} else { // whole archive walk, so also (re)build index for next time
+		Index.Entries.clear();
+		for (uint64_t Next = 0;;) {
+			int r = Reader.SeekTo(Next) ? ReadTGZItem(Reader, Item) : GETARC_UNEXPEOF;
+			if (r == GETARC_EOF) {
+				if (!IndexLoaded && !Index.Points.empty())
+					Index.Save(ArcStat);
+				break;
+			}
+			if (r != GETARC_SUCCESS) {
+				fprintf(stderr, "Error %d reading archive at %llu\n", r, (unsigned long long)Next);
+				out = false;
+				break;
+			}
+			Next = Reader.Tell() + ((Item.Size + 511) & ~uint64_t(511));
+			Index.Entries.emplace_back(GZSeekEntry{Item.Offset, Item.Path});
+			if (TGZMatchesWanteds(TGZNormalizePath(Item.Path.c_str()), Wanteds))
+				ProcessItem(Item);
+		}
+	}
+
+	return out ? 0 : 1;
+}
+
+#endif
+
 BOOL WINAPI _export TARGZ_CloseArchive(struct ArcInfo *Info)
 {
+#ifdef HAVE_ZLIB
+	if (ArcType == TGZ_FORMAT) {
+		CloseArchiveTGZ();
+		return TRUE;
+	}
+#endif
 	return (WINPORT(CloseHandle)(ArcHandle));
 }
 
 BOOL WINAPI _export TARGZ_GetFormatName(int Type, std::string &FormatName, std::string &DefaultExt)
 {
-	static const char *const FmtAndExt[5][2] = {
+	static const char *const FmtAndExt[6][2] = {
 			{"TAR",     "tar"},
 			{"GZip",    "gz" },
 			{"Z(Unix)", "z"  },
 			{"BZip",    "bz2"},
 			{"XZip",    "xz" },
+			{"TarGZip", "tgz"},
 	};
 	switch (Type) {
 		case TAR_FORMAT:
@@ -486,6 +1028,9 @@ BOOL WINAPI _export TARGZ_GetFormatName(int Type, std::string &FormatName, std::
 		case Z_FORMAT:
 		case BZ_FORMAT:
 		case XZ_FORMAT:
+#ifdef HAVE_ZLIB
+		case TGZ_FORMAT:
+#endif
 			FormatName = FmtAndExt[Type][0];
 			DefaultExt = FmtAndExt[Type][1];
 			return (TRUE);
@@ -495,7 +1040,7 @@ BOOL WINAPI _export TARGZ_GetFormatName(int Type, std::string &FormatName, std::
 
 BOOL WINAPI _export TARGZ_GetDefaultCommands(int Type, int Command, std::string &Dest)
 {
-	static const char *Commands[5][15] = {
+	static const char *Commands[6][15] = {
 			{	// TAR_FORMAT
 #if defined(__TAR_LIMITED_ARGS__)
 					"tar -xf %%A %%FSq32768", "tar -O -xf %%A %%fSq > %%fWq", "",
@@ -526,8 +1071,11 @@ BOOL WINAPI _export TARGZ_GetDefaultCommands(int Type, int Command, std::string
 			{	// BZ_FORMAT
 					"xz -cd %%A >%%fq", "xz -cd %%A >%%fq", "xz -cd %%A >/dev/null", "", "", "", "", "", "",
 					"", "xz -c %%fq >%%A", "xz %%fq", "xz -c %%fq >%%A", "xz %%fq", "*"},
+			{	// TGZ_FORMAT
+					"^targz X %%A -@%%R -- %%FMq4096", "^targz x %%A -- %%FMq4096", "^targz t %%A", "", "", "",
+					"", "", "", "", "", "", "", "", "*"},
 	};
-	if (Type >= TAR_FORMAT && Type <= XZ_FORMAT && Command < (int)(ARRAYSIZE(Commands[Type]))) {
+	if (Type >= TAR_FORMAT && Type <= TGZ_FORMAT && Command < (int)(ARRAYSIZE(Commands[Type]))) {
 		Dest = Commands[Type][Command];
 		return (TRUE);
 	}
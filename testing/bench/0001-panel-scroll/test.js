@@ -0,0 +1,56 @@
+// Keystroke-to-paint latency of scrolling panel with 100000 files.
+// Results are logged as BENCH JSON lines, nothing is asserted except liveness.
+mydir=WorkDir()
+profile=mydir + "/profile"
+many=mydir + "/many"
+empty=mydir + "/empty"
+MkdirsAll([profile, many, empty], 0700)
+
+files_count = 100000
+files = []
+for (i = 0; i < files_count; ++i) {
+	files.push(many + "/file" + i + ".e" + (i % 13))
+}
+Mkfiles(files, 0666, 0, 0)
+
+function report(name, samples) {
+	dispatch = [], update = [], paint = []
+	for (i = 0; i < samples.length; ++i) {
+		dispatch.push(samples[i].Dispatch)
+		update.push(samples[i].Update)
+		paint.push(samples[i].Paint)
+	}
+	BenchReport(name, "dispatch_ms", dispatch)
+	BenchReport(name, "update_ms", update)
+	BenchReport(name, "paint_ms", paint)
+}
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", many, "-cd", empty]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+ExpectString("file0.e0", 0, 0, -1, -1, 30000);
+Sync(30000)
+
+samples = []
+for (n = 0; n < 300; ++n) {
+	samples.push(MeasureVK(0x28, 10000)) // VK_DOWN
+}
+report("panel-scroll-down", samples)
+
+samples = []
+for (n = 0; n < 200; ++n) {
+	samples.push(MeasureVK(0x22, 10000)) // VK_NEXT
+}
+report("panel-scroll-pagedown", samples)
+
+samples = []
+for (n = 0; n < 50; ++n) {
+	samples.push(MeasureVK((n % 2) ? 0x24 : 0x23, 10000)) // VK_HOME / VK_END
+}
+report("panel-scroll-home-end", samples)
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?", 0, 0, -1, -1, 10000)
+TypeEnter()
+ExpectAppExit(0, 10000)
+0;
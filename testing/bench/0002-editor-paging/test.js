@@ -0,0 +1,60 @@
+// Keystroke-to-paint latency of paging through big file in editor.
+mydir=WorkDir()
+profile=mydir + "/profile"
+left=mydir + "/left"
+right=mydir + "/right"
+MkdirsAll([profile, left, right], 0700)
+
+lines = []
+for (i = 0; i < 200000; ++i) {
+	lines.push("line " + i + "\tthe quick brown fox jumps over the lazy dog " + (i * 7919 % 100003))
+}
+SaveTextFile(left + "/big.txt", lines)
+
+function report(name, samples) {
+	dispatch = [], update = [], paint = []
+	for (i = 0; i < samples.length; ++i) {
+		dispatch.push(samples[i].Dispatch)
+		update.push(samples[i].Update)
+		paint.push(samples[i].Paint)
+	}
+	BenchReport(name, "dispatch_ms", dispatch)
+	BenchReport(name, "update_ms", update)
+	BenchReport(name, "paint_ms", paint)
+}
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", left, "-cd", right]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+TypeDown()
+TypeFKey(4)
+ExpectString("left/big.txt", 0, 0, -1, -1, 30000)
+Sync(30000)
+
+samples = []
+for (n = 0; n < 300; ++n) {
+	samples.push(MeasureVK(0x22, 10000)) // VK_NEXT
+}
+report("editor-pagedown", samples)
+
+samples = []
+for (n = 0; n < 300; ++n) {
+	samples.push(MeasureVK(0x26, 10000)) // VK_UP
+}
+report("editor-line-up", samples)
+
+ToggleLCtrl(true)
+samples = []
+for (n = 0; n < 20; ++n) {
+	samples.push(MeasureVK((n % 2) ? 0x24 : 0x23, 10000)) // Ctrl+Home / Ctrl+End
+}
+ToggleLCtrl(false)
+report("editor-begin-end", samples)
+
+TypeEscape()
+ExpectNoString("left/big.txt", 0, 0, -1, -1, 10000)
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?", 0, 0, -1, -1, 10000)
+TypeEnter()
+ExpectAppExit(0, 10000)
+0;
@@ -0,0 +1,51 @@
+// Keystroke-to-paint latency of repeating search in viewer on big file.
+mydir=WorkDir()
+profile=mydir + "/profile"
+left=mydir + "/left"
+right=mydir + "/right"
+MkdirsAll([profile, left, right], 0700)
+
+lines = []
+for (i = 0; i < 200000; ++i) {
+	if (i % 2000 == 1999) {
+		lines.push("line " + i + " here is the needle")
+	} else {
+		lines.push("line " + i + "\tthe quick brown fox jumps over the lazy dog " + (i * 7919 % 100003))
+	}
+}
+SaveTextFile(left + "/big.txt", lines)
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", left, "-cd", right]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+TypeDown()
+TypeFKey(3)
+ExpectString("left/big.txt", 0, 0, -1, -1, 30000)
+Sync(30000)
+
+TypeFKey(7)
+ExpectString("═══ Search ═══", 0, 0, -1, -1, 10000)
+TypeText("needle")
+TypeEnter()
+ExpectString("line 1999 here is the needle", 0, 0, -1, -1, 10000)
+
+// Shift+F7 - search next
+ToggleShift(true)
+update = [], paint = []
+for (n = 0; n < 90; ++n) {
+	lat = MeasureVK(0x76, 10000) // VK_F7
+	update.push(lat.Update)
+	paint.push(lat.Paint)
+}
+ToggleShift(false)
+ExpectString("line 181999 here is the needle", 0, 0, -1, -1, 10000)
+BenchReport("viewer-search-next", "update_ms", update)
+BenchReport("viewer-search-next", "paint_ms", paint)
+
+TypeEscape()
+ExpectNoString("left/big.txt", 0, 0, -1, -1, 10000)
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?", 0, 0, -1, -1, 10000)
+TypeEnter()
+ExpectAppExit(0, 10000)
+0;
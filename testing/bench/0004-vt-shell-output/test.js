@@ -0,0 +1,32 @@
+// Time to get bulk command output through VT shell onto screen
+// and amount of terminal output it produces.
+mydir=WorkDir()
+profile=mydir + "/profile"
+left=mydir + "/left"
+right=mydir + "/right"
+MkdirsAll([profile, left, right], 0700)
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", left, "-cd", right]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+Sync(10000)
+
+elapsed = [], kbytes = [], writes = []
+for (n = 0; n < 10; ++n) {
+	before = BenchStats()
+	TypeText("seq 1 100000; echo OUTPUT_$((1000+" + n + "))")
+	TypeEnter()
+	ExpectString("OUTPUT_" + (1000 + n), 0, 0, -1, -1, 60000)
+	after = BenchStats()
+	elapsed.push((after.Now - before.Now) / 1000000)
+	kbytes.push((after.BackendBytes - before.BackendBytes) / 1024)
+	writes.push(after.ConsoleWrites - before.ConsoleWrites)
+}
+BenchReport("vt-shell-seq-100000", "elapsed_ms", elapsed)
+BenchReport("vt-shell-seq-100000", "backend_kbytes", kbytes)
+BenchReport("vt-shell-seq-100000", "console_writes", writes)
+
+TypeText("exit far")
+TypeEnter()
+ExpectAppExit(0, 10000)
+0;
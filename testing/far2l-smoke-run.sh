@@ -7,6 +7,7 @@ APP="$1"
 if [ "$APP" = "" ]; then
 	echo 'Please specify path to far2l binary as argument'
 	echo 'Note that far2l must be built with -DTESTING=Yes'
+	echo 'Set SUITE=bench to run latency benchmarks instead of tests'
 	exit 1
 fi
 if [ ! -f ./far2l-smoke ] || [ ./far2l-smoke -ot ./far2l-smoke.go ]; then
@@ -19,8 +20,10 @@ if [ ! -f ./far2l-smoke ] || [ ./far2l-smoke -ot ./far2l-smoke.go ]; then
 	echo PREPARE: done
 fi
 
+SUITE="${SUITE:-tests}"
+
 echo 'Cleaning up...'
-for test in tests/*; do
+for test in "$SUITE"/*; do
 	rm -rf "$test"/workdir
 done
 
@@ -28,12 +31,12 @@ if [ "$2" == "clean" ]; then
 	exit 0
 fi
 
-echo 'Starting tests:' tests/"$2"*
-for test in tests/*; do
+echo 'Starting tests:' "$SUITE"/"$2"*
+for test in "$SUITE"/*; do
 	mkdir -p "$test"/workdir
 	if [ -e "$test"/initdir ]; then
 		cp -r -f "$test"/initdir/* "$test"/workdir/
 	fi
 done
 
-./far2l-smoke "$APP" tests/"$2"*
+./far2l-smoke "$APP" "$SUITE"/"$2"*
@@ -13,7 +13,10 @@ import (
 	"io"
 	"io/ioutil"
 	"io/fs"
+	"math"
 	"math/rand"
+	"sort"
+	"encoding/json"
 	"hash"
 	"crypto/sha256"
 	"encoding/binary"
@@ -65,6 +68,36 @@ type far2l_Cell struct {
 	Strikeout bool
 }
 
+type far2l_BenchStats struct {
+	Now uint64
+	KeyInjected uint64
+	InputDequeued uint64
+	OutputUpdated uint64
+	BackendOutput uint64
+	BackendBytes uint64
+	BackendWrites uint64
+	ConsoleWrites uint64
+	ConsoleNotifications uint64
+}
+
+type far2l_KeyLatency struct {
+	Dispatch float64
+	Update float64
+	Paint float64
+	Bytes uint64
+	Writes uint64
+}
+
+type aux_Percentiles struct {
+	Count int
+	Min float64
+	Mean float64
+	P50 float64
+	P90 float64
+	P99 float64
+	Max float64
+}
+
 var g_far2l_sock string
 var g_far2l_bin string
 var g_socket *net.UnixConn
@@ -211,6 +244,109 @@ func far2l_ReqRecvSync(tmout uint32) bool {
 }
 
 
+func far2l_ReqRecvBenchStats() far2l_BenchStats {
+	binary.LittleEndian.PutUint32(g_buf[0:], 7) // TEST_CMD_BENCH_STATS
+	n, err := g_socket.WriteTo(g_buf[0:4], g_addr)
+	if err != nil || n != 4 {
+		aux_Panic(err.Error())
+	}
+	far2l_ReadSocket(72, 0)
+	return far2l_BenchStats {
+		Now:                  binary.LittleEndian.Uint64(g_buf[0:]),
+		KeyInjected:          binary.LittleEndian.Uint64(g_buf[8:]),
+		InputDequeued:        binary.LittleEndian.Uint64(g_buf[16:]),
+		OutputUpdated:        binary.LittleEndian.Uint64(g_buf[24:]),
+		BackendOutput:        binary.LittleEndian.Uint64(g_buf[32:]),
+		BackendBytes:         binary.LittleEndian.Uint64(g_buf[40:]),
+		BackendWrites:        binary.LittleEndian.Uint64(g_buf[48:]),
+		ConsoleWrites:        binary.LittleEndian.Uint64(g_buf[56:]),
+		ConsoleNotifications: binary.LittleEndian.Uint64(g_buf[64:]),
+	}
+}
+
+func msecBetween(from uint64, to uint64) float64 {
+	if to < from {
+		return -1
+	}
+	return float64(to - from) / 1000000.0
+}
+
+// Sends key press and release and waits until its processed, then - until backend
+// delivered resulting output to terminal. Latencies are in msec since key press
+// was injected, -1 means key caused no such activity.
+func far2l_MeasureVK(key_code uint32, tmout uint32) far2l_KeyLatency {
+	before := far2l_ReqRecvBenchStats()
+	far2l_TypeVK(key_code)
+	far2l_ReqRecvSync(tmout)
+	deadline := time.Now().Add(time.Duration(tmout) * time.Millisecond)
+	after := far2l_ReqRecvBenchStats()
+	for after.OutputUpdated > after.KeyInjected && after.BackendOutput < after.OutputUpdated && time.Now().Before(deadline) {
+		time.Sleep(time.Millisecond)
+		after = far2l_ReqRecvBenchStats()
+	}
+	out := far2l_KeyLatency {
+		Dispatch: msecBetween(after.KeyInjected, after.InputDequeued),
+		Update:   msecBetween(after.KeyInjected, after.OutputUpdated),
+		Paint:    msecBetween(after.KeyInjected, after.BackendOutput),
+		Bytes:    after.BackendBytes - before.BackendBytes,
+		Writes:   after.ConsoleWrites - before.ConsoleWrites,
+	}
+	if out.Update < 0 {
+		out.Paint = -1
+	}
+	return out
+}
+
+func aux_CalcPercentiles(samples []float64) aux_Percentiles {
+	sorted := []float64{}
+	sum := 0.0
+	for _, v := range samples {
+		if v >= 0 {
+			sorted = append(sorted, v)
+			sum+= v
+		}
+	}
+	out := aux_Percentiles{Count: len(sorted)}
+	if len(sorted) == 0 {
+		return out
+	}
+	sort.Float64s(sorted)
+	at := func(p float64) float64 {
+		i := int(math.Ceil(p * float64(len(sorted)))) - 1
+		if i < 0 { i = 0 }
+		return sorted[i]
+	}
+	out.Min = sorted[0]
+	out.Max = sorted[len(sorted) - 1]
+	out.Mean = sum / float64(len(sorted))
+	out.P50 = at(0.50)
+	out.P90 = at(0.90)
+	out.P99 = at(0.99)
+	return out
+}
+
+// Logs percentiles of samples as single JSON line prefixed by BENCH and also
+// appends that JSON line to file specified by FAR2L_BENCH_OUT environment variable.
+func aux_BenchReport(name string, metric string, samples []float64) aux_Percentiles {
+	pcs := aux_CalcPercentiles(samples)
+	data, err := json.Marshal(map[string]interface{} {
+		"name": name, "metric": metric, "count": pcs.Count,
+		"min": pcs.Min, "mean": pcs.Mean, "p50": pcs.P50, "p90": pcs.P90, "p99": pcs.P99, "max": pcs.Max,
+	})
+	if err != nil {
+		aux_Panic(err.Error())
+	}
+	log.Print("BENCH " + string(data))
+	if out_path := os.Getenv("FAR2L_BENCH_OUT"); out_path != "" {
+		f, err := os.OpenFile(out_path, os.O_APPEND | os.O_CREATE | os.O_WRONLY, 0644)
+		if assertNoError(err) {
+			f.Write(append(data, '\n'))
+			f.Close()
+		}
+	}
+	return pcs
+}
+
 func far2l_ReqRecvExpectString(str string, x uint32, y uint32, w uint32, h uint32, tmout uint32) far2l_FoundString {
 	return far2l_ReqRecvExpectXStrings([]string{str}, x, y, w, h, tmout, true)
 }
@@ -869,6 +1005,8 @@ func initVM() {
 
 	setVMFunction("AppStatus", far2l_ReqRecvStatus)
 	setVMFunction("Sync", far2l_ReqRecvSync)
+	setVMFunction("BenchStats", far2l_ReqRecvBenchStats)
+	setVMFunction("MeasureVK", far2l_MeasureVK)
 
 	setVMFunction("ReadCellRaw", far2l_ReqRecvReadCellRaw)
 	setVMFunction("ReadCell", far2l_ReqRecvReadCell)
@@ -921,6 +1059,8 @@ func initVM() {
 	setVMFunction("TTYCtrlC", tty_CtrlC)
 
 	setVMFunction("Log", aux_Log)
+	setVMFunction("Percentiles", aux_CalcPercentiles)
+	setVMFunction("BenchReport", aux_BenchReport)
 	setVMFunction("Panic", aux_Panic)
 
 	setVMFunction("RunCmd", aux_RunCmd)
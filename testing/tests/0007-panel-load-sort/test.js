@@ -0,0 +1,51 @@
+// Measures time of loading and re-sorting panel with many files.
+// Timings are only logged - to compare builds, not to fail on.
+mydir=WorkDir()
+profile=mydir + "/profile"
+many=mydir + "/many"
+empty=mydir + "/empty"
+MkdirsAll([profile, many, empty], 0700)
+
+files_count = 20000
+files = []
+for (i = 0; i < files_count; ++i) {
+	files.push(many + "/file" + i + ".e" + (i % 13))
+}
+Mkfiles(files, 0666, 0, 4096)
+
+t = Date.now()
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", many, "-cd", empty]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+ExpectString("file0.e0", 0, 0, -1, -1, 10000);
+Log("Panel load of " + files_count + " files: " + (Date.now() - t) + " ms")
+
+// Ctrl+F4 - by extension, Ctrl+F5 - by modification time, Ctrl+F6 - by size, Ctrl+F3 - by name
+sort_keys = [4, 5, 6, 3]
+sort_names = ["extension", "time", "size", "name"]
+for (i = 0; i < sort_keys.length; ++i) {
+	t = Date.now()
+	ToggleLCtrl(true)
+	TypeFKey(sort_keys[i])
+	ToggleLCtrl(false)
+	if (!Sync(10000)) {
+		Panic("Sort by " + sort_names[i] + " timed out")
+	}
+	Log("Sort by " + sort_names[i] + ": " + (Date.now() - t) + " ms")
+}
+
+// Ctrl+R - reread
+t = Date.now()
+ToggleLCtrl(true)
+TypeText("r")
+ToggleLCtrl(false)
+if (!Sync(10000)) {
+	Panic("Reread timed out")
+}
+Log("Panel reread: " + (Date.now() - t) + " ms")
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?", 0, 0, -1, -1, 10000)
+TypeEnter()
+ExpectAppExit(0, 10000)
+0;
@@ -0,0 +1,47 @@
+// Checks that panel view mode columns survive load and save of settings:
+// G is git status column while G with size modifiers is legacy alias of P.
+mydir=WorkDir()
+profile=mydir + "/profile"
+settings=profile + "/.config/settings"
+MkdirsAll([settings], 0700)
+
+SaveTextFile(settings + "/panel.ini", [
+	"[Panel/ViewModes/Mode9]",
+	"Columns=N,G,GC",
+	"ColumnWidths=0,1,10",
+	"StatusColumns=NR",
+	"StatusColumnWidths=0"
+])
+
+StartApp(["--tty", "--nodetect", "--mortal", "-u", profile]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+
+// Shift+F9 - save setup
+ToggleShift(true)
+TypeFKey(9)
+ToggleShift(false)
+ExpectString("Do you wish to save", 0, 0, -1, -1, 10000)
+TypeEnter()
+Sync(10000)
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?", 0, 0, -1, -1, 10000)
+TypeEnter()
+ExpectAppExit(0, 10000)
+
+columns = ""
+section = ""
+lines = LoadTextFile(settings + "/panel.ini")
+for (i = 0; i < lines.length; ++i) {
+	if (lines[i].startsWith("[")) {
+		section = lines[i]
+	} else if (section == "[Panel/ViewModes/Mode9]" && lines[i].startsWith("Columns=")) {
+		columns = lines[i]
+	}
+}
+
+if (columns != "Columns=N,G,PC") {
+	Panic("Unexpected saved view mode columns: '" + columns + "'")
+}
+0;
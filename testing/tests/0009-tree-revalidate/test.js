@@ -0,0 +1,65 @@
+// Checks that tree panel revalidation of changed directory doesn't duplicate
+// its nested subdirectories and keeps count of other tree items unchanged.
+mydir=WorkDir()
+profile=mydir + "/profile"
+root=mydir + "/root"
+nested=["level1", "level1/level2", "level1/level2/level3", "level1/level2/level3/level4"]
+dirs=[profile]
+for (i = 0; i < nested.length; ++i) {
+	dirs.push(root + "/" + nested[i])
+}
+MkdirsAll(dirs, 0700)
+
+status = StartApp(["--tty", "--nodetect", "--mortal", "-u", profile, "-cd", root, "-cd", root]);
+ExpectString("Help - FAR2L", 0, 0, -1, -1, 10000);
+TypeEscape()
+
+ToggleLCtrl(true)
+TypeText("t")
+ToggleLCtrl(false)
+ExpectString("level4", 0, 0, Math.floor(status.Width / 2), status.Height, 10000)
+
+function TreeLines() {
+	Sync(10000)
+	out = []
+	lines = BoundedLines(1, 1, Math.floor(status.Width / 2) - 2, status.Height - 3, " \t│║")
+	for (j = 0; j < lines.length; ++j) {
+		if (lines[j].indexOf("level") >= 0 || lines[j].indexOf("added") >= 0) {
+			out.push(lines[j])
+		}
+	}
+	return out
+}
+
+function CheckNoDuplicates(lines) {
+	for (k = 1; k <= 4; ++k) {
+		count = 0
+		for (j = 0; j < lines.length; ++j) {
+			if (lines[j].indexOf("level" + k) >= 0) {
+				++count
+			}
+		}
+		if (count != 1) {
+			Panic("level" + k + " shown " + count + " times in tree: " + lines.join(" | "))
+		}
+	}
+}
+
+before = TreeLines()
+CheckNoDuplicates(before)
+
+// changes stamp of level1, so its children get revalidated
+Mkdir(root + "/level1/added", 0700)
+ExpectString("added", 0, 0, Math.floor(status.Width / 2), status.Height, 10000)
+
+after = TreeLines()
+CheckNoDuplicates(after)
+if (after.length != before.length + 1) {
+	Panic("Tree had " + before.length + " items, has " + after.length + " after adding one directory")
+}
+
+TypeFKey(10)
+ExpectString("Do you want to quit FAR?", 0, 0, -1, -1, 10000)
+TypeEnter()
+ExpectAppExit(0, 10000)
+0;
@@ -6,6 +6,9 @@ Temporary panel plugin class implementation
 */
 
 #include "TmpPanel.hpp"
+#include <utils.h>
+
+#define TMP_BACKGROUND_REFRESH_ITEMS 2000
 
 TmpPanel::TmpPanel(const wchar_t* pHostFile)
 {
@@ -137,11 +140,6 @@ HANDLE TmpPanel::BeginPutFiles()
 	return hScreen;
 }
 
-static inline int cmp_names(const WIN32_FIND_DATA &wfd, const FAR_FIND_DATA &ffd)
-{
-	return wcscmp(wfd.cFileName, FSF.PointToName(ffd.lpwszFileName));
-}
-
 int TmpPanel::PutDirectoryContents(const wchar_t *Path)
 {
 	if (Opt.SelectedCopyContents == 2) {
@@ -361,78 +359,58 @@ void TmpPanel::UpdateItems(int ShowOwners, int ShowGroups, int ShowLinks)
 		UpdateNotNeeded = FALSE;
 		return;
 	}
-	HANDLE hScreen = Info.SaveScreen(0, 0, -1, -1);
-	const wchar_t *MsgItems[] = {GetMsg(MTempPanel), GetMsg(MTempUpdate)};
-	Info.Message(Info.ModuleNumber, 0, NULL, MsgItems, ARRAYSIZE(MsgItems), 0);
 	LastOwnersRead = ShowOwners;
 	LastGroupsRead = ShowGroups;
 	LastLinksRead = ShowLinks;
-	struct PluginPanelItem *CurItem = TmpPanelItem;
 
+	// Абсолютные пути обновляются пачкой через Refresher (свежие берутся из его
+	// кэша), остальные - как раньше, по одному через GetFileInfoAndValidate
+	std::vector<int> StatItems, OtherItems;
+	std::vector<std::string> StatPaths;
+	std::string Path;
+	TmpStatInfo StatInfo;
+
+	Refresher.PurgeCache();
+	struct PluginPanelItem *CurItem = TmpPanelItem;
 	for (int i = 0; i < TmpItemsNumber; i++, CurItem++) {
-		HANDLE FindHandle;
-		const wchar_t *lpFullName = CurItem->FindData.lpwszFileName;
-
-		const wchar_t *lpSlash = wcsrchr(lpFullName, GOOD_SLASH);
-		int Length = lpSlash ? (int)(lpSlash - lpFullName + 1) : 0;
-
-		int SameFolderItems = 1;
-		/* $ 23.12.2001 DJ
-		   если FullName - это каталог, то FindFirstFile (FullName+"*.*")
-		   этот каталог не найдет. Поэтому для каталогов оптимизацию с
-		   SameFolderItems пропускаем.
-		*/
-		if (Length > 0 && Length > (int)wcslen(lpFullName))	/* DJ $ */
-		{
-			for (int j = 1; i + j < TmpItemsNumber; j++) {
-				if (memcmp(lpFullName, CurItem[j].FindData.lpwszFileName, Length * sizeof(wchar_t)) == 0
-						&& wcschr((const wchar_t *)CurItem[j].FindData.lpwszFileName + Length, GOOD_SLASH)
-								== NULL) {
-					SameFolderItems++;
-				} else {
-					break;
-				}
-			}
+		if (!TmpStatRefresher::IsSuitablePath(CurItem->FindData.lpwszFileName)) {
+			OtherItems.push_back(i);
+			continue;
 		}
+		Wide2MB(CurItem->FindData.lpwszFileName, Path);
+		if (Refresher.LookupCache(Path, StatInfo))
+			ApplyStatInfo(*CurItem, StatInfo);
+		else if (!Refresher.IsBackgroundBusy()) {
+			StatItems.push_back(i);
+			StatPaths.emplace_back(Path);
+		}
+	}
 
-		// SameFolderItems - оптимизация для случая, когда в панели лежат
-		// несколько файлов из одного и того же каталога. При этом
-		// FindFirstFile() делается один раз на каталог, а не отдельно для
-		// каждого файла.
-		if (SameFolderItems > 2) {
-			WIN32_FIND_DATA FindData;
-
-			StrBuf FindFile((int)(lpSlash - lpFullName) + 1 + 1 + 1);
-			wcsncpy(FindFile, lpFullName, (int)(lpSlash - lpFullName) + 1);
-			wcscpy(FindFile + (lpSlash + 1 - lpFullName), L"*");
-
-			for (int J = 0; J < SameFolderItems; J++)
-				CurItem[J].Flags|= REMOVE_FLAG;
-
-			int Done = (FindHandle = FindFirstFile(FindFile, &FindData)) == INVALID_HANDLE_VALUE;
-			while (!Done) {
-				for (int J = 0; J < SameFolderItems; J++) {
-					if ((CurItem[J].Flags & 1) && cmp_names(FindData, CurItem[J].FindData) == 0) {
-						CurItem[J].Flags&= ~REMOVE_FLAG;
+	// Большой список обновляется в фоне: панель сразу показывает то, что есть,
+	// а результаты подхватываются по мере готовности на FE_IDLE
+	if (StatPaths.size() >= TMP_BACKGROUND_REFRESH_ITEMS) {
+		Refresher.StartBackground(std::move(StatPaths));
+		StatItems.clear();
+	}
 
-						const wchar_t *save = CurItem[J].FindData.lpwszFileName;
-						WFD2FFD(FindData, CurItem[J].FindData);
+	HANDLE hScreen = NULL;
+	if (!StatItems.empty() || !OtherItems.empty() || ShowOwners || ShowGroups || ShowLinks) {
+		hScreen = Info.SaveScreen(0, 0, -1, -1);
+		const wchar_t *MsgItems[] = {GetMsg(MTempPanel), GetMsg(MTempUpdate)};
+		Info.Message(Info.ModuleNumber, 0, NULL, MsgItems, ARRAYSIZE(MsgItems), 0);
+	}
 
-						free((wchar_t *)CurItem[J].FindData.lpwszFileName);
-						CurItem[J].FindData.lpwszFileName = save;
-						break;
-					}
-				}
+	if (!StatItems.empty()) {
+		std::vector<TmpStatInfo> StatInfos;
+		Refresher.StatNow(StatPaths, StatInfos);
+		for (size_t i = 0; i < StatItems.size(); i++)
+			ApplyStatInfo(TmpPanelItem[StatItems[i]], StatInfos[i]);
+	}
 
-				Done = !FindNextFile(FindHandle, &FindData);
-			}
-			FindClose(FindHandle);
-			i+= SameFolderItems - 1;
-			CurItem+= SameFolderItems - 1;
-		} else {
-			if (!GetFileInfoAndValidate(lpFullName, &CurItem->FindData, Opt.AnyInPanel))
-				CurItem->Flags|= REMOVE_FLAG;
-		}
+	for (int i : OtherItems) {
+		CurItem = &TmpPanelItem[i];
+		if (!GetFileInfoAndValidate(CurItem->FindData.lpwszFileName, &CurItem->FindData, Opt.AnyInPanel))
+			CurItem->Flags|= REMOVE_FLAG;
 	}
 
 	RemoveEmptyItems();
@@ -462,11 +440,54 @@ void TmpPanel::UpdateItems(int ShowOwners, int ShowGroups, int ShowLinks)
 				CurItem->NumberOfLinks = FSF.GetNumberOfLinks(CurItem->FindData.lpwszFileName);
 		}
 	}
-	Info.RestoreScreen(hScreen);
+	if (hScreen)
+		Info.RestoreScreen(hScreen);
+}
+
+void TmpPanel::ApplyStatInfo(PluginPanelItem &Item, const TmpStatInfo &StatInfo)
+{
+	if (StatInfo.Attributes != INVALID_FILE_ATTRIBUTES)
+		StatInfo.ToFindData(Item.FindData);
+	else if (Opt.AnyInPanel)
+		Item.FindData.dwFileAttributes = FILE_ATTRIBUTE_ARCHIVE;
+	else
+		Item.Flags|= REMOVE_FLAG;
+}
+
+void TmpPanel::ApplyBackgroundRefresh()
+{
+	std::vector<std::pair<std::string, TmpStatInfo>> Results;
+	bool Done;
+	if (!Refresher.FetchBackground(Results, Done))
+		return;
+
+	IfOptCommonPanel();
+	std::unordered_map<std::string, const TmpStatInfo *> ResultsMap;
+	for (const auto &Result : Results)
+		ResultsMap.emplace(Result.first, &Result.second);
+
+	std::string Path;
+	struct PluginPanelItem *CurItem = TmpPanelItem;
+	for (int i = 0; i < TmpItemsNumber; i++, CurItem++) {
+		if (!TmpStatRefresher::IsSuitablePath(CurItem->FindData.lpwszFileName))
+			continue;
+		Wide2MB(CurItem->FindData.lpwszFileName, Path);
+		auto it = ResultsMap.find(Path);
+		if (it != ResultsMap.end())
+			ApplyStatInfo(*CurItem, *it->second);
+	}
+	RemoveEmptyItems();
+
+	UpdateNotNeeded = TRUE;
+	Info.Control(this, FCTL_UPDATEPANEL, TRUE, 0);
+	Info.Control(this, FCTL_REDRAWPANEL, 0, 0);
 }
 
 int TmpPanel::ProcessEvent(int Event, void *)
 {
+	if (Event == FE_IDLE && Refresher.IsBackgroundBusy())
+		ApplyBackgroundRefresh();
+
 	if (Event == FE_CHANGEVIEWMODE) {
 		IfOptCommonPanel();
 
@@ -11,6 +11,7 @@ Temporary panel plugin class header file
 #define REMOVE_FLAG 1
 
 #include <farplug-wide.h>
+#include "TmpStat.hpp"
 
 class TmpPanel
 {
@@ -18,6 +19,8 @@ private:
 	void RemoveDups();
 	void RemoveEmptyItems();
 	void UpdateItems(int ShowOwners, int ShowGroups, int ShowLinks);
+	void ApplyStatInfo(PluginPanelItem &Item, const TmpStatInfo &StatInfo);
+	void ApplyBackgroundRefresh();
 	int IsOwnersDisplayed(LPCTSTR ColumnTypes);
 	int IsGroupsDisplayed(LPCTSTR ColumnTypes);
 	int IsLinksDisplayed(LPCTSTR ColumnTypes);
@@ -36,6 +39,7 @@ private:
 	int LastLinksRead;
 	int UpdateNotNeeded;
 	wchar_t* HostFile;
+	TmpStatRefresher Refresher;
 
 public:
 	TmpPanel(const wchar_t *pHostFile = nullptr);
@@ -0,0 +1,331 @@
+/*
+TMPSTAT.CPP
+
+Temporary panel items metadata refresher
+
+*/
+
+#include "TmpPanel.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TMP_STAT_CACHE_MSEC       2000
+#define TMP_STAT_MAX_THREADS      8
+#define TMP_STAT_ITEMS_PER_THREAD 64
+
+#ifdef O_PATH
+# define TMP_STAT_DIR_OPEN_FLAGS (O_PATH | O_DIRECTORY | O_CLOEXEC)
+#else
+# define TMP_STAT_DIR_OPEN_FLAGS (O_RDONLY | O_DIRECTORY | O_CLOEXEC)
+#endif
+
+struct TmpStatJob
+{
+	std::vector<std::string> Paths;
+	std::vector<TmpStatInfo> Infos;
+	std::vector<size_t> Order;	// индексы Paths, упорядоченные по родительскому каталогу
+	std::vector<std::pair<size_t, size_t>> Groups;	// диапазоны Order с общим каталогом
+	std::atomic<size_t> NextGroup{0};
+	std::atomic<bool> Cancel{false};
+	bool Background = false;
+
+	std::mutex Mutex;
+	std::vector<size_t> Completed;	// готовые, но еще не забранные группы
+	size_t GroupsFetched = 0;
+};
+
+namespace
+{
+	struct StatData
+	{
+		uint32_t Mode;
+		uint64_t Links;
+		uint64_t Size;
+		uint64_t Blocks;
+		struct timespec ATime, MTime, CTime;
+	};
+
+	bool StatAt(int DirFD, const char *Name, bool Follow, StatData &Data)
+	{
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+		// AT_STATX_DONT_SYNC - на сетевых ФС не ходить на сервер за тем, что уже есть в кэше ядра
+		struct statx stx;
+		if (statx(DirFD, Name, (Follow ? 0 : AT_SYMLINK_NOFOLLOW) | AT_STATX_DONT_SYNC, STATX_BASIC_STATS, &stx) != 0)
+			return false;
+
+		Data.Mode = stx.stx_mode;
+		Data.Links = stx.stx_nlink;
+		Data.Size = stx.stx_size;
+		Data.Blocks = stx.stx_blocks;
+		Data.ATime.tv_sec = stx.stx_atime.tv_sec;
+		Data.ATime.tv_nsec = stx.stx_atime.tv_nsec;
+		Data.MTime.tv_sec = stx.stx_mtime.tv_sec;
+		Data.MTime.tv_nsec = stx.stx_mtime.tv_nsec;
+		Data.CTime.tv_sec = stx.stx_ctime.tv_sec;
+		Data.CTime.tv_nsec = stx.stx_ctime.tv_nsec;
+#else
+		struct stat st;
+		if (fstatat(DirFD, Name, &st, Follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+			return false;
+
+		Data.Mode = st.st_mode;
+		Data.Links = st.st_nlink;
+		Data.Size = st.st_size;
+		Data.Blocks = st.st_blocks;
+# ifdef __APPLE__
+		Data.ATime = st.st_atimespec;
+		Data.MTime = st.st_mtimespec;
+		Data.CTime = st.st_ctimespec;
+# else
+		Data.ATime = st.st_atim;
+		Data.MTime = st.st_mtim;
+		Data.CTime = st.st_ctim;
+# endif
+#endif
+		return true;
+	}
+
+	// Те же правила, что у FindFirstFile: симлинк помечается REPARSE_POINT и
+	// описывается данными цели, битый - еще и BROKEN, с данными самой ссылки
+	void StatItem(int DirFD, const char *Name, TmpStatInfo &Info)
+	{
+		StatData Lnk, Dst;
+		if (!StatAt(DirFD, Name, false, Lnk)) {
+			Info.Attributes = INVALID_FILE_ATTRIBUTES;
+			return;
+		}
+
+		const StatData *Deref = &Lnk;
+		Info.Attributes = 0;
+		if ((Lnk.Mode & S_IFMT) == S_IFLNK) {
+			if (StatAt(DirFD, Name, true, Dst)) {
+				Info.Attributes = FILE_ATTRIBUTE_REPARSE_POINT;
+				Deref = &Dst;
+			} else {
+				Info.Attributes = FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_BROKEN;
+				Lnk.Size = 0;
+			}
+		}
+
+		Info.Attributes|= WINPORT(EvaluateAttributesA)(Deref->Mode, Name);
+		Info.UnixMode = Deref->Mode;
+		Info.NumberOfLinks = (DWORD)Deref->Links;
+		Info.FileSize = Deref->Size;
+		Info.PhysicalSize = Lnk.Blocks * 512;
+		WINPORT(FileTime_UnixToWin32)(Deref->CTime, &Info.CreationTime);
+		WINPORT(FileTime_UnixToWin32)(Deref->ATime, &Info.LastAccessTime);
+		WINPORT(FileTime_UnixToWin32)(Deref->MTime, &Info.LastWriteTime);
+	}
+
+	void PrepareJob(TmpStatJob &Job)
+	{
+		const size_t Count = Job.Paths.size();
+		std::vector<size_t> DirLens(Count);
+		for (size_t i = 0; i < Count; i++)
+			DirLens[i] = Job.Paths[i].rfind('/');
+
+		auto DirCompare = [&](size_t a, size_t b) {
+			return Job.Paths[a].compare(0, DirLens[a], Job.Paths[b], 0, DirLens[b]);
+		};
+
+		Job.Order.resize(Count);
+		for (size_t i = 0; i < Count; i++)
+			Job.Order[i] = i;
+		std::stable_sort(Job.Order.begin(), Job.Order.end(),
+				[&](size_t a, size_t b) { return DirCompare(a, b) < 0; });
+
+		for (size_t i = 0; i < Count;) {
+			size_t j = i + 1;
+			while (j < Count && DirCompare(Job.Order[i], Job.Order[j]) == 0)
+				j++;
+			Job.Groups.emplace_back(i, j);
+			i = j;
+		}
+
+		Job.Infos.resize(Count);
+	}
+
+	void StatGroups(TmpStatJob *Job)
+	{
+		while (!Job->Cancel) {
+			const size_t G = Job->NextGroup++;
+			if (G >= Job->Groups.size())
+				break;
+
+			const auto &Range = Job->Groups[G];
+			const std::string &First = Job->Paths[Job->Order[Range.first]];
+			const size_t Slash = First.rfind('/');
+
+			// одиночный элемент дешевле stat'нуть по полному пути, чем открывать каталог
+			int DirFD = -1;
+			if (Range.second - Range.first > 1) {
+				const std::string Dir = Slash ? First.substr(0, Slash) : std::string("/");
+				DirFD = open(Dir.c_str(), TMP_STAT_DIR_OPEN_FLAGS);
+			}
+
+			for (size_t i = Range.first; i != Range.second; i++) {
+				const size_t Index = Job->Order[i];
+				const char *Path = Job->Paths[Index].c_str();
+				if (DirFD != -1)
+					StatItem(DirFD, Path + Slash + 1, Job->Infos[Index]);
+				else
+					StatItem(AT_FDCWD, Path, Job->Infos[Index]);
+			}
+
+			if (DirFD != -1)
+				close(DirFD);
+
+			if (Job->Background) {
+				std::lock_guard<std::mutex> Lock(Job->Mutex);
+				Job->Completed.push_back(G);
+			}
+		}
+	}
+
+	size_t ThreadsFor(const TmpStatJob &Job)
+	{
+		size_t Threads = std::min((size_t)TMP_STAT_MAX_THREADS, (size_t)std::thread::hardware_concurrency());
+		Threads = std::min(Threads, Job.Paths.size() / TMP_STAT_ITEMS_PER_THREAD);
+		Threads = std::min(Threads, Job.Groups.size());
+		return std::max(Threads, (size_t)1);
+	}
+}
+
+void TmpStatInfo::ToFindData(FAR_FIND_DATA &FindData) const
+{
+	FindData.dwFileAttributes = Attributes;
+	FindData.dwUnixMode = UnixMode;
+	FindData.ftCreationTime = CreationTime;
+	FindData.ftLastAccessTime = LastAccessTime;
+	FindData.ftLastWriteTime = LastWriteTime;
+	FindData.nFileSize = FileSize;
+	FindData.nPhysicalSize = PhysicalSize;
+}
+
+TmpStatRefresher::TmpStatRefresher()
+{
+}
+
+TmpStatRefresher::~TmpStatRefresher()
+{
+	if (BgJob)
+		BgJob->Cancel = true;
+	JoinBackground();
+}
+
+void TmpStatRefresher::JoinBackground()
+{
+	for (auto &Thread : BgThreads)
+		Thread.join();
+	BgThreads.clear();
+	BgJob.reset();
+}
+
+bool TmpStatRefresher::IsSuitablePath(const wchar_t *Path)
+{
+	if (Path[0] != GOOD_SLASH || !Path[1])
+		return false;
+
+	for (const wchar_t *p = Path; *p; p++) {
+		if (*p == L'$')
+			return false;
+		if (*p == GOOD_SLASH) {
+			if (p[1] == GOOD_SLASH || !p[1])
+				return false;
+			if (p[1] == L'.' && (p[2] == GOOD_SLASH || !p[2]
+						|| (p[2] == L'.' && (p[3] == GOOD_SLASH || !p[3]))))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool TmpStatRefresher::LookupCache(const std::string &Path, TmpStatInfo &Info)
+{
+	auto it = Cache.find(Path);
+	if (it == Cache.end() || GetTickCount() - it->second.second >= TMP_STAT_CACHE_MSEC)
+		return false;
+
+	Info = it->second.first;
+	return true;
+}
+
+void TmpStatRefresher::PurgeCache()
+{
+	const DWORD Now = GetTickCount();
+	for (auto it = Cache.begin(); it != Cache.end();) {
+		if (Now - it->second.second >= TMP_STAT_CACHE_MSEC)
+			it = Cache.erase(it);
+		else
+			++it;
+	}
+}
+
+void TmpStatRefresher::StatNow(const std::vector<std::string> &Paths, std::vector<TmpStatInfo> &Infos)
+{
+	TmpStatJob Job;
+	Job.Paths = Paths;
+	PrepareJob(Job);
+
+	std::vector<std::thread> Threads;
+	for (size_t i = ThreadsFor(Job); i > 1; i--)
+		Threads.emplace_back(StatGroups, &Job);
+	StatGroups(&Job);
+	for (auto &Thread : Threads)
+		Thread.join();
+
+	const DWORD Now = GetTickCount();
+	for (size_t i = 0; i < Job.Paths.size(); i++)
+		Cache[Job.Paths[i]] = std::make_pair(Job.Infos[i], Now);
+
+	Infos.swap(Job.Infos);
+}
+
+bool TmpStatRefresher::StartBackground(std::vector<std::string> &&Paths)
+{
+	if (BgJob)
+		return false;
+
+	BgJob.reset(new TmpStatJob);
+	BgJob->Paths.swap(Paths);
+	BgJob->Background = true;
+	PrepareJob(*BgJob);
+
+	for (size_t i = ThreadsFor(*BgJob); i > 0; i--)
+		BgThreads.emplace_back(StatGroups, BgJob.get());
+
+	return true;
+}
+
+bool TmpStatRefresher::FetchBackground(std::vector<std::pair<std::string, TmpStatInfo>> &Results, bool &Done)
+{
+	Done = !BgJob;
+	if (Done)
+		return false;
+
+	std::vector<size_t> Completed;
+	{
+		std::lock_guard<std::mutex> Lock(BgJob->Mutex);
+		Completed.swap(BgJob->Completed);
+	}
+
+	const DWORD Now = GetTickCount();
+	for (size_t G : Completed) {
+		const auto &Range = BgJob->Groups[G];
+		for (size_t i = Range.first; i != Range.second; i++) {
+			const size_t Index = BgJob->Order[i];
+			Cache[BgJob->Paths[Index]] = std::make_pair(BgJob->Infos[Index], Now);
+			Results.emplace_back(BgJob->Paths[Index], BgJob->Infos[Index]);
+		}
+	}
+
+	BgJob->GroupsFetched+= Completed.size();
+	if (BgJob->GroupsFetched == BgJob->Groups.size()) {
+		JoinBackground();
+		Done = true;
+	}
+
+	return !Completed.empty();
+}
@@ -0,0 +1,74 @@
+/*
+TMPSTAT.HPP
+
+Temporary panel items metadata refresher
+
+*/
+
+#ifndef __TMPSTAT_HPP__
+#define __TMPSTAT_HPP__
+
+#include <windows.h>
+#include <farplug-wide.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Результат stat() одного элемента панели в том же виде, что дает FindFirstFile:
+// для симлинков - атрибуты и данные цели, размер на диске - самой ссылки
+struct TmpStatInfo
+{
+	DWORD Attributes;	// INVALID_FILE_ATTRIBUTES если файла нет
+	DWORD UnixMode;
+	DWORD NumberOfLinks;
+	uint64_t FileSize;
+	uint64_t PhysicalSize;
+	FILETIME CreationTime;
+	FILETIME LastAccessTime;
+	FILETIME LastWriteTime;
+
+	void ToFindData(FAR_FIND_DATA &FindData) const;
+};
+
+struct TmpStatJob;
+
+// Обновляет метаданные элементов пачкой: пути группируются по родительскому
+// каталогу, каждый каталог открывается один раз и его элементы stat'ятся
+// относительно него (statx где есть), группы разбираются несколькими потоками.
+// Результаты кэшируются на короткое время, чтобы повторные GetFindData
+// (перерисовки, смена режима) не повторяли всю работу.
+class TmpStatRefresher
+{
+	std::unordered_map<std::string, std::pair<TmpStatInfo, DWORD>> Cache;
+	std::unique_ptr<TmpStatJob> BgJob;
+	std::vector<std::thread> BgThreads;
+
+	void JoinBackground();
+
+public:
+	TmpStatRefresher();
+	~TmpStatRefresher();
+
+	// Путь может быть обработан здесь: абсолютный, нормализованный и не требующий
+	// раскрытия переменных окружения, иначе - GetFileInfoAndValidate
+	static bool IsSuitablePath(const wchar_t *Path);
+
+	bool LookupCache(const std::string &Path, TmpStatInfo &Info);
+	void PurgeCache();
+
+	// Блокирующий вариант - возвращает управление когда все пути обработаны
+	void StatNow(const std::vector<std::string> &Paths, std::vector<TmpStatInfo> &Infos);
+
+	// Фоновый вариант - готовые результаты забираются FetchBackground по мере
+	// готовности, пока он идет новый не запускается
+	bool StartBackground(std::vector<std::string> &&Paths);
+	bool IsBackgroundBusy() const { return !!BgJob; }
+	// Возвращает false если ничего нового не готово; Done - фоновая работа завершена
+	bool FetchBackground(std::vector<std::pair<std::string, TmpStatInfo>> &Results, bool &Done);
+};
+
+#endif	/* __TMPSTAT_HPP__ */
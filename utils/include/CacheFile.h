@@ -0,0 +1,38 @@
+#pragma once
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// Helpers for files that keep in cache dir some data derived from other big file, like index or
+// listing, that is expensive to rebuild. Cache file is identified by device and inode of source
+// file and starts with stamp that allows to detect that source file was changed since then.
+
+struct CacheFileStamp
+{
+	char Magic[8];
+	uint64_t Size;
+	int64_t MTimeSec;
+	int64_t MTimeNSec;
+
+	void Fill(const char (&magic)[8], const struct stat &s);
+
+	// true if stamp is of given format and describes source file in same state as s
+	bool Matches(const char (&magic)[8], const struct stat &s) const;
+};
+
+// path of cache file within subdir of cache dir for source file with given stat
+std::string CacheFilePath(const char *subdir, const struct stat &s, const char *ext);
+
+// creates uniquely named temporary file next to path and returns its name in tmp_path,
+// so concurrent writers of same cache file don't mix their data; it becomes cache file
+// on path only when CacheFileCommit succeeds
+FILE *CacheFileCreate(const std::string &path, std::string &tmp_path);
+
+// closes f, then if ok and everything was written - atomically replaces cache file by it and
+// removes least recently used files in same dir so no more than files_limit of them remain,
+// otherwise removes temporary file; returns true on success
+bool CacheFileCommit(FILE *f, const std::string &tmp_path, const std::string &path, bool ok, size_t files_limit);
+
+// refreshes usage time of cache file, so eviction removes least recently used files
+void CacheFileTouch(const std::string &path);
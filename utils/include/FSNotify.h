@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <functional>
 
 struct IFSNotify
 {
@@ -13,4 +14,6 @@ enum FSNotifyWhat
 	FSNW_NAMES_AND_STATS
 };
 
-IFSNotify *IFSNotify_Create(const std::string &pathname, bool watch_subtree, FSNotifyWhat what);
+// optional on_change invoked from watcher thread once, when first change detected
+IFSNotify *IFSNotify_Create(const std::string &pathname, bool watch_subtree, FSNotifyWhat what,
+	std::function<void()> on_change = nullptr);
@@ -0,0 +1,111 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "CacheFile.h"
+#include "utils.h"
+
+void CacheFileStamp::Fill(const char (&magic)[8], const struct stat &s)
+{
+	memcpy(Magic, magic, sizeof(Magic));
+	Size = s.st_size;
+	MTimeSec = s.st_mtim.tv_sec;
+	MTimeNSec = s.st_mtim.tv_nsec;
+}
+
+bool CacheFileStamp::Matches(const char (&magic)[8], const struct stat &s) const
+{
+	return memcmp(Magic, magic, sizeof(Magic)) == 0 && Size == (uint64_t)s.st_size
+		&& MTimeSec == (int64_t)s.st_mtim.tv_sec && MTimeNSec == (int64_t)s.st_mtim.tv_nsec;
+}
+
+std::string CacheFilePath(const char *subdir, const struct stat &s, const char *ext)
+{
+	return InMyCache(StrPrintf("%s/%llx-%llx.%s", subdir,
+		(unsigned long long)s.st_dev, (unsigned long long)s.st_ino, ext).c_str());
+}
+
+#define CACHE_FILE_TEMP_INFIX ".tmp."
+
+// temporary files not renamed for so long are leftovers of crashed writers
+static const time_t CacheFileTempMaxAge = 3600;
+
+FILE *CacheFileCreate(const std::string &path, std::string &tmp_path)
+{
+	tmp_path = path + CACHE_FILE_TEMP_INFIX "XXXXXX";
+	const int fd = mkstemp(&tmp_path[0]);
+	FILE *f = (fd != -1) ? fdopen(fd, "wb") : nullptr;
+	if (!f) {
+		fprintf(stderr, "%s: error %u creating '%s'\n", __FUNCTION__, errno, tmp_path.c_str());
+		if (fd != -1) {
+			close(fd);
+			unlink(tmp_path.c_str());
+		}
+	}
+	return f;
+}
+
+static void CacheFilesEvict(const std::string &dir, size_t files_limit)
+{
+	DIR *d = opendir(dir.c_str());
+	if (!d) {
+		return;
+	}
+
+	const time_t now = time(NULL);
+	std::vector<std::pair<time_t, std::string> > files;
+	while (struct dirent *de = readdir(d)) {
+		struct stat s{};
+		std::string path = dir + "/" + de->d_name;
+		if (de->d_name[0] == '.' || stat(path.c_str(), &s) != 0 || !S_ISREG(s.st_mode)) {
+			continue;
+		}
+		if (strstr(de->d_name, CACHE_FILE_TEMP_INFIX)) {
+			// don't interfere with other process that is writing cache file right now
+			if (now - s.st_mtime > CacheFileTempMaxAge) {
+				unlink(path.c_str());
+			}
+			continue;
+		}
+		files.emplace_back(s.st_mtime, std::move(path));
+	}
+	closedir(d);
+
+	if (files.size() > files_limit) {
+		std::sort(files.begin(), files.end());
+		for (size_t i = 0; i < files.size() - files_limit; ++i) {
+			unlink(files[i].second.c_str());
+		}
+	}
+}
+
+bool CacheFileCommit(FILE *f, const std::string &tmp_path, const std::string &path, bool ok, size_t files_limit)
+{
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+
+	if (!ok || rename(tmp_path.c_str(), path.c_str()) == -1) {
+		fprintf(stderr, "%s: error %u writing '%s'\n", __FUNCTION__, errno, path.c_str());
+		unlink(tmp_path.c_str());
+		return false;
+	}
+
+	const size_t slash = path.rfind('/');
+	if (slash != std::string::npos) {
+		CacheFilesEvict(path.substr(0, slash), files_limit);
+	}
+	return true;
+}
+
+void CacheFileTouch(const std::string &path)
+{
+	utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+}
@@ -28,7 +28,7 @@
 class FSNotify : public IFSNotify
 { // dummy implementation that doesnt watch for changes
 	public:
-		FSNotify(const std::string &pathname, bool watch_subtree, FSNotifyWhat what) {}
+		FSNotify(const std::string &pathname, bool watch_subtree, FSNotifyWhat what, std::function<void()> on_change) {}
 		virtual bool Check() const noexcept { return false; }
 };
 
@@ -45,8 +45,16 @@ class FSNotify : public IFSNotify
 	FSNotifyWhat _what;
 	std::atomic<bool> _watching{false};
 	std::atomic<bool> _change_notified{false};
+	std::function<void()> _on_change;
 	int _pipe[2];
 
+	void OnChange()
+	{
+		if (!_change_notified.exchange(true) && _on_change) {
+			_on_change();
+		}
+	}
+
 
 	void AddWatch(const char *path)
 	{
@@ -122,7 +130,7 @@ class FSNotify : public IFSNotify
 		int nev = kevent(_fd, &_events[0], _events.size(), &ev, 1, nullptr);
 		if (nev > 0) {
 			if (ev.ident != _pipe[0]) {
-				_change_notified = true;
+				OnChange();
 			}
 		}
 #else
@@ -144,7 +152,7 @@ class FSNotify : public IFSNotify
 				r = read(_fd, &buf, sizeof(buf) - 1);
 				if (r > 0) {
 					//fprintf(stderr, "WatcherProc: triggered by %s\n", buf.ie.name);
-					_change_notified = true;
+					OnChange();
 
 				} else if (errno != EAGAIN && errno != EINTR) {
 					fprintf(stderr, "WatcherProc: event read error %u\n", errno);
@@ -164,9 +172,9 @@ class FSNotify : public IFSNotify
 	}
 
 public:
-	FSNotify(const std::string &pathname, bool watch_subtree, FSNotifyWhat what)
+	FSNotify(const std::string &pathname, bool watch_subtree, FSNotifyWhat what, std::function<void()> on_change)
 		:
-		_watcher(0), _fd(-1), _what(what)
+		_watcher(0), _fd(-1), _what(what), _on_change(on_change)
 	{
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__DragonFly__)
 		_fd = kqueue();
@@ -247,7 +255,8 @@ public:
 
 #endif
 
-IFSNotify *IFSNotify_Create(const std::string &pathname, bool watch_subtree, FSNotifyWhat what)
+IFSNotify *IFSNotify_Create(const std::string &pathname, bool watch_subtree, FSNotifyWhat what,
+	std::function<void()> on_change)
 {
-	return new FSNotify(pathname, watch_subtree, what);
+	return new FSNotify(pathname, watch_subtree, what, on_change);
 }